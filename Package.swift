@@ -9,11 +9,24 @@ let package = Package(
         .macOS(.v10_11)
     ],
     products: [
-        .library(name: "ShortcutRecorder", targets: ["ShortcutRecorder"])
+        .library(name: "ShortcutRecorder", targets: ["ShortcutRecorder"]),
+        .library(name: "ShortcutRecorderCore", targets: ["ShortcutRecorderCore"]),
+        .executable(name: "ShortcutRecorderCoreReplay", targets: ["ShortcutRecorderCoreReplay"])
     ],
     targets: [
+        .target(
+            name: "ShortcutRecorderCore",
+            linkerSettings: [
+                .linkedLibrary("m", .when(platforms: [.linux]))
+            ]
+        ),
+        .target(
+            name: "ShortcutRecorderCoreReplay",
+            dependencies: ["ShortcutRecorderCore"]
+        ),
         .target(
             name: "ShortcutRecorder",
+            dependencies: ["ShortcutRecorderCore"],
             exclude: [
                 "Info.plist",
                 "Resources/ShortcutRecorder.sketch",
@@ -32,6 +45,34 @@ let package = Package(
             exclude: [
                 "Info.plist"
             ]
+        ),
+        .testTarget(
+            name: "ShortcutRecorderCoreTests",
+            dependencies: ["ShortcutRecorderCore"]
+        ),
+        .target(
+            name: "ShortcutRecorderCoreBenchmarkSupport",
+            path: "Tests/ShortcutRecorderCoreBenchmarkSupport"
+        ),
+        .testTarget(
+            name: "ShortcutRecorderBenchmarks",
+            dependencies: ["ShortcutRecorder", "ShortcutRecorderCoreBenchmarkSupport"],
+            exclude: [
+                "Baseline.json"
+            ]
+        ),
+        .testTarget(
+            name: "ShortcutRecorderCoreBenchmarks",
+            dependencies: ["ShortcutRecorderCore", "ShortcutRecorderCoreBenchmarkSupport"],
+            exclude: [
+                "Baseline.json"
+            ]
         )
     ]
 )
+
+#if !canImport(AppKit)
+// Only the portable core builds without AppKit, e.g. on Linux.
+package.products = package.products.filter { $0.name.hasPrefix("ShortcutRecorderCore") }
+package.targets = package.targets.filter { $0.name.hasPrefix("ShortcutRecorderCore") }
+#endif
@@ -86,47 +86,9 @@
     BOOL isNumPad = [modifierFlagsString containsString:@"#"];
     if (isNumPad)
     {
-        switch (keyCode.unsignedShortValue)
-        {
-            case SRKeyCode0:
-                keyCode = @(SRKeyCodeKeypad0);
-                break;
-            case SRKeyCode1:
-                keyCode = @(SRKeyCodeKeypad1);
-                break;
-            case SRKeyCode2:
-                keyCode = @(SRKeyCodeKeypad2);
-                break;
-            case SRKeyCode3:
-                keyCode = @(SRKeyCodeKeypad3);
-                break;
-            case SRKeyCode4:
-                keyCode = @(SRKeyCodeKeypad4);
-                break;
-            case SRKeyCode5:
-                keyCode = @(SRKeyCodeKeypad5);
-                break;
-            case SRKeyCode6:
-                keyCode = @(SRKeyCodeKeypad6);
-                break;
-            case SRKeyCode7:
-                keyCode = @(SRKeyCodeKeypad7);
-                break;
-            case SRKeyCode8:
-                keyCode = @(SRKeyCodeKeypad8);
-                break;
-            case SRKeyCode9:
-                keyCode = @(SRKeyCodeKeypad9);
-                break;
-            case SRKeyCodeMinus:
-                keyCode = @(SRKeyCodeKeypadMinus);
-                break;
-            case SRKeyCodeEqual:
-                keyCode = @(SRKeyCodeKeypadEquals);
-                break;
-            default:
-                break;
-        }
+        SRKeyCode keypadKeyCode = [SRKeyCodeTransformer keypadKeyCodeForKeyCode:keyCode.unsignedShortValue];
+        if (keypadKeyCode != SRKeyCodeNone)
+            keyCode = @(keypadKeyCode);
     }
 
     NSString *characters = [SRASCIISymbolicKeyCodeTransformer.sharedTransformer transformedValue:keyCode
@@ -175,31 +137,7 @@
     SRKeyCode keyCodeValue = keyCode.unsignedShortValue;
     NSEventModifierFlags modifierFlagsValue = modifierFlags.unsignedIntegerValue;
 
-    BOOL isNumPad = NO;
-    switch (keyCodeValue)
-    {
-        case SRKeyCodeKeypad0:
-        case SRKeyCodeKeypad1:
-        case SRKeyCodeKeypad2:
-        case SRKeyCodeKeypad3:
-        case SRKeyCodeKeypad4:
-        case SRKeyCodeKeypad5:
-        case SRKeyCodeKeypad6:
-        case SRKeyCodeKeypad7:
-        case SRKeyCodeKeypad8:
-        case SRKeyCodeKeypad9:
-        case SRKeyCodeKeypadDecimal:
-        case SRKeyCodeKeypadMultiply:
-        case SRKeyCodeKeypadPlus:
-        case SRKeyCodeKeypadClear:
-        case SRKeyCodeKeypadDivide:
-        case SRKeyCodeKeypadEnter:
-        case SRKeyCodeKeypadMinus:
-        case SRKeyCodeKeypadEquals:
-            isNumPad = YES;
-        default:
-            break;
-    }
+    BOOL isNumPad = [SRKeyCodeTransformer isKeypadKeyCode:keyCodeValue];
 
     NSMutableString *keyBinding = [NSMutableString new];
 
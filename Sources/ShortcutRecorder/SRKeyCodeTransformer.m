@@ -5,6 +5,8 @@
 
 #import <os/trace.h>
 #import <os/activity.h>
+#import <mach/mach_time.h>
+#import <stdatomic.h>
 
 #import "ShortcutRecorder/SRCommon.h"
 #import "ShortcutRecorder/SRShortcut.h"
@@ -18,66 +20,1549 @@
 typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 
 
-@interface _SRKeyCodeTranslatorCacheKey : NSObject <NSCopying>
-@property (copy, readonly) NSString *identifier;
-@property (readonly) NSEventModifierFlags implicitModifierFlags;
-@property (readonly) NSEventModifierFlags explicitModifierFlags;
-@property (readonly) SRKeyCode keyCode;
-- (instancetype)initWithIdentifier:(NSString *)anIdentifier
-             implicitModifierFlags:(NSEventModifierFlags)anImplicitModifierFlags
-             explicitModifierFlags:(NSEventModifierFlags)anExplicitModifierFlags
-                           keyCode:(SRKeyCode)aKeyCode;
+/*!
+ Maximum length of a translation produced by UCKeyTranslate.
+ */
+#define _SRKeyCodeTranslationMaxLength 255
+
+
+/*!
+ Translate the key code into a string using the keyboard layout.
+
+ @param aModifierFlags Modifier flags that affect the translation.
+
+ @param aKeyboardType Physical keyboard type, usually LMGetKbdType().
+ */
+NS_INLINE NSString * _Nullable _SRKeyCodeTranslate(CFDataRef _Nullable aLayoutData,
+                                                   SRKeyCode aKeyCode,
+                                                   NSEventModifierFlags aModifierFlags,
+                                                   UInt32 aKeyboardType)
+{
+    if (!aLayoutData)
+    {
+        os_trace_error("#Error Input source misses the keyboard layout");
+        return nil;
+    }
+
+    const UCKeyboardLayout *keyLayout = (const UCKeyboardLayout *)CFDataGetBytePtr(aLayoutData);
+    UniCharCount actualLength = 0;
+    UniChar chars[_SRKeyCodeTranslationMaxLength] = {0};
+    UInt32 deadKeyState = 0;
+    OSStatus error = UCKeyTranslate(keyLayout,
+                                    aKeyCode,
+                                    kUCKeyActionDisplay,
+                                    SRCocoaToCarbonFlags(aModifierFlags) >> 8,
+                                    aKeyboardType,
+                                    kUCKeyTranslateNoDeadKeysBit,
+                                    &deadKeyState,
+                                    sizeof(chars) / sizeof(UniChar),
+                                    &actualLength,
+                                    chars);
+    if (error != noErr)
+    {
+        os_trace_error("#Error Unable to translate keyCode %hu and modifierFlags %lu: %d",
+                       aKeyCode,
+                       aModifierFlags,
+                       error);
+        return nil;
+    }
+    else if (actualLength == 0)
+    {
+        os_trace_debug("#Error No translation exists for keyCode %hu and modifierFlags %lu",
+                       aKeyCode,
+                       aModifierFlags);
+        return nil;
+    }
+
+    return [NSString stringWithCharacters:chars length:actualLength];
+}
+
+
+/*!
+ Translate the key code as if it was pressed after keys that left the dead key state.
+
+ @param ioDeadKeyState Dead key state before and after the key is pressed.
+
+ @return nil if the key is a dead key or produces nothing.
+ */
+NS_INLINE NSString * _Nullable _SRKeyCodeTranslateWithDeadKeyState(CFDataRef aLayoutData,
+                                                                   SRKeyCode aKeyCode,
+                                                                   NSEventModifierFlags aModifierFlags,
+                                                                   UInt32 aKeyboardType,
+                                                                   UInt32 *ioDeadKeyState)
+{
+    const UCKeyboardLayout *keyLayout = (const UCKeyboardLayout *)CFDataGetBytePtr(aLayoutData);
+    UniCharCount actualLength = 0;
+    UniChar chars[_SRKeyCodeTranslationMaxLength] = {0};
+    OSStatus error = UCKeyTranslate(keyLayout,
+                                    aKeyCode,
+                                    kUCKeyActionDown,
+                                    SRCocoaToCarbonFlags(aModifierFlags) >> 8,
+                                    aKeyboardType,
+                                    0,
+                                    ioDeadKeyState,
+                                    sizeof(chars) / sizeof(UniChar),
+                                    &actualLength,
+                                    chars);
+    if (error != noErr || actualLength == 0)
+        return nil;
+
+    return [NSString stringWithCharacters:chars length:actualLength];
+}
+
+
+/*!
+ Compare translations by their UTF-16 code units.
+ */
+NS_INLINE NSComparisonResult _SRKeyCodeTranslationCompare(const UniChar *aChars,
+                                                          NSUInteger aLength,
+                                                          const UniChar *anotherChars,
+                                                          NSUInteger anotherLength)
+{
+    NSUInteger length = MIN(aLength, anotherLength);
+
+    for (NSUInteger i = 0; i < length; ++i)
+    {
+        if (aChars[i] != anotherChars[i])
+            return aChars[i] < anotherChars[i] ? NSOrderedAscending : NSOrderedDescending;
+    }
+
+    if (aLength == anotherLength)
+        return NSOrderedSame;
+    else
+        return aLength < anotherLength ? NSOrderedAscending : NSOrderedDescending;
+}
+
+
+/*!
+ Key codes described by _SRKeyCodeInfoTable.
+ */
+#define _SRKeyCodeInfoCount 128
+
+/*!
+ Characters of reverse transformations are hashed modulo a number below this value.
+ */
+#define _SRKeyCodeCharacterMapCapacity 512
+
+
+/*!
+ What is known about a key code regardless of the input source.
+
+ @discussion
+ Zero-initialized fields mean the key does not have the property.
+ */
+typedef struct
+{
+    /*!
+     Literal that is longer than a glyph, e.g. F1.
+     */
+    __unsafe_unretained NSString * _Nullable name;
+
+    /*!
+     Whether the name is a key for SRLoc.
+     */
+    BOOL isNameLocalized;
+
+    /*!
+     Left-to-right literal, e.g. ⌫.
+     */
+    unichar glyph;
+
+    /*!
+     Key equivalent, e.g. NSBackspaceCharacter.
+     */
+    unichar symbol;
+
+    /*!
+     ANSI character that identifies the key in reverse transformations regardless of the input source.
+     */
+    unichar character;
+
+    /*!
+     Numeric keypad key that produces the same character.
+
+     @note SRKeyCodeA is not on the keypad: 0 means there is no such key.
+     */
+    SRKeyCode keypadKeyCode;
+
+    /*!
+     Whether the key is on the numeric keypad.
+     */
+    BOOL isKeypad;
+
+    /*!
+     Whether the key is in SRKeyCodeTransformer/specialKeyCodeToSymbolMapping.
+     */
+    BOOL isSpecial;
+} _SRKeyCodeInfo;
+
+
+/*!
+ Metadata of every key code that transformers handle without the input source.
+ */
+static const _SRKeyCodeInfo _SRKeyCodeInfoTable[_SRKeyCodeInfoCount] = {
+    [SRKeyCode0] = {.character = SRKeyCodeGlyphANSI0, .keypadKeyCode = SRKeyCodeKeypad0},
+    [SRKeyCode1] = {.character = SRKeyCodeGlyphANSI1, .keypadKeyCode = SRKeyCodeKeypad1},
+    [SRKeyCode2] = {.character = SRKeyCodeGlyphANSI2, .keypadKeyCode = SRKeyCodeKeypad2},
+    [SRKeyCode3] = {.character = SRKeyCodeGlyphANSI3, .keypadKeyCode = SRKeyCodeKeypad3},
+    [SRKeyCode4] = {.character = SRKeyCodeGlyphANSI4, .keypadKeyCode = SRKeyCodeKeypad4},
+    [SRKeyCode5] = {.character = SRKeyCodeGlyphANSI5, .keypadKeyCode = SRKeyCodeKeypad5},
+    [SRKeyCode6] = {.character = SRKeyCodeGlyphANSI6, .keypadKeyCode = SRKeyCodeKeypad6},
+    [SRKeyCode7] = {.character = SRKeyCodeGlyphANSI7, .keypadKeyCode = SRKeyCodeKeypad7},
+    [SRKeyCode8] = {.character = SRKeyCodeGlyphANSI8, .keypadKeyCode = SRKeyCodeKeypad8},
+    [SRKeyCode9] = {.character = SRKeyCodeGlyphANSI9, .keypadKeyCode = SRKeyCodeKeypad9},
+    [SRKeyCodeEqual] = {.character = SRKeyCodeGlyphANSIEqual, .keypadKeyCode = SRKeyCodeKeypadEquals},
+    [SRKeyCodeMinus] = {.character = SRKeyCodeGlyphANSIMinus, .keypadKeyCode = SRKeyCodeKeypadMinus},
+    [SRKeyCodeSlash] = {.character = SRKeyCodeGlyphANSISlash, .keypadKeyCode = SRKeyCodeKeypadDivide},
+    [SRKeyCodePeriod] = {.character = SRKeyCodeGlyphANSIPeriod, .keypadKeyCode = SRKeyCodeKeypadDecimal},
+    [SRKeyCodeKeypad0] = {.isKeypad = YES},
+    [SRKeyCodeKeypad1] = {.isKeypad = YES},
+    [SRKeyCodeKeypad2] = {.isKeypad = YES},
+    [SRKeyCodeKeypad3] = {.isKeypad = YES},
+    [SRKeyCodeKeypad4] = {.isKeypad = YES},
+    [SRKeyCodeKeypad5] = {.isKeypad = YES},
+    [SRKeyCodeKeypad6] = {.isKeypad = YES},
+    [SRKeyCodeKeypad7] = {.isKeypad = YES},
+    [SRKeyCodeKeypad8] = {.isKeypad = YES},
+    [SRKeyCodeKeypad9] = {.isKeypad = YES},
+    [SRKeyCodeKeypadDecimal] = {.isKeypad = YES},
+    [SRKeyCodeKeypadMultiply] = {.isKeypad = YES},
+    [SRKeyCodeKeypadPlus] = {.isKeypad = YES},
+    [SRKeyCodeKeypadDivide] = {.isKeypad = YES},
+    [SRKeyCodeKeypadMinus] = {.isKeypad = YES},
+    [SRKeyCodeKeypadEquals] = {.isKeypad = YES},
+    [SRKeyCodeKeypadClear] = {.glyph = SRKeyCodeGlyphPadClear, .symbol = NSClearLineFunctionKey, .isKeypad = YES, .isSpecial = YES},
+    [SRKeyCodeKeypadEnter] = {.glyph = SRKeyCodeGlyphReturn, .symbol = NSEnterCharacter, .isKeypad = YES, .isSpecial = YES},
+    [SRKeyCodeF1] = {.name = @"F1", .symbol = NSF1FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF2] = {.name = @"F2", .symbol = NSF2FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF3] = {.name = @"F3", .symbol = NSF3FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF4] = {.name = @"F4", .symbol = NSF4FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF5] = {.name = @"F5", .symbol = NSF5FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF6] = {.name = @"F6", .symbol = NSF6FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF7] = {.name = @"F7", .symbol = NSF7FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF8] = {.name = @"F8", .symbol = NSF8FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF9] = {.name = @"F9", .symbol = NSF9FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF10] = {.name = @"F10", .symbol = NSF10FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF11] = {.name = @"F11", .symbol = NSF11FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF12] = {.name = @"F12", .symbol = NSF12FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF13] = {.name = @"F13", .symbol = NSF13FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF14] = {.name = @"F14", .symbol = NSF14FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF15] = {.name = @"F15", .symbol = NSF15FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF16] = {.name = @"F16", .symbol = NSF16FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF17] = {.name = @"F17", .symbol = NSF17FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF18] = {.name = @"F18", .symbol = NSF18FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF19] = {.name = @"F19", .symbol = NSF19FunctionKey, .isSpecial = YES},
+    [SRKeyCodeF20] = {.name = @"F20", .symbol = NSF20FunctionKey, .isSpecial = YES},
+    [SRKeyCodeSpace] = {.name = @"Space", .isNameLocalized = YES, .glyph = SRKeyCodeGlyphSpace, .symbol = ' ', .isSpecial = YES},
+    [SRKeyCodeDelete] = {.glyph = SRKeyCodeGlyphDeleteLeft, .symbol = NSBackspaceCharacter, .isSpecial = YES},
+    [SRKeyCodeForwardDelete] = {.glyph = SRKeyCodeGlyphDeleteRight, .symbol = NSDeleteCharacter, .isSpecial = YES},
+    [SRKeyCodeLeftArrow] = {.glyph = SRKeyCodeGlyphLeftArrow, .symbol = NSLeftArrowFunctionKey, .isSpecial = YES},
+    [SRKeyCodeRightArrow] = {.glyph = SRKeyCodeGlyphRightArrow, .symbol = NSRightArrowFunctionKey, .isSpecial = YES},
+    [SRKeyCodeUpArrow] = {.glyph = SRKeyCodeGlyphUpArrow, .symbol = NSUpArrowFunctionKey, .isSpecial = YES},
+    [SRKeyCodeDownArrow] = {.glyph = SRKeyCodeGlyphDownArrow, .symbol = NSDownArrowFunctionKey, .isSpecial = YES},
+    [SRKeyCodeEnd] = {.glyph = SRKeyCodeGlyphSoutheastArrow, .symbol = NSEndFunctionKey, .isSpecial = YES},
+    [SRKeyCodeHome] = {.glyph = SRKeyCodeGlyphNorthwestArrow, .symbol = NSHomeFunctionKey, .isSpecial = YES},
+    [SRKeyCodeEscape] = {.glyph = SRKeyCodeGlyphEscape, .symbol = '\e', .isSpecial = YES},
+    [SRKeyCodePageDown] = {.glyph = SRKeyCodeGlyphPageDown, .symbol = NSPageDownFunctionKey, .isSpecial = YES},
+    [SRKeyCodePageUp] = {.glyph = SRKeyCodeGlyphPageUp, .symbol = NSPageUpFunctionKey, .isSpecial = YES},
+    [SRKeyCodeReturn] = {.glyph = SRKeyCodeGlyphReturnR2L, .symbol = NSCarriageReturnCharacter, .isSpecial = YES},
+    [SRKeyCodeTab] = {.glyph = SRKeyCodeGlyphTabRight, .symbol = NSTabCharacter, .isSpecial = YES},
+    [SRKeyCodeHelp] = {.name = @"?⃝", .symbol = NSHelpFunctionKey, .isSpecial = YES},
+    [SRKeyCodeJISUnderscore] = {.glyph = SRKeyCodeGlyphJISUnderscore, .symbol = SRKeyCodeGlyphJISUnderscore},
+    [SRKeyCodeJISKeypadComma] = {.glyph = SRKeyCodeGlyphJISComma, .symbol = SRKeyCodeGlyphJISComma},
+    [SRKeyCodeJISYen] = {.glyph = SRKeyCodeGlyphJISYen, .symbol = SRKeyCodeGlyphJISYen}
+};
+
+
+/*!
+ Known key codes in the order of preference of reverse transformations: the last one wins.
+ */
+static const SRKeyCode _SRKnownKeyCodes[] = {
+    SRKeyCode0,
+    SRKeyCode1,
+    SRKeyCode2,
+    SRKeyCode3,
+    SRKeyCode4,
+    SRKeyCode5,
+    SRKeyCode6,
+    SRKeyCode7,
+    SRKeyCode8,
+    SRKeyCode9,
+    SRKeyCodeA,
+    SRKeyCodeB,
+    SRKeyCodeBackslash,
+    SRKeyCodeC,
+    SRKeyCodeComma,
+    SRKeyCodeD,
+    SRKeyCodeE,
+    SRKeyCodeEqual,
+    SRKeyCodeF,
+    SRKeyCodeG,
+    SRKeyCodeGrave,
+    SRKeyCodeH,
+    SRKeyCodeI,
+    SRKeyCodeJ,
+    SRKeyCodeK,
+    SRKeyCodeKeypad0,
+    SRKeyCodeKeypad1,
+    SRKeyCodeKeypad2,
+    SRKeyCodeKeypad3,
+    SRKeyCodeKeypad4,
+    SRKeyCodeKeypad5,
+    SRKeyCodeKeypad6,
+    SRKeyCodeKeypad7,
+    SRKeyCodeKeypad8,
+    SRKeyCodeKeypad9,
+    SRKeyCodeKeypadDecimal,
+    SRKeyCodeKeypadDivide,
+    SRKeyCodeKeypadEnter,
+    SRKeyCodeKeypadEquals,
+    SRKeyCodeKeypadMinus,
+    SRKeyCodeKeypadMultiply,
+    SRKeyCodeKeypadPlus,
+    SRKeyCodeL,
+    SRKeyCodeLeftBracket,
+    SRKeyCodeM,
+    SRKeyCodeMinus,
+    SRKeyCodeN,
+    SRKeyCodeO,
+    SRKeyCodeP,
+    SRKeyCodePeriod,
+    SRKeyCodeQ,
+    SRKeyCodeQuote,
+    SRKeyCodeR,
+    SRKeyCodeRightBracket,
+    SRKeyCodeS,
+    SRKeyCodeSemicolon,
+    SRKeyCodeSlash,
+    SRKeyCodeT,
+    SRKeyCodeU,
+    SRKeyCodeV,
+    SRKeyCodeW,
+    SRKeyCodeX,
+    SRKeyCodeY,
+    SRKeyCodeZ,
+    SRKeyCodeDelete,
+    SRKeyCodeDownArrow,
+    SRKeyCodeEnd,
+    SRKeyCodeEscape,
+    SRKeyCodeF1,
+    SRKeyCodeF2,
+    SRKeyCodeF3,
+    SRKeyCodeF4,
+    SRKeyCodeF5,
+    SRKeyCodeF6,
+    SRKeyCodeF7,
+    SRKeyCodeF8,
+    SRKeyCodeF9,
+    SRKeyCodeF10,
+    SRKeyCodeF11,
+    SRKeyCodeF12,
+    SRKeyCodeF13,
+    SRKeyCodeF14,
+    SRKeyCodeF15,
+    SRKeyCodeF16,
+    SRKeyCodeF17,
+    SRKeyCodeF18,
+    SRKeyCodeF19,
+    SRKeyCodeF20,
+    SRKeyCodeForwardDelete,
+    SRKeyCodeHelp,
+    SRKeyCodeHome,
+    SRKeyCodeISOSection,
+    SRKeyCodeJISKeypadComma,
+    SRKeyCodeJISUnderscore,
+    SRKeyCodeJISYen,
+    SRKeyCodeLeftArrow,
+    SRKeyCodePageDown,
+    SRKeyCodePageUp,
+    SRKeyCodeReturn,
+    SRKeyCodeRightArrow,
+    SRKeyCodeSpace,
+    SRKeyCodeTab,
+    SRKeyCodeUpArrow
+};
+
+#define _SRKnownKeyCodeCount (sizeof(_SRKnownKeyCodes) / sizeof(_SRKnownKeyCodes[0]))
+
+
+/*!
+ Reverse transformation of a single character.
+
+ @discussion
+ The modulus is chosen so that every character has its own slot: lookup is a single comparison.
+ */
+typedef struct
+{
+    NSUInteger modulus;
+    unichar characters[_SRKeyCodeCharacterMapCapacity];
+    SRKeyCode keyCodes[_SRKeyCodeCharacterMapCapacity];
+} _SRKeyCodeCharacterMap;
+
+
+/*!
+ Find the smallest modulus that hashes the characters without collisions.
+
+ @param aCharacters Non-zero characters. The first key code of a repeated character wins.
+ */
+static void _SRKeyCodeCharacterMapInit(_SRKeyCodeCharacterMap *aMap,
+                                       const unichar *aCharacters,
+                                       const SRKeyCode *aKeyCodes,
+                                       NSUInteger aCount)
+{
+    for (NSUInteger modulus = MAX(aCount, 1); modulus <= _SRKeyCodeCharacterMapCapacity; ++modulus)
+    {
+        memset(aMap, 0, sizeof(*aMap));
+        BOOL isPerfect = YES;
+
+        for (NSUInteger i = 0; i < aCount && isPerfect; ++i)
+        {
+            NSUInteger slot = aCharacters[i] % modulus;
+
+            if (aMap->characters[slot] == 0)
+            {
+                aMap->characters[slot] = aCharacters[i];
+                aMap->keyCodes[slot] = aKeyCodes[i];
+            }
+            else if (aMap->characters[slot] != aCharacters[i])
+                isPerfect = NO;
+        }
+
+        if (isPerfect)
+        {
+            aMap->modulus = modulus;
+            return;
+        }
+    }
+
+    os_trace_error("#Critical Failed to hash characters of key codes");
+    memset(aMap, 0, sizeof(*aMap));
+}
+
+
+NS_INLINE SRKeyCode _SRKeyCodeCharacterMapGet(const _SRKeyCodeCharacterMap *aMap, unichar aCharacter)
+{
+    if (!aMap->modulus || !aCharacter)
+        return SRKeyCodeNone;
+
+    NSUInteger slot = aCharacter % aMap->modulus;
+    return aMap->characters[slot] == aCharacter ? aMap->keyCodes[slot] : SRKeyCodeNone;
+}
+
+
+/*!
+ Glyphs, ANSI characters and literal aliases.
+ */
+static _SRKeyCodeCharacterMap _SRKeyCodeLiteralMap;
+
+/*!
+ Key equivalents, ANSI characters and symbol aliases.
+ */
+static _SRKeyCodeCharacterMap _SRKeyCodeSymbolMap;
+
+static NSString *_SRKeyCodeGlyphStrings[_SRKeyCodeInfoCount];
+static NSString *_SRKeyCodeSymbolStrings[_SRKeyCodeInfoCount];
+
+
+/*!
+ Derive reverse maps and strings from _SRKeyCodeInfoTable once.
+ */
+static void _SRKeyCodeInfoLoad(void)
+{
+    static dispatch_once_t OnceToken;
+    dispatch_once(&OnceToken, ^{
+        unichar literals[_SRKeyCodeInfoCount * 2 + 1];
+        SRKeyCode literalKeyCodes[_SRKeyCodeInfoCount * 2 + 1];
+        NSUInteger literalCount = 0;
+
+        unichar symbols[_SRKeyCodeInfoCount * 2 + 1];
+        SRKeyCode symbolKeyCodes[_SRKeyCodeInfoCount * 2 + 1];
+        NSUInteger symbolCount = 0;
+
+        for (SRKeyCode keyCode = 0; keyCode < _SRKeyCodeInfoCount; ++keyCode)
+        {
+            __auto_type info = &_SRKeyCodeInfoTable[keyCode];
+
+            if (info->glyph)
+            {
+                _SRKeyCodeGlyphStrings[keyCode] = SRUnicharToString(info->glyph);
+                literals[literalCount] = info->glyph;
+                literalKeyCodes[literalCount++] = keyCode;
+            }
+
+            if (info->symbol)
+            {
+                _SRKeyCodeSymbolStrings[keyCode] = SRUnicharToString(info->symbol);
+                symbols[symbolCount] = info->symbol;
+                symbolKeyCodes[symbolCount++] = keyCode;
+            }
+
+            if (info->character)
+            {
+                literals[literalCount] = info->character;
+                literalKeyCodes[literalCount++] = keyCode;
+                symbols[symbolCount] = info->character;
+                symbolKeyCodes[symbolCount++] = keyCode;
+            }
+        }
+
+        literals[literalCount] = SRKeyCodeGlyphTabLeft;
+        literalKeyCodes[literalCount++] = SRKeyCodeTab;
+        symbols[symbolCount] = NSBackTabCharacter;
+        symbolKeyCodes[symbolCount++] = SRKeyCodeTab;
+
+        _SRKeyCodeCharacterMapInit(&_SRKeyCodeLiteralMap, literals, literalKeyCodes, literalCount);
+        _SRKeyCodeCharacterMapInit(&_SRKeyCodeSymbolMap, symbols, symbolKeyCodes, symbolCount);
+    });
+}
+
+
+NS_INLINE const _SRKeyCodeInfo *_SRKeyCodeInfoGet(SRKeyCode aKeyCode)
+{
+    static const _SRKeyCodeInfo Unknown = {0};
+    return aKeyCode < _SRKeyCodeInfoCount ? &_SRKeyCodeInfoTable[aKeyCode] : &Unknown;
+}
+
+
+/*!
+ Left-to-right literal of the key code that does not depend on the input source.
+ */
+NS_INLINE NSString * _Nullable _SRKeyCodeInfoLiteral(SRKeyCode aKeyCode)
+{
+    __auto_type info = _SRKeyCodeInfoGet(aKeyCode);
+
+    if (info->name)
+        return info->isNameLocalized ? SRLoc(info->name) : info->name;
+    else if (info->glyph)
+    {
+        _SRKeyCodeInfoLoad();
+        return _SRKeyCodeGlyphStrings[aKeyCode];
+    }
+    else
+        return nil;
+}
+
+
+/*!
+ Symbol of the key code that does not depend on the input source.
+ */
+NS_INLINE NSString * _Nullable _SRKeyCodeInfoSymbol(SRKeyCode aKeyCode)
+{
+    if (!_SRKeyCodeInfoGet(aKeyCode)->symbol)
+        return nil;
+
+    _SRKeyCodeInfoLoad();
+    return _SRKeyCodeSymbolStrings[aKeyCode];
+}
+
+
+/*!
+ Key code of the glyph or ANSI character, e.g. SRKeyCodeDelete for ⌫.
+ */
+NS_INLINE SRKeyCode _SRKeyCodeInfoKeyCodeForLiteral(unichar aCharacter)
+{
+    _SRKeyCodeInfoLoad();
+    return _SRKeyCodeCharacterMapGet(&_SRKeyCodeLiteralMap, aCharacter);
+}
+
+
+/*!
+ Key code of the key equivalent or ANSI character, e.g. SRKeyCodeDelete for NSBackspaceCharacter.
+ */
+NS_INLINE SRKeyCode _SRKeyCodeInfoKeyCodeForSymbol(unichar aCharacter)
+{
+    _SRKeyCodeInfoLoad();
+    return _SRKeyCodeCharacterMapGet(&_SRKeyCodeSymbolMap, aCharacter);
+}
+
+
+/*!
+ Translations are tabulated for virtual key codes below this value.
+ */
+#define _SRKeyCodeTranslationTableKeyCodeCount 128
+
+/*!
+ Every combination of SRCocoaModifierFlagsMask.
+ */
+#define _SRKeyCodeTranslationTableModifierFlagsCount 16
+
+/*!
+ 'SRKT'
+ */
+#define _SRKeyCodeTranslationTableMagic 0x544B5253
+
+/*!
+ Bump whenever the layout of the file or the way translations are made changes.
+ */
+#define _SRKeyCodeTranslationTableVersion 3
+
+/*!
+ Index of a missing translation.
+ */
+#define _SRKeyCodeTranslationTableNoString UINT16_MAX
+
+/*!
+ Layouts rarely have more than a dozen dead keys across all layers.
+ */
+#define _SRKeyCodeTranslationTableMaxDeadKeyCount 64
+
+/*!
+ Keys that follow a dead key are tabulated without modifier flags and with Shift.
+ */
+#define _SRKeyCodeTranslationTableComposeModifierFlagsCount 2
+
+
+/*!
+ On-disk representation of _SRKeyCodeTranslationTable.
+
+ @discussion
+ Integers are little-endian and positions are byte offsets from the start of the file:
+ the file is mapped and used in place at any address. Strings are stored once, as UTF-16,
+ and referenced by index.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t modifierFlagsCount;
+    uint16_t keyCodeCount;
+    uint16_t reserved;
+    uint32_t keyboardType;
+    uint64_t layoutHash;
+
+    /*!
+     uint16_t[modifierFlagsCount * keyCodeCount]: index of the translation or _SRKeyCodeTranslationTableNoString.
+     */
+    uint32_t translationsOffset;
+
+    uint32_t stringCount;
+
+    /*!
+     uint32_t[stringCount + 1]: index of the first UniChar of every string followed by the end of the last one.
+     */
+    uint32_t stringBoundsOffset;
+
+    /*!
+     UniChar[]
+     */
+    uint32_t stringsOffset;
+
+    /*!
+     _SRKeyCodeTranslationTableReverseEntry[reverseEntryCount] sorted by _SRKeyCodeTranslationCompare
+     and then by preference: fewer modifier flags first.
+     */
+    uint32_t reverseEntriesOffset;
+
+    uint32_t reverseEntryCount;
+
+    /*!
+     _SRKeyCodeTranslationTableDeadKey[deadKeyCount]
+     */
+    uint32_t deadKeysOffset;
+
+    uint32_t deadKeyCount;
+
+    /*!
+     uint16_t[deadKeyCount * composeModifierFlagsCount * keyCodeCount]: index of what the key produces
+     when pressed after the dead key or _SRKeyCodeTranslationTableNoString.
+     */
+    uint32_t composedTranslationsOffset;
+
+    uint32_t composeModifierFlagsCount;
+} _SRKeyCodeTranslationTableHeader;
+
+_Static_assert(sizeof(_SRKeyCodeTranslationTableHeader) == 64, "the header must not have padding");
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the file is read in place");
+
+
+/*!
+ Key code and modifier flags that produce a translation.
+ */
+typedef struct
+{
+    uint16_t stringIndex;
+    uint8_t keyCode;
+
+    /*!
+     Modifier flags shifted by 17 as in the table of translations.
+     */
+    uint8_t modifierFlagsIndex;
+} _SRKeyCodeTranslationTableReverseEntry;
+
+
+/*!
+ Key and modifier flags that start a compose sequence.
+ */
+typedef struct
+{
+    uint8_t keyCode;
+    uint8_t modifierFlagsIndex;
+} _SRKeyCodeTranslationTableDeadKey;
+
+
+/*!
+ FNV-1a of the keyboard layout and the keyboard type: both affect translations.
+ */
+NS_INLINE uint64_t _SRKeyCodeTranslationTableHash(CFDataRef aLayoutData, UInt32 aKeyboardType)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    const uint8_t *bytes = CFDataGetBytePtr(aLayoutData);
+    CFIndex length = CFDataGetLength(aLayoutData);
+
+    for (CFIndex i = 0; i < length; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3;
+
+    for (NSUInteger i = 0; i < sizeof(aKeyboardType); ++i)
+        hash = (hash ^ ((aKeyboardType >> (i * 8)) & 0xFF)) * 0x100000001b3;
+
+    return hash;
+}
+
+
+/*!
+ Whether the file has room for the array at the offset.
+ */
+NS_INLINE BOOL _SRKeyCodeTranslationTableIsRegionValid(NSUInteger aLength,
+                                                       uint32_t anOffset,
+                                                       uint64_t aCount,
+                                                       size_t anElementSize)
+{
+    return anOffset % anElementSize == 0 && (uint64_t)anOffset + aCount * anElementSize <= aLength;
+}
+
+
+/*!
+ Default directory of the cached translation tables.
+
+ @discussion
+ The Caches directory is shared by the app and its helpers unless they are sandboxed.
+ */
+NS_INLINE NSURL * _Nullable _SRKeyCodeTranslationTableDefaultCacheDirectoryURL(void)
+{
+    NSError *error = nil;
+    NSURL *cachesURL = [NSFileManager.defaultManager URLForDirectory:NSCachesDirectory
+                                                            inDomain:NSUserDomainMask
+                                                   appropriateForURL:nil
+                                                              create:NO
+                                                               error:&error];
+    if (!cachesURL)
+    {
+        os_trace_error_with_payload("#Error Unable to locate the caches directory", ^(xpc_object_t d) {
+            xpc_dictionary_set_string(d, "error", error.localizedDescription.UTF8String);
+        });
+        return nil;
+    }
+
+    return [cachesURL URLByAppendingPathComponent:@"com.kulakov.ShortcutRecorder/KeyCodeTranslations" isDirectory:YES];
+}
+
+
+/*!
+ Translations of every key code and combination of modifier flags of a keyboard layout.
+
+ @discussion
+ The table is immutable: lookups are an array index with neither locks nor allocations.
+ Equal translations share the same instance.
+
+ Tables are shared by the process and persisted in the Caches directory keyed by the hash of the layout,
+ so that subsequent launches skip UCKeyTranslate altogether. A stale or damaged file is regenerated.
+ */
+@interface _SRKeyCodeTranslationTable : NSObject
+
+/*!
+ Directory of the cached tables.
+
+ @discussion
+ Defaults to a subdirectory of Caches, setting nil restores it. Internal: tests point it to a temporary directory.
+ */
+@property (class, nullable, copy) NSURL *cacheDirectoryURL;
+
+/*!
+ Table of the keyboard layout of the input source on the keyboard of the given type, see LMGetKbdType.
+
+ @return nil if the input source has no keyboard layout.
+
+ @discussion
+ Tables are shared by the process.
+ */
++ (nullable instancetype)tableForInputSource:(TISInputSourceRef)anInputSource keyboardType:(UInt32)aKeyboardType;
+
+/*!
+ Read the table from the cache directory or build it and write it there in background.
+ */
++ (instancetype)tableWithLayoutData:(CFDataRef)aLayoutData keyboardType:(UInt32)aKeyboardType;
+
+/*!
+ Serialize translations of the keyboard layout.
+ */
++ (NSData *)dataWithLayoutData:(CFDataRef)aLayoutData keyboardType:(UInt32)aKeyboardType layoutHash:(uint64_t)aLayoutHash;
+
+/*!
+ @return nil if the data is malformed or was made for a different layout.
+ */
+- (nullable instancetype)initWithData:(NSData *)aData
+                           layoutHash:(uint64_t)aLayoutHash
+                         keyboardType:(UInt32)aKeyboardType NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ Whether the table was read from the cache directory rather than built.
+ */
+@property (readonly, getter=isCached) BOOL cached;
+
+/*!
+ Physical keyboard type the table was made for.
+ */
+@property (readonly) UInt32 keyboardType;
+
+- (nullable NSString *)translationForKeyCode:(SRKeyCode)aKeyCode modifierFlags:(NSEventModifierFlags)aModifierFlags;
+
+/*!
+ Key code among SRKeyCodeTransformer.knownKeyCodes whose translation without modifier flags is equal to the given.
+ */
+- (nullable NSNumber *)keyCodeForTranslation:(NSString *)aTranslation;
+
+/*!
+ Enumerate every known key code and combination of modifier flags that produce the translation.
+
+ @discussion
+ Combinations with fewer modifier flags come first.
+ */
+- (void)enumerateKeyCodesForTranslation:(NSString *)aTranslation
+                             usingBlock:(void (NS_NOESCAPE ^)(SRKeyCode aKeyCode, NSEventModifierFlags aModifierFlags, BOOL *outStop))aBlock;
+
+- (BOOL)isDeadKeyCode:(SRKeyCode)aKeyCode modifierFlags:(NSEventModifierFlags)aModifierFlags;
+
+/*!
+ What the key produces when pressed after the dead key.
+
+ @discussion
+ Only no modifier flags and Shift are tabulated for the key.
+ */
+- (nullable NSString *)translationForKeyCode:(SRKeyCode)aKeyCode
+                               modifierFlags:(NSEventModifierFlags)aModifierFlags
+                            afterDeadKeyCode:(SRKeyCode)aDeadKeyCode
+                               modifierFlags:(NSEventModifierFlags)aDeadKeyModifierFlags;
+
+@end
+
+
+@implementation _SRKeyCodeTranslationTable
+{
+    NSData *_data;
+    NSArray<NSString *> *_strings;
+    const uint16_t *_composedTranslations;
+    const uint32_t *_stringBounds;
+    const UniChar *_chars;
+    const _SRKeyCodeTranslationTableReverseEntry *_reverseEntries;
+    NSUInteger _reverseEntryCount;
+    NSString *_translations[_SRKeyCodeTranslationTableModifierFlagsCount * _SRKeyCodeTranslationTableKeyCodeCount];
+
+    /*!
+     Row of the dead key in _composedTranslations plus one.
+     */
+    uint8_t _deadKeyRows[_SRKeyCodeTranslationTableModifierFlagsCount * _SRKeyCodeTranslationTableKeyCodeCount];
+}
+
+static NSURL *_SRKeyCodeTranslationTableCacheDirectoryURL = nil;
+
++ (NSURL *)cacheDirectoryURL
+{
+    @synchronized (self)
+    {
+        if (_SRKeyCodeTranslationTableCacheDirectoryURL)
+            return _SRKeyCodeTranslationTableCacheDirectoryURL;
+    }
+
+    static NSURL *DefaultURL = nil;
+    static dispatch_once_t OnceToken;
+    dispatch_once(&OnceToken, ^{
+        DefaultURL = _SRKeyCodeTranslationTableDefaultCacheDirectoryURL();
+    });
+    return DefaultURL;
+}
+
++ (void)setCacheDirectoryURL:(NSURL *)newCacheDirectoryURL
+{
+    @synchronized (self)
+    {
+        _SRKeyCodeTranslationTableCacheDirectoryURL = [newCacheDirectoryURL copy];
+    }
+}
+
++ (instancetype)tableForInputSource:(TISInputSourceRef)anInputSource keyboardType:(UInt32)aKeyboardType
+{
+    static NSMutableDictionary<NSNumber *, _SRKeyCodeTranslationTable *> *Tables = nil;
+    static dispatch_once_t OnceToken;
+    dispatch_once(&OnceToken, ^{
+        Tables = [NSMutableDictionary new];
+    });
+
+    CFDataRef layoutData = TISGetInputSourceProperty(anInputSource, kTISPropertyUnicodeKeyLayoutData);
+
+    if (!layoutData)
+    {
+        os_trace_error("#Error Input source misses the keyboard layout");
+        return nil;
+    }
+
+    uint64_t layoutHash = _SRKeyCodeTranslationTableHash(layoutData, aKeyboardType);
+
+    @synchronized (Tables)
+    {
+        _SRKeyCodeTranslationTable *table = Tables[@(layoutHash)];
+
+        if (!table)
+        {
+            table = [self tableWithLayoutData:layoutData keyboardType:aKeyboardType];
+            Tables[@(layoutHash)] = table;
+        }
+
+        return table;
+    }
+}
+
++ (instancetype)tableWithLayoutData:(CFDataRef)aLayoutData keyboardType:(UInt32)aKeyboardType
+{
+    uint64_t layoutHash = _SRKeyCodeTranslationTableHash(aLayoutData, aKeyboardType);
+    NSString *fileName = [NSString stringWithFormat:@"%016llx.table", layoutHash];
+    NSURL *cacheURL = [self.cacheDirectoryURL URLByAppendingPathComponent:fileName isDirectory:NO];
+    _SRKeyCodeTranslationTable *table = nil;
+    NSData *data = nil;
+
+    if (cacheURL)
+        data = [NSData dataWithContentsOfURL:cacheURL options:NSDataReadingMappedIfSafe error:NULL];
+
+    if (data)
+    {
+        table = [[self alloc] initWithData:data layoutHash:layoutHash keyboardType:aKeyboardType];
+
+        if (table)
+            table->_cached = YES;
+        else
+            os_trace_debug("Discarding stale translation table");
+    }
+
+    if (!table)
+    {
+        os_trace_debug("Building translation table");
+        data = [self dataWithLayoutData:aLayoutData keyboardType:aKeyboardType layoutHash:layoutHash];
+        table = [[self alloc] initWithData:data layoutHash:layoutHash keyboardType:aKeyboardType];
+        NSAssert(table != nil, @"A freshly built table must be valid");
+
+        if (cacheURL)
+        {
+            dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                NSError *error = nil;
+                BOOL isWritten = [NSFileManager.defaultManager createDirectoryAtURL:cacheURL.URLByDeletingLastPathComponent
+                                                        withIntermediateDirectories:YES
+                                                                         attributes:nil
+                                                                              error:&error] &&
+                                 [data writeToURL:cacheURL options:NSDataWritingAtomic error:&error];
+
+                if (!isWritten)
+                {
+                    os_trace_error_with_payload("#Error Unable to cache the translation table", ^(xpc_object_t d) {
+                        xpc_dictionary_set_string(d, "error", error.localizedDescription.UTF8String);
+                    });
+                }
+            });
+        }
+    }
+
+    return table;
+}
+
++ (NSData *)dataWithLayoutData:(CFDataRef)aLayoutData keyboardType:(UInt32)aKeyboardType layoutHash:(uint64_t)aLayoutHash
+{
+    uint16_t translations[_SRKeyCodeTranslationTableModifierFlagsCount * _SRKeyCodeTranslationTableKeyCodeCount];
+    NSMutableArray<NSString *> *strings = [NSMutableArray new];
+    NSMutableDictionary<NSString *, NSNumber *> *stringIndices = [NSMutableDictionary new];
+
+    for (NSUInteger i = 0; i < _SRKeyCodeTranslationTableModifierFlagsCount; ++i)
+    {
+        NSEventModifierFlags modifierFlags = (NSEventModifierFlags)i << 17;
+
+        for (SRKeyCode keyCode = 0; keyCode < _SRKeyCodeTranslationTableKeyCodeCount; ++keyCode)
+        {
+            NSString *translation = _SRKeyCodeTranslate(aLayoutData, keyCode, modifierFlags, aKeyboardType);
+            NSNumber *stringIndex = nil;
+
+            if (translation)
+            {
+                stringIndex = stringIndices[translation];
+
+                if (!stringIndex)
+                {
+                    stringIndex = @(strings.count);
+                    stringIndices[translation] = stringIndex;
+                    [strings addObject:translation];
+                }
+            }
+
+            translations[i * _SRKeyCodeTranslationTableKeyCodeCount + keyCode] = stringIndex ?
+                stringIndex.unsignedShortValue :
+                _SRKeyCodeTranslationTableNoString;
+        }
+    }
+
+    // Compose sequences: a dead key followed by an unmodified or shifted key.
+    NSMutableData *deadKeys = [NSMutableData new];
+    NSMutableData *composedTranslations = [NSMutableData new];
+
+    for (NSUInteger i = 0; i < _SRKeyCodeTranslationTableModifierFlagsCount; ++i)
+    {
+        NSEventModifierFlags modifierFlags = (NSEventModifierFlags)i << 17;
+
+        for (SRKeyCode keyCode = 0; keyCode < _SRKeyCodeTranslationTableKeyCodeCount; ++keyCode)
+        {
+            UInt32 deadKeyState = 0;
+
+            if (_SRKeyCodeTranslateWithDeadKeyState(aLayoutData, keyCode, modifierFlags, aKeyboardType, &deadKeyState) ||
+                deadKeyState == 0)
+            {
+                continue;
+            }
+
+            if (deadKeys.length / sizeof(_SRKeyCodeTranslationTableDeadKey) == _SRKeyCodeTranslationTableMaxDeadKeyCount)
+            {
+                os_trace_error("#Error Too many dead keys");
+                break;
+            }
+
+            _SRKeyCodeTranslationTableDeadKey deadKey = {.keyCode = (uint8_t)keyCode, .modifierFlagsIndex = (uint8_t)i};
+            [deadKeys appendBytes:&deadKey length:sizeof(deadKey)];
+
+            for (NSUInteger j = 0; j < _SRKeyCodeTranslationTableComposeModifierFlagsCount; ++j)
+            {
+                NSEventModifierFlags composeModifierFlags = j ? NSEventModifierFlagShift : 0;
+
+                for (SRKeyCode composeKeyCode = 0; composeKeyCode < _SRKeyCodeTranslationTableKeyCodeCount; ++composeKeyCode)
+                {
+                    UInt32 composeDeadKeyState = deadKeyState;
+                    NSString *translation = _SRKeyCodeTranslateWithDeadKeyState(aLayoutData,
+                                                                                composeKeyCode,
+                                                                                composeModifierFlags,
+                                                                                aKeyboardType,
+                                                                                &composeDeadKeyState);
+                    uint16_t composedTranslation = _SRKeyCodeTranslationTableNoString;
+
+                    if (translation)
+                    {
+                        NSNumber *stringIndex = stringIndices[translation];
+
+                        if (!stringIndex)
+                        {
+                            stringIndex = @(strings.count);
+                            stringIndices[translation] = stringIndex;
+                            [strings addObject:translation];
+                        }
+
+                        composedTranslation = stringIndex.unsignedShortValue;
+                    }
+
+                    [composedTranslations appendBytes:&composedTranslation length:sizeof(composedTranslation)];
+                }
+            }
+        }
+    }
+
+    NSMutableData *stringBounds = [NSMutableData dataWithLength:sizeof(uint32_t)];
+    NSMutableData *chars = [NSMutableData new];
+
+    for (NSString *string in strings)
+    {
+        UniChar stringChars[_SRKeyCodeTranslationMaxLength];
+        [string getCharacters:stringChars range:NSMakeRange(0, string.length)];
+        [chars appendBytes:stringChars length:string.length * sizeof(UniChar)];
+
+        uint32_t stringBound = (uint32_t)(chars.length / sizeof(UniChar));
+        [stringBounds appendBytes:&stringBound length:sizeof(stringBound)];
+    }
+
+    // Every layer of the known key codes. Among equally modified keys the last known key code is preferred
+    // as it always was for the unmodified layer.
+    typedef struct
+    {
+        _SRKeyCodeTranslationTableReverseEntry entry;
+        NSUInteger rank;
+    } RankedEntry;
+
+    NSMutableData *rankedEntries = [NSMutableData new];
+
+    for (NSUInteger i = 0; i < _SRKeyCodeTranslationTableModifierFlagsCount; ++i)
+    {
+        for (NSUInteger j = _SRKnownKeyCodeCount; j-- > 0;)
+        {
+            SRKeyCode keyCode = _SRKnownKeyCodes[j];
+
+            if (keyCode >= _SRKeyCodeTranslationTableKeyCodeCount)
+                continue;
+
+            uint16_t stringIndex = translations[i * _SRKeyCodeTranslationTableKeyCodeCount + keyCode];
+
+            if (stringIndex == _SRKeyCodeTranslationTableNoString)
+                continue;
+
+            RankedEntry rankedEntry = {
+                .entry = {.stringIndex = stringIndex, .keyCode = (uint8_t)keyCode, .modifierFlagsIndex = (uint8_t)i},
+                .rank = _SRKnownKeyCodeCount - j
+            };
+            [rankedEntries appendBytes:&rankedEntry length:sizeof(rankedEntry)];
+        }
+    }
+
+    const uint32_t *bounds = stringBounds.bytes;
+    const UniChar *boundChars = chars.bytes;
+    NSUInteger reverseEntryCount = rankedEntries.length / sizeof(RankedEntry);
+    qsort_b(rankedEntries.mutableBytes, reverseEntryCount, sizeof(RankedEntry), ^int(const void *a, const void *b) {
+        const RankedEntry *aEntry = a;
+        const RankedEntry *bEntry = b;
+        uint16_t aIndex = aEntry->entry.stringIndex;
+        uint16_t bIndex = bEntry->entry.stringIndex;
+
+        if (aIndex != bIndex)
+        {
+            return (int)_SRKeyCodeTranslationCompare(boundChars + bounds[aIndex],
+                                                     bounds[aIndex + 1] - bounds[aIndex],
+                                                     boundChars + bounds[bIndex],
+                                                     bounds[bIndex + 1] - bounds[bIndex]);
+        }
+
+        int aFlagsCount = __builtin_popcount(aEntry->entry.modifierFlagsIndex);
+        int bFlagsCount = __builtin_popcount(bEntry->entry.modifierFlagsIndex);
+
+        if (aFlagsCount != bFlagsCount)
+            return aFlagsCount - bFlagsCount;
+        else if (aEntry->entry.modifierFlagsIndex != bEntry->entry.modifierFlagsIndex)
+            return aEntry->entry.modifierFlagsIndex - bEntry->entry.modifierFlagsIndex;
+        else
+            return aEntry->rank < bEntry->rank ? -1 : 1;
+    });
+
+    _SRKeyCodeTranslationTableHeader header = {
+        .magic = _SRKeyCodeTranslationTableMagic,
+        .version = _SRKeyCodeTranslationTableVersion,
+        .modifierFlagsCount = _SRKeyCodeTranslationTableModifierFlagsCount,
+        .keyCodeCount = _SRKeyCodeTranslationTableKeyCodeCount,
+        .keyboardType = aKeyboardType,
+        .layoutHash = aLayoutHash,
+        .stringCount = (uint32_t)strings.count,
+        .reverseEntryCount = (uint32_t)reverseEntryCount,
+        .deadKeyCount = (uint32_t)(deadKeys.length / sizeof(_SRKeyCodeTranslationTableDeadKey)),
+        .composeModifierFlagsCount = _SRKeyCodeTranslationTableComposeModifierFlagsCount
+    };
+    NSMutableData *data = [NSMutableData dataWithLength:sizeof(header)];
+
+    header.translationsOffset = (uint32_t)data.length;
+    [data appendBytes:translations length:sizeof(translations)];
+
+    header.stringBoundsOffset = (uint32_t)data.length;
+    [data appendData:stringBounds];
+
+    header.stringsOffset = (uint32_t)data.length;
+    [data appendData:chars];
+
+    header.reverseEntriesOffset = (uint32_t)data.length;
+    const RankedEntry *sortedEntries = rankedEntries.bytes;
+
+    for (NSUInteger i = 0; i < reverseEntryCount; ++i)
+        [data appendBytes:&sortedEntries[i].entry length:sizeof(_SRKeyCodeTranslationTableReverseEntry)];
+
+    header.deadKeysOffset = (uint32_t)data.length;
+    [data appendData:deadKeys];
+
+    header.composedTranslationsOffset = (uint32_t)data.length;
+    [data appendData:composedTranslations];
+
+    [data replaceBytesInRange:NSMakeRange(0, sizeof(header)) withBytes:&header];
+
+    return [data copy];
+}
+
+- (instancetype)initWithData:(NSData *)aData layoutHash:(uint64_t)aLayoutHash keyboardType:(UInt32)aKeyboardType
+{
+    self = [super init];
+
+    if (self)
+    {
+        _keyboardType = aKeyboardType;
+
+        const uint8_t *bytes = aData.bytes;
+        NSUInteger length = aData.length;
+        _SRKeyCodeTranslationTableHeader header;
+
+        if (length < sizeof(header))
+            return nil;
+
+        memcpy(&header, bytes, sizeof(header));
+
+        if (header.magic != _SRKeyCodeTranslationTableMagic ||
+            header.version != _SRKeyCodeTranslationTableVersion ||
+            header.modifierFlagsCount != _SRKeyCodeTranslationTableModifierFlagsCount ||
+            header.keyCodeCount != _SRKeyCodeTranslationTableKeyCodeCount ||
+            header.keyboardType != aKeyboardType ||
+            header.layoutHash != aLayoutHash ||
+            header.stringCount >= _SRKeyCodeTranslationTableNoString ||
+            header.deadKeyCount > _SRKeyCodeTranslationTableMaxDeadKeyCount ||
+            header.composeModifierFlagsCount != _SRKeyCodeTranslationTableComposeModifierFlagsCount)
+        {
+            return nil;
+        }
+
+        NSUInteger translationCount = _SRKeyCodeTranslationTableModifierFlagsCount * _SRKeyCodeTranslationTableKeyCodeCount;
+
+        if (!_SRKeyCodeTranslationTableIsRegionValid(length, header.translationsOffset, translationCount, sizeof(uint16_t)) ||
+            !_SRKeyCodeTranslationTableIsRegionValid(length, header.stringBoundsOffset, (uint64_t)header.stringCount + 1, sizeof(uint32_t)) ||
+            !_SRKeyCodeTranslationTableIsRegionValid(length, header.reverseEntriesOffset, header.reverseEntryCount, sizeof(_SRKeyCodeTranslationTableReverseEntry)) ||
+            !_SRKeyCodeTranslationTableIsRegionValid(length, header.deadKeysOffset, header.deadKeyCount, sizeof(_SRKeyCodeTranslationTableDeadKey)) ||
+            !_SRKeyCodeTranslationTableIsRegionValid(length,
+                                                     header.composedTranslationsOffset,
+                                                     (uint64_t)header.deadKeyCount * _SRKeyCodeTranslationTableComposeModifierFlagsCount * _SRKeyCodeTranslationTableKeyCodeCount,
+                                                     sizeof(uint16_t)))
+        {
+            return nil;
+        }
+
+        const uint32_t *stringBounds = (const uint32_t *)(bytes + header.stringBoundsOffset);
+        uint32_t charCount = stringBounds[header.stringCount];
+
+        if (!_SRKeyCodeTranslationTableIsRegionValid(length, header.stringsOffset, charCount, sizeof(UniChar)))
+            return nil;
+
+        const UniChar *chars = (const UniChar *)(bytes + header.stringsOffset);
+        NSMutableArray<NSString *> *strings = [NSMutableArray arrayWithCapacity:header.stringCount];
+
+        for (uint32_t i = 0; i < header.stringCount; ++i)
+        {
+            uint32_t begin = stringBounds[i];
+            uint32_t end = stringBounds[i + 1];
+
+            if (begin >= end || end > charCount || end - begin > _SRKeyCodeTranslationMaxLength)
+                return nil;
+
+            [strings addObject:[NSString stringWithCharacters:chars + begin length:end - begin]];
+        }
+
+        const uint16_t *translations = (const uint16_t *)(bytes + header.translationsOffset);
+
+        for (NSUInteger i = 0; i < translationCount; ++i)
+        {
+            if (translations[i] == _SRKeyCodeTranslationTableNoString)
+                continue;
+            else if (translations[i] >= header.stringCount)
+                return nil;
+
+            _translations[i] = strings[translations[i]];
+        }
+
+        const _SRKeyCodeTranslationTableReverseEntry *reverseEntries =
+            (const _SRKeyCodeTranslationTableReverseEntry *)(bytes + header.reverseEntriesOffset);
+
+        for (uint32_t i = 0; i < header.reverseEntryCount; ++i)
+        {
+            if (reverseEntries[i].stringIndex >= header.stringCount ||
+                reverseEntries[i].keyCode >= _SRKeyCodeTranslationTableKeyCodeCount ||
+                reverseEntries[i].modifierFlagsIndex >= _SRKeyCodeTranslationTableModifierFlagsCount)
+            {
+                return nil;
+            }
+        }
+
+        const _SRKeyCodeTranslationTableDeadKey *deadKeys =
+            (const _SRKeyCodeTranslationTableDeadKey *)(bytes + header.deadKeysOffset);
+
+        for (uint32_t i = 0; i < header.deadKeyCount; ++i)
+        {
+            if (deadKeys[i].keyCode >= _SRKeyCodeTranslationTableKeyCodeCount ||
+                deadKeys[i].modifierFlagsIndex >= _SRKeyCodeTranslationTableModifierFlagsCount)
+            {
+                return nil;
+            }
+
+            _deadKeyRows[deadKeys[i].modifierFlagsIndex * _SRKeyCodeTranslationTableKeyCodeCount + deadKeys[i].keyCode] = i + 1;
+        }
+
+        const uint16_t *composedTranslations = (const uint16_t *)(bytes + header.composedTranslationsOffset);
+        NSUInteger composedTranslationCount = header.deadKeyCount * _SRKeyCodeTranslationTableComposeModifierFlagsCount * _SRKeyCodeTranslationTableKeyCodeCount;
+
+        for (NSUInteger i = 0; i < composedTranslationCount; ++i)
+        {
+            if (composedTranslations[i] != _SRKeyCodeTranslationTableNoString && composedTranslations[i] >= header.stringCount)
+                return nil;
+        }
+
+        _data = aData;
+        _strings = [strings copy];
+        _composedTranslations = composedTranslations;
+        _stringBounds = stringBounds;
+        _chars = chars;
+        _reverseEntries = reverseEntries;
+        _reverseEntryCount = header.reverseEntryCount;
+    }
+
+    return self;
+}
+
+- (NSString *)translationForKeyCode:(SRKeyCode)aKeyCode modifierFlags:(NSEventModifierFlags)aModifierFlags
+{
+    NSParameterAssert(aKeyCode < _SRKeyCodeTranslationTableKeyCodeCount);
+    NSUInteger modifierFlagsIndex = (aModifierFlags & SRCocoaModifierFlagsMask) >> 17;
+    return _translations[modifierFlagsIndex * _SRKeyCodeTranslationTableKeyCodeCount + aKeyCode];
+}
+
+- (NSNumber *)keyCodeForTranslation:(NSString *)aTranslation
+{
+    __block NSNumber *keyCode = nil;
+    [self enumerateKeyCodesForTranslation:aTranslation usingBlock:^(SRKeyCode aKeyCode, NSEventModifierFlags aModifierFlags, BOOL *outStop) {
+        if (aModifierFlags == 0)
+            keyCode = @(aKeyCode);
+
+        *outStop = YES;
+    }];
+    return keyCode;
+}
+
+- (void)enumerateKeyCodesForTranslation:(NSString *)aTranslation
+                             usingBlock:(void (NS_NOESCAPE ^)(SRKeyCode, NSEventModifierFlags, BOOL *))aBlock
+{
+    NSUInteger length = aTranslation.length;
+
+    if (!length || length > _SRKeyCodeTranslationMaxLength)
+        return;
+
+    UniChar chars[_SRKeyCodeTranslationMaxLength];
+    [aTranslation getCharacters:chars range:NSMakeRange(0, length)];
+
+    // Lower bound: entries of the translation are adjacent.
+    NSUInteger low = 0;
+    NSUInteger high = _reverseEntryCount;
+
+    while (low < high)
+    {
+        NSUInteger middle = low + (high - low) / 2;
+
+        if ([self _compareReverseEntryAtIndex:middle withChars:chars length:length] == NSOrderedAscending)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    BOOL isStopped = NO;
+
+    for (NSUInteger i = low; i < _reverseEntryCount && !isStopped; ++i)
+    {
+        if ([self _compareReverseEntryAtIndex:i withChars:chars length:length] != NSOrderedSame)
+            break;
+
+        __auto_type entry = _reverseEntries[i];
+        aBlock(entry.keyCode, (NSEventModifierFlags)entry.modifierFlagsIndex << 17, &isStopped);
+    }
+}
+
+- (BOOL)isDeadKeyCode:(SRKeyCode)aKeyCode modifierFlags:(NSEventModifierFlags)aModifierFlags
+{
+    NSParameterAssert(aKeyCode < _SRKeyCodeTranslationTableKeyCodeCount);
+    NSUInteger modifierFlagsIndex = (aModifierFlags & SRCocoaModifierFlagsMask) >> 17;
+    return _deadKeyRows[modifierFlagsIndex * _SRKeyCodeTranslationTableKeyCodeCount + aKeyCode] != 0;
+}
+
+- (NSString *)translationForKeyCode:(SRKeyCode)aKeyCode
+                      modifierFlags:(NSEventModifierFlags)aModifierFlags
+                   afterDeadKeyCode:(SRKeyCode)aDeadKeyCode
+                      modifierFlags:(NSEventModifierFlags)aDeadKeyModifierFlags
+{
+    NSParameterAssert(aKeyCode < _SRKeyCodeTranslationTableKeyCodeCount);
+    NSParameterAssert(aDeadKeyCode < _SRKeyCodeTranslationTableKeyCodeCount);
+
+    NSUInteger deadKeyModifierFlagsIndex = (aDeadKeyModifierFlags & SRCocoaModifierFlagsMask) >> 17;
+    NSUInteger deadKeyRow = _deadKeyRows[deadKeyModifierFlagsIndex * _SRKeyCodeTranslationTableKeyCodeCount + aDeadKeyCode];
+    aModifierFlags &= SRCocoaModifierFlagsMask;
+
+    if (!deadKeyRow || (aModifierFlags & ~NSEventModifierFlagShift))
+        return nil;
+
+    NSUInteger composeModifierFlagsIndex = aModifierFlags ? 1 : 0;
+    NSUInteger i = ((deadKeyRow - 1) * _SRKeyCodeTranslationTableComposeModifierFlagsCount + composeModifierFlagsIndex) *
+        _SRKeyCodeTranslationTableKeyCodeCount + aKeyCode;
+    uint16_t stringIndex = _composedTranslations[i];
+    return stringIndex != _SRKeyCodeTranslationTableNoString ? _strings[stringIndex] : nil;
+}
+
+#pragma mark Private
+
+- (NSComparisonResult)_compareReverseEntryAtIndex:(NSUInteger)anIndex withChars:(const UniChar *)aChars length:(NSUInteger)aLength
+{
+    uint16_t stringIndex = _reverseEntries[anIndex].stringIndex;
+    uint32_t begin = _stringBounds[stringIndex];
+    return _SRKeyCodeTranslationCompare(_chars + begin, _stringBounds[stringIndex + 1] - begin, aChars, aLength);
+}
+
+@end
+
+
+NSNotificationName const SRKeyCodeTransformerInputSourceDidChangeNotification = @"SRKeyCodeTransformerInputSourceDidChange";
+
+
+/*!
+ Incremented whenever the selected keyboard input source changes.
+ */
+static _Atomic(NSUInteger) _SRKeyCodeInputSourceGeneration = 0;
+
+
+static void _onSelectedKeyboardInputSourceChange(CFNotificationCenterRef aCenter,
+                                                 void *anObserver,
+                                                 CFNotificationName aName,
+                                                 const void *anObject,
+                                                 CFDictionaryRef aUserInfo)
+{
+    os_trace_debug("Selected keyboard input source did change");
+    atomic_fetch_add(&_SRKeyCodeInputSourceGeneration, 1);
+
+    // Posted after the increment so that observers never see the previous input source.
+    [NSNotificationCenter.defaultCenter postNotificationName:SRKeyCodeTransformerInputSourceDidChangeNotification
+                                                      object:nil];
+}
+
+
+/*!
+ Current generation of the selected keyboard input source.
+
+ @discussion
+ The first call starts observing kTISNotifySelectedKeyboardInputSourceChanged.
+ */
+static NSUInteger _SRKeyCodeInputSourceGenerationGet(void)
+{
+    static dispatch_once_t OnceToken;
+    dispatch_once(&OnceToken, ^{
+        CFNotificationCenterAddObserver(CFNotificationCenterGetDistributedCenter(),
+                                        NULL,
+                                        _onSelectedKeyboardInputSourceChange,
+                                        kTISNotifySelectedKeyboardInputSourceChanged,
+                                        NULL,
+                                        CFNotificationSuspensionBehaviorCoalesce);
+    });
+
+    return atomic_load(&_SRKeyCodeInputSourceGeneration);
+}
+
+
+/*!
+ How long, in mach time units, the selected input source is assumed to stay the same while
+ kTISNotifySelectedKeyboardInputSourceChanged is not delivered.
+ */
+static uint64_t _SRKeyCodeInputSourceUnobservedLifetime(void)
+{
+    static uint64_t Lifetime = 0;
+    static dispatch_once_t OnceToken;
+    dispatch_once(&OnceToken, ^{
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        Lifetime = 100 * NSEC_PER_MSEC * timebase.denom / timebase.numer;
+    });
+    return Lifetime;
+}
+
+
+/*!
+ Whether the main run loop is running and thus delivers kTISNotifySelectedKeyboardInputSourceChanged.
+ */
+static BOOL _SRKeyCodeIsMainRunLoopRunning(void)
+{
+    CFRunLoopMode mode = CFRunLoopCopyCurrentMode(CFRunLoopGetMain());
+
+    if (!mode)
+        return NO;
+
+    CFRelease(mode);
+    return YES;
+}
+
+
+/*!
+ Input source along with its identifier and translation table.
+
+ @discussion
+ The input source and its identifier are IPC-backed and therefore read once.
+ */
+@interface _SRKeyCodeTranslatorInputSource : NSObject
+@property (readonly) id inputSource;
+@property (readonly, nullable) NSString *identifier;
+
+/*!
+ Generation of the selected keyboard input source when the input source was created.
+ */
+@property (readonly) NSUInteger generation;
+
+/*!
+ Mach time after which the input source must be queried again, UINT64_MAX while changes are observed.
+ */
+@property uint64_t expirationTime;
+
+- (instancetype)initWithInputSource:(id)anInputSource generation:(NSUInteger)aGeneration NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ Whether the input source may be used without querying the selected input source.
+ */
+- (BOOL)isValidForGeneration:(NSUInteger)aGeneration;
+
+/*!
+ Translation table of the input source last resolved by the translator if it was made for the keyboard type.
+ */
+- (nullable _SRKeyCodeTranslationTable *)tableForKeyboardType:(UInt32)aKeyboardType;
+
+/*!
+ Remember the resolved translation table.
+
+ @discussion
+ Tables are shared by the process and never deallocated, therefore the table is not retained.
+ */
+- (void)setTable:(_SRKeyCodeTranslationTable *)aTable;
 @end
 
 
-@implementation _SRKeyCodeTranslatorCacheKey
+@implementation _SRKeyCodeTranslatorInputSource
+{
+    _Atomic(const void *) _table;
+}
 
-- (instancetype)initWithIdentifier:(NSString *)anIdentifier
-             implicitModifierFlags:(NSEventModifierFlags)anImplicitModifierFlags
-             explicitModifierFlags:(NSEventModifierFlags)anExplicitModifierFlags
-                           keyCode:(SRKeyCode)aKeyCode
+- (instancetype)initWithInputSource:(id)anInputSource generation:(NSUInteger)aGeneration
 {
     self = [super init];
 
     if (self)
     {
-        _identifier = [anIdentifier copy];
-        _implicitModifierFlags = anImplicitModifierFlags & SRCocoaModifierFlagsMask;
-        _explicitModifierFlags = anExplicitModifierFlags & SRCocoaModifierFlagsMask;
-        _keyCode = aKeyCode;
+        _inputSource = anInputSource;
+        _generation = aGeneration;
+        _expirationTime = UINT64_MAX;
+        _identifier = [(__bridge NSString *)TISGetInputSourceProperty((__bridge TISInputSourceRef)anInputSource,
+                                                                      kTISPropertyInputSourceID) copy];
+        atomic_init(&_table, NULL);
     }
 
     return self;
 }
 
-- (id)copyWithZone:(NSZone *)aZone
+- (BOOL)isValidForGeneration:(NSUInteger)aGeneration
 {
-    return self;
+    if (_generation != aGeneration)
+        return NO;
+
+    uint64_t expirationTime = self.expirationTime;
+    return expirationTime == UINT64_MAX || mach_absolute_time() < expirationTime;
 }
 
-- (BOOL)isEqual:(_SRKeyCodeTranslatorCacheKey *)anObject
+- (_SRKeyCodeTranslationTable *)tableForKeyboardType:(UInt32)aKeyboardType
 {
-    return self.keyCode == anObject.keyCode &&
-        self.explicitModifierFlags == anObject.explicitModifierFlags &&
-        self.implicitModifierFlags == anObject.implicitModifierFlags &&
-        [self.identifier isEqual:anObject.identifier];
+    __unsafe_unretained _SRKeyCodeTranslationTable *table = (__bridge _SRKeyCodeTranslationTable *)atomic_load_explicit(&_table, memory_order_acquire);
+    return table.keyboardType == aKeyboardType ? table : nil;
 }
 
-- (NSUInteger)hash
+- (void)setTable:(_SRKeyCodeTranslationTable *)aTable
 {
-    NSUInteger implicitFlagsBitSize = 4;
-    NSUInteger explicitFlagsBitSize = 4;
-    NSUInteger keyCodeBitSize = sizeof(SRKeyCode) * CHAR_BIT;
-
-    NSUInteger identifierHash = _identifier.hash;
-    NSUInteger implicitFlagsHash = _implicitModifierFlags >> 17;
-    NSUInteger explicitFlagsHash = _explicitModifierFlags >> 17;
-    NSUInteger keyCodeHash = _keyCode;
-
-    return keyCodeHash |
-        (implicitFlagsHash << keyCodeBitSize) |
-        (explicitFlagsHash << (keyCodeBitSize + implicitFlagsBitSize)) |
-        (identifierHash << (keyCodeBitSize + implicitFlagsBitSize + explicitFlagsBitSize));
+    atomic_store_explicit(&_table, (__bridge const void *)aTable, memory_order_release);
 }
 
 @end
@@ -91,8 +1576,15 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 @property (class, readonly) _SRKeyCodeTranslator *shared;
 @property (readonly) _SRKeyCodeTransformerCacheInputSourceCreate inputSourceCreator;
 @property (readonly) id inputSource;
+
 /*!
  @param aCreator Lazily instantiates an instance of input source.
+
+ @discussion
+ The input source is created once and then again after kTISNotifySelectedKeyboardInputSourceChanged.
+ The notification is delivered via the main run loop: while it is not running the selected input source
+ is queried again when the cached one is older than 100ms. The identifier and the translation table are kept
+ if the selection did not change.
  */
 - (instancetype)initWithInputSourceCreator:(_SRKeyCodeTransformerCacheInputSourceCreate)aCreator NS_DESIGNATED_INITIALIZER;
 - (instancetype)initWithInputSource:(id)anInputSource NS_DESIGNATED_INITIALIZER;
@@ -100,14 +1592,43 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
                   implicitModifierFlags:(NSEventModifierFlags)anImplicitModifierFlags
                   explicitModifierFlags:(NSEventModifierFlags)anExplicitModifierFlags
                              usingCache:(BOOL)anIsUsingCache;
+
+/*!
+ Key code and the fewest modifier flags that produce the translation in any layer of the input source.
+ */
+- (nullable NSNumber *)keyCodeForTranslation:(NSString *)aTranslation
+                               modifierFlags:(nullable NSEventModifierFlags *)outModifierFlags;
+
+- (BOOL)isDeadKeyCode:(SRKeyCode)aKeyCode modifierFlags:(NSEventModifierFlags)aModifierFlags;
+
+/*!
+ Translate the key code pressed after the dead key using the compose sequences of the input source.
+ */
+- (nullable NSString *)translateKeyCode:(SRKeyCode)aKeyCode
+                          modifierFlags:(NSEventModifierFlags)aModifierFlags
+                       afterDeadKeyCode:(SRKeyCode)aDeadKeyCode
+                          modifierFlags:(NSEventModifierFlags)aDeadKeyModifierFlags;
+@end
+
+
+@interface _SRKeyCodeTranslator ()
+/*!
+ Translation tables by input source identifier and then by keyboard type.
+ Replaced, never mutated, when a new layout or keyboard appears.
+ */
+@property (atomic, copy) NSDictionary<NSString *, NSDictionary<NSNumber *, _SRKeyCodeTranslationTable *> *> *translationTables;
+
+/*!
+ Cached input source of the translator. Outdated when its generation differs from the current or it expires.
+ */
+@property (atomic, nullable) _SRKeyCodeTranslatorInputSource *currentInputSource;
+
+- (nullable _SRKeyCodeTranslatorInputSource *)_currentInputSource;
+- (nullable _SRKeyCodeTranslationTable *)_translationTableForInputSource:(_SRKeyCodeTranslatorInputSource *)anInputSource;
 @end
 
 
 @implementation _SRKeyCodeTranslator
-{
-    NSCache<_SRKeyCodeTranslatorCacheKey *, NSString *> *_translationCache;
-    id _inputSource;
-}
 
 + (_SRKeyCodeTranslator *)shared
 {
@@ -131,7 +1652,7 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
     if (self)
     {
         _inputSourceCreator = aCreator;
-        _translationCache = [NSCache new];
+        _translationTables = @{};
     }
 
     return self;
@@ -143,8 +1664,8 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 
     if (self)
     {
-        _inputSource = anInputSource;
-        _translationCache = [NSCache new];
+        _currentInputSource = [[_SRKeyCodeTranslatorInputSource alloc] initWithInputSource:anInputSource generation:0];
+        _translationTables = @{};
     }
 
     return self;
@@ -152,10 +1673,7 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 
 - (id)inputSource
 {
-    if (_inputSource)
-        return _inputSource;
-    else
-        return (__bridge_transfer id)_inputSourceCreator();
+    return [self _currentInputSource].inputSource;
 }
 
 - (nullable NSString *)translateKeyCode:(SRKeyCode)aKeyCode
@@ -167,9 +1685,8 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
         return @"";
 
     anImplicitModifierFlags &= SRCocoaModifierFlagsMask;
-    anExplicitModifierFlags &= SRCocoaModifierFlagsMask;
 
-    TISInputSourceRef inputSource = (__bridge TISInputSourceRef)self.inputSource;
+    __auto_type inputSource = [self _currentInputSource];
 
     if (!inputSource)
     {
@@ -177,77 +1694,181 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
         return nil;
     }
 
-    _SRKeyCodeTranslatorCacheKey *cacheKey = nil;
+    if (anIsUsingCache && aKeyCode < _SRKeyCodeTranslationTableKeyCodeCount)
+    {
+        __auto_type table = [self _translationTableForInputSource:inputSource];
+
+        if (table)
+            return [table translationForKeyCode:aKeyCode modifierFlags:anImplicitModifierFlags];
+    }
+
+    return _SRKeyCodeTranslate(TISGetInputSourceProperty((__bridge TISInputSourceRef)inputSource.inputSource,
+                                                         kTISPropertyUnicodeKeyLayoutData),
+                               aKeyCode,
+                               anImplicitModifierFlags,
+                               LMGetKbdType());
+}
+
+- (nullable NSNumber *)keyCodeForTranslation:(NSString *)aTranslation
+                               modifierFlags:(NSEventModifierFlags *)outModifierFlags
+{
+    __auto_type inputSource = [self _currentInputSource];
 
-    if (anIsUsingCache)
+    if (!inputSource)
     {
-        NSString *sourceIdentifier = (__bridge NSString *)TISGetInputSourceProperty(inputSource, kTISPropertyInputSourceID);
+        os_trace_error("#Critical Failed to create an input source");
+        return nil;
+    }
 
-        if (sourceIdentifier)
-        {
-            cacheKey = [[_SRKeyCodeTranslatorCacheKey alloc] initWithIdentifier:sourceIdentifier
-                                                          implicitModifierFlags:anImplicitModifierFlags
-                                                          explicitModifierFlags:anExplicitModifierFlags
-                                                                        keyCode:aKeyCode];
-        }
-        else
-            os_trace_error("#Error Input source misses an ID");
+    __block NSNumber *keyCode = nil;
+    [[self _translationTableForInputSource:inputSource] enumerateKeyCodesForTranslation:aTranslation
+                                                                              usingBlock:^(SRKeyCode aKeyCode, NSEventModifierFlags aModifierFlags, BOOL *outStop)
+    {
+        keyCode = @(aKeyCode);
+
+        if (outModifierFlags)
+            *outModifierFlags = aModifierFlags;
+
+        *outStop = YES;
+    }];
+    return keyCode;
+}
+
+- (BOOL)isDeadKeyCode:(SRKeyCode)aKeyCode modifierFlags:(NSEventModifierFlags)aModifierFlags
+{
+    if (aKeyCode >= _SRKeyCodeTranslationTableKeyCodeCount)
+        return NO;
+
+    __auto_type inputSource = [self _currentInputSource];
+
+    if (!inputSource)
+    {
+        os_trace_error("#Critical Failed to create an input source");
+        return NO;
+    }
+
+    return [[self _translationTableForInputSource:inputSource] isDeadKeyCode:aKeyCode modifierFlags:aModifierFlags];
+}
+
+- (nullable NSString *)translateKeyCode:(SRKeyCode)aKeyCode
+                          modifierFlags:(NSEventModifierFlags)aModifierFlags
+                       afterDeadKeyCode:(SRKeyCode)aDeadKeyCode
+                          modifierFlags:(NSEventModifierFlags)aDeadKeyModifierFlags
+{
+    if (aKeyCode >= _SRKeyCodeTranslationTableKeyCodeCount || aDeadKeyCode >= _SRKeyCodeTranslationTableKeyCodeCount)
+        return nil;
+
+    __auto_type inputSource = [self _currentInputSource];
+
+    if (!inputSource)
+    {
+        os_trace_error("#Critical Failed to create an input source");
+        return nil;
+    }
+
+    return [[self _translationTableForInputSource:inputSource] translationForKeyCode:aKeyCode
+                                                                        modifierFlags:aModifierFlags
+                                                                     afterDeadKeyCode:aDeadKeyCode
+                                                                        modifierFlags:aDeadKeyModifierFlags];
+}
+
+#pragma mark Private
+
+- (nullable _SRKeyCodeTranslatorInputSource *)_currentInputSource
+{
+    __auto_type currentInputSource = self.currentInputSource;
+
+    if (!_inputSourceCreator)
+        return currentInputSource;
+
+    NSUInteger generation = _SRKeyCodeInputSourceGenerationGet();
+
+    if ([currentInputSource isValidForGeneration:generation])
+        return currentInputSource;
+
+    // Without the main run loop changes go unnoticed: the input source expires instead.
+    uint64_t expirationTime = UINT64_MAX;
+
+    if (!_SRKeyCodeIsMainRunLoopRunning())
+        expirationTime = mach_absolute_time() + _SRKeyCodeInputSourceUnobservedLifetime();
+
+    id inputSource = (__bridge_transfer id)_inputSourceCreator();
+
+    if (!inputSource)
+        return nil;
+
+    // Same selection: keep the identifier and the resolved table.
+    if (currentInputSource &&
+        currentInputSource.generation == generation &&
+        CFEqual((__bridge CFTypeRef)inputSource, (__bridge CFTypeRef)currentInputSource.inputSource))
+    {
+        currentInputSource.expirationTime = expirationTime;
+        return currentInputSource;
     }
 
+    os_trace_debug("Caching the input source");
+    currentInputSource = [[_SRKeyCodeTranslatorInputSource alloc] initWithInputSource:inputSource generation:generation];
+    currentInputSource.expirationTime = expirationTime;
+
     @synchronized (self)
     {
-        NSString *translation = nil;
+        // Another thread may have already cached a newer source.
+        __auto_type cachedInputSource = self.currentInputSource;
+        if (!cachedInputSource || cachedInputSource.generation <= generation)
+            self.currentInputSource = currentInputSource;
+    }
 
-        if (cacheKey)
-        {
-            translation = [_translationCache objectForKey:cacheKey];
+    return currentInputSource;
+}
 
-            if (translation)
-            {
-                os_trace_debug("Translation cache hit");
-                return translation;
-            }
-            else
-                os_trace_debug("Translation cache miss");
-        }
+- (nullable _SRKeyCodeTranslationTable *)_translationTableForInputSource:(_SRKeyCodeTranslatorInputSource *)anInputSource
+{
+    // The same layout translates differently on ANSI, ISO and JIS keyboards.
+    UInt32 keyboardType = LMGetKbdType();
+    __auto_type table = [anInputSource tableForKeyboardType:keyboardType];
 
-        CFDataRef layoutData = TISGetInputSourceProperty(inputSource, kTISPropertyUnicodeKeyLayoutData);
-        const UCKeyboardLayout *keyLayout = (const UCKeyboardLayout *)CFDataGetBytePtr(layoutData);
-        UniCharCount actualLength = 0;
-        UniChar chars[255] = {0};
-        UInt32 deadKeyState = 0;
-        OSStatus error = UCKeyTranslate(keyLayout,
-                                        aKeyCode,
-                                        kUCKeyActionDisplay,
-                                        SRCocoaToCarbonFlags(anImplicitModifierFlags) >> 8,
-                                        LMGetKbdType(),
-                                        kUCKeyTranslateNoDeadKeysBit,
-                                        &deadKeyState,
-                                        sizeof(chars) / sizeof(UniChar),
-                                        &actualLength,
-                                        chars);
-        if (error != noErr)
-        {
-            os_trace_error("#Error Unable to translate keyCode %hu and modifierFlags %lu: %d",
-                           aKeyCode,
-                           anImplicitModifierFlags,
-                           error);
-            return nil;
-        }
-        else if (actualLength == 0)
+    if (table)
+        return table;
+
+    NSString *sourceIdentifier = anInputSource.identifier;
+
+    if (!sourceIdentifier)
+    {
+        os_trace_error("#Error Input source misses an ID");
+        return nil;
+    }
+
+    NSNumber *keyboardTypeKey = @(keyboardType);
+    table = self.translationTables[sourceIdentifier][keyboardTypeKey];
+
+    if (table)
+    {
+        [anInputSource setTable:table];
+        return table;
+    }
+
+    @synchronized (self)
+    {
+        __auto_type translationTables = self.translationTables;
+        table = translationTables[sourceIdentifier][keyboardTypeKey];
+
+        if (!table)
         {
-            os_trace_debug("#Error No translation exists for keyCode %hu and modifierFlags %lu",
-                           aKeyCode,
-                           anImplicitModifierFlags);
-            return nil;
-        }
+            table = [_SRKeyCodeTranslationTable tableForInputSource:(__bridge TISInputSourceRef)anInputSource.inputSource
+                                                       keyboardType:keyboardType];
 
-        translation = [NSString stringWithCharacters:chars length:actualLength];
+            if (!table)
+                return nil;
 
-        if (cacheKey)
-            [_translationCache setObject:translation forKey:cacheKey];
+            NSMutableDictionary *newSourceTables = [translationTables[sourceIdentifier] mutableCopy] ?: [NSMutableDictionary new];
+            newSourceTables[keyboardTypeKey] = table;
+            NSMutableDictionary *newTranslationTables = [translationTables mutableCopy];
+            newTranslationTables[sourceIdentifier] = [newSourceTables copy];
+            self.translationTables = newTranslationTables;
+        }
 
-        return translation;
+        [anInputSource setTable:table];
+        return table;
     }
 }
 
@@ -264,10 +1885,6 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 
 
 @implementation _SRKeyCodeASCIITranslator
-{
-    NSDictionary<NSString *, NSNumber *> *_translationToKeyCode;
-    NSString *_inputSourceIdentifier;
-}
 
 + (_SRKeyCodeASCIITranslator *)shared
 {
@@ -283,7 +1900,7 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 {
     NSAssert([aTranslation.lowercaseString isEqualToString:aTranslation], @"aTranslation must be a lowercase string");
 
-    TISInputSourceRef inputSource = self.inputSourceCreator();
+    __auto_type inputSource = [self _currentInputSource];
 
     if (!inputSource)
     {
@@ -291,42 +1908,7 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
         return nil;
     }
 
-    inputSource = (TISInputSourceRef)CFAutorelease(inputSource);
-
-    NSString *sourceIdentifier = (__bridge NSString *)TISGetInputSourceProperty(inputSource, kTISPropertyInputSourceID);
-
-    if (!sourceIdentifier)
-    {
-        os_trace_error("#Error Input source misses an ID");
-        return nil;
-    }
-
-    @synchronized (self)
-    {
-        if ([_inputSourceIdentifier isEqualToString:sourceIdentifier])
-            return _translationToKeyCode[aTranslation];
-
-        os_trace_debug("Updating translation -> key code mapping");
-
-        __auto_type knownKeyCodes = SRKeyCodeTransformer.knownKeyCodes;
-        NSMutableDictionary *newTranslationToKeyCode = [NSMutableDictionary dictionaryWithCapacity:knownKeyCodes.count];
-
-        for (NSNumber *keyCode in knownKeyCodes)
-        {
-            NSString *translation = [self translateKeyCode:keyCode.unsignedShortValue
-                                     implicitModifierFlags:0
-                                     explicitModifierFlags:0
-                                                usingCache:YES];
-
-            if (translation.length)
-                newTranslationToKeyCode[translation] = keyCode;
-        }
-
-        _translationToKeyCode = [newTranslationToKeyCode copy];
-        _inputSourceIdentifier = [sourceIdentifier copy];
-
-        return _translationToKeyCode[aTranslation];
-    }
+    return [[self _translationTableForInputSource:inputSource] keyCodeForTranslation:aTranslation];
 }
 
 @end
@@ -376,121 +1958,38 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
     static NSArray<NSNumber *> *KnownKeyCodes = nil;
     static dispatch_once_t OnceToken;
     dispatch_once(&OnceToken, ^{
-        KnownKeyCodes = @[
-            @(SRKeyCode0),
-            @(SRKeyCode1),
-            @(SRKeyCode2),
-            @(SRKeyCode3),
-            @(SRKeyCode4),
-            @(SRKeyCode5),
-            @(SRKeyCode6),
-            @(SRKeyCode7),
-            @(SRKeyCode8),
-            @(SRKeyCode9),
-            @(SRKeyCodeA),
-            @(SRKeyCodeB),
-            @(SRKeyCodeBackslash),
-            @(SRKeyCodeC),
-            @(SRKeyCodeComma),
-            @(SRKeyCodeD),
-            @(SRKeyCodeE),
-            @(SRKeyCodeEqual),
-            @(SRKeyCodeF),
-            @(SRKeyCodeG),
-            @(SRKeyCodeGrave),
-            @(SRKeyCodeH),
-            @(SRKeyCodeI),
-            @(SRKeyCodeJ),
-            @(SRKeyCodeK),
-            @(SRKeyCodeKeypad0),
-            @(SRKeyCodeKeypad1),
-            @(SRKeyCodeKeypad2),
-            @(SRKeyCodeKeypad3),
-            @(SRKeyCodeKeypad4),
-            @(SRKeyCodeKeypad5),
-            @(SRKeyCodeKeypad6),
-            @(SRKeyCodeKeypad7),
-            @(SRKeyCodeKeypad8),
-            @(SRKeyCodeKeypad9),
-            @(SRKeyCodeKeypadDecimal),
-            @(SRKeyCodeKeypadDivide),
-            @(SRKeyCodeKeypadEnter),
-            @(SRKeyCodeKeypadEquals),
-            @(SRKeyCodeKeypadMinus),
-            @(SRKeyCodeKeypadMultiply),
-            @(SRKeyCodeKeypadPlus),
-            @(SRKeyCodeL),
-            @(SRKeyCodeLeftBracket),
-            @(SRKeyCodeM),
-            @(SRKeyCodeMinus),
-            @(SRKeyCodeN),
-            @(SRKeyCodeO),
-            @(SRKeyCodeP),
-            @(SRKeyCodePeriod),
-            @(SRKeyCodeQ),
-            @(SRKeyCodeQuote),
-            @(SRKeyCodeR),
-            @(SRKeyCodeRightBracket),
-            @(SRKeyCodeS),
-            @(SRKeyCodeSemicolon),
-            @(SRKeyCodeSlash),
-            @(SRKeyCodeT),
-            @(SRKeyCodeU),
-            @(SRKeyCodeV),
-            @(SRKeyCodeW),
-            @(SRKeyCodeX),
-            @(SRKeyCodeY),
-            @(SRKeyCodeZ),
-            @(SRKeyCodeDelete),
-            @(SRKeyCodeDownArrow),
-            @(SRKeyCodeEnd),
-            @(SRKeyCodeEscape),
-            @(SRKeyCodeF1),
-            @(SRKeyCodeF2),
-            @(SRKeyCodeF3),
-            @(SRKeyCodeF4),
-            @(SRKeyCodeF5),
-            @(SRKeyCodeF6),
-            @(SRKeyCodeF7),
-            @(SRKeyCodeF8),
-            @(SRKeyCodeF9),
-            @(SRKeyCodeF10),
-            @(SRKeyCodeF11),
-            @(SRKeyCodeF12),
-            @(SRKeyCodeF13),
-            @(SRKeyCodeF14),
-            @(SRKeyCodeF15),
-            @(SRKeyCodeF16),
-            @(SRKeyCodeF17),
-            @(SRKeyCodeF18),
-            @(SRKeyCodeF19),
-            @(SRKeyCodeF20),
-            @(SRKeyCodeForwardDelete),
-            @(SRKeyCodeHelp),
-            @(SRKeyCodeHome),
-            @(SRKeyCodeISOSection),
-            @(SRKeyCodeJISKeypadComma),
-            @(SRKeyCodeJISUnderscore),
-            @(SRKeyCodeJISYen),
-            @(SRKeyCodeLeftArrow),
-            @(SRKeyCodePageDown),
-            @(SRKeyCodePageUp),
-            @(SRKeyCodeReturn),
-            @(SRKeyCodeRightArrow),
-            @(SRKeyCodeSpace),
-            @(SRKeyCodeTab),
-            @(SRKeyCodeUpArrow)
-        ];
+        NSMutableArray *keyCodes = [NSMutableArray arrayWithCapacity:_SRKnownKeyCodeCount];
+
+        for (NSUInteger i = 0; i < _SRKnownKeyCodeCount; ++i)
+            [keyCodes addObject:@(_SRKnownKeyCodes[i])];
+
+        KnownKeyCodes = [keyCodes copy];
     });
 
     return KnownKeyCodes;
 }
 
++ (BOOL)isKeypadKeyCode:(SRKeyCode)aValue
+{
+    return _SRKeyCodeInfoGet(aValue)->isKeypad;
+}
+
++ (SRKeyCode)keypadKeyCodeForKeyCode:(SRKeyCode)aValue
+{
+    __auto_type info = _SRKeyCodeInfoGet(aValue);
+    return info->keypadKeyCode ? info->keypadKeyCode : SRKeyCodeNone;
+}
+
 + (instancetype)sharedTransformer
 {
     return SRSymbolicKeyCodeTransformer.sharedTransformer;
 }
 
++ (NSUInteger)inputSourceGeneration
+{
+    return _SRKeyCodeInputSourceGenerationGet();
+}
+
 - (id)inputSource
 {
     return _translator.inputSource;
@@ -505,76 +2004,10 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 {
     switch (aValue)
     {
-        case SRKeyCodeF1:
-            return @"F1";
-        case SRKeyCodeF2:
-            return @"F2";
-        case SRKeyCodeF3:
-            return @"F3";
-        case SRKeyCodeF4:
-            return @"F4";
-        case SRKeyCodeF5:
-            return @"F5";
-        case SRKeyCodeF6:
-            return @"F6";
-        case SRKeyCodeF7:
-            return @"F7";
-        case SRKeyCodeF8:
-            return @"F8";
-        case SRKeyCodeF9:
-            return @"F9";
-        case SRKeyCodeF10:
-            return @"F10";
-        case SRKeyCodeF11:
-            return @"F11";
-        case SRKeyCodeF12:
-            return @"F12";
-        case SRKeyCodeF13:
-            return @"F13";
-        case SRKeyCodeF14:
-            return @"F14";
-        case SRKeyCodeF15:
-            return @"F15";
-        case SRKeyCodeF16:
-            return @"F16";
-        case SRKeyCodeF17:
-            return @"F17";
-        case SRKeyCodeF18:
-            return @"F18";
-        case SRKeyCodeF19:
-            return @"F19";
-        case SRKeyCodeF20:
-            return @"F20";
-        case SRKeyCodeSpace:
-            return SRLoc(@"Space");
         case SRKeyCodeDelete:
             return aDirection == NSUserInterfaceLayoutDirectionRightToLeft ? SRKeyCodeStringDeleteRight : SRKeyCodeStringDeleteLeft;
         case SRKeyCodeForwardDelete:
             return aDirection == NSUserInterfaceLayoutDirectionRightToLeft ? SRKeyCodeStringDeleteLeft : SRKeyCodeStringDeleteRight;
-        case SRKeyCodeKeypadClear:
-            return SRKeyCodeStringPadClear;
-        case SRKeyCodeLeftArrow:
-            return SRKeyCodeStringLeftArrow;
-        case SRKeyCodeRightArrow:
-            return SRKeyCodeStringRightArrow;
-        case SRKeyCodeUpArrow:
-            return SRKeyCodeStringUpArrow;
-        case SRKeyCodeDownArrow:
-            return SRKeyCodeStringDownArrow;
-        case SRKeyCodeEnd:
-            return SRKeyCodeStringSoutheastArrow;
-        case SRKeyCodeHome:
-            return SRKeyCodeStringNorthwestArrow;
-        case SRKeyCodeEscape:
-            return SRKeyCodeStringEscape;
-        case SRKeyCodePageDown:
-            return SRKeyCodeStringPageDown;
-        case SRKeyCodePageUp:
-            return SRKeyCodeStringPageUp;
-        case SRKeyCodeReturn:
-            return SRKeyCodeStringReturnR2L;
-        case SRKeyCodeKeypadEnter:
-            return SRKeyCodeStringReturn;
         case SRKeyCodeTab:
         {
             if (anImplicitModifierFlags & NSEventModifierFlagShift)
@@ -582,115 +2015,51 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
             else
                 return aDirection == NSUserInterfaceLayoutDirectionRightToLeft ? SRKeyCodeStringTabLeft : SRKeyCodeStringTabRight;
         }
-        case SRKeyCodeHelp:
-            return SRKeyCodeStringHelp;
-        case SRKeyCodeJISUnderscore:
-            return SRKeyCodeStringJISUnderscore;
-        case SRKeyCodeJISKeypadComma:
-            return SRKeyCodeStringJISComma;
-        case SRKeyCodeJISYen:
-            return SRKeyCodeStringJISYen;
         default:
+        {
+            NSString *literal = _SRKeyCodeInfoLiteral(aValue);
+
+            if (literal)
+                return literal;
+
             return [_translator translateKeyCode:aValue
                            implicitModifierFlags:anImplicitModifierFlags
                            explicitModifierFlags:anExplicitModifierFlags
                                       usingCache:YES].uppercaseString;
+        }
     }
 }
 
+- (BOOL)isDeadKeyCode:(SRKeyCode)aValue withModifierFlags:(NSEventModifierFlags)aModifierFlags
+{
+    return [_translator isDeadKeyCode:aValue modifierFlags:aModifierFlags];
+}
+
+- (NSString *)literalForKeyCode:(SRKeyCode)aValue
+      withImplicitModifierFlags:(NSEventModifierFlags)anImplicitModifierFlags
+               afterDeadKeyCode:(SRKeyCode)aDeadKeyCode
+   deadKeyImplicitModifierFlags:(NSEventModifierFlags)aDeadKeyImplicitModifierFlags
+{
+    return [_translator translateKeyCode:aValue
+                           modifierFlags:anImplicitModifierFlags
+                        afterDeadKeyCode:aDeadKeyCode
+                           modifierFlags:aDeadKeyImplicitModifierFlags];
+}
+
 - (NSString *)symbolForKeyCode:(SRKeyCode)aValue
      withImplicitModifierFlags:(NSEventModifierFlags)anImplicitModifierFlags
          explicitModifierFlags:(NSEventModifierFlags)anExplicitModifierFlags
                layoutDirection:(NSUserInterfaceLayoutDirection)aDirection
 {
-    switch (aValue)
-    {
-        case SRKeyCodeF1:
-            return SRUnicharToString(NSF1FunctionKey);
-        case SRKeyCodeF2:
-            return SRUnicharToString(NSF2FunctionKey);
-        case SRKeyCodeF3:
-            return SRUnicharToString(NSF3FunctionKey);
-        case SRKeyCodeF4:
-            return SRUnicharToString(NSF4FunctionKey);
-        case SRKeyCodeF5:
-            return SRUnicharToString(NSF5FunctionKey);
-        case SRKeyCodeF6:
-            return SRUnicharToString(NSF6FunctionKey);
-        case SRKeyCodeF7:
-            return SRUnicharToString(NSF7FunctionKey);
-        case SRKeyCodeF8:
-            return SRUnicharToString(NSF8FunctionKey);
-        case SRKeyCodeF9:
-            return SRUnicharToString(NSF9FunctionKey);
-        case SRKeyCodeF10:
-            return SRUnicharToString(NSF10FunctionKey);
-        case SRKeyCodeF11:
-            return SRUnicharToString(NSF11FunctionKey);
-        case SRKeyCodeF12:
-            return SRUnicharToString(NSF12FunctionKey);
-        case SRKeyCodeF13:
-            return SRUnicharToString(NSF13FunctionKey);
-        case SRKeyCodeF14:
-            return SRUnicharToString(NSF14FunctionKey);
-        case SRKeyCodeF15:
-            return SRUnicharToString(NSF15FunctionKey);
-        case SRKeyCodeF16:
-            return SRUnicharToString(NSF16FunctionKey);
-        case SRKeyCodeF17:
-            return SRUnicharToString(NSF17FunctionKey);
-        case SRKeyCodeF18:
-            return SRUnicharToString(NSF18FunctionKey);
-        case SRKeyCodeF19:
-            return SRUnicharToString(NSF19FunctionKey);
-        case SRKeyCodeF20:
-            return SRUnicharToString(NSF20FunctionKey);
-        case SRKeyCodeSpace:
-            return SRUnicharToString(' ');
-        case SRKeyCodeDelete:
-            return SRUnicharToString(NSBackspaceCharacter);
-        case SRKeyCodeForwardDelete:
-            return SRUnicharToString(NSDeleteCharacter);
-        case SRKeyCodeKeypadClear:
-            return SRUnicharToString(NSClearLineFunctionKey);
-        case SRKeyCodeLeftArrow:
-            return SRUnicharToString(NSLeftArrowFunctionKey);
-        case SRKeyCodeRightArrow:
-            return SRUnicharToString(NSRightArrowFunctionKey);
-        case SRKeyCodeUpArrow:
-            return SRUnicharToString(NSUpArrowFunctionKey);
-        case SRKeyCodeDownArrow:
-            return SRUnicharToString(NSDownArrowFunctionKey);
-        case SRKeyCodeEnd:
-            return SRUnicharToString(NSEndFunctionKey);
-        case SRKeyCodeHome:
-            return SRUnicharToString(NSHomeFunctionKey);
-        case SRKeyCodeEscape:
-            return SRUnicharToString('\e');
-        case SRKeyCodePageDown:
-            return SRUnicharToString(NSPageDownFunctionKey);
-        case SRKeyCodePageUp:
-            return SRUnicharToString(NSPageUpFunctionKey);
-        case SRKeyCodeReturn:
-            return SRUnicharToString(NSCarriageReturnCharacter);
-        case SRKeyCodeKeypadEnter:
-            return SRUnicharToString(NSEnterCharacter);
-        case SRKeyCodeTab:
-            return SRUnicharToString(NSTabCharacter);
-        case SRKeyCodeHelp:
-            return SRUnicharToString(NSHelpFunctionKey);
-        case SRKeyCodeJISUnderscore:
-            return SRKeyCodeStringJISUnderscore;
-        case SRKeyCodeJISKeypadComma:
-            return SRKeyCodeStringJISComma;
-        case SRKeyCodeJISYen:
-            return SRKeyCodeStringJISYen;
-        default:
-            return [_translator translateKeyCode:aValue
-                           implicitModifierFlags:anImplicitModifierFlags
-                           explicitModifierFlags:anExplicitModifierFlags
-                                      usingCache:YES];
-    }
+    NSString *symbol = _SRKeyCodeInfoSymbol(aValue);
+
+    if (symbol)
+        return symbol;
+
+    return [_translator translateKeyCode:aValue
+                   implicitModifierFlags:anImplicitModifierFlags
+                   explicitModifierFlags:anExplicitModifierFlags
+                              usingCache:YES];
 }
 
 - (NSString *)transformedValue:(NSNumber *)aValue
@@ -728,45 +2097,15 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
     static NSDictionary *Mapping = nil;
     static dispatch_once_t OnceToken;
     dispatch_once(&OnceToken, ^{
-        Mapping = @{
-            @(SRKeyCodeF1): SRUnicharToString(NSF1FunctionKey),
-            @(SRKeyCodeF2): SRUnicharToString(NSF2FunctionKey),
-            @(SRKeyCodeF3): SRUnicharToString(NSF3FunctionKey),
-            @(SRKeyCodeF4): SRUnicharToString(NSF4FunctionKey),
-            @(SRKeyCodeF5): SRUnicharToString(NSF5FunctionKey),
-            @(SRKeyCodeF6): SRUnicharToString(NSF6FunctionKey),
-            @(SRKeyCodeF7): SRUnicharToString(NSF7FunctionKey),
-            @(SRKeyCodeF8): SRUnicharToString(NSF8FunctionKey),
-            @(SRKeyCodeF9): SRUnicharToString(NSF9FunctionKey),
-            @(SRKeyCodeF10): SRUnicharToString(NSF10FunctionKey),
-            @(SRKeyCodeF11): SRUnicharToString(NSF11FunctionKey),
-            @(SRKeyCodeF12): SRUnicharToString(NSF12FunctionKey),
-            @(SRKeyCodeF13): SRUnicharToString(NSF13FunctionKey),
-            @(SRKeyCodeF14): SRUnicharToString(NSF14FunctionKey),
-            @(SRKeyCodeF15): SRUnicharToString(NSF15FunctionKey),
-            @(SRKeyCodeF16): SRUnicharToString(NSF16FunctionKey),
-            @(SRKeyCodeF17): SRUnicharToString(NSF17FunctionKey),
-            @(SRKeyCodeF18): SRUnicharToString(NSF18FunctionKey),
-            @(SRKeyCodeF19): SRUnicharToString(NSF19FunctionKey),
-            @(SRKeyCodeF20): SRUnicharToString(NSF20FunctionKey),
-            @(SRKeyCodeSpace): SRUnicharToString(' '),
-            @(SRKeyCodeDelete): SRUnicharToString(NSBackspaceCharacter),
-            @(SRKeyCodeForwardDelete): SRUnicharToString(NSDeleteCharacter),
-            @(SRKeyCodeKeypadClear): SRUnicharToString(NSClearLineFunctionKey),
-            @(SRKeyCodeLeftArrow): SRUnicharToString(NSLeftArrowFunctionKey),
-            @(SRKeyCodeRightArrow): SRUnicharToString(NSRightArrowFunctionKey),
-            @(SRKeyCodeUpArrow): SRUnicharToString(NSUpArrowFunctionKey),
-            @(SRKeyCodeDownArrow): SRUnicharToString(NSDownArrowFunctionKey),
-            @(SRKeyCodeEnd): SRUnicharToString(NSEndFunctionKey),
-            @(SRKeyCodeHome): SRUnicharToString(NSHomeFunctionKey),
-            @(SRKeyCodeEscape): SRUnicharToString('\e'),
-            @(SRKeyCodePageDown): SRUnicharToString(NSPageDownFunctionKey),
-            @(SRKeyCodePageUp): SRUnicharToString(NSPageUpFunctionKey),
-            @(SRKeyCodeReturn): SRUnicharToString(NSCarriageReturnCharacter),
-            @(SRKeyCodeKeypadEnter): SRUnicharToString(NSEnterCharacter),
-            @(SRKeyCodeTab): SRUnicharToString(NSTabCharacter),
-            @(SRKeyCodeHelp): SRUnicharToString(NSHelpFunctionKey)
-        };
+        NSMutableDictionary *mapping = [NSMutableDictionary new];
+
+        for (SRKeyCode keyCode = 0; keyCode < _SRKeyCodeInfoCount; ++keyCode)
+        {
+            if (_SRKeyCodeInfoTable[keyCode].isSpecial)
+                mapping[@(keyCode)] = _SRKeyCodeInfoSymbol(keyCode);
+        }
+
+        Mapping = [mapping copy];
     });
     return Mapping;
 }
@@ -776,45 +2115,15 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
     static NSDictionary *Mapping = nil;
     static dispatch_once_t OnceToken;
     dispatch_once(&OnceToken, ^{
-        Mapping = @{
-            @(SRKeyCodeF1): @"F1",
-            @(SRKeyCodeF2): @"F2",
-            @(SRKeyCodeF3): @"F3",
-            @(SRKeyCodeF4): @"F4",
-            @(SRKeyCodeF5): @"F5",
-            @(SRKeyCodeF6): @"F6",
-            @(SRKeyCodeF7): @"F7",
-            @(SRKeyCodeF8): @"F8",
-            @(SRKeyCodeF9): @"F9",
-            @(SRKeyCodeF10): @"F10",
-            @(SRKeyCodeF11): @"F11",
-            @(SRKeyCodeF12): @"F12",
-            @(SRKeyCodeF13): @"F13",
-            @(SRKeyCodeF14): @"F14",
-            @(SRKeyCodeF15): @"F15",
-            @(SRKeyCodeF16): @"F16",
-            @(SRKeyCodeF17): @"F17",
-            @(SRKeyCodeF18): @"F18",
-            @(SRKeyCodeF19): @"F19",
-            @(SRKeyCodeF20): @"F20",
-            @(SRKeyCodeSpace): SRLoc(@"Space"),
-            @(SRKeyCodeDelete): SRKeyCodeStringDeleteLeft,
-            @(SRKeyCodeForwardDelete): SRKeyCodeStringDeleteRight,
-            @(SRKeyCodeKeypadClear): SRKeyCodeStringPadClear,
-            @(SRKeyCodeLeftArrow): SRKeyCodeStringLeftArrow,
-            @(SRKeyCodeRightArrow): SRKeyCodeStringRightArrow,
-            @(SRKeyCodeUpArrow): SRKeyCodeStringUpArrow,
-            @(SRKeyCodeDownArrow): SRKeyCodeStringDownArrow,
-            @(SRKeyCodeEnd): SRKeyCodeStringSoutheastArrow,
-            @(SRKeyCodeHome): SRKeyCodeStringNorthwestArrow,
-            @(SRKeyCodeEscape): SRKeyCodeStringEscape,
-            @(SRKeyCodePageDown): SRKeyCodeStringPageDown,
-            @(SRKeyCodePageUp): SRKeyCodeStringPageUp,
-            @(SRKeyCodeReturn): SRKeyCodeStringReturnR2L,
-            @(SRKeyCodeKeypadEnter): SRKeyCodeStringReturn,
-            @(SRKeyCodeTab): SRKeyCodeStringTabRight,
-            @(SRKeyCodeHelp): @"?⃝"
-        };
+        NSMutableDictionary *mapping = [NSMutableDictionary new];
+
+        for (SRKeyCode keyCode = 0; keyCode < _SRKeyCodeInfoCount; ++keyCode)
+        {
+            if (_SRKeyCodeInfoTable[keyCode].isSpecial)
+                mapping[@(keyCode)] = _SRKeyCodeInfoLiteral(keyCode);
+        }
+
+        Mapping = [mapping copy];
     });
     return Mapping;
 }
@@ -870,7 +2179,7 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 
 - (BOOL)isKeyCodeSpecial:(SRKeyCode)aKeyCode
 {
-    return self.class.specialKeyCodeToSymbolMapping[@(aKeyCode)] != nil;
+    return _SRKeyCodeInfoGet(aKeyCode)->isSpecial;
 }
 
 #pragma clang diagnostic pop
@@ -1063,8 +2372,14 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 }
 
 - (NSNumber *)reverseTransformedValue:(NSString *)aValue
+{
+    return [self reverseTransformedValue:aValue implicitModifierFlags:NULL];
+}
+
+- (NSNumber *)reverseTransformedValue:(NSString *)aValue implicitModifierFlags:(NSEventModifierFlags *)outImplicitModifierFlags
 {
     __block NSNumber *result = nil;
+    __block NSEventModifierFlags implicitModifierFlags = 0;
     os_activity_initiate("ASCII Literal -> Key Code", OS_ACTIVITY_FLAG_DEFAULT, ^{
         if (![aValue isKindOfClass:NSString.class] || !aValue.length)
         {
@@ -1076,184 +2391,25 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 
         if (lowercaseValue.length == 1)
         {
-            unichar glyph = [lowercaseValue characterAtIndex:0];
+            SRKeyCode keyCode = _SRKeyCodeInfoKeyCodeForLiteral([lowercaseValue characterAtIndex:0]);
 
-            switch (glyph)
-            {
-                case SRKeyCodeGlyphTabRight:
-                case SRKeyCodeGlyphTabLeft:
-                    result = @(SRKeyCodeTab);
-                    break;
-                case SRKeyCodeGlyphReturn:
-                    result = @(SRKeyCodeKeypadEnter);
-                    break;
-                case SRKeyCodeGlyphReturnR2L:
-                    result = @(SRKeyCodeReturn);
-                    break;
-                case SRKeyCodeGlyphDeleteLeft:
-                    result = @(SRKeyCodeDelete);
-                    break;
-                case SRKeyCodeGlyphDeleteRight:
-                    result = @(SRKeyCodeForwardDelete);
-                    break;
-                case SRKeyCodeGlyphPadClear:
-                    result = @(SRKeyCodeKeypadClear);
-                    break;
-                case SRKeyCodeGlyphLeftArrow:
-                    result = @(SRKeyCodeLeftArrow);
-                    break;
-                case SRKeyCodeGlyphRightArrow:
-                    result = @(SRKeyCodeRightArrow);
-                    break;
-                case SRKeyCodeGlyphUpArrow:
-                    result = @(SRKeyCodeUpArrow);
-                    break;
-                case SRKeyCodeGlyphDownArrow:
-                    result = @(SRKeyCodeDownArrow);
-                    break;
-                case SRKeyCodeGlyphPageDown:
-                    result = @(SRKeyCodePageDown);
-                    break;
-                case SRKeyCodeGlyphPageUp:
-                    result = @(SRKeyCodePageUp);
-                    break;
-                case SRKeyCodeGlyphNorthwestArrow:
-                    result = @(SRKeyCodeHome);
-                    break;
-                case SRKeyCodeGlyphSoutheastArrow:
-                    result = @(SRKeyCodeEnd);
-                    break;
-                case SRKeyCodeGlyphEscape:
-                    result = @(SRKeyCodeEscape);
-                    break;
-                case SRKeyCodeGlyphSpace:
-                    result = @(SRKeyCodeSpace);
-                    break;
-                case SRKeyCodeGlyphJISUnderscore:
-                    result = @(SRKeyCodeJISUnderscore);
-                    break;
-                case SRKeyCodeGlyphJISComma:
-                    result = @(SRKeyCodeJISKeypadComma);
-                    break;
-                case SRKeyCodeGlyphJISYen:
-                    result = @(SRKeyCodeJISYen);
-                    break;
-                case SRKeyCodeGlyphANSI0:
-                    result = @(SRKeyCode0);
-                    break;
-                case SRKeyCodeGlyphANSI1:
-                    result = @(SRKeyCode1);
-                    break;
-                case SRKeyCodeGlyphANSI2:
-                    result = @(SRKeyCode2);
-                    break;
-                case SRKeyCodeGlyphANSI3:
-                    result = @(SRKeyCode3);
-                    break;
-                case SRKeyCodeGlyphANSI4:
-                    result = @(SRKeyCode4);
-                    break;
-                case SRKeyCodeGlyphANSI5:
-                    result = @(SRKeyCode5);
-                    break;
-                case SRKeyCodeGlyphANSI6:
-                    result = @(SRKeyCode6);
-                    break;
-                case SRKeyCodeGlyphANSI7:
-                    result = @(SRKeyCode7);
-                    break;
-                case SRKeyCodeGlyphANSI8:
-                    result = @(SRKeyCode8);
-                    break;
-                case SRKeyCodeGlyphANSI9:
-                    result = @(SRKeyCode9);
-                    break;
-                case SRKeyCodeGlyphANSIEqual:
-                    result = @(SRKeyCodeEqual);
-                    break;
-                case SRKeyCodeGlyphANSIMinus:
-                    result = @(SRKeyCodeMinus);
-                    break;
-                case SRKeyCodeGlyphANSISlash:
-                    result = @(SRKeyCodeSlash);
-                    break;
-                case SRKeyCodeGlyphANSIPeriod:
-                    result = @(SRKeyCodePeriod);
-                    break;
-                default:
-                    break;
-            }
+            if (keyCode != SRKeyCodeNone)
+                result = @(keyCode);
         }
         else if ((lowercaseValue.length == 2 || lowercaseValue.length == 3) & [lowercaseValue hasPrefix:@"f"])
         {
+            static const SRKeyCode FunctionKeyCodes[] = {
+                SRKeyCodeF1, SRKeyCodeF2, SRKeyCodeF3, SRKeyCodeF4, SRKeyCodeF5,
+                SRKeyCodeF6, SRKeyCodeF7, SRKeyCodeF8, SRKeyCodeF9, SRKeyCodeF10,
+                SRKeyCodeF11, SRKeyCodeF12, SRKeyCodeF13, SRKeyCodeF14, SRKeyCodeF15,
+                SRKeyCodeF16, SRKeyCodeF17, SRKeyCodeF18, SRKeyCodeF19, SRKeyCodeF20
+            };
+
             NSInteger fNumber = [lowercaseValue substringFromIndex:1].integerValue;
             if (fNumber > 0 && ((lowercaseValue.length == 2 && fNumber < 10) || (lowercaseValue.length == 3 && fNumber >= 10)))
             {
-                switch (fNumber)
-                {
-                    case 1:
-                        result = @(SRKeyCodeF1);
-                        break;
-                    case 2:
-                        result = @(SRKeyCodeF2);
-                        break;
-                    case 3:
-                        result = @(SRKeyCodeF3);
-                        break;
-                    case 4:
-                        result = @(SRKeyCodeF4);
-                        break;
-                    case 5:
-                        result = @(SRKeyCodeF5);
-                        break;
-                    case 6:
-                        result = @(SRKeyCodeF6);
-                        break;
-                    case 7:
-                        result = @(SRKeyCodeF7);
-                        break;
-                    case 8:
-                        result = @(SRKeyCodeF8);
-                        break;
-                    case 9:
-                        result = @(SRKeyCodeF9);
-                        break;
-                    case 10:
-                        result = @(SRKeyCodeF10);
-                        break;
-                    case 11:
-                        result = @(SRKeyCodeF11);
-                        break;
-                    case 12:
-                        result = @(SRKeyCodeF12);
-                        break;
-                    case 13:
-                        result = @(SRKeyCodeF13);
-                        break;
-                    case 14:
-                        result = @(SRKeyCodeF14);
-                        break;
-                    case 15:
-                        result = @(SRKeyCodeF15);
-                        break;
-                    case 16:
-                        result = @(SRKeyCodeF16);
-                        break;
-                    case 17:
-                        result = @(SRKeyCodeF17);
-                        break;
-                    case 18:
-                        result = @(SRKeyCodeF18);
-                        break;
-                    case 19:
-                        result = @(SRKeyCodeF19);
-                        break;
-                    case 20:
-                        result = @(SRKeyCodeF20);
-                        break;
-                    default:
-                        break;
-                }
+                if (fNumber <= (NSInteger)(sizeof(FunctionKeyCodes) / sizeof(FunctionKeyCodes[0])))
+                    result = @(FunctionKeyCodes[fNumber - 1]);
             }
         }
         else
@@ -1275,6 +2431,10 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
 
         if (result == nil)
             result = [(_SRKeyCodeASCIITranslator *)self->_translator keyCodeForTranslation:lowercaseValue];
+
+        // Characters of modified keys, e.g. !, only if the caller can learn the implied modifier flags.
+        if (result == nil && outImplicitModifierFlags)
+            result = [self->_translator keyCodeForTranslation:aValue modifierFlags:&implicitModifierFlags];
     });
 
     if (!result)
@@ -1282,6 +2442,9 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
         os_trace_error("#Error Invalid value for reverse transformation");
     }
 
+    if (result && outImplicitModifierFlags)
+        *outImplicitModifierFlags = implicitModifierFlags;
+
     return result;
 }
 
@@ -1352,155 +2515,12 @@ typedef TISInputSourceRef (*_SRKeyCodeTransformerCacheInputSourceCreate)(void);
             return;
         }
 
-        unichar glyph = [aValue characterAtIndex:0];
+        SRKeyCode keyCode = _SRKeyCodeInfoKeyCodeForSymbol([aValue characterAtIndex:0]);
 
-        switch (glyph)
-        {
-            case NSF1FunctionKey:
-                result = @(SRKeyCodeF1);
-                break;
-            case NSF2FunctionKey:
-                result = @(SRKeyCodeF2);
-                break;
-            case NSF3FunctionKey:
-                result = @(SRKeyCodeF3);
-                break;
-            case NSF4FunctionKey:
-                result = @(SRKeyCodeF4);
-                break;
-            case NSF5FunctionKey:
-                result = @(SRKeyCodeF5);
-                break;
-            case NSF6FunctionKey:
-                result = @(SRKeyCodeF6);
-                break;
-            case NSF7FunctionKey:
-                result = @(SRKeyCodeF7);
-                break;
-            case NSF8FunctionKey:
-                result = @(SRKeyCodeF8);
-                break;
-            case NSF9FunctionKey:
-                result = @(SRKeyCodeF9);
-                break;
-            case NSF10FunctionKey:
-                result = @(SRKeyCodeF10);
-                break;
-            case NSF11FunctionKey:
-                result = @(SRKeyCodeF11);
-                break;
-            case NSF12FunctionKey:
-                result = @(SRKeyCodeF12);
-                break;
-            case NSF13FunctionKey:
-                result = @(SRKeyCodeF13);
-                break;
-            case NSF14FunctionKey:
-                result = @(SRKeyCodeF14);
-                break;
-            case NSF15FunctionKey:
-                result = @(SRKeyCodeF15);
-                break;
-            case NSF16FunctionKey:
-                result = @(SRKeyCodeF16);
-                break;
-            case NSF17FunctionKey:
-                result = @(SRKeyCodeF17);
-                break;
-            case NSF18FunctionKey:
-                result = @(SRKeyCodeF18);
-                break;
-            case NSF19FunctionKey:
-                result = @(SRKeyCodeF19);
-                break;
-            case NSF20FunctionKey:
-                result = @(SRKeyCodeF20);
-                break;
-            case NSUpArrowFunctionKey:
-                result = @(SRKeyCodeUpArrow);
-                break;
-            case NSDownArrowFunctionKey:
-                result = @(SRKeyCodeDownArrow);
-                break;
-            case NSLeftArrowFunctionKey:
-                result = @(SRKeyCodeLeftArrow);
-                break;
-            case NSRightArrowFunctionKey:
-                result = @(SRKeyCodeRightArrow);
-                break;
-            case NSEndFunctionKey:
-                result = @(SRKeyCodeEnd);
-                break;
-            case NSHelpFunctionKey:
-                result = @(SRKeyCodeHelp);
-                break;
-            case NSHomeFunctionKey:
-                result = @(SRKeyCodeHome);
-                break;
-            case NSPageDownFunctionKey:
-                result = @(SRKeyCodePageDown);
-                break;
-            case NSPageUpFunctionKey:
-                result = @(SRKeyCodePageUp);
-                break;
-            case NSBackTabCharacter:
-                result = @(SRKeyCodeTab);
-                break;
-            case SRKeyCodeGlyphJISUnderscore:
-                result = @(SRKeyCodeJISUnderscore);
-                break;
-            case SRKeyCodeGlyphJISComma:
-                result = @(SRKeyCodeJISKeypadComma);
-                break;
-            case SRKeyCodeGlyphJISYen:
-                result = @(SRKeyCodeJISYen);
-                break;
-            case SRKeyCodeGlyphANSI0:
-                result = @(SRKeyCode0);
-                break;
-            case SRKeyCodeGlyphANSI1:
-                result = @(SRKeyCode1);
-                break;
-            case SRKeyCodeGlyphANSI2:
-                result = @(SRKeyCode2);
-                break;
-            case SRKeyCodeGlyphANSI3:
-                result = @(SRKeyCode3);
-                break;
-            case SRKeyCodeGlyphANSI4:
-                result = @(SRKeyCode4);
-                break;
-            case SRKeyCodeGlyphANSI5:
-                result = @(SRKeyCode5);
-                break;
-            case SRKeyCodeGlyphANSI6:
-                result = @(SRKeyCode6);
-                break;
-            case SRKeyCodeGlyphANSI7:
-                result = @(SRKeyCode7);
-                break;
-            case SRKeyCodeGlyphANSI8:
-                result = @(SRKeyCode8);
-                break;
-            case SRKeyCodeGlyphANSI9:
-                result = @(SRKeyCode9);
-                break;
-            case SRKeyCodeGlyphANSIEqual:
-                result = @(SRKeyCodeEqual);
-                break;
-            case SRKeyCodeGlyphANSIMinus:
-                result = @(SRKeyCodeMinus);
-                break;
-            case SRKeyCodeGlyphANSISlash:
-                result = @(SRKeyCodeSlash);
-                break;
-            case SRKeyCodeGlyphANSIPeriod:
-                result = @(SRKeyCodePeriod);
-                break;
-            default:
-                result = [(_SRKeyCodeASCIITranslator *)self->_translator keyCodeForTranslation:aValue.lowercaseString];
-                break;
-        }
+        if (keyCode != SRKeyCodeNone)
+            result = @(keyCode);
+        else
+            result = [(_SRKeyCodeASCIITranslator *)self->_translator keyCodeForTranslation:aValue.lowercaseString];
     });
 
     if (!result)
@@ -158,15 +158,18 @@ NSString *const SRShortcutCharactersIgnoringModifiers = SRShortcutKeyCharactersI
     if (modifierFlagsString.length)
         modifierFlags = [SRSymbolicModifierFlagsTransformer.sharedTransformer reverseTransformedValue:modifierFlagsString];
 
+    // Characters of modified keys imply their modifier flags, e.g. ⌘! is ⇧⌘1 in the U.S. English input source.
     NSNumber *keyCode = @(SRKeyCodeNone);
+    NSEventModifierFlags implicitModifierFlags = 0;
     if (keyCodeString.length)
-        keyCode = [SRASCIILiteralKeyCodeTransformer.sharedTransformer reverseTransformedValue:keyCodeString];
+        keyCode = [SRASCIILiteralKeyCodeTransformer.sharedTransformer reverseTransformedValue:keyCodeString
+                                                                       implicitModifierFlags:&implicitModifierFlags];
 
     if (!modifierFlags || !keyCode)
         return nil;
 
     return [self shortcutWithCode:keyCode.unsignedShortValue
-                    modifierFlags:modifierFlags.unsignedIntegerValue
+                    modifierFlags:modifierFlags.unsignedIntegerValue | implicitModifierFlags
                        characters:nil
       charactersIgnoringModifiers:nil];
 }
@@ -4,22 +4,306 @@
 //
 
 #import <Carbon/Carbon.h>
+#import <IOKit/hidsystem/IOLLEvent.h>
+#import <mach/mach_time.h>
+#import <objc/runtime.h>
+#import <pthread.h>
 #import <os/trace.h>
 #import <os/activity.h>
+#import <stdatomic.h>
 
 #import "ShortcutRecorder/SRCommon.h"
 
 #import "ShortcutRecorder/SRShortcutAction.h"
 
+#import "SRShortcutCore.h"
+
+
+#ifndef SR_SHORTCUT_MONITOR_METRICS
+#define SR_SHORTCUT_MONITOR_METRICS 1
+#endif // SR_SHORTCUT_MONITOR_METRICS
+
 
 static void *_SRShortcutActionContext = &_SRShortcutActionContext;
 
 
+// The portable core mirrors the constants of the frameworks.
+_Static_assert(SRKeyCodeNone == UINT16_MAX, "");
+_Static_assert(SRCoreKeyCodeCommand == kVK_Command && SRCoreKeyCodeRightCommand == kVK_RightCommand, "");
+_Static_assert(SRCoreKeyCodeOption == kVK_Option && SRCoreKeyCodeRightOption == kVK_RightOption, "");
+_Static_assert(SRCoreKeyCodeShift == kVK_Shift && SRCoreKeyCodeRightShift == kVK_RightShift, "");
+_Static_assert(SRCoreKeyCodeControl == kVK_Control && SRCoreKeyCodeRightControl == kVK_RightControl, "");
+_Static_assert(SRCoreModifierFlagsMask == SRCocoaModifierFlagsMask, "");
+_Static_assert(SRCoreModifierFlagCommand == NSEventModifierFlagCommand && SRCoreModifierFlagCommand == kCGEventFlagMaskCommand, "");
+_Static_assert(SRCoreModifierFlagOption == NSEventModifierFlagOption && SRCoreModifierFlagOption == kCGEventFlagMaskAlternate, "");
+_Static_assert(SRCoreModifierFlagShift == NSEventModifierFlagShift && SRCoreModifierFlagShift == kCGEventFlagMaskShift, "");
+_Static_assert(SRCoreModifierFlagControl == NSEventModifierFlagControl && SRCoreModifierFlagControl == kCGEventFlagMaskControl, "");
+_Static_assert(SRCoreCarbonModifierFlagCommand == cmdKey && SRCoreCarbonModifierFlagOption == optionKey, "");
+_Static_assert(SRCoreCarbonModifierFlagShift == shiftKey && SRCoreCarbonModifierFlagControl == controlKey, "");
+_Static_assert(SRCoreDeviceModifierFlagLeftCommand == NX_DEVICELCMDKEYMASK && SRCoreDeviceModifierFlagRightCommand == NX_DEVICERCMDKEYMASK, "");
+_Static_assert(SRCoreDeviceModifierFlagLeftOption == NX_DEVICELALTKEYMASK && SRCoreDeviceModifierFlagRightOption == NX_DEVICERALTKEYMASK, "");
+_Static_assert(SRCoreDeviceModifierFlagLeftShift == NX_DEVICELSHIFTKEYMASK && SRCoreDeviceModifierFlagRightShift == NX_DEVICERSHIFTKEYMASK, "");
+_Static_assert(SRCoreDeviceModifierFlagLeftControl == NX_DEVICELCTLKEYMASK && SRCoreDeviceModifierFlagRightControl == NX_DEVICERCTLKEYMASK, "");
+_Static_assert(SRCoreModifierGestureKindTap == SRModifierGestureKindTap && SRCoreModifierGestureKindDoubleTap == SRModifierGestureKindDoubleTap, "");
+_Static_assert(SRCoreModifierGestureKindHold == SRModifierGestureKindHold, "");
+
+
+NS_INLINE mach_timebase_info_data_t _SRMachTimebase(void)
+{
+    static mach_timebase_info_data_t Timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&Timebase);
+    });
+    return Timebase;
+}
+
+
+NS_INLINE NSTimeInterval _SRMachTimeToSeconds(uint64_t aMachTime)
+{
+    __auto_type timebase = _SRMachTimebase();
+    return (NSTimeInterval)aMachTime * timebase.numer / timebase.denom / NSEC_PER_SEC;
+}
+
+
+NS_INLINE uint64_t _SRMachTimeToNanoseconds(uint64_t aMachTime)
+{
+    __auto_type timebase = _SRMachTimebase();
+    return aMachTime * timebase.numer / timebase.denom;
+}
+
+
+NS_INLINE uint64_t _SRNanosecondsToMachTime(uint64_t aNanoseconds)
+{
+    __auto_type timebase = _SRMachTimebase();
+    return aNanoseconds * timebase.denom / timebase.numer;
+}
+
+
+typedef NS_ENUM(uint8_t, _SRShortcutActionInvocationKind)
+{
+    _SRShortcutActionInvocationKindNone = 0,
+    _SRShortcutActionInvocationKindHandler,
+    _SRShortcutActionInvocationKindAction,
+    _SRShortcutActionInvocationKindActionWithSender,
+    _SRShortcutActionInvocationKindProtocol
+};
+
+
+/*!
+ How SRShortcutAction performs itself on targets of a particular class.
+
+ @discussion
+ Resolving the method of the action involves several runtime queries and is only done
+ when the action, the target or the class of the target changes.
+ Plans are immutable and replaced as a whole.
+ */
+@interface _SRShortcutActionInvocationPlan : NSObject
+{
+    @public
+    SRShortcutActionHandler _actionHandler;
+    __weak id _target;
+    SEL _action;
+    Class _targetClass; // Nil if unresolved
+    _SRShortcutActionInvocationKind _kind;
+    IMP _actionMethod;
+    BOOL _returnsBool;
+    BOOL _validatesItems;
+}
+
+/*!
+ @param aTarget Target to resolve the plan for. Defaults to the stored target.
+
+ @note Must be called with the action unlocked: runtime queries may call into the target.
+ */
+- (instancetype)initWithActionHandler:(nullable SRShortcutActionHandler)anActionHandler
+                               target:(nullable id)aStoredTarget
+                               action:(nullable SEL)anAction
+                       resolvedTarget:(nullable id)aTarget NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ The stored target or the shared application if none.
+ */
+@property (readonly, nullable) id target;
+
+@end
+
+
+@implementation _SRShortcutActionInvocationPlan
+
+- (instancetype)initWithActionHandler:(SRShortcutActionHandler)anActionHandler
+                               target:(id)aStoredTarget
+                               action:(SEL)anAction
+                       resolvedTarget:(id)aTarget
+{
+    self = [super init];
+
+    if (self)
+    {
+        _actionHandler = anActionHandler;
+        _target = aStoredTarget;
+        _action = anAction;
+
+        if (_actionHandler)
+        {
+            _kind = _SRShortcutActionInvocationKindHandler;
+            return self;
+        }
+
+        id target = aTarget != nil ? aTarget : self.target;
+
+        if (!target)
+            return self;
+
+        _targetClass = object_getClass(target);
+
+        if (anAction && [target respondsToSelector:anAction])
+        {
+            NSMethodSignature *sig = [target methodSignatureForSelector:anAction];
+            _actionMethod = [target methodForSelector:anAction];
+            _returnsBool = strncmp(sig.methodReturnType, @encode(BOOL), 2) == 0;
+
+            switch (sig.numberOfArguments)
+            {
+                case 2:
+                    _kind = _SRShortcutActionInvocationKindAction;
+                    break;
+                case 3:
+                    _kind = _SRShortcutActionInvocationKindActionWithSender;
+                    break;
+                default:
+                    break;
+            }
+        }
+        else if ([target respondsToSelector:@selector(performShortcutAction:)])
+            _kind = _SRShortcutActionInvocationKindProtocol;
+
+        _validatesItems = [target respondsToSelector:@selector(validateUserInterfaceItem:)];
+    }
+
+    return self;
+}
+
+- (id)target
+{
+    id strongTarget = _target;
+    return strongTarget != nil ? strongTarget : NSApplication.sharedApplication;
+}
+
+@end
+
+
+/*!
+ Callbacks of the action to its monitors.
+
+ @discussion
+ The action is unlocked when it calls them and the monitor never locks the action:
+ concurrent changes may be reported out of order, so the monitor reads the current state of the action.
+ */
+@interface SRShortcutMonitor ()
+
+/*!
+ Called by the action after its enabled state changes.
+ */
+- (void)_actionDidChangeEnabled:(SRShortcutAction *)anAction;
+
+/*!
+ Called by the action after its shortcut changes.
+ */
+- (void)_actionDidChangeShortcut:(SRShortcutAction *)anAction;
+
+/*!
+ Called by the action after its priority changes.
+ */
+- (void)_actionDidChangePriority:(SRShortcutAction *)anAction;
+
+@end
+
+
+/*!
+ Number of monitors an action tracks without allocating.
+ */
+#define _SRShortcutActionInlineMonitorCapacity 2
+
+/*!
+ Number of target classes an action keeps invocation plans for.
+
+ @discussion
+ Actions without a target are performed on whatever responder is current: a few classes cover the common cases.
+ */
+#define _SRShortcutActionInvocationPlanCapacity 4
+
+
+@interface SRShortcutAction ()
+
+/*!
+ Plans of the most recent invocations by target class, most recent first.
+
+ @discussion
+ Immutable and replaced as a whole. Reset whenever the action handler, target or action changes.
+ */
+@property (atomic, nullable) NSArray<_SRShortcutActionInvocationPlan *> *invocationPlans;
+
+/*!
+ The shortcut as monitors read it: without locking the action.
+ */
+@property (atomic, nullable) SRShortcut *monitoredShortcut;
+
+/*!
+ Notify the monitor directly about changes of the enabled state, the shortcut and the priority.
+
+ @discussion
+ Monitors are not retained and must be removed before they are deallocated.
+ A monitor may be added only once.
+
+ The list of monitors has its own lock: a locked monitor may add or remove itself.
+ */
+- (void)_addMonitor:(SRShortcutMonitor *)aMonitor;
+
+- (void)_removeMonitor:(SRShortcutMonitor *)aMonitor;
+
+/*!
+ Perform the action on behalf of a monitor according to the repeat policy.
+
+ @param anIsRepeat Whether the key event is an auto-repeat of the held shortcut.
+
+ @param aTime Mach time of the key event; repeats are throttled by it rather than by the current time.
+ */
+- (BOOL)_performActionOnTarget:(nullable id)aTarget isRepeat:(BOOL)anIsRepeat time:(uint64_t)aTime;
+
+@end
+
+
+const SRShortcutActionPriority SRShortcutActionPriorityApplication = 0;
+
+const SRShortcutActionPriority SRShortcutActionPriorityDocument = 500;
+
+const SRShortcutActionPriority SRShortcutActionPriorityWindow = 1000;
+
+
 @implementation SRShortcutAction
 {
     SRShortcut *_shortcut;
     SRShortcutActionHandler _actionHandler;
     __weak id _target;
+    SEL _action;
+    BOOL _enabled;
+    SRShortcutActionPriority _priority;
+    NSUInteger _invocationPlansGeneration; // incremented whenever invocationPlans is reset
+
+    // Repeat policy state, guarded by self.
+    uint64_t _lastRepeatPerformTime; // in mach time units
+    NSUInteger _skippedRepeatCount;
+    BOOL _lastRepeatPerformResult;
+
+    // Points to either _inlineMonitors or to a heap allocated array, guarded by _monitorsLock.
+    pthread_mutex_t _monitorsLock;
+    __unsafe_unretained SRShortcutMonitor **_monitors;
+    __unsafe_unretained SRShortcutMonitor *_inlineMonitors[_SRShortcutActionInlineMonitorCapacity];
+    NSUInteger _monitorsCount;
+    NSUInteger _monitorsCapacity;
 }
 
 + (instancetype)shortcutActionWithShortcut:(SRShortcut *)aShortcut
@@ -73,7 +357,11 @@ static void *_SRShortcutActionContext = &_SRShortcutActionContext;
     self = [super init];
 
     if (self)
+    {
         _enabled = YES;
+        _repeatInterval = 0.1;
+        pthread_mutex_init(&_monitorsLock, NULL);
+    }
 
     return self;
 }
@@ -81,6 +369,11 @@ static void *_SRShortcutActionContext = &_SRShortcutActionContext;
 - (void)dealloc
 {
     [self _invalidateObserving];
+
+    if (_monitors != _inlineMonitors)
+        free(_monitors);
+
+    pthread_mutex_destroy(&_monitorsLock);
 }
 
 #pragma mark Properties
@@ -112,26 +405,38 @@ static void *_SRShortcutActionContext = &_SRShortcutActionContext;
 
 - (void)setShortcut:(SRShortcut *)aShortcut
 {
-    os_activity_initiate("-[SRShortcutAction setShortcut:]", OS_ACTIVITY_FLAG_DEFAULT, ^{
-        @synchronized (self)
+    NSArray<SRShortcutMonitor *> *monitors = nil;
+
+    @synchronized (self)
+    {
+        // Observation properties change only if the action was observing.
+        BOOL isObserving = _observedKeyPath != nil;
+
+        if (isObserving)
         {
             [self willChangeValueForKey:@"observedObject"];
             [self willChangeValueForKey:@"observedKeyPath"];
+            [self _invalidateObserving];
+        }
 
-            if (self->_shortcut != aShortcut && ![self->_shortcut isEqual:aShortcut])
-            {
-                [self willChangeValueForKey:@"shortcut"];
-                [self _invalidateObserving];
-                self->_shortcut = aShortcut;
-                [self didChangeValueForKey:@"shortcut"];
-            }
-            else
-                [self _invalidateObserving];
+        if (_shortcut != aShortcut && ![_shortcut isEqual:aShortcut])
+        {
+            [self willChangeValueForKey:@"shortcut"];
+            _shortcut = aShortcut;
+            self.monitoredShortcut = aShortcut;
+            [self didChangeValueForKey:@"shortcut"];
+            monitors = [self _currentMonitors];
+        }
 
+        if (isObserving)
+        {
             [self didChangeValueForKey:@"observedKeyPath"];
             [self didChangeValueForKey:@"observedObject"];
         }
-    });
+    }
+
+    for (SRShortcutMonitor *m in monitors)
+        [m _actionDidChangeShortcut:self];
 }
 
 - (void)setObservedObject:(id)newObservedObject withKeyPath:(NSString *)newKeyPath
@@ -181,6 +486,7 @@ static void *_SRShortcutActionContext = &_SRShortcutActionContext;
             [self didChangeValueForKey:@"target"];
         }
 
+        [self _resetInvocationPlans];
         [self didChangeValueForKey:@"actionHandler"];
     }
 }
@@ -216,223 +522,1763 @@ static void *_SRShortcutActionContext = &_SRShortcutActionContext;
             [self didChangeValueForKey:@"actionHandler"];
         }
 
+        [self _resetInvocationPlans];
         [self didChangeValueForKey:@"target"];
     }
 }
 
-#pragma mark Methods
-
-- (BOOL)performActionOnTarget:(id)aTarget
+- (SEL)action
 {
-    __block BOOL isPerformed = NO;
-
-    os_activity_initiate("-[SRShortcutAction performActionOnTarget:]", OS_ACTIVITY_FLAG_DEFAULT, ^{
-        if (!self.isEnabled)
-        {
-            os_trace_debug("Not performed: disabled");
-            return;
-        }
+    @synchronized (self)
+    {
+        return _action;
+    }
+}
 
-        SRShortcutActionHandler actionHandler = self.actionHandler;
+- (BOOL)isEnabled
+{
+    return _enabled;
+}
 
-        if (actionHandler)
-        {
-            os_trace_debug("Using action handler");
-            isPerformed = actionHandler(self);
-        }
-        else
-        {
-            id target = aTarget != nil ? aTarget : self.target;
-            if (!target)
-            {
-                os_trace_debug("Not performed: no associated target");
-                return;
-            }
+- (void)setEnabled:(BOOL)newEnabled
+{
+    NSArray<SRShortcutMonitor *> *monitors = nil;
 
-            SEL action = self.action;
+    @synchronized (self)
+    {
+        if (_enabled == newEnabled)
+            return;
 
-            BOOL canPerformAction = NO;
-            BOOL canPerformProtocol = NO;
-            if (!(canPerformAction = action && [target respondsToSelector:action]) && !(canPerformProtocol = [target respondsToSelector:@selector(performShortcutAction:)]))
-            {
-                os_trace_debug("Not performed: target cannot respond to action");
-                return;
-            }
-            else if ([target respondsToSelector:@selector(validateUserInterfaceItem:)] && ![target validateUserInterfaceItem:self])
-            {
-                os_trace_debug("Not performed: target ignored action");
-                return;
-            }
+        _enabled = newEnabled;
+        monitors = [self _currentMonitors];
+    }
 
-            if (canPerformAction)
-            {
-                os_trace_debug("Using action");
-                NSMethodSignature *sig = [target methodSignatureForSelector:action];
-                IMP actionMethod = [target methodForSelector:action];
-                BOOL returnsBool = strncmp(sig.methodReturnType, @encode(BOOL), 2) == 0;
-                switch (sig.numberOfArguments)
-                {
-                    case 2:
-                    {
-                        if (returnsBool)
-                            isPerformed = ((BOOL (*)(id, SEL))actionMethod)(target, action);
-                        else
-                        {
-                            ((void (*)(id, SEL))actionMethod)(target, action);
-                            isPerformed = YES;
-                        }
-                        break;
-                    }
-                    case 3:
-                    {
-                        if (returnsBool)
-                            isPerformed = ((BOOL (*)(id, SEL, id))actionMethod)(target, action, self);
-                        else
-                        {
-                            ((void (*)(id, SEL, id))actionMethod)(target, action, self);
-                            isPerformed = YES;
-                        }
-                        break;
-                    }
-                    default:
-                        break;
-                }
-            }
-            else if (canPerformProtocol)
-            {
-                os_trace_debug("Using protocol");
-                isPerformed = [(id<SRShortcutActionTarget>)target performShortcutAction:self];
-            }
-        }
-    });
+    // Monitors lock themselves: the action must be unlocked to avoid a lock-order inversion with -addAction:forKeyEvent:.
+    for (SRShortcutMonitor *m in monitors)
+        [m _actionDidChangeEnabled:self];
+}
 
-    return isPerformed;
+- (void)setAction:(SEL)newAction
+{
+    @synchronized (self)
+    {
+        _action = newAction;
+        [self _resetInvocationPlans];
+    }
 }
 
-#pragma mark Private
+- (SRShortcutActionPriority)priority
+{
+    return _priority;
+}
 
-- (void)_invalidateObserving
+- (void)setPriority:(SRShortcutActionPriority)newPriority
 {
-    id strongObservedObject = _observedObject;
+    NSArray<SRShortcutMonitor *> *monitors = nil;
 
-    if (strongObservedObject)
-        [strongObservedObject removeObserver:self forKeyPath:_observedKeyPath context:_SRShortcutActionContext];
+    @synchronized (self)
+    {
+        if (_priority == newPriority)
+            return;
 
-    _observedObject = nil;
-    _observedKeyPath = nil;
+        _priority = newPriority;
+        monitors = [self _currentMonitors];
+    }
+
+    for (SRShortcutMonitor *m in monitors)
+        [m _actionDidChangePriority:self];
 }
 
-#pragma mark NSObject
+#pragma mark Methods
 
-- (void)observeValueForKeyPath:(NSString *)aKeyPath
-                      ofObject:(NSObject *)anObject
-                        change:(NSDictionary<NSKeyValueChangeKey,id> *)aChange
-                       context:(void *)aContext
+- (BOOL)_performActionOnTarget:(id)aTarget isRepeat:(BOOL)anIsRepeat time:(uint64_t)aTime
 {
-    if (aContext != _SRShortcutActionContext)
-    {
-        [super observeValueForKeyPath:aKeyPath ofObject:anObject change:aChange context:aContext];
-        return;
-    }
-
-    os_activity_initiate("-[SRShortcutAction observeValueForKeyPath:ofObject:change:context:]", OS_ACTIVITY_FLAG_DEFAULT, ^{
-        SRShortcut *newShortcut = aChange[NSKeyValueChangeNewKey];
+    __auto_type repeatPolicy = self.repeatPolicy;
 
-        // NSController subclasses are notable for not setting the New and Old keys of the change dictionary.
-        if ((!newShortcut || (NSNull *)newShortcut == NSNull.null) && [anObject isKindOfClass:NSController.class])
-            newShortcut = [anObject valueForKeyPath:aKeyPath];
+    // Steady state of the default policy: no bookkeeping.
+    if (repeatPolicy == SRShortcutActionRepeatPolicyPerform)
+        return [self performActionOnTarget:aTarget];
 
-        if ([newShortcut isKindOfClass:NSDictionary.class])
-            newShortcut = [SRShortcut shortcutWithDictionary:(NSDictionary *)newShortcut];
-        else if ([newShortcut isKindOfClass:NSData.class])
-            newShortcut = [NSKeyedUnarchiver unarchiveObjectWithData:(NSData *)newShortcut];
-        else if ((NSNull *)newShortcut == NSNull.null)
-            newShortcut = nil;
+    @synchronized (self)
+    {
+        // Events may arrive out of order from different monitors.
+        uint64_t elapsed = aTime > _lastRepeatPerformTime ? aTime - _lastRepeatPerformTime : 0;
 
-        @synchronized (self)
+        if (anIsRepeat &&
+            (repeatPolicy == SRShortcutActionRepeatPolicyIgnore ||
+             _SRMachTimeToSeconds(elapsed) < _repeatInterval))
         {
-            if (self->_shortcut == newShortcut || [self->_shortcut isEqual:newShortcut])
-                return;
-
-            [self willChangeValueForKey:@"shortcut"];
-            self->_shortcut = newShortcut;
-            [self didChangeValueForKey:@"shortcut"];
+            os_trace_debug("Not performed: repeat is skipped");
+            _skippedRepeatCount += 1;
+            return _lastRepeatPerformResult;
         }
-    });
-}
-
-@end
-
-
-#pragma mark -
 
+        if (!anIsRepeat)
+            _repeatCount = 0;
+        else if (repeatPolicy == SRShortcutActionRepeatPolicyCoalesce)
+            _repeatCount = _skippedRepeatCount + 1;
+        else
+            _repeatCount = 1;
 
-@implementation NSEvent (SRShortcutAction)
+        _skippedRepeatCount = 0;
+        _lastRepeatPerformTime = aTime;
+    }
 
-+ (SRKeyEventType)SR_keyEventTypeForEventType:(NSEventType)anEventType
-                                      keyCode:(unsigned short)aKeyCode
-                                modifierFlags:(NSEventModifierFlags)aModifierFlags
-{
-    SRKeyEventType eventType = SRKeyEventTypeDown;
+    // The action must not be locked while it's performed: it may be changed from within.
+    BOOL result = [self performActionOnTarget:aTarget];
 
-    switch (anEventType)
+    @synchronized (self)
     {
-        case NSEventTypeKeyDown:
-            eventType = SRKeyEventTypeDown;
-            break;
-        case NSEventTypeKeyUp:
-            eventType = SRKeyEventTypeUp;
-            break;
-        case NSEventTypeFlagsChanged:
-        {
-            __auto_type keyCode = aKeyCode;
-            __auto_type modifierFlags = aModifierFlags;
-
-            if (keyCode == kVK_Command || keyCode == kVK_RightCommand)
-                eventType = modifierFlags & NSEventModifierFlagCommand ? SRKeyEventTypeDown : SRKeyEventTypeUp;
-            else if (keyCode == kVK_Option || keyCode == kVK_RightOption)
-                eventType = modifierFlags & NSEventModifierFlagOption ? SRKeyEventTypeDown : SRKeyEventTypeUp;
-            else if (keyCode == kVK_Shift || keyCode == kVK_RightShift)
-                eventType = modifierFlags & NSEventModifierFlagShift ? SRKeyEventTypeDown : SRKeyEventTypeUp;
-            else if (keyCode == kVK_Control || keyCode == kVK_RightControl)
-                eventType = modifierFlags & NSEventModifierFlagControl ? SRKeyEventTypeDown : SRKeyEventTypeUp;
-            else
-                os_trace("#Error Unexpected key code %hu for the FlagsChanged event", keyCode);
-            break;
-        }
-        default:
-            [NSException raise:NSInternalInconsistencyException format:@"Expected a key event, got %lu", anEventType];
-            break;
+        _lastRepeatPerformResult = result;
     }
 
-    return eventType;
+    return result;
 }
 
-- (SRKeyEventType)SR_keyEventType
+- (BOOL)performActionOnTarget:(id)aTarget
 {
-    return [self.class SR_keyEventTypeForEventType:self.type keyCode:self.keyCode modifierFlags:self.modifierFlags];
-}
-
-@end
+    if (!self.isEnabled)
+    {
+        os_trace_debug("Not performed: disabled");
+        return NO;
+    }
 
+    // Steady state: one atomic load of the plans, a short scan and a direct call.
+    __auto_type plans = self.invocationPlans;
+    __auto_type plan = plans.firstObject;
 
-static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
+    if (!plan)
+        plan = [self _makeInvocationPlanForTarget:aTarget];
+
+    if (plan->_kind == _SRShortcutActionInvocationKindHandler)
+        return plan->_actionHandler(self);
+
+    id target = aTarget != nil ? aTarget : plan.target;
+    if (!target)
+    {
+        os_trace_debug("Not performed: no associated target");
+        return NO;
+    }
+
+    Class targetClass = object_getClass(target);
+
+    if (targetClass != plan->_targetClass)
+    {
+        plan = nil;
+
+        for (_SRShortcutActionInvocationPlan *p in plans)
+        {
+            if (p->_targetClass == targetClass)
+            {
+                plan = p;
+                break;
+            }
+        }
+
+        if (!plan)
+            plan = [self _makeInvocationPlanForTarget:target];
+
+        if (plan->_kind == _SRShortcutActionInvocationKindHandler)
+            return plan->_actionHandler(self);
+    }
+
+    if (plan->_kind == _SRShortcutActionInvocationKindNone)
+    {
+        os_trace_debug("Not performed: target cannot respond to action");
+        return NO;
+    }
+    else if (plan->_validatesItems && ![target validateUserInterfaceItem:self])
+    {
+        os_trace_debug("Not performed: target ignored action");
+        return NO;
+    }
+
+    SEL action = plan->_action;
+    IMP actionMethod = plan->_actionMethod;
+
+    switch (plan->_kind)
+    {
+        case _SRShortcutActionInvocationKindAction:
+        {
+            if (plan->_returnsBool)
+                return ((BOOL (*)(id, SEL))actionMethod)(target, action);
+
+            ((void (*)(id, SEL))actionMethod)(target, action);
+            return YES;
+        }
+        case _SRShortcutActionInvocationKindActionWithSender:
+        {
+            if (plan->_returnsBool)
+                return ((BOOL (*)(id, SEL, id))actionMethod)(target, action, self);
+
+            ((void (*)(id, SEL, id))actionMethod)(target, action, self);
+            return YES;
+        }
+        case _SRShortcutActionInvocationKindProtocol:
+            return [(id<SRShortcutActionTarget>)target performShortcutAction:self];
+        default:
+            return NO;
+    }
+}
+
+#pragma mark Private
+
+- (_SRShortcutActionInvocationPlan *)_makeInvocationPlanForTarget:(nullable id)aTarget
+{
+    SRShortcutActionHandler actionHandler = nil;
+    id storedTarget = nil;
+    SEL action = NULL;
+    NSUInteger generation = 0;
+
+    @synchronized (self)
+    {
+        actionHandler = _actionHandler;
+        storedTarget = _target;
+        action = _action;
+        generation = _invocationPlansGeneration;
+    }
+
+    // Runtime queries may call into the target: resolve with the action unlocked.
+    __auto_type plan = [[_SRShortcutActionInvocationPlan alloc] initWithActionHandler:actionHandler
+                                                                               target:storedTarget
+                                                                               action:action
+                                                                       resolvedTarget:aTarget];
+
+    @synchronized (self)
+    {
+        // The plan is stale if the action changed meanwhile: use it once but don't keep it.
+        if (generation != _invocationPlansGeneration)
+            return plan;
+
+        NSMutableArray *plans = [NSMutableArray arrayWithObject:plan];
+
+        for (_SRShortcutActionInvocationPlan *p in self.invocationPlans)
+        {
+            if (plans.count == _SRShortcutActionInvocationPlanCapacity)
+                break;
+            else if (p->_targetClass != plan->_targetClass)
+                [plans addObject:p];
+        }
+
+        self.invocationPlans = [plans copy];
+    }
+
+    return plan;
+}
+
+/*!
+ @note Must be called with the action locked.
+ */
+- (void)_resetInvocationPlans
+{
+    _invocationPlansGeneration += 1;
+    self.invocationPlans = nil;
+}
+
+- (void)_addMonitor:(SRShortcutMonitor *)aMonitor
+{
+    pthread_mutex_lock(&_monitorsLock);
+
+    if (!_monitors)
+    {
+        _monitors = _inlineMonitors;
+        _monitorsCapacity = _SRShortcutActionInlineMonitorCapacity;
+    }
+    else if (_monitorsCount == _monitorsCapacity)
+    {
+        NSUInteger newCapacity = _monitorsCapacity * 2;
+        __unsafe_unretained SRShortcutMonitor **newMonitors = (__unsafe_unretained SRShortcutMonitor **)calloc(newCapacity, sizeof(*newMonitors));
+        memcpy(newMonitors, _monitors, _monitorsCount * sizeof(*newMonitors));
+
+        if (_monitors != _inlineMonitors)
+            free(_monitors);
+
+        _monitors = newMonitors;
+        _monitorsCapacity = newCapacity;
+    }
+
+    _monitors[_monitorsCount++] = aMonitor;
+
+    pthread_mutex_unlock(&_monitorsLock);
+}
+
+- (void)_removeMonitor:(SRShortcutMonitor *)aMonitor
+{
+    pthread_mutex_lock(&_monitorsLock);
+
+    for (NSUInteger i = 0; i < _monitorsCount; ++i)
+    {
+        if (_monitors[i] != aMonitor)
+            continue;
+
+        _monitors[i] = _monitors[--_monitorsCount];
+        _monitors[_monitorsCount] = nil;
+        break;
+    }
+
+    pthread_mutex_unlock(&_monitorsLock);
+}
+
+/*!
+ Monitors to notify once the action is unlocked.
+ */
+- (nullable NSArray<SRShortcutMonitor *> *)_currentMonitors
+{
+    pthread_mutex_lock(&_monitorsLock);
+    NSArray<SRShortcutMonitor *> *monitors = _monitorsCount ? [NSArray arrayWithObjects:_monitors count:_monitorsCount] : nil;
+    pthread_mutex_unlock(&_monitorsLock);
+    return monitors;
+}
+
+- (void)_invalidateObserving
+{
+    id strongObservedObject = _observedObject;
+
+    if (strongObservedObject)
+        [strongObservedObject removeObserver:self forKeyPath:_observedKeyPath context:_SRShortcutActionContext];
+
+    _observedObject = nil;
+    _observedKeyPath = nil;
+}
+
+#pragma mark NSObject
+
+- (void)observeValueForKeyPath:(NSString *)aKeyPath
+                      ofObject:(NSObject *)anObject
+                        change:(NSDictionary<NSKeyValueChangeKey,id> *)aChange
+                       context:(void *)aContext
+{
+    if (aContext != _SRShortcutActionContext)
+    {
+        [super observeValueForKeyPath:aKeyPath ofObject:anObject change:aChange context:aContext];
+        return;
+    }
+
+    os_activity_initiate("-[SRShortcutAction observeValueForKeyPath:ofObject:change:context:]", OS_ACTIVITY_FLAG_DEFAULT, ^{
+        SRShortcut *newShortcut = aChange[NSKeyValueChangeNewKey];
+
+        // NSController subclasses are notable for not setting the New and Old keys of the change dictionary.
+        if ((!newShortcut || (NSNull *)newShortcut == NSNull.null) && [anObject isKindOfClass:NSController.class])
+            newShortcut = [anObject valueForKeyPath:aKeyPath];
+
+        if ([newShortcut isKindOfClass:NSDictionary.class])
+            newShortcut = [SRShortcut shortcutWithDictionary:(NSDictionary *)newShortcut];
+        else if ([newShortcut isKindOfClass:NSData.class])
+            newShortcut = [NSKeyedUnarchiver unarchiveObjectWithData:(NSData *)newShortcut];
+        else if ((NSNull *)newShortcut == NSNull.null)
+            newShortcut = nil;
+
+        NSArray<SRShortcutMonitor *> *monitors = nil;
+
+        @synchronized (self)
+        {
+            if (self->_shortcut == newShortcut || [self->_shortcut isEqual:newShortcut])
+                return;
+
+            [self willChangeValueForKey:@"shortcut"];
+            self->_shortcut = newShortcut;
+            self.monitoredShortcut = newShortcut;
+            [self didChangeValueForKey:@"shortcut"];
+            monitors = [self _currentMonitors];
+        }
+
+        for (SRShortcutMonitor *m in monitors)
+            [m _actionDidChangeShortcut:self];
+    });
+}
+
+@end
+
+
+#pragma mark -
+
+
+/*!
+ Modifier flag of the modifier key, if any.
+ */
+NS_INLINE NSEventModifierFlags _SRModifierFlagForKeyCode(unsigned short aKeyCode)
+{
+    return (NSEventModifierFlags)SRCoreModifierFlagForKeyCode(aKeyCode);
+}
+
+
+@implementation NSEvent (SRShortcutAction)
+
++ (SRKeyEventType)SR_keyEventTypeForEventType:(NSEventType)anEventType
+                                      keyCode:(unsigned short)aKeyCode
+                                modifierFlags:(NSEventModifierFlags)aModifierFlags
+{
+    SRKeyEventType eventType = SRKeyEventTypeDown;
+
+    switch (anEventType)
+    {
+        case NSEventTypeKeyDown:
+            eventType = SRKeyEventTypeDown;
+            break;
+        case NSEventTypeKeyUp:
+            eventType = SRKeyEventTypeUp;
+            break;
+        case NSEventTypeFlagsChanged:
+        {
+            NSEventModifierFlags keyCodeModifierFlag = _SRModifierFlagForKeyCode(aKeyCode);
+
+            if (keyCodeModifierFlag)
+                eventType = aModifierFlags & keyCodeModifierFlag ? SRKeyEventTypeDown : SRKeyEventTypeUp;
+            else
+                os_trace("#Error Unexpected key code %hu for the FlagsChanged event", aKeyCode);
+            break;
+        }
+        default:
+            [NSException raise:NSInternalInconsistencyException format:@"Expected a key event, got %lu", anEventType];
+            break;
+    }
+
+    return eventType;
+}
+
+- (SRKeyEventType)SR_keyEventType
+{
+    return [self.class SR_keyEventTypeForEventType:self.type keyCode:self.keyCode modifierFlags:self.modifierFlags];
+}
+
+@end
+
+
+/*!
+ Shortcut and key event packed into 32 bits, see SRCoreShortcutKey.
+ */
+typedef SRCoreShortcutKey _SRShortcutKey;
+
+
+NS_INLINE _SRShortcutKey _SRShortcutKeyMake(SRKeyCode aKeyCode, NSEventModifierFlags aModifierFlags, SRKeyEventType aKeyEvent)
+{
+    return SRCoreShortcutKeyMake(aKeyCode, aModifierFlags, aKeyEvent == SRKeyEventTypeDown);
+}
+
+
+NS_INLINE _SRShortcutKey _SRShortcutKeyMakeWithShortcut(SRShortcut *aShortcut, SRKeyEventType aKeyEvent)
+{
+    return _SRShortcutKeyMake(aShortcut.keyCode, aShortcut.modifierFlags, aKeyEvent);
+}
+
+
+NS_INLINE SRKeyCode _SRShortcutKeyGetKeyCode(_SRShortcutKey aKey)
+{
+    return SRCoreShortcutKeyGetKeyCode(aKey);
+}
+
+
+NS_INLINE NSEventModifierFlags _SRShortcutKeyGetModifierFlags(_SRShortcutKey aKey)
+{
+    return (NSEventModifierFlags)SRCoreShortcutKeyGetModifierFlags(aKey);
+}
+
+
+NS_INLINE SRKeyEventType _SRShortcutKeyGetKeyEvent(_SRShortcutKey aKey)
+{
+    return SRCoreShortcutKeyIsKeyDown(aKey) ? SRKeyEventTypeDown : SRKeyEventTypeUp;
+}
+
+
+NS_INLINE BOOL _SRShortcutKeyIsRepeat(_SRShortcutKey aKey)
+{
+    return SRCoreShortcutKeyIsRepeat(aKey);
+}
+
+
+/*!
+ The key without the auto-repeat mark, suitable for lookups.
+ */
+NS_INLINE _SRShortcutKey _SRShortcutKeyGetLookupKey(_SRShortcutKey aKey)
+{
+    return SRCoreShortcutKeyGetLookupKey(aKey);
+}
+
+
+/*!
+ Position of an action among the actions of a key: by priority, then by the order of addition.
+ The sequence is unique within the monitor.
+ */
+typedef SRCoreActionRank _SRShortcutActionRank;
+
+
+/*!
+ Table of enabled actions keyed by _SRShortcutKey, see SRCoreActionTable.
+
+ @discussion
+ Every key owns a contiguous array of actions ordered by rank from the lowest to the highest,
+ so performing them in reverse tries higher priorities and then more recent actions first.
+ The receiver retains the actions.
+ */
+@interface _SRShortcutActionTable : NSObject <NSCopying>
+
+/*!
+ Number of keys with at least one action.
+ */
+@property (readonly) NSUInteger count;
+
+/*!
+ Contiguous array of actions associated with the key.
+
+ @param outCount Number of actions in the returned array.
+
+ @return NULL if the key has no associated actions.
+
+ @note The array is invalidated by the next mutation of the receiver.
+ */
+- (SRShortcutAction * __unsafe_unretained const *)actionsForKey:(_SRShortcutKey)aKey count:(NSUInteger *)outCount NS_RETURNS_INNER_POINTER;
+
+/*!
+ Same as -actionsForKey:count:, additionally returns the fire counter of the key, if any.
+ */
+- (SRShortcutAction * __unsafe_unretained const *)actionsForKey:(_SRShortcutKey)aKey
+                                                          count:(NSUInteger *)outCount
+                                                      fireCount:(_Atomic(uint64_t) * _Nullable *)outFireCount NS_RETURNS_INNER_POINTER;
+
+/*!
+ Associate a fire counter with the key, which must have actions.
+
+ @discussion
+ The counter is not owned by the receiver and is shared with its copies.
+ */
+- (void)setFireCount:(_Atomic(uint64_t) *)aFireCount forKey:(_SRShortcutKey)aKey;
+
+- (BOOL)containsAction:(SRShortcutAction *)anAction forKey:(_SRShortcutKey)aKey;
+
+/*!
+ Insert the action into the actions of the key according to its rank.
+
+ @discussion
+ The action must not be associated with the key.
+ */
+- (void)addAction:(SRShortcutAction *)anAction forKey:(_SRShortcutKey)aKey rank:(_SRShortcutActionRank)aRank;
+
+/*!
+ Change the rank of the action.
+
+ @discussion
+ Only the actions between the old and the new positions are shifted.
+ */
+- (void)moveAction:(SRShortcutAction *)anAction
+            forKey:(_SRShortcutKey)aKey
+          fromRank:(_SRShortcutActionRank)anOldRank
+            toRank:(_SRShortcutActionRank)aNewRank;
+
+- (void)removeAction:(SRShortcutAction *)anAction forKey:(_SRShortcutKey)aKey rank:(_SRShortcutActionRank)aRank;
+
+- (void)removeAllActions;
+
+- (void)enumerateKeysAndActionsUsingBlock:(void (NS_NOESCAPE ^)(_SRShortcutKey aKey, SRShortcutAction * __unsafe_unretained const *anActions, NSUInteger aCount))aBlock;
+
+@end
+
+
+@implementation _SRShortcutActionTable
+{
+    SRCoreActionTable _table;
+}
+
+NS_INLINE SRShortcutAction * __unsafe_unretained const *_SRShortcutActionTableEntryGetActions(SRCoreActionTableEntry *anEntry)
+{
+    return (SRShortcutAction * __unsafe_unretained const *)(const void *)anEntry->actions;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (self && !SRCoreActionTableInit(&_table))
+        return nil;
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_table.entries)
+        [self _releaseActions];
+
+    SRCoreActionTableDestroy(&_table);
+}
+
+#pragma mark Properties
+
+- (NSUInteger)count
+{
+    return _table.count;
+}
+
+#pragma mark Methods
+
+- (SRShortcutAction * __unsafe_unretained const *)actionsForKey:(_SRShortcutKey)aKey count:(NSUInteger *)outCount
+{
+    SRCoreActionTableEntry *entry = SRCoreActionTableGetEntry(&_table, aKey);
+
+    if (entry)
+    {
+        *outCount = entry->count;
+        return _SRShortcutActionTableEntryGetActions(entry);
+    }
+    else
+    {
+        *outCount = 0;
+        return NULL;
+    }
+}
+
+- (SRShortcutAction * __unsafe_unretained const *)actionsForKey:(_SRShortcutKey)aKey
+                                                          count:(NSUInteger *)outCount
+                                                      fireCount:(_Atomic(uint64_t) **)outFireCount
+{
+    SRCoreActionTableEntry *entry = SRCoreActionTableGetEntry(&_table, aKey);
+
+    if (entry)
+    {
+        *outCount = entry->count;
+        *outFireCount = (_Atomic(uint64_t) *)entry->context;
+        return _SRShortcutActionTableEntryGetActions(entry);
+    }
+    else
+    {
+        *outCount = 0;
+        *outFireCount = NULL;
+        return NULL;
+    }
+}
+
+- (void)setFireCount:(_Atomic(uint64_t) *)aFireCount forKey:(_SRShortcutKey)aKey
+{
+    SRCoreActionTableEntry *entry = SRCoreActionTableGetEntry(&_table, aKey);
+    NSParameterAssert(entry);
+
+    if (entry)
+        entry->context = (void *)aFireCount;
+}
+
+- (BOOL)containsAction:(SRShortcutAction *)anAction forKey:(_SRShortcutKey)aKey
+{
+    return SRCoreActionTableContainsAction(&_table, aKey, (__bridge const void *)anAction);
+}
+
+- (void)addAction:(SRShortcutAction *)anAction forKey:(_SRShortcutKey)aKey rank:(_SRShortcutActionRank)aRank
+{
+    NSParameterAssert(aKey != SRCoreShortcutKeyInvalid);
+    NSParameterAssert(![self containsAction:anAction forKey:aKey]);
+
+    CFRetain((__bridge CFTypeRef)anAction);
+
+    if (!SRCoreActionTableAddAction(&_table, aKey, (__bridge const void *)anAction, aRank))
+    {
+        CFRelease((__bridge CFTypeRef)anAction);
+        [NSException raise:NSMallocException format:@"Failed to add an action to the table"];
+    }
+}
+
+- (void)moveAction:(SRShortcutAction *)anAction
+            forKey:(_SRShortcutKey)aKey
+          fromRank:(_SRShortcutActionRank)anOldRank
+            toRank:(_SRShortcutActionRank)aNewRank
+{
+    __unused BOOL isMoved = SRCoreActionTableMoveAction(&_table, aKey, (__bridge const void *)anAction, anOldRank, aNewRank);
+    NSParameterAssert(isMoved);
+}
+
+- (void)removeAction:(SRShortcutAction *)anAction forKey:(_SRShortcutKey)aKey rank:(_SRShortcutActionRank)aRank
+{
+    BOOL isRemoved = SRCoreActionTableRemoveAction(&_table, aKey, (__bridge const void *)anAction, aRank);
+    NSParameterAssert(isRemoved);
+
+    if (isRemoved)
+        CFRelease((__bridge CFTypeRef)anAction);
+}
+
+- (void)removeAllActions
+{
+    [self _releaseActions];
+    SRCoreActionTableDestroy(&_table);
+
+    if (!SRCoreActionTableInit(&_table))
+        [NSException raise:NSMallocException format:@"Failed to reset the table"];
+}
+
+- (void)enumerateKeysAndActionsUsingBlock:(void (NS_NOESCAPE ^)(_SRShortcutKey, SRShortcutAction * __unsafe_unretained const *, NSUInteger))aBlock
+{
+    size_t capacity = SRCoreActionTableCapacity(&_table);
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        SRCoreActionTableEntry *entry = &_table.entries[i];
+
+        if (entry->key != SRCoreShortcutKeyInvalid)
+            aBlock(entry->key, _SRShortcutActionTableEntryGetActions(entry), entry->count);
+    }
+}
+
+#pragma mark Private
+
+- (void)_retainActions
+{
+    size_t capacity = SRCoreActionTableCapacity(&_table);
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        for (uint32_t j = 0; j < _table.entries[i].count; ++j)
+            CFRetain(_table.entries[i].actions[j]);
+    }
+}
+
+- (void)_releaseActions
+{
+    size_t capacity = SRCoreActionTableCapacity(&_table);
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        for (uint32_t j = 0; j < _table.entries[i].count; ++j)
+            CFRelease(_table.entries[i].actions[j]);
+    }
+}
+
+#pragma mark NSCopying
+
+- (id)copyWithZone:(NSZone *)aZone
+{
+    _SRShortcutActionTable *copy = [[self.class allocWithZone:aZone] init];
+
+    if (!copy)
+        return nil;
+
+    SRCoreActionTableDestroy(&copy->_table);
+
+    if (!SRCoreActionTableCopy(&copy->_table, &_table))
+        return nil;
+
+    [copy _retainActions];
+    return copy;
+}
+
+@end
+
+
+/*!
+ Number of buckets of the latency histograms: the bucket i counts durations within [2^i, 2^(i + 1)) nanoseconds.
+ */
+#define _SRLatencyHistogramBucketCount 32
+
+
+NS_INLINE uint64_t _SRMetricsTimestamp(void)
+{
+#if SR_SHORTCUT_MONITOR_METRICS
+    return mach_absolute_time();
+#else
+    return 0;
+#endif
+}
+
+
+NS_INLINE void _SRMetricsIncrement(_Atomic(uint64_t) * _Nullable aCounter)
+{
+#if SR_SHORTCUT_MONITOR_METRICS
+    if (aCounter)
+        atomic_fetch_add_explicit(aCounter, 1, memory_order_relaxed);
+#endif
+}
+
+
+/*!
+ Private storage of SRShortcutMonitor's metrics.
+
+ @discussion
+ Shared with the action queue, so that it can record durations of actions it performs.
+ */
+@interface _SRShortcutMonitorMetricsStorage : NSObject
+{
+    @public
+    _Atomic(uint64_t) _seenEventCount;
+    _Atomic(uint64_t) _matchedEventCount;
+    _Atomic(uint64_t) _consumedEventCount;
+    _Atomic(uint64_t) _lookupLatencyHistogram[_SRLatencyHistogramBucketCount];
+    _Atomic(uint64_t) _actionLatencyHistogram[_SRLatencyHistogramBucketCount];
+    uint32_t _timebaseNumer;
+    uint32_t _timebaseDenom;
+}
+
+/*!
+ Stable fire counter of the key. Counters are never deallocated before the receiver.
+
+ @note Must be called under the monitor's lock.
+ */
+- (_Atomic(uint64_t) *)fireCountForKey:(_SRShortcutKey)aKey;
+
+/*!
+ @note Must be called under the monitor's lock.
+ */
+- (void)enumerateFireCountsUsingBlock:(void (NS_NOESCAPE ^)(_SRShortcutKey aKey, uint64_t aFireCount))aBlock;
+
+@end
+
+
+/*!
+ Record the time elapsed since aStart, as returned by _SRMetricsTimestamp, into one of the histograms of aMetrics.
+ */
+NS_INLINE void _SRMetricsRecordDuration(_SRShortcutMonitorMetricsStorage *aMetrics, _Atomic(uint64_t) *aHistogram, uint64_t aStart)
+{
+#if SR_SHORTCUT_MONITOR_METRICS
+    uint64_t nanoseconds = (mach_absolute_time() - aStart) * aMetrics->_timebaseNumer / aMetrics->_timebaseDenom;
+    NSUInteger bucket = MIN((NSUInteger)(63 - __builtin_clzll(nanoseconds | 1)), _SRLatencyHistogramBucketCount - 1);
+    atomic_fetch_add_explicit(&aHistogram[bucket], 1, memory_order_relaxed);
+#endif
+}
+
+
+@implementation _SRShortcutMonitorMetricsStorage
+{
+    NSMapTable<NSNumber *, id> *_keyToFireCount;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (self)
+    {
+        _keyToFireCount = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality
+                                                valueOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality];
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        _timebaseNumer = timebase.numer;
+        _timebaseDenom = timebase.denom;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    for (NSNumber *key in _keyToFireCount)
+        free((__bridge void *)[_keyToFireCount objectForKey:key]);
+}
+
+#pragma mark Methods
+
+- (_Atomic(uint64_t) *)fireCountForKey:(_SRShortcutKey)aKey
+{
+    _Atomic(uint64_t) *fireCount = (__bridge void *)[_keyToFireCount objectForKey:@(aKey)];
+
+    if (!fireCount)
+    {
+        fireCount = (_Atomic(uint64_t) *)malloc(sizeof(_Atomic(uint64_t)));
+        atomic_init(fireCount, 0);
+        [_keyToFireCount setObject:(__bridge id)(void *)fireCount forKey:@(aKey)];
+    }
+
+    return fireCount;
+}
+
+- (void)enumerateFireCountsUsingBlock:(void (NS_NOESCAPE ^)(_SRShortcutKey, uint64_t))aBlock
+{
+    for (NSNumber *key in _keyToFireCount)
+    {
+        _Atomic(uint64_t) *fireCount = (__bridge void *)[_keyToFireCount objectForKey:key];
+        aBlock((_SRShortcutKey)key.unsignedIntValue, atomic_load_explicit(fireCount, memory_order_relaxed));
+    }
+}
+
+@end
+
+
+@interface SRShortcutMonitorMetrics ()
+- (instancetype)initWithStorage:(_SRShortcutMonitorMetricsStorage *)aStorage
+                     fireCounts:(NSDictionary<NSNumber *, NSNumber *> *)aFireCounts NS_DESIGNATED_INITIALIZER;
+@end
+
+
+@implementation SRShortcutMonitorMetrics
+{
+    NSDictionary<NSNumber *, NSNumber *> *_fireCounts; // _SRShortcutKey to its fire count
+}
+
+- (instancetype)initWithStorage:(_SRShortcutMonitorMetricsStorage *)aStorage
+                     fireCounts:(NSDictionary<NSNumber *, NSNumber *> *)aFireCounts
+{
+    self = [super init];
+
+    if (self)
+    {
+        _seenEventCount = atomic_load_explicit(&aStorage->_seenEventCount, memory_order_relaxed);
+        _matchedEventCount = atomic_load_explicit(&aStorage->_matchedEventCount, memory_order_relaxed);
+        _consumedEventCount = atomic_load_explicit(&aStorage->_consumedEventCount, memory_order_relaxed);
+
+        NSMutableArray<NSNumber *> *lookupLatencyHistogram = [NSMutableArray arrayWithCapacity:_SRLatencyHistogramBucketCount];
+        NSMutableArray<NSNumber *> *actionLatencyHistogram = [NSMutableArray arrayWithCapacity:_SRLatencyHistogramBucketCount];
+
+        for (NSUInteger i = 0; i < _SRLatencyHistogramBucketCount; ++i)
+        {
+            [lookupLatencyHistogram addObject:@(atomic_load_explicit(&aStorage->_lookupLatencyHistogram[i], memory_order_relaxed))];
+            [actionLatencyHistogram addObject:@(atomic_load_explicit(&aStorage->_actionLatencyHistogram[i], memory_order_relaxed))];
+        }
+
+        _lookupLatencyHistogram = [lookupLatencyHistogram copy];
+        _actionLatencyHistogram = [actionLatencyHistogram copy];
+        _fireCounts = [aFireCounts copy];
+    }
+
+    return self;
+}
+
+#pragma mark Methods
+
+- (uint64_t)fireCountForShortcut:(SRShortcut *)aShortcut keyEvent:(SRKeyEventType)aKeyEvent
+{
+    return _fireCounts[@(_SRShortcutKeyMakeWithShortcut(aShortcut, aKeyEvent))].unsignedLongLongValue;
+}
+
+@end
+
+
+/*!
+ Deterministic automaton that recognizes shortcut sequences such as ⌃X ⌃S, see SRCoreSequenceTable.
+
+ @discussion
+ The transitions are immutable. The current state is the only mutable part and is expected to be advanced
+ by one thread at a time, i.e. by the thread that handles events of the monitor.
+ */
+@interface _SRShortcutSequenceMatcher : NSObject
+
+@property (nonatomic, readonly) NSArray<NSArray<SRShortcut *> *> *sequences;
+
+/*!
+ @param aSequences Actions associated with sequences of at least 2 shortcuts.
+
+ @param aTimeout Maximum time between keystrokes.
+ */
+- (instancetype)initWithSequences:(NSDictionary<NSArray<SRShortcut *> *, NSArray<SRShortcutAction *> *> *)aSequences
+                          timeout:(NSTimeInterval)aTimeout NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ Advance the automaton by the key down.
+
+ @discussion
+ Auto-repeats of the key down are consumed while a sequence is in progress rather than advance it,
+ so holding the key of a sequence like ⌃X ⌃X does not complete it.
+
+ @param aTime Mach time of the key event; the timeout is measured by it rather than by the current time.
+
+ @param outActions Actions of the completed sequence.
+ */
+- (SRCoreSequenceStep)stepWithKey:(_SRShortcutKey)aKey
+                             time:(uint64_t)aTime
+                          actions:(NSArray<SRShortcutAction *> * _Nullable * _Nonnull)outActions;
+
+@end
+
+
+@implementation _SRShortcutSequenceMatcher
+{
+    SRCoreSequenceTable _table;
+    NSArray<NSArray<SRShortcutAction *> *> *_sequenceActions; // owns the actions of the table
+    uint64_t _timeout; // in mach time units
+    _Atomic(uint32_t) _state;
+    _Atomic(uint64_t) _stateTimestamp;
+}
+
+- (instancetype)initWithSequences:(NSDictionary<NSArray<SRShortcut *> *, NSArray<SRShortcutAction *> *> *)aSequences
+                          timeout:(NSTimeInterval)aTimeout
+{
+    self = [super init];
+
+    if (self)
+    {
+        _sequences = aSequences.allKeys;
+
+        if (!SRCoreSequenceTableInit(&_table))
+            return nil;
+
+        NSMutableArray<NSArray<SRShortcutAction *> *> *sequenceActions = [NSMutableArray arrayWithCapacity:aSequences.count];
+        __block BOOL isBuilt = YES;
+        [aSequences enumerateKeysAndObjectsUsingBlock:^(NSArray<SRShortcut *> *aSequence, NSArray<SRShortcutAction *> *anActions, BOOL *aStop) {
+            SRCoreShortcutKey keys[aSequence.count];
+
+            for (NSUInteger i = 0; i < aSequence.count; ++i)
+                keys[i] = _SRShortcutKeyMakeWithShortcut(aSequence[i], SRKeyEventTypeDown);
+
+            NSArray<SRShortcutAction *> *actions = [anActions copy];
+            [sequenceActions addObject:actions];
+
+            if (SRCoreSequenceTableAddSequence(&self->_table, keys, aSequence.count, (__bridge const void *)actions) == SRCoreSequenceInvalidState)
+            {
+                isBuilt = NO;
+                *aStop = YES;
+            }
+        }];
+
+        if (!isBuilt)
+            return nil;
+
+        _sequenceActions = sequenceActions;
+
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        _timeout = (uint64_t)(aTimeout * NSEC_PER_SEC) * timebase.denom / timebase.numer;
+        atomic_init(&_state, SRCoreSequenceRootState);
+        atomic_init(&_stateTimestamp, 0);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    SRCoreSequenceTableDestroy(&_table);
+}
+
+- (SRCoreSequenceStep)stepWithKey:(_SRShortcutKey)aKey time:(uint64_t)aTime actions:(NSArray<SRShortcutAction *> **)outActions
+{
+    uint64_t now = aTime;
+    uint32_t state = atomic_load_explicit(&_state, memory_order_relaxed);
+
+    if (state != SRCoreSequenceRootState && now - atomic_load_explicit(&_stateTimestamp, memory_order_relaxed) > _timeout)
+        state = SRCoreSequenceRootState;
+
+    const void *actions = NULL;
+    __auto_type step = SRCoreSequenceTableStep(&_table, state, aKey, &state, &actions);
+
+    // Auto-repeats do not extend the time to complete the sequence.
+    if (step == SRCoreSequenceStepPrefix && !_SRShortcutKeyIsRepeat(aKey))
+        atomic_store_explicit(&_stateTimestamp, now, memory_order_relaxed);
+    else if (step == SRCoreSequenceStepComplete)
+        *outActions = (__bridge NSArray<SRShortcutAction *> *)actions;
+
+    atomic_store_explicit(&_state, state, memory_order_relaxed);
+    return step;
+}
+
+@end
+
+
+/*!
+ Immutable state of SRShortcutMonitor that is read without locking.
+ */
+@interface _SRShortcutMonitorSnapshot : NSObject
+
+@property (nonatomic, readonly) NSArray<SRShortcutAction *> *actions;
+
+@property (nonatomic, readonly) NSArray<SRShortcutAction *> *keyDownActions;
+
+@property (nonatomic, readonly) NSArray<SRShortcutAction *> *keyUpActions;
+
+@property (nonatomic, readonly) NSArray<SRShortcut *> *shortcuts;
+
+/*!
+ @note Must not be mutated.
+ */
+@property (nonatomic, readonly) _SRShortcutActionTable *enabledActionsTable;
+
+/*!
+ Nil if there are no shortcut sequences.
+
+ @note Carried over to the next snapshot unless sequences change: its state survives unrelated mutations.
+ */
+@property (nonatomic, readonly, nullable) _SRShortcutSequenceMatcher *sequenceMatcher;
+
+- (instancetype)initWithActions:(NSArray<SRShortcutAction *> *)anActions
+                 keyDownActions:(NSArray<SRShortcutAction *> *)aKeyDownActions
+                   keyUpActions:(NSArray<SRShortcutAction *> *)aKeyUpActions
+                      shortcuts:(NSArray<SRShortcut *> *)aShortcuts
+            enabledActionsTable:(_SRShortcutActionTable *)aTable
+                sequenceMatcher:(nullable _SRShortcutSequenceMatcher *)aSequenceMatcher NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+- (NSArray<SRShortcutAction *> *)actionsForKeyEvent:(SRKeyEventType)aKeyEvent;
+
+/*!
+ Perform enabled actions for the key in reverse order until one of them handles it.
+
+ @param aTime Mach time of the key event.
+ */
+- (BOOL)performEnabledActionsForKey:(_SRShortcutKey)aKey time:(uint64_t)aTime onTarget:(nullable id)aTarget;
+
+@end
+
+
+/*!
+ Perform actions in reverse order until one of them handles the event.
+ */
+NS_INLINE BOOL _SRPerformActions(SRShortcutAction * __unsafe_unretained const *anActions,
+                                  NSUInteger aCount,
+                                  id _Nullable aTarget,
+                                  BOOL anIsRepeat,
+                                  uint64_t aTime)
+{
+    for (NSUInteger i = aCount; i > 0; --i)
+    {
+        if ([anActions[i - 1] _performActionOnTarget:aTarget isRepeat:anIsRepeat time:aTime])
+            return YES;
+    }
+
+    return NO;
+}
+
+
+/*!
+ Same as _SRPerformActions for the actions of a shortcut sequence or a modifier gesture.
+ */
+NS_INLINE BOOL _SRPerformActionsInArray(NSArray<SRShortcutAction *> *anActions, id _Nullable aTarget, BOOL anIsRepeat, uint64_t aTime)
+{
+    for (NSUInteger i = anActions.count; i > 0; --i)
+    {
+        if ([anActions[i - 1] _performActionOnTarget:aTarget isRepeat:anIsRepeat time:aTime])
+            return YES;
+    }
+
+    return NO;
+}
+
+
+@implementation _SRShortcutMonitorSnapshot
+
+- (instancetype)initWithActions:(NSArray<SRShortcutAction *> *)anActions
+                 keyDownActions:(NSArray<SRShortcutAction *> *)aKeyDownActions
+                   keyUpActions:(NSArray<SRShortcutAction *> *)aKeyUpActions
+                      shortcuts:(NSArray<SRShortcut *> *)aShortcuts
+            enabledActionsTable:(_SRShortcutActionTable *)aTable
+                sequenceMatcher:(_SRShortcutSequenceMatcher *)aSequenceMatcher
+{
+    self = [super init];
+
+    if (self)
+    {
+        _actions = anActions;
+        _keyDownActions = aKeyDownActions;
+        _keyUpActions = aKeyUpActions;
+        _shortcuts = aShortcuts;
+        _enabledActionsTable = aTable;
+        _sequenceMatcher = aSequenceMatcher;
+    }
+
+    return self;
+}
+
+- (NSArray<SRShortcutAction *> *)actionsForKeyEvent:(SRKeyEventType)aKeyEvent
+{
+    switch (aKeyEvent)
+    {
+        case SRKeyEventTypeDown:
+            return _keyDownActions;
+        case SRKeyEventTypeUp:
+            return _keyUpActions;
+        default:
+            [NSException raise:NSInvalidArgumentException format:@"Unexpected keyboard event type %lu", aKeyEvent];
+            return nil;
+    }
+}
+
+- (BOOL)performEnabledActionsForKey:(_SRShortcutKey)aKey time:(uint64_t)aTime onTarget:(nullable id)aTarget
+{
+    // The receiver keeps its actions alive for as long as it's retained.
+    NSUInteger count = 0;
+    __auto_type actions = [_enabledActionsTable actionsForKey:_SRShortcutKeyGetLookupKey(aKey) count:&count];
+    return _SRPerformActions(actions, count, aTarget, _SRShortcutKeyIsRepeat(aKey), aTime);
+}
+
+@end
+
+
+typedef struct
+{
+    _Atomic(NSUInteger) sequence;
+    _SRShortcutKey key;
+    uint64_t time;
+    CFTypeRef snapshot;
+    CFTypeRef actions; // NULL for the enabled actions of the key in the snapshot
+    CFTypeRef target;
+} _SRShortcutActionRingSlot;
+
+
+/*!
+ Bounded lock-free FIFO of key events whose actions are performed on a dispatch queue.
+
+ @discussion
+ Based on Dmitry Vyukov's bounded MPMC queue: every slot has a sequence number that tells producers
+ and the consumer whether the slot is free or filled. The consumer is the event handler of a dispatch source
+ and therefore serial. Enqueuing never allocates or blocks.
+ */
+@interface _SRShortcutActionRing : NSObject
+
+@property (readonly) NSUInteger enqueuedCount;
+
+@property (readonly) NSUInteger overflowCount;
+
+/*!
+ @param aCapacity Power of 2.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)aCapacity
+                           queue:(dispatch_queue_t)aQueue
+                         metrics:(_SRShortcutMonitorMetricsStorage *)aMetrics NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ @param aTime Mach time of the key event, the actions are performed as of that time.
+
+ @param aSnapshot Snapshot whose enabled actions of the key are performed unless anActions is given.
+
+ @param anActions Actions of a completed shortcut sequence or a modifier gesture.
+
+ @return NO if the ring is full.
+ */
+- (BOOL)enqueueKey:(_SRShortcutKey)aKey
+              time:(uint64_t)aTime
+          snapshot:(nullable _SRShortcutMonitorSnapshot *)aSnapshot
+           actions:(nullable NSArray<SRShortcutAction *> *)anActions
+            target:(nullable id)aTarget;
+
+@end
+
+
+@implementation _SRShortcutActionRing
+{
+    _SRShortcutActionRingSlot *_slots;
+    NSUInteger _mask;
+    _Atomic(NSUInteger) _enqueuePosition;
+    _Atomic(NSUInteger) _dequeuePosition;
+    _Atomic(NSUInteger) _enqueuedCount;
+    _Atomic(NSUInteger) _overflowCount;
+    dispatch_source_t _source;
+    _SRShortcutMonitorMetricsStorage *_metrics;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)aCapacity
+                           queue:(dispatch_queue_t)aQueue
+                         metrics:(_SRShortcutMonitorMetricsStorage *)aMetrics
+{
+    NSParameterAssert(aCapacity && !(aCapacity & (aCapacity - 1)));
+
+    self = [super init];
+
+    if (self)
+    {
+        _slots = (_SRShortcutActionRingSlot *)calloc(aCapacity, sizeof(_SRShortcutActionRingSlot));
+        _mask = aCapacity - 1;
+        _metrics = aMetrics;
+
+        for (NSUInteger i = 0; i < aCapacity; ++i)
+            atomic_init(&_slots[i].sequence, i);
+
+        atomic_init(&_enqueuePosition, 0);
+        atomic_init(&_dequeuePosition, 0);
+        atomic_init(&_enqueuedCount, 0);
+        atomic_init(&_overflowCount, 0);
+
+        _source = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, aQueue);
+        __weak typeof(self) weakSelf = self;
+        dispatch_source_set_event_handler(_source, ^{
+            [weakSelf _drain];
+        });
+        dispatch_resume(_source);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    dispatch_source_cancel(_source);
+
+    _SRShortcutKey key;
+    uint64_t time;
+    CFTypeRef snapshot;
+    CFTypeRef actions;
+    CFTypeRef target;
+
+    while ([self _dequeueKey:&key time:&time snapshot:&snapshot actions:&actions target:&target])
+    {
+        if (snapshot)
+            CFRelease(snapshot);
+
+        if (actions)
+            CFRelease(actions);
+
+        if (target)
+            CFRelease(target);
+    }
+
+    free(_slots);
+}
+
+#pragma mark Properties
+
+- (NSUInteger)enqueuedCount
+{
+    return atomic_load_explicit(&_enqueuedCount, memory_order_relaxed);
+}
+
+- (NSUInteger)overflowCount
+{
+    return atomic_load_explicit(&_overflowCount, memory_order_relaxed);
+}
+
+#pragma mark Methods
+
+- (BOOL)enqueueKey:(_SRShortcutKey)aKey
+              time:(uint64_t)aTime
+          snapshot:(_SRShortcutMonitorSnapshot *)aSnapshot
+           actions:(NSArray<SRShortcutAction *> *)anActions
+            target:(id)aTarget
+{
+    NSUInteger position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+    _SRShortcutActionRingSlot *slot = NULL;
+
+    while (YES)
+    {
+        slot = &_slots[position & _mask];
+        NSUInteger sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        NSInteger difference = (NSInteger)sequence - (NSInteger)position;
+
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&_enqueuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            atomic_fetch_add_explicit(&_overflowCount, 1, memory_order_relaxed);
+            return NO;
+        }
+        else
+            position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+    }
+
+    slot->key = aKey;
+    slot->time = aTime;
+    slot->snapshot = aSnapshot ? CFBridgingRetain(aSnapshot) : NULL;
+    slot->actions = anActions ? CFBridgingRetain(anActions) : NULL;
+    slot->target = aTarget ? CFBridgingRetain(aTarget) : NULL;
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    atomic_fetch_add_explicit(&_enqueuedCount, 1, memory_order_relaxed);
+    dispatch_source_merge_data(_source, 1);
+    return YES;
+}
+
+#pragma mark Private
+
+- (BOOL)_dequeueKey:(_SRShortcutKey *)outKey
+              time:(uint64_t *)outTime
+          snapshot:(CFTypeRef *)outSnapshot
+           actions:(CFTypeRef *)outActions
+            target:(CFTypeRef *)outTarget
+{
+    // There is only one consumer.
+    NSUInteger position = atomic_load_explicit(&_dequeuePosition, memory_order_relaxed);
+    _SRShortcutActionRingSlot *slot = &_slots[position & _mask];
+
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != position + 1)
+        return NO;
+
+    *outKey = slot->key;
+    *outTime = slot->time;
+    *outSnapshot = slot->snapshot;
+    *outActions = slot->actions;
+    *outTarget = slot->target;
+    slot->snapshot = NULL;
+    slot->actions = NULL;
+    slot->target = NULL;
+    atomic_store_explicit(&_dequeuePosition, position + 1, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, position + _mask + 1, memory_order_release);
+    return YES;
+}
+
+- (void)_drain
+{
+    _SRShortcutKey key;
+    uint64_t time;
+    CFTypeRef snapshotRef;
+    CFTypeRef actionsRef;
+    CFTypeRef targetRef;
+
+    while ([self _dequeueKey:&key time:&time snapshot:&snapshotRef actions:&actionsRef target:&targetRef])
+    {
+        @autoreleasepool
+        {
+            _SRShortcutMonitorSnapshot *snapshot = snapshotRef ? CFBridgingRelease(snapshotRef) : nil;
+            NSArray<SRShortcutAction *> *actions = actionsRef ? CFBridgingRelease(actionsRef) : nil;
+            id target = targetRef ? CFBridgingRelease(targetRef) : nil;
+            uint64_t start = _SRMetricsTimestamp();
+
+            if (actions)
+                _SRPerformActionsInArray(actions, target, _SRShortcutKeyIsRepeat(key), time);
+            else
+                [snapshot performEnabledActionsForKey:key time:time onTarget:target];
+
+            _SRMetricsRecordDuration(_metrics, _metrics->_actionLatencyHistogram, start);
+        }
+    }
+}
+
+@end
+
+
+/*!
+ Parts of the monitor's state that changed since the last published snapshot.
+ */
+typedef NS_OPTIONS(NSUInteger, _SRShortcutMonitorSnapshotPart)
+{
+    _SRShortcutMonitorSnapshotPartActions = 1 << 0,
+    _SRShortcutMonitorSnapshotPartShortcuts = 1 << 1,
+    _SRShortcutMonitorSnapshotPartEnabledActions = 1 << 2,
+    _SRShortcutMonitorSnapshotPartShortcutSequences = 1 << 3,
+    _SRShortcutMonitorSnapshotPartAll = _SRShortcutMonitorSnapshotPartActions |
+                                        _SRShortcutMonitorSnapshotPartShortcuts |
+                                        _SRShortcutMonitorSnapshotPartEnabledActions |
+                                        _SRShortcutMonitorSnapshotPartShortcutSequences
+};
+
+
+static const NSUInteger _SRShortcutActionRingCapacity = 256;
+
+static const NSTimeInterval _SRShortcutSequenceDefaultTimeout = 1.0;
+
+
+typedef NS_OPTIONS(uint8_t, _SRKeyEventMask)
+{
+    _SRKeyEventMaskDown = 1 << 0,
+    _SRKeyEventMaskUp = 1 << 1
+};
+
+
+NS_INLINE _SRKeyEventMask _SRKeyEventMaskMake(SRKeyEventType aKeyEvent)
+{
+    return aKeyEvent == SRKeyEventTypeDown ? _SRKeyEventMaskDown : _SRKeyEventMaskUp;
+}
+
+
+/*!
+ What the monitor knows about one of its actions.
+
+ @discussion
+ The record is the only place that knows under which keys the action is stored in the enabled actions table:
+ the shortcut of the action itself may already be different when the monitor is notified.
+
+ The ranks the action has in the enabled actions table are derived from the priority
+ and the sequences of its most recent additions.
+ */
+@interface _SRShortcutMonitorActionRecord : NSObject
+{
+    @public
+    _SRKeyEventMask _keyEvents; // key events the action is added for
+    BOOL _isEnabled;
+    SRShortcut *_enabledShortcut; // shortcut in the enabled actions table, if any
+    SRShortcutActionPriority _priority;
+    uint64_t _keyDownSequence;
+    uint64_t _keyUpSequence;
+}
+@end
+
+
+@implementation _SRShortcutMonitorActionRecord
+@end
+
+
+NS_INLINE _SRShortcutActionRank _SRShortcutMonitorActionRecordGetRank(_SRShortcutMonitorActionRecord *aRecord, SRKeyEventType aKeyEvent)
+{
+    return (_SRShortcutActionRank){
+        aRecord->_priority,
+        aKeyEvent == SRKeyEventTypeDown ? aRecord->_keyDownSequence : aRecord->_keyUpSequence
+    };
+}
+
+
+/*!
+ Number of records buffered before they are handed to the writing queue.
+ */
+static const NSUInteger _SRShortcutMonitorTraceBufferCapacity = 1024;
+
+
+_Static_assert(sizeof(SRCoreTraceHeader) == 16, "Unexpected size of the trace header");
+_Static_assert(sizeof(SRCoreTraceRecord) == 16, "Unexpected size of the trace record");
+
+
+/*!
+ Appends records of key events to a trace file.
+
+ @discussion
+ Records are collected into one of two preallocated buffers under a short lock. Once the buffer is full
+ the buffers are swapped and a dispatch source signals the writing queue, so recording neither allocates
+ nor waits for the disk. Records that arrive while both buffers are full are dropped and counted.
+ */
+@interface _SRShortcutMonitorTraceRecorder : NSObject
+
+- (nullable instancetype)initWithURL:(NSURL *)aURL error:(NSError * _Nullable *)outError NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+- (void)recordKey:(_SRShortcutKey)aKey isHandled:(BOOL)anIsHandled start:(uint64_t)aStart end:(uint64_t)anEnd;
+
+/*!
+ Write the remaining records and close the file.
+ */
+- (void)close;
+
+@end
+
+
+@implementation _SRShortcutMonitorTraceRecorder
+{
+    pthread_mutex_t _lock;
+    FILE *_file; // accessed only on _queue
+    dispatch_queue_t _queue;
+    dispatch_source_t _source;
+    uint64_t _startTime; // in mach time units
+    SRCoreTraceRecord *_buffers[2];
+    NSUInteger _counts[2];
+    _Atomic(BOOL) _isBufferFull[2]; // set by the recorder, cleared by the writer
+    NSUInteger _recordIndex; // buffer being filled
+    NSUInteger _writeIndex; // next buffer to write, accessed only on _queue
+    NSUInteger _droppedCount;
+    BOOL _isClosed;
+}
+
+- (instancetype)initWithURL:(NSURL *)aURL error:(NSError * _Nullable *)outError
+{
+    FILE *file = fopen(aURL.fileSystemRepresentation, "wb");
+
+    if (!file)
+    {
+        if (outError)
+            *outError = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSURLErrorKey: aURL}];
+
+        return nil;
+    }
+
+    self = [super init];
+
+    if (self)
+    {
+        pthread_mutex_init(&_lock, NULL);
+        _file = file;
+        _queue = dispatch_queue_create("com.kulakov.ShortcutRecorder.ShortcutMonitorTrace", DISPATCH_QUEUE_SERIAL);
+        _startTime = mach_absolute_time();
+
+        for (NSUInteger i = 0; i < 2; ++i)
+        {
+            _buffers[i] = malloc(_SRShortcutMonitorTraceBufferCapacity * sizeof(SRCoreTraceRecord));
+            atomic_init(&_isBufferFull[i], NO);
+        }
+
+        __auto_type header = SRCoreTraceHeaderMake((uint64_t)(NSDate.date.timeIntervalSince1970 * NSEC_PER_SEC));
+        dispatch_async(_queue, ^{
+            if (fwrite(&header, sizeof(header), 1, file) != 1)
+                os_trace_error("#Error Unable to write trace header");
+        });
+
+        _source = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, _queue);
+        __weak typeof(self) weakSelf = self;
+        dispatch_source_set_event_handler(_source, ^{
+            [weakSelf _writeFullBuffers];
+        });
+        dispatch_resume(_source);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self close];
+    pthread_mutex_destroy(&_lock);
+}
+
+#pragma mark Methods
+
+- (void)recordKey:(_SRShortcutKey)aKey isHandled:(BOOL)anIsHandled start:(uint64_t)aStart end:(uint64_t)anEnd
+{
+    // An event that started before the recording is stamped with its start.
+    SRCoreTraceEvent event = {
+        _SRMachTimeToNanoseconds(MAX(aStart, _startTime) - _startTime),
+        (uint32_t)MIN(_SRMachTimeToNanoseconds(anEnd - aStart), UINT32_MAX),
+        aKey,
+        anIsHandled
+    };
+    __auto_type record = SRCoreTraceRecordMake(&event);
+
+    pthread_mutex_lock(&_lock);
+
+    if (!_isClosed)
+    {
+        NSUInteger i = _recordIndex;
+
+        if (atomic_load_explicit(&_isBufferFull[i], memory_order_acquire))
+            _droppedCount += 1; // the writer is behind by a whole buffer
+        else
+        {
+            _buffers[i][_counts[i]++] = record;
+
+            if (_counts[i] == _SRShortcutMonitorTraceBufferCapacity)
+            {
+                atomic_store_explicit(&_isBufferFull[i], YES, memory_order_release);
+                _recordIndex = 1 - i;
+                dispatch_source_merge_data(_source, 1);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)close
+{
+    pthread_mutex_lock(&_lock);
+
+    if (_isClosed)
+    {
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+
+    _isClosed = YES;
+
+    // Hand the partially filled buffer to the writer as well.
+    if (_counts[_recordIndex])
+        atomic_store_explicit(&_isBufferFull[_recordIndex], YES, memory_order_release);
+
+    NSUInteger droppedCount = _droppedCount;
+    pthread_mutex_unlock(&_lock);
+
+    if (droppedCount)
+        os_trace_error("#Error %lu trace records were dropped", droppedCount);
+
+    // Called from -dealloc as well: the block must not retain the receiver.
+    __unsafe_unretained typeof(self) unretainedSelf = self;
+    dispatch_sync(_queue, ^{
+        [unretainedSelf _writeFullBuffers];
+        fclose(unretainedSelf->_file);
+        unretainedSelf->_file = NULL;
+    });
+    dispatch_source_cancel(_source);
+
+    for (NSUInteger i = 0; i < 2; ++i)
+    {
+        free(_buffers[i]);
+        _buffers[i] = NULL;
+    }
+}
+
+#pragma mark Private
+
+/*!
+ @note Must be called on _queue.
+ */
+- (void)_writeFullBuffers
+{
+    // Buffers are filled in turns: writing them in turns keeps records in order.
+    while (atomic_load_explicit(&_isBufferFull[_writeIndex], memory_order_acquire))
+    {
+        NSUInteger count = _counts[_writeIndex];
+
+        if (_file && fwrite(_buffers[_writeIndex], sizeof(SRCoreTraceRecord), count, _file) != count)
+            os_trace_error("#Error Unable to write trace records");
+
+        _counts[_writeIndex] = 0;
+        atomic_store_explicit(&_isBufferFull[_writeIndex], NO, memory_order_release);
+        _writeIndex = 1 - _writeIndex;
+    }
+}
+
+@end
 
 
 @interface SRShortcutMonitor ()
 {
     @protected
     NSCountedSet<SRShortcutAction *> *_actions;
-    NSMutableSet<SRShortcutAction *> *_enabledActions;
     NSMutableSet<SRShortcutAction *> *_keyUpActions;
     NSMutableSet<SRShortcutAction *> *_keyDownActions;
-    NSMutableDictionary<SRShortcut *, NSMutableOrderedSet<SRShortcutAction *> *> *_shortcutToEnabledKeyDownActions;
-    NSMutableDictionary<SRShortcut *, NSMutableOrderedSet<SRShortcutAction *> *> *_shortcutToEnabledKeyUpActions;
+    _SRShortcutActionTable *_enabledActionsTable;
     NSCountedSet<SRShortcut *> *_shortcuts; // count increased for every enabled action
+    _SRShortcutMonitorSnapshotPart _invalidSnapshotParts;
+    NSUInteger _batchUpdatesDepth;
+    NSSet<SRShortcut *> *_batchUpdatesShortcuts; // shortcuts before the outermost batch
+    dispatch_queue_t _actionQueue;
+    _SRShortcutMonitorMetricsStorage *_metrics;
+    NSMutableDictionary<NSArray<SRShortcut *> *, NSMutableArray<SRShortcutAction *> *> *_sequenceActions;
+    NSTimeInterval _shortcutSequenceTimeout;
+    NSMapTable<SRShortcutAction *, _SRShortcutMonitorActionRecord *> *_actionRecords;
+    uint64_t _lastActionSequence;
 }
+
+/*!
+ The most recently published state of the monitor.
+
+ @discussion
+ Mutations are made under the lock and published by the writer as a new snapshot when the mutation,
+ or the outermost batch of mutations, ends. Only the changed parts are copied. Readers do a single atomic load
+ instead of taking the lock: an old snapshot is deallocated once the last reader releases it.
+ */
+@property (atomic) _SRShortcutMonitorSnapshot *snapshot;
+
+/*!
+ Set when actions are performed asynchronously on the actionQueue.
+ */
+@property (atomic, nullable) _SRShortcutActionRing *actionRing;
+
+/*!
+ Set while key events are recorded into a trace.
+ */
+@property (atomic, nullable) _SRShortcutMonitorTraceRecorder *traceRecorder;
+
+/*!
+ Perform enabled actions for the key or put them on the action queue.
+
+ @param aTime Mach time of the key event. Live events pass the current time, replays pass the replay clock.
+
+ @return Whether the key event is handled.
+ */
+- (BOOL)_performEnabledActionsForKey:(_SRShortcutKey)aKey time:(uint64_t)aTime onTarget:(nullable id)aTarget;
+
+/*!
+ Perform actions of a completed shortcut sequence or a modifier gesture or put them on the action queue.
+
+ @return Whether one of the actions handled the key or the actions are enqueued.
+ */
+- (BOOL)_performActions:(NSArray<SRShortcutAction *> *)anActions
+                 forKey:(_SRShortcutKey)aKey
+                   time:(uint64_t)aTime
+               onTarget:(nullable id)aTarget;
+
+/*!
+ Advance shortcut sequences by the key and perform enabled actions for it unless a sequence consumes it.
+
+ @return Whether the key event is handled.
+ */
+- (BOOL)_performActionsForKey:(_SRShortcutKey)aKey time:(uint64_t)aTime onTarget:(nullable id)aTarget;
+
+/*!
+ Called under the lock after shortcut sequences are published.
+ */
+- (void)_didChangeShortcutSequences;
+
+/*!
+ Record the key event into the trace, if any.
+
+ @param aStart Mach time when the monitor started handling the event.
+ */
+- (void)_traceKey:(_SRShortcutKey)aKey isHandled:(BOOL)anIsHandled since:(uint64_t)aStart;
+
 @end
 
 
+static bool _SRShortcutMonitorReplayEvent(void *aContext, const SRCoreTraceEvent *anEvent, uint64_t aTime)
+{
+    @autoreleasepool
+    {
+        __unsafe_unretained SRShortcutMonitor *monitor = (__bridge SRShortcutMonitor *)aContext;
+        return [monitor _performActionsForKey:anEvent->key time:_SRNanosecondsToMachTime(aTime) onTarget:nil];
+    }
+}
+
+
 @implementation SRShortcutMonitor
 
 - (instancetype)init
@@ -442,12 +2288,17 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
     if (self)
     {
         _actions = [NSCountedSet new];
-        _enabledActions = [NSMutableSet new];
-        _shortcutToEnabledKeyDownActions = [NSMutableDictionary new];
-        _shortcutToEnabledKeyUpActions = [NSMutableDictionary new];
+        _enabledActionsTable = [_SRShortcutActionTable new];
         _keyUpActions = [NSMutableSet new];
         _keyDownActions = [NSMutableSet new];
         _shortcuts = [NSCountedSet new];
+        _metrics = [_SRShortcutMonitorMetricsStorage new];
+        _sequenceActions = [NSMutableDictionary new];
+        _shortcutSequenceTimeout = _SRShortcutSequenceDefaultTimeout;
+        _actionRecords = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                               valueOptions:NSPointerFunctionsStrongMemory];
+        _invalidSnapshotParts = _SRShortcutMonitorSnapshotPartAll;
+        [self _publishSnapshotIfNeeded];
     }
 
     return self;
@@ -456,49 +2307,84 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
 - (void)dealloc
 {
     for (SRShortcutAction *a in _actions)
-        [a removeObserver:self forKeyPath:@"enabled" context:_SRShortcutMonitorContext];
+        [a _removeMonitor:self];
 
-    for (SRShortcutAction *a in _enabledActions)
-        [a removeObserver:self forKeyPath:@"shortcut" context:_SRShortcutMonitorContext];
+    [self.traceRecorder close];
 }
 
 #pragma mark Properties
 
 - (NSArray<SRShortcutAction *> *)actions
 {
-    @synchronized (_actions)
-    {
-        return _actions.allObjects;
-    }
+    return self.snapshot.actions;
 }
 
 - (NSArray<SRShortcut *> *)shortcuts
 {
+    return self.snapshot.shortcuts;
+}
+
+- (SRShortcutMonitorMetrics *)metrics
+{
+    NSMutableDictionary<NSNumber *, NSNumber *> *fireCounts = [NSMutableDictionary new];
+
     @synchronized (_actions)
     {
-        return _shortcuts.allObjects;
+        [_metrics enumerateFireCountsUsingBlock:^(_SRShortcutKey aKey, uint64_t aFireCount) {
+            fireCounts[@(aKey)] = @(aFireCount);
+        }];
     }
-}
 
-#pragma mark Methods
+    return [[SRShortcutMonitorMetrics alloc] initWithStorage:_metrics fireCounts:fireCounts];
+}
 
-- (NSArray<SRShortcutAction *> *)actionsForKeyEvent:(SRKeyEventType)aKeyEvent
+- (dispatch_queue_t)actionQueue
 {
     @synchronized (_actions)
     {
-        return [self _actionsForKeyEvent:aKeyEvent].allObjects;
+        return _actionQueue;
     }
 }
 
-- (NSArray<SRShortcutAction *> *)enabledActionsForShortcut:(SRShortcut *)aShortcut keyEvent:(SRKeyEventType)aKeyEvent
+- (void)setActionQueue:(dispatch_queue_t)anActionQueue
 {
     @synchronized (_actions)
     {
-        __auto_type result = [self _enabledActionsForShortcut:aShortcut keyEvent:aKeyEvent];
-        return result != nil ? [NSArray arrayWithArray:result.array] : [NSArray new];
+        _actionQueue = anActionQueue;
+        self.actionRing = anActionQueue ? [[_SRShortcutActionRing alloc] initWithCapacity:_SRShortcutActionRingCapacity
+                                                                                     queue:anActionQueue
+                                                                                   metrics:_metrics] : nil;
     }
 }
 
+- (NSUInteger)actionQueueEnqueuedCount
+{
+    return self.actionRing.enqueuedCount;
+}
+
+- (NSUInteger)actionQueueOverflowCount
+{
+    return self.actionRing.overflowCount;
+}
+
+#pragma mark Methods
+
+- (NSArray<SRShortcutAction *> *)actionsForKeyEvent:(SRKeyEventType)aKeyEvent
+{
+    return [self.snapshot actionsForKeyEvent:aKeyEvent];
+}
+
+- (NSArray<SRShortcutAction *> *)enabledActionsForShortcut:(SRShortcut *)aShortcut keyEvent:(SRKeyEventType)aKeyEvent
+{
+    if (aKeyEvent != SRKeyEventTypeDown && aKeyEvent != SRKeyEventTypeUp)
+        [NSException raise:NSInvalidArgumentException format:@"Unexpected keyboard event type %lu", aKeyEvent];
+
+    __auto_type snapshot = self.snapshot;
+    NSUInteger count = 0;
+    __auto_type actions = [snapshot.enabledActionsTable actionsForKey:_SRShortcutKeyMakeWithShortcut(aShortcut, aKeyEvent) count:&count];
+    return count ? [NSArray arrayWithObjects:actions count:count] : [NSArray new];
+}
+
 - (void)addAction:(SRShortcutAction *)anAction forKeyEvent:(SRKeyEventType)aKeyEvent
 {
     @synchronized (_actions)
@@ -506,41 +2392,58 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
         NSAssert([_actions countForObject:anAction] < 2, @"Action is added too many times");
 
         __auto_type keyEventActions = [self _actionsForKeyEvent:aKeyEvent];
-        BOOL isFirstActionForKeyEvent = ![keyEventActions containsObject:anAction];
+        __auto_type keyEventMask = _SRKeyEventMaskMake(aKeyEvent);
+        __auto_type record = [_actionRecords objectForKey:anAction];
+        BOOL isFirstAction = !record;
+        BOOL isFirstActionForKeyEvent = isFirstAction || !(record->_keyEvents & keyEventMask);
 
         if (isFirstActionForKeyEvent)
         {
-            BOOL isFirstAction = ![_actions countForObject:anAction];
-
             if (isFirstAction)
-                [self willChangeValueForKey:@"actions"];
+                [self _willChangeValueForKeyUnlessBatching:@"actions"];
 
             [_actions addObject:anAction];
             [keyEventActions addObject:anAction];
+            _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartActions;
 
             if (isFirstAction)
             {
-                [anAction addObserver:self
-                           forKeyPath:@"enabled"
-                              options:NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld | NSKeyValueObservingOptionInitial
-                              context:_SRShortcutMonitorContext];
+                // The action is never locked by the monitor: changes made after it adds the monitor are reported,
+                // those made before are read here.
+                record = [_SRShortcutMonitorActionRecord new];
+                record->_keyEvents = keyEventMask;
+                [_actionRecords setObject:record forKey:anAction];
+                [anAction _addMonitor:self];
+                record->_priority = anAction.priority;
+
+                if (anAction.isEnabled)
+                    [self _actionDidChangeEnabled:anAction];
             }
-            else if ([_enabledActions containsObject:anAction])
+            else
             {
-                __auto_type shortcut = [self _shortcutForEnabledAction:anAction hint:nil];
-                [self _addEnabledAction:anAction toShortcut:shortcut forKeyEvent:aKeyEvent];
+                record->_keyEvents |= keyEventMask;
+
+                if (record->_enabledShortcut)
+                    [self _addEnabledAction:anAction toShortcut:record->_enabledShortcut forKeyEvent:aKeyEvent];
             }
 
+            [self _publishSnapshotIfNeeded];
+
             if (isFirstAction)
-                [self didChangeValueForKey:@"actions"];
+                [self _didChangeValueForKeyUnlessBatching:@"actions"];
         }
-        else if (anAction.shortcut)
+        else if (record->_enabledShortcut)
         {
-            __auto_type shortcutActions = [self _enabledActionsForShortcut:anAction.shortcut keyEvent:aKeyEvent];
-            NSAssert(shortcutActions.count, @"Action was not added to the shortcut");
-            NSUInteger fromIndex = [shortcutActions indexOfObject:anAction];
-            NSAssert(fromIndex != NSNotFound, @"Action was not added to the shortcut");
-            [shortcutActions moveObjectsAtIndexes:[NSIndexSet indexSetWithIndex:fromIndex] toIndex:shortcutActions.count - 1];
+            // Make the action the most recent one of its priority.
+            __auto_type key = _SRShortcutKeyMakeWithShortcut(record->_enabledShortcut, aKeyEvent);
+            __auto_type oldRank = _SRShortcutMonitorActionRecordGetRank(record, aKeyEvent);
+            [self _setSequence:++_lastActionSequence ofRecord:record forKeyEvent:aKeyEvent];
+            [_enabledActionsTable moveAction:anAction
+                                      forKey:key
+                                    fromRank:oldRank
+                                      toRank:_SRShortcutMonitorActionRecordGetRank(record, aKeyEvent)];
+            _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartEnabledActions;
+            [self _publishSnapshotIfNeeded];
         }
     }
 }
@@ -550,51 +2453,52 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
     @synchronized (_actions)
     {
         __auto_type keyEventActions = [self _actionsForKeyEvent:aKeyEvent];
-        if (![keyEventActions containsObject:anAction])
+        __auto_type keyEventMask = _SRKeyEventMaskMake(aKeyEvent);
+        __auto_type record = [_actionRecords objectForKey:anAction];
+
+        if (!record || !(record->_keyEvents & keyEventMask))
             return;
 
-        BOOL isLastAction = [_actions countForObject:anAction] == 1;
+        BOOL isLastAction = record->_keyEvents == keyEventMask;
 
         if (isLastAction)
         {
-            [self willChangeValueForKey:@"actions"];
-            [anAction removeObserver:self forKeyPath:@"enabled" context:_SRShortcutMonitorContext];
+            [self _willChangeValueForKeyUnlessBatching:@"actions"];
+            [anAction _removeMonitor:self];
         }
 
-        BOOL isLastActionForShortcut = NO;
-        SRShortcut *shortcut = nil;
+        SRShortcut *shortcut = record->_enabledShortcut;
+        BOOL isLastActionForShortcut = shortcut && [_shortcuts countForObject:shortcut] == 1;
 
-        if ([_enabledActions containsObject:anAction])
+        if (shortcut)
         {
-            if (isLastAction)
-                [anAction removeObserver:self forKeyPath:@"shortcut" context:_SRShortcutMonitorContext];
-
-            shortcut = [self _shortcutForEnabledAction:anAction hint:nil];
-            isLastActionForShortcut = [_shortcuts countForObject:shortcut] == 1;
-
             if (isLastActionForShortcut)
             {
-                [self willChangeValueForKey:@"shortcuts"];
-                [self willRemoveShortcut:shortcut];
+                [self _willChangeValueForKeyUnlessBatching:@"shortcuts"];
+                [self _willRemoveShortcutUnlessBatching:shortcut];
             }
 
             [self _removeEnabledAction:anAction fromShortcut:shortcut forKeyEvent:aKeyEvent];
-
-            if (isLastAction)
-                [_enabledActions removeObject:anAction];
         }
 
+        record->_keyEvents &= ~keyEventMask;
         [keyEventActions removeObject:anAction];
         [_actions removeObject:anAction];
 
+        if (isLastAction)
+            [_actionRecords removeObjectForKey:anAction];
+
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartActions;
+        [self _publishSnapshotIfNeeded];
+
         if (isLastActionForShortcut)
         {
-            [self didRemoveShortcut:shortcut];
-            [self didChangeValueForKey:@"shortcuts"];
+            [self _didRemoveShortcutUnlessBatching:shortcut];
+            [self _didChangeValueForKeyUnlessBatching:@"shortcuts"];
         }
 
         if (isLastAction)
-            [self didChangeValueForKey:@"actions"];
+            [self _didChangeValueForKeyUnlessBatching:@"actions"];
     }
 }
 
@@ -612,35 +2516,208 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
     @synchronized (_actions)
     {
         for (SRShortcutAction *a in _actions)
-            [a removeObserver:self forKeyPath:@"enabled" context:_SRShortcutMonitorContext];
+            [a _removeMonitor:self];
 
-        for (SRShortcutAction *a in _enabledActions)
-            [a removeObserver:self forKeyPath:@"shortcut" context:_SRShortcutMonitorContext];
-
-        [self willChangeValueForKey:@"actions"];
-        [self willChangeValueForKey:@"shortcuts"];
+        [self _willChangeValueForKeyUnlessBatching:@"actions"];
+        [self _willChangeValueForKeyUnlessBatching:@"shortcuts"];
 
         __auto_type oldShortcuts = _shortcuts.allObjects;
         for (SRShortcut *s in oldShortcuts)
-            [self willRemoveShortcut:s];
+            [self _willRemoveShortcutUnlessBatching:s];
 
         _shortcuts = [NSCountedSet new];
         [_actions removeAllObjects];
-        [_enabledActions removeAllObjects];
         [_keyUpActions removeAllObjects];
         [_keyDownActions removeAllObjects];
-        [_shortcutToEnabledKeyDownActions removeAllObjects];
-        [_shortcutToEnabledKeyUpActions removeAllObjects];
+        [_enabledActionsTable removeAllActions];
+        [_actionRecords removeAllObjects];
+        [_sequenceActions removeAllObjects];
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartAll;
+        [self _publishSnapshotIfNeeded];
 
         [oldShortcuts enumerateObjectsWithOptions:NSEnumerationReverse
                                        usingBlock:^(SRShortcut * _Nonnull obj, NSUInteger idx, BOOL * _Nonnull stop)
         {
-            [self didRemoveShortcut:obj];
+            [self _didRemoveShortcutUnlessBatching:obj];
         }];
 
-        [self didChangeValueForKey:@"shortcuts"];
-        [self didChangeValueForKey:@"actions"];
-    }
+        [self _didChangeValueForKeyUnlessBatching:@"shortcuts"];
+        [self _didChangeValueForKeyUnlessBatching:@"actions"];
+    }
+}
+
+- (NSTimeInterval)shortcutSequenceTimeout
+{
+    @synchronized (_actions)
+    {
+        return _shortcutSequenceTimeout;
+    }
+}
+
+- (void)setShortcutSequenceTimeout:(NSTimeInterval)newTimeout
+{
+    if (newTimeout <= 0.0)
+        [NSException raise:NSInvalidArgumentException format:@"Timeout %f must be positive", newTimeout];
+
+    @synchronized (_actions)
+    {
+        _shortcutSequenceTimeout = newTimeout;
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartShortcutSequences;
+        [self _publishSnapshotIfNeeded];
+    }
+}
+
+- (NSArray<NSArray<SRShortcut *> *> *)shortcutSequences
+{
+    __auto_type sequences = self.snapshot.sequenceMatcher.sequences;
+    return sequences ? sequences : @[];
+}
+
+- (void)addAction:(SRShortcutAction *)anAction forShortcutSequence:(NSArray<SRShortcut *> *)aSequence
+{
+    if (aSequence.count < 2)
+        [NSException raise:NSInvalidArgumentException format:@"Shortcut sequence must have at least 2 shortcuts"];
+
+    @synchronized (_actions)
+    {
+        __auto_type sequence = [aSequence copy];
+        __auto_type actions = _sequenceActions[sequence];
+
+        if (!actions)
+        {
+            actions = [NSMutableArray new];
+            _sequenceActions[sequence] = actions;
+        }
+        else
+            [actions removeObject:anAction];
+
+        [actions addObject:anAction];
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartShortcutSequences;
+        [self _publishSnapshotIfNeeded];
+    }
+}
+
+- (void)removeAction:(SRShortcutAction *)anAction forShortcutSequence:(NSArray<SRShortcut *> *)aSequence
+{
+    @synchronized (_actions)
+    {
+        __auto_type actions = _sequenceActions[aSequence];
+
+        if (![actions containsObject:anAction])
+            return;
+
+        [actions removeObject:anAction];
+
+        if (!actions.count)
+            [_sequenceActions removeObjectForKey:aSequence];
+
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartShortcutSequences;
+        [self _publishSnapshotIfNeeded];
+    }
+}
+
+- (void)performBatchUpdates:(void (NS_NOESCAPE ^)(void))anUpdates
+{
+    @synchronized (_actions)
+    {
+        if (_batchUpdatesDepth++ == 0)
+        {
+            [self willChangeValueForKey:@"actions"];
+            [self willChangeValueForKey:@"shortcuts"];
+            _batchUpdatesShortcuts = [NSSet setWithArray:_shortcuts.allObjects];
+        }
+
+        @try
+        {
+            anUpdates();
+        }
+        @finally
+        {
+            if (--_batchUpdatesDepth == 0)
+            {
+                __auto_type oldShortcuts = _batchUpdatesShortcuts;
+                _batchUpdatesShortcuts = nil;
+
+                NSMutableSet<SRShortcut *> *removedShortcuts = [oldShortcuts mutableCopy];
+                [removedShortcuts minusSet:_shortcuts];
+
+                NSMutableSet<SRShortcut *> *addedShortcuts = [NSMutableSet setWithArray:_shortcuts.allObjects];
+                [addedShortcuts minusSet:oldShortcuts];
+
+                // Subclasses may release resources of the removed shortcuts for the added ones.
+                for (SRShortcut *s in removedShortcuts)
+                    [self willRemoveShortcut:s];
+
+                for (SRShortcut *s in addedShortcuts)
+                    [self willAddShortcut:s];
+
+                [self _publishSnapshotIfNeeded];
+
+                for (SRShortcut *s in removedShortcuts)
+                    [self didRemoveShortcut:s];
+
+                for (SRShortcut *s in addedShortcuts)
+                    [self didAddShortcut:s];
+
+                [self didChangeValueForKey:@"shortcuts"];
+                [self didChangeValueForKey:@"actions"];
+            }
+        }
+    }
+}
+
+- (BOOL)startTraceRecordingToURL:(NSURL *)aURL error:(NSError * _Nullable *)outError
+{
+    __auto_type recorder = [[_SRShortcutMonitorTraceRecorder alloc] initWithURL:aURL error:outError];
+
+    if (!recorder)
+        return NO;
+
+    @synchronized (_actions)
+    {
+        [self.traceRecorder close];
+        self.traceRecorder = recorder;
+    }
+
+    return YES;
+}
+
+- (void)stopTraceRecording
+{
+    @synchronized (_actions)
+    {
+        [self.traceRecorder close];
+        self.traceRecorder = nil;
+    }
+}
+
+- (BOOL)replayTraceAtURL:(NSURL *)aURL mismatchCount:(NSUInteger *)outMismatchCount error:(NSError * _Nullable *)outError
+{
+    __auto_type data = [NSData dataWithContentsOfURL:aURL options:NSDataReadingMappedIfSafe error:outError];
+
+    if (!data)
+        return NO;
+
+    // The replay clock starts now so that the replayed events follow the live ones.
+    size_t mismatchCount = 0;
+
+    if (!SRCoreTraceReplay(data.bytes,
+                           data.length,
+                           _SRMachTimeToNanoseconds(mach_absolute_time()),
+                           _SRShortcutMonitorReplayEvent,
+                           (__bridge void *)self,
+                           &mismatchCount))
+    {
+        if (outError)
+            *outError = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{NSURLErrorKey: aURL}];
+
+        return NO;
+    }
+
+    if (outMismatchCount)
+        *outMismatchCount = mismatchCount;
+
+    return YES;
 }
 
 - (void)willAddShortcut:(SRShortcut *)aShortcut
@@ -675,62 +2752,219 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
     }
 }
 
-- (NSMutableDictionary<SRShortcut *, NSMutableOrderedSet<SRShortcutAction *> *> *)_shortcutToEnabledActionsForKeyEvent:(SRKeyEventType)aKeyEvent
+- (BOOL)_performEnabledActionsForKey:(_SRShortcutKey)aKey time:(uint64_t)aTime onTarget:(nullable id)aTarget
 {
-    switch (aKeyEvent)
+    _SRMetricsIncrement(&_metrics->_seenEventCount);
+
+    // The snapshot keeps its actions alive for as long as it's retained.
+    uint64_t lookupStart = _SRMetricsTimestamp();
+    __auto_type snapshot = self.snapshot;
+    __auto_type actionRing = self.actionRing;
+    NSUInteger count = 0;
+    _Atomic(uint64_t) *fireCount = NULL;
+    __auto_type actions = [snapshot.enabledActionsTable actionsForKey:_SRShortcutKeyGetLookupKey(aKey)
+                                                                count:&count
+                                                            fireCount:&fireCount];
+    _SRMetricsRecordDuration(_metrics, _metrics->_lookupLatencyHistogram, lookupStart);
+
+    if (!count)
     {
-        case SRKeyEventTypeDown:
-            return _shortcutToEnabledKeyDownActions;
-        case SRKeyEventTypeUp:
-            return _shortcutToEnabledKeyUpActions;
-        default:
-            [NSException raise:NSInvalidArgumentException format:@"Unexpected keyboard event type %lu", aKeyEvent];
-            return nil;
+        os_trace_debug("No actions for the shortcut");
+        return NO;
     }
+
+    _SRMetricsIncrement(&_metrics->_matchedEventCount);
+    _SRMetricsIncrement(fireCount);
+
+    BOOL isHandled = NO;
+
+    if (!actionRing)
+    {
+        uint64_t actionStart = _SRMetricsTimestamp();
+        isHandled = _SRPerformActions(actions, count, aTarget, _SRShortcutKeyIsRepeat(aKey), aTime);
+        _SRMetricsRecordDuration(_metrics, _metrics->_actionLatencyHistogram, actionStart);
+    }
+    else
+        isHandled = [self _enqueueKey:aKey time:aTime snapshot:snapshot actions:nil onTarget:aTarget inRing:actionRing];
+
+    if (isHandled)
+        _SRMetricsIncrement(&_metrics->_consumedEventCount);
+
+    return isHandled;
 }
 
-- (nullable NSMutableOrderedSet<SRShortcutAction *> *)_enabledActionsForShortcut:(nonnull SRShortcut *)aShortcut
-                                                                        keyEvent:(SRKeyEventType)aKeyEvent
+- (BOOL)_performActions:(NSArray<SRShortcutAction *> *)anActions
+                 forKey:(_SRShortcutKey)aKey
+                   time:(uint64_t)aTime
+               onTarget:(nullable id)aTarget
 {
-    return [[self _shortcutToEnabledActionsForKeyEvent:aKeyEvent] objectForKey:aShortcut];
+    _SRMetricsIncrement(&_metrics->_matchedEventCount);
+
+    __auto_type actionRing = self.actionRing;
+
+    if (!actionRing)
+    {
+        uint64_t actionStart = _SRMetricsTimestamp();
+        BOOL isHandled = _SRPerformActionsInArray(anActions, aTarget, _SRShortcutKeyIsRepeat(aKey), aTime);
+        _SRMetricsRecordDuration(_metrics, _metrics->_actionLatencyHistogram, actionStart);
+        return isHandled;
+    }
+    else
+        return [self _enqueueKey:aKey time:aTime snapshot:nil actions:anActions onTarget:aTarget inRing:actionRing];
 }
 
-- (nonnull SRShortcut *)_shortcutForEnabledAction:(nonnull SRShortcutAction *)anAction hint:(nullable SRShortcut *)aShortcut
+- (BOOL)_enqueueKey:(_SRShortcutKey)aKey
+               time:(uint64_t)aTime
+           snapshot:(nullable _SRShortcutMonitorSnapshot *)aSnapshot
+            actions:(nullable NSArray<SRShortcutAction *> *)anActions
+           onTarget:(nullable id)aTarget
+             inRing:(_SRShortcutActionRing *)aRing
 {
-    NSParameterAssert([_enabledActions containsObject:anAction]);
+    if ([aRing enqueueKey:aKey time:aTime snapshot:aSnapshot actions:anActions target:aTarget])
+        return YES;
 
-    __auto_type checkShortcut = ^(SRShortcut * _Nullable aShortcut) {
-        if (!aShortcut)
-            return NO;
+    os_trace_error("#Error Action queue is full");
+    return _actionQueueOverflowPolicy == SRShortcutMonitorOverflowPolicyDiscard;
+}
 
-        if (self->_shortcutToEnabledKeyDownActions[aShortcut] != nil &&
-            [self->_shortcutToEnabledKeyDownActions[aShortcut] containsObject:anAction])
-        {
-            return YES;
-        }
-        else if (self->_shortcutToEnabledKeyUpActions[aShortcut] != nil &&
-                 [self->_shortcutToEnabledKeyUpActions[aShortcut] containsObject:anAction])
-        {
-            return YES;
-        }
+- (BOOL)_performActionsForKey:(_SRShortcutKey)aKey time:(uint64_t)aTime onTarget:(nullable id)aTarget
+{
+    if (self.traceRecorder)
+    {
+        uint64_t start = mach_absolute_time();
+        BOOL isHandled = [self _performSequenceOrEnabledActionsForKey:aKey time:aTime onTarget:aTarget];
+        [self _traceKey:aKey isHandled:isHandled since:start];
+        return isHandled;
+    }
+    else
+        return [self _performSequenceOrEnabledActionsForKey:aKey time:aTime onTarget:aTarget];
+}
 
-        return NO;
-    };
+- (void)_traceKey:(_SRShortcutKey)aKey isHandled:(BOOL)anIsHandled since:(uint64_t)aStart
+{
+    [self.traceRecorder recordKey:aKey isHandled:anIsHandled start:aStart end:mach_absolute_time()];
+}
 
-    if (checkShortcut(aShortcut))
-        return aShortcut;
-    else if (checkShortcut(anAction.shortcut))
-        return anAction.shortcut;
-    else
+- (BOOL)_performSequenceOrEnabledActionsForKey:(_SRShortcutKey)aKey time:(uint64_t)aTime onTarget:(nullable id)aTarget
+{
+    // Only key downs with a key code advance sequences: key ups and modifier changes between the keystrokes do not.
+    __auto_type sequenceMatcher = self.snapshot.sequenceMatcher;
+
+    if (sequenceMatcher && _SRShortcutKeyGetKeyEvent(aKey) == SRKeyEventTypeDown && _SRShortcutKeyGetKeyCode(aKey) != SRKeyCodeNone)
     {
-        for (SRShortcut *s in _shortcuts)
+        NSArray<SRShortcutAction *> *actions = nil;
+
+        switch ([sequenceMatcher stepWithKey:aKey time:aTime actions:&actions])
         {
-            if (checkShortcut(s))
-                return s;
+            case SRCoreSequenceStepPrefix:
+            {
+                os_trace_debug("Waiting for the next keystroke of the sequence");
+                _SRMetricsIncrement(&_metrics->_seenEventCount);
+                _SRMetricsIncrement(&_metrics->_consumedEventCount);
+                return YES;
+            }
+            case SRCoreSequenceStepComplete:
+            {
+                _SRMetricsIncrement(&_metrics->_seenEventCount);
+                BOOL isHandled = [self _performActions:actions forKey:aKey time:aTime onTarget:aTarget];
+
+                if (isHandled)
+                    _SRMetricsIncrement(&_metrics->_consumedEventCount);
+
+                return isHandled;
+            }
+            case SRCoreSequenceStepNone:
+                break;
         }
     }
 
-    __builtin_unreachable();
+    return [self _performEnabledActionsForKey:aKey time:aTime onTarget:aTarget];
+}
+
+- (void)_publishSnapshotIfNeeded
+{
+    // Batches are published at once when the outermost one completes.
+    if (!_invalidSnapshotParts || _batchUpdatesDepth)
+        return;
+
+    __auto_type oldSnapshot = self.snapshot;
+    __auto_type actions = oldSnapshot.actions;
+    __auto_type keyDownActions = oldSnapshot.keyDownActions;
+    __auto_type keyUpActions = oldSnapshot.keyUpActions;
+    __auto_type shortcuts = oldSnapshot.shortcuts;
+    __auto_type enabledActionsTable = oldSnapshot.enabledActionsTable;
+    __auto_type sequenceMatcher = oldSnapshot.sequenceMatcher;
+    BOOL didChangeShortcutSequences = (_invalidSnapshotParts & _SRShortcutMonitorSnapshotPartShortcutSequences) != 0;
+
+    if (_invalidSnapshotParts & _SRShortcutMonitorSnapshotPartActions)
+    {
+        actions = _actions.allObjects;
+        keyDownActions = _keyDownActions.allObjects;
+        keyUpActions = _keyUpActions.allObjects;
+    }
+
+    if (_invalidSnapshotParts & _SRShortcutMonitorSnapshotPartShortcuts)
+        shortcuts = _shortcuts.allObjects;
+
+    if (_invalidSnapshotParts & _SRShortcutMonitorSnapshotPartEnabledActions)
+        enabledActionsTable = [_enabledActionsTable copy];
+
+    if (didChangeShortcutSequences)
+    {
+        sequenceMatcher = _sequenceActions.count ? [[_SRShortcutSequenceMatcher alloc] initWithSequences:_sequenceActions
+                                                                                                 timeout:_shortcutSequenceTimeout] : nil;
+    }
+
+    self.snapshot = [[_SRShortcutMonitorSnapshot alloc] initWithActions:actions
+                                                         keyDownActions:keyDownActions
+                                                           keyUpActions:keyUpActions
+                                                              shortcuts:shortcuts
+                                                    enabledActionsTable:enabledActionsTable
+                                                        sequenceMatcher:sequenceMatcher];
+    _invalidSnapshotParts = 0;
+
+    if (didChangeShortcutSequences)
+        [self _didChangeShortcutSequences];
+}
+
+- (void)_didChangeShortcutSequences
+{
+}
+
+- (void)_willChangeValueForKeyUnlessBatching:(NSString *)aKey
+{
+    if (!_batchUpdatesDepth)
+        [self willChangeValueForKey:aKey];
+}
+
+- (void)_didChangeValueForKeyUnlessBatching:(NSString *)aKey
+{
+    if (!_batchUpdatesDepth)
+        [self didChangeValueForKey:aKey];
+}
+
+- (void)_willAddShortcutUnlessBatching:(SRShortcut *)aShortcut
+{
+    if (!_batchUpdatesDepth)
+        [self willAddShortcut:aShortcut];
+}
+
+- (void)_didAddShortcutUnlessBatching:(SRShortcut *)aShortcut
+{
+    if (!_batchUpdatesDepth)
+        [self didAddShortcut:aShortcut];
+}
+
+- (void)_willRemoveShortcutUnlessBatching:(SRShortcut *)aShortcut
+{
+    if (!_batchUpdatesDepth)
+        [self willRemoveShortcut:aShortcut];
+}
+
+- (void)_didRemoveShortcutUnlessBatching:(SRShortcut *)aShortcut
+{
+    if (!_batchUpdatesDepth)
+        [self didRemoveShortcut:aShortcut];
 }
 
 - (void)_enabledActionDidChangeShortcut:(nonnull SRShortcutAction *)anAction
@@ -739,16 +2973,20 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
 {
     NSParameterAssert(![anOldShortcut isEqual:aNewShortcut]);
 
-    BOOL isKeyDownAction = [_keyDownActions containsObject:anAction];
-    BOOL isKeyUpAction = [_keyUpActions containsObject:anAction];
+    __auto_type record = [_actionRecords objectForKey:anAction];
+    NSParameterAssert(record && record->_isEnabled);
+    NSParameterAssert(record->_enabledShortcut == anOldShortcut || [record->_enabledShortcut isEqual:anOldShortcut]);
+
+    BOOL isKeyDownAction = (record->_keyEvents & _SRKeyEventMaskDown) != 0;
+    BOOL isKeyUpAction = (record->_keyEvents & _SRKeyEventMaskUp) != 0;
     BOOL isLastActionForOldShortcut = anOldShortcut && [_shortcuts countForObject:anOldShortcut] == 1;
     BOOL isFirstActionForNewShortcut = aNewShortcut && [_shortcuts countForObject:aNewShortcut] == 0;
 
     if (isLastActionForOldShortcut || isFirstActionForNewShortcut)
-        [self willChangeValueForKey:@"shortcuts"];
+        [self _willChangeValueForKeyUnlessBatching:@"shortcuts"];
 
     if (isLastActionForOldShortcut)
-        [self willRemoveShortcut:anOldShortcut];
+        [self _willRemoveShortcutUnlessBatching:anOldShortcut];
 
     if (anOldShortcut)
     {
@@ -757,13 +2995,17 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
 
         if (isKeyUpAction)
             [self _removeEnabledAction:anAction fromShortcut:anOldShortcut forKeyEvent:SRKeyEventTypeUp];
+
+        record->_enabledShortcut = nil;
     }
 
+    [self _publishSnapshotIfNeeded];
+
     if (isLastActionForOldShortcut)
-        [self didRemoveShortcut:anOldShortcut];
+        [self _didRemoveShortcutUnlessBatching:anOldShortcut];
 
     if (isFirstActionForNewShortcut)
-        [self willAddShortcut:aNewShortcut];
+        [self _willAddShortcutUnlessBatching:aNewShortcut];
 
     if (aNewShortcut)
     {
@@ -772,194 +3014,472 @@ static void *_SRShortcutMonitorContext = &_SRShortcutMonitorContext;
 
         if (isKeyUpAction)
             [self _addEnabledAction:anAction toShortcut:aNewShortcut forKeyEvent:SRKeyEventTypeUp];
+
+        record->_enabledShortcut = aNewShortcut;
     }
 
+    [self _publishSnapshotIfNeeded];
+
     if (isFirstActionForNewShortcut)
-        [self didAddShortcut:aNewShortcut];
+        [self _didAddShortcutUnlessBatching:aNewShortcut];
 
     if (isLastActionForOldShortcut || isFirstActionForNewShortcut)
-        [self didChangeValueForKey:@"shortcuts"];
+        [self _didChangeValueForKeyUnlessBatching:@"shortcuts"];
+}
+
+- (void)_actionDidChangeEnabled:(SRShortcutAction *)anAction
+{
+    @synchronized (_actions)
+    {
+        __auto_type record = [_actionRecords objectForKey:anAction];
+        BOOL isEnabled = anAction.isEnabled;
+
+        if (!record || record->_isEnabled == isEnabled)
+            return;
+
+        if (isEnabled)
+        {
+            __auto_type shortcut = anAction.monitoredShortcut;
+            record->_isEnabled = YES;
+
+            if (shortcut)
+                [self _enabledActionDidChangeShortcut:anAction from:nil to:shortcut];
+        }
+        else
+        {
+            if (record->_enabledShortcut)
+                [self _enabledActionDidChangeShortcut:anAction from:record->_enabledShortcut to:nil];
+
+            record->_isEnabled = NO;
+        }
+    }
+}
+
+- (void)_actionDidChangeShortcut:(SRShortcutAction *)anAction
+{
+    @synchronized (_actions)
+    {
+        __auto_type record = [_actionRecords objectForKey:anAction];
+        __auto_type newShortcut = anAction.monitoredShortcut;
+
+        if (!record || !record->_isEnabled || record->_enabledShortcut == newShortcut || [record->_enabledShortcut isEqual:newShortcut])
+            return;
+
+        [self _enabledActionDidChangeShortcut:anAction from:record->_enabledShortcut to:newShortcut];
+    }
+}
+
+- (void)_actionDidChangePriority:(SRShortcutAction *)anAction
+{
+    @synchronized (_actions)
+    {
+        __auto_type record = [_actionRecords objectForKey:anAction];
+        __auto_type priority = anAction.priority;
+
+        if (!record || record->_priority == priority)
+            return;
+
+        __auto_type shortcut = record->_enabledShortcut;
+        __auto_type oldKeyDownRank = _SRShortcutMonitorActionRecordGetRank(record, SRKeyEventTypeDown);
+        __auto_type oldKeyUpRank = _SRShortcutMonitorActionRecordGetRank(record, SRKeyEventTypeUp);
+        record->_priority = priority;
+
+        if (!shortcut)
+            return;
+
+        if (record->_keyEvents & _SRKeyEventMaskDown)
+        {
+            [_enabledActionsTable moveAction:anAction
+                                      forKey:_SRShortcutKeyMakeWithShortcut(shortcut, SRKeyEventTypeDown)
+                                    fromRank:oldKeyDownRank
+                                      toRank:_SRShortcutMonitorActionRecordGetRank(record, SRKeyEventTypeDown)];
+        }
+
+        if (record->_keyEvents & _SRKeyEventMaskUp)
+        {
+            [_enabledActionsTable moveAction:anAction
+                                      forKey:_SRShortcutKeyMakeWithShortcut(shortcut, SRKeyEventTypeUp)
+                                    fromRank:oldKeyUpRank
+                                      toRank:_SRShortcutMonitorActionRecordGetRank(record, SRKeyEventTypeUp)];
+        }
+
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartEnabledActions;
+        [self _publishSnapshotIfNeeded];
+    }
 }
 
 - (void)_addEnabledAction:(nonnull SRShortcutAction *)anAction
                toShortcut:(nonnull SRShortcut *)aShortcut
               forKeyEvent:(SRKeyEventType)aKeyEvent
 {
-    __auto_type shortcutToActions = [self _shortcutToEnabledActionsForKeyEvent:aKeyEvent];
-    __auto_type actions = shortcutToActions[aShortcut];
-    NSParameterAssert(![actions containsObject:anAction]);
+    if (![_shortcuts countForObject:aShortcut])
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartShortcuts;
 
+    // A newly enabled action is the most recent one of its priority.
+    __auto_type key = _SRShortcutKeyMakeWithShortcut(aShortcut, aKeyEvent);
+    __auto_type record = [_actionRecords objectForKey:anAction];
+    [self _setSequence:++_lastActionSequence ofRecord:record forKeyEvent:aKeyEvent];
     [_shortcuts addObject:aShortcut];
-
-    if (!actions)
-    {
-        actions = [NSMutableOrderedSet orderedSetWithObject:anAction];
-        shortcutToActions[aShortcut] = actions;
-    }
-    else
-        [actions addObject:anAction];
+    [_enabledActionsTable addAction:anAction forKey:key rank:_SRShortcutMonitorActionRecordGetRank(record, aKeyEvent)];
+#if SR_SHORTCUT_MONITOR_METRICS
+    [_enabledActionsTable setFireCount:[_metrics fireCountForKey:key] forKey:key];
+#endif
+    _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartEnabledActions;
 }
 
 - (void)_removeEnabledAction:(nonnull SRShortcutAction *)anAction
                 fromShortcut:(SRShortcut *)aShortcut
                  forKeyEvent:(SRKeyEventType)aKeyEvent
 {
-    __auto_type shortcutToActions = [self _shortcutToEnabledActionsForKeyEvent:aKeyEvent];
-    __auto_type actions = shortcutToActions[aShortcut];
-    NSParameterAssert([actions containsObject:anAction]);
+    if ([_shortcuts countForObject:aShortcut] == 1)
+        _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartShortcuts;
 
     [_shortcuts removeObject:aShortcut];
-    [actions removeObject:anAction];
+    [_enabledActionsTable removeAction:anAction
+                                forKey:_SRShortcutKeyMakeWithShortcut(aShortcut, aKeyEvent)
+                                  rank:_SRShortcutMonitorActionRecordGetRank([_actionRecords objectForKey:anAction], aKeyEvent)];
+    _invalidSnapshotParts |= _SRShortcutMonitorSnapshotPartEnabledActions;
+}
 
-    if (!actions.count)
-        shortcutToActions[aShortcut] = nil;
+- (void)_setSequence:(uint64_t)aSequence ofRecord:(_SRShortcutMonitorActionRecord *)aRecord forKeyEvent:(SRKeyEventType)aKeyEvent
+{
+    if (aKeyEvent == SRKeyEventTypeDown)
+        aRecord->_keyDownSequence = aSequence;
+    else
+        aRecord->_keyUpSequence = aSequence;
 }
 
 #pragma mark NSObject
 
-- (void)observeValueForKeyPath:(NSString *)aKeyPath
-                      ofObject:(NSObject *)anObject
-                        change:(NSDictionary<NSKeyValueChangeKey, id> *)aChange
-                       context:(void *)aContext
+- (NSString *)debugDescription
 {
-    if (aContext == _SRShortcutMonitorContext)
+    NSMutableString *d = [NSMutableString new];
+    __auto_type snapshot = self.snapshot;
+    __auto_type formatActions = ^(SRKeyEventType aKeyEvent) {
+        [snapshot.enabledActionsTable enumerateKeysAndActionsUsingBlock:^(_SRShortcutKey aKey, SRShortcutAction * __unsafe_unretained const *anActions, NSUInteger aCount) {
+            if (_SRShortcutKeyGetKeyEvent(aKey) != aKeyEvent)
+                return;
+
+            [d appendFormat:@"\t%@: {\n", [SRShortcut shortcutWithCode:_SRShortcutKeyGetKeyCode(aKey)
+                                                        modifierFlags:_SRShortcutKeyGetModifierFlags(aKey)
+                                                           characters:nil
+                                          charactersIgnoringModifiers:nil]];
+
+            for (NSUInteger i = 0; i < aCount; ++i)
+                [d appendFormat:@"\t\t%@\n", anActions[i]];
+
+            [d appendString:@"\t}\n"];
+        }];
+    };
+
+    if (snapshot.keyDownActions.count)
     {
-        __auto_type action = (SRShortcutAction *)anObject;
+        [d appendString:@"Key Down Shortcuts: {\n"];
+        formatActions(SRKeyEventTypeDown);
+        [d appendString:@"}\n"];
+    }
 
-        if ([aKeyPath isEqualToString:@"enabled"])
-        {
-            BOOL wasEnabled = [aChange[NSKeyValueChangeOldKey] boolValue]; // NO for NSKeyValueObservingOptionInitial
-            BOOL isEnabled = [aChange[NSKeyValueChangeNewKey] boolValue];
+    if (snapshot.keyUpActions.count)
+    {
+        [d appendString:@"Key Up Shortcuts: {\n"];
+        formatActions(SRKeyEventTypeUp);
+        [d appendString:@"}\n"];
+    }
 
-            if (wasEnabled == isEnabled)
-                return;
+    if (d.length)
+        return d;
+    else
+        return @"No Shortcuts";
+}
+
+@end
+
+
+@implementation SRShortcutMonitor (SRShortcutMonitorConveniences)
+
+- (SRShortcutAction *)addAction:(SEL)anAction forKeyEquivalent:(NSString *)aKeyEquivalent tag:(NSInteger)aTag
+{
+    SRShortcut *shortcut = [SRShortcut shortcutWithKeyEquivalent:aKeyEquivalent];
+
+    if (!shortcut)
+        return nil;
+
+    SRShortcutAction *action = [SRShortcutAction shortcutActionWithShortcut:shortcut target:nil action:anAction tag:aTag];
+    [self addAction:action forKeyEvent:SRKeyEventTypeDown];
+    return action;
+}
+
+@end
+
+
+const OSType SRShortcutActionSignature = 'SRSR';
+
+static const UInt32 _SRInvalidHotKeyID = 0;
+
+static const NSUInteger _SRHotKeyTableMinimumCapacity = 16;
+
+/*!
+ Minimum time before a freed hot key ID is reused.
+ */
+static const NSTimeInterval _SRHotKeyIDReuseDelay = 1.0;
+
+
+typedef struct
+{
+    _Atomic(_SRShortcutKey) key; // key up variant of the shortcut or SRCoreShortcutKeyInvalid if the slot is free
+    _Atomic(uintptr_t) monitor; // identity of the owning monitor, never dereferenced; 0 if the slot is free
+    EventHotKeyRef hotKey;
+    UInt32 nextFreeHotKeyID; // _SRInvalidHotKeyID terminates the free list
+    uint64_t freeTime; // mach_absolute_time() when the slot was freed
+} _SRHotKeySlot;
+
+
+/*!
+ Dense table of hot key slots indexed by hot key ID - 1.
+
+ @discussion
+ Slots are modified under the lock of _SRHotKeyRegistry. Event handlers only read the keys and the owners.
+ When the table is full it is replaced with a larger copy: readers keep using the copy they retained.
+ */
+@interface _SRHotKeyTable : NSObject
+{
+    @public
+    NSUInteger _capacity;
+    _SRHotKeySlot *_slots;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)aCapacity table:(nullable _SRHotKeyTable *)aTable NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ @return SRCoreShortcutKeyInvalid if the hot key ID is not registered by the monitor.
+ */
+- (_SRShortcutKey)keyForHotKeyID:(UInt32)aHotKeyID monitor:(SRGlobalShortcutMonitor *)aMonitor;
+
+@end
+
+
+@implementation _SRHotKeyTable
+
+- (instancetype)initWithCapacity:(NSUInteger)aCapacity table:(_SRHotKeyTable *)aTable
+{
+    NSParameterAssert(!aTable || aTable->_capacity <= aCapacity);
+
+    self = [super init];
+
+    if (self)
+    {
+        _capacity = aCapacity;
+        _slots = aCapacity ? (_SRHotKeySlot *)calloc(aCapacity, sizeof(_SRHotKeySlot)) : NULL;
 
-            if (isEnabled)
+        for (NSUInteger i = 0; i < aCapacity; ++i)
+        {
+            if (aTable && i < aTable->_capacity)
             {
-                [_enabledActions addObject:action];
-                [action addObserver:self
-                         forKeyPath:@"shortcut"
-                            options:NSKeyValueObservingOptionNew | NSKeyValueObservingOptionOld | NSKeyValueObservingOptionInitial
-                            context:_SRShortcutMonitorContext];
+                __auto_type slot = &aTable->_slots[i];
+                atomic_init(&_slots[i].key, atomic_load_explicit(&slot->key, memory_order_relaxed));
+                atomic_init(&_slots[i].monitor, atomic_load_explicit(&slot->monitor, memory_order_relaxed));
+                _slots[i].hotKey = slot->hotKey;
+                _slots[i].nextFreeHotKeyID = slot->nextFreeHotKeyID;
+                _slots[i].freeTime = slot->freeTime;
             }
             else
             {
-                [action removeObserver:self forKeyPath:@"shortcut" context:_SRShortcutMonitorContext];
+                atomic_init(&_slots[i].key, SRCoreShortcutKeyInvalid);
+                atomic_init(&_slots[i].monitor, 0);
+            }
+        }
+    }
 
-                @synchronized (_actions)
-                {
-                    __auto_type shortcut = [self _shortcutForEnabledAction:action hint:nil];
-                    BOOL isLastActionForShortcut = [_shortcuts countForObject:shortcut] == 1;
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_slots);
+}
 
-                    if (isLastActionForShortcut)
-                    {
-                        [self willChangeValueForKey:@"shortcuts"];
-                        [self willRemoveShortcut:shortcut];
-                    }
+- (_SRShortcutKey)keyForHotKeyID:(UInt32)aHotKeyID monitor:(SRGlobalShortcutMonitor *)aMonitor
+{
+    NSUInteger index = (NSUInteger)aHotKeyID - 1;
 
-                    if ([_keyDownActions containsObject:action])
-                        [self _removeEnabledAction:action fromShortcut:shortcut forKeyEvent:SRKeyEventTypeDown];
+    if (aHotKeyID == _SRInvalidHotKeyID || index >= _capacity)
+        return SRCoreShortcutKeyInvalid;
 
-                    if ([_keyUpActions containsObject:action])
-                        [self _removeEnabledAction:action fromShortcut:shortcut forKeyEvent:SRKeyEventTypeUp];
+    __auto_type slot = &_slots[index];
+    _SRShortcutKey key = atomic_load_explicit(&slot->key, memory_order_acquire);
 
-                    if (isLastActionForShortcut)
-                    {
-                        [self didRemoveShortcut:shortcut];
-                        [self didChangeValueForKey:@"shortcuts"];
-                    }
+    if (atomic_load_explicit(&slot->monitor, memory_order_acquire) != (uintptr_t)aMonitor)
+        return SRCoreShortcutKeyInvalid;
 
-                    [_enabledActions removeObject:action];
-                }
-            }
-        }
-        else if ([aKeyPath isEqualToString:@"shortcut"])
-        {
-            SRShortcut *oldShortcut = aChange[NSKeyValueChangeOldKey]; // nil for NSKeyValueObservingOptionInitial
-            SRShortcut *newShortcut = aChange[NSKeyValueChangeNewKey];
+    return key;
+}
+
+@end
+
+
+/*!
+ Hot key IDs of every SRGlobalShortcutMonitor in the process.
+
+ @discussion
+ All monitors register hot keys with SRShortcutActionSignature and install their handlers on the same target:
+ each handler sees hot keys of the others. IDs are therefore unique across monitors and every slot
+ knows its owner so that a handler passes events of other monitors to the next handler.
+
+ Freed IDs are reused in FIFO order and not earlier than _SRHotKeyIDReuseDelay: an event of the previous
+ owner that is still in the queue must not reach the actions of the next one.
+ */
+@interface _SRHotKeyRegistry : NSObject
+
+@property (class, readonly) _SRHotKeyRegistry *shared;
+
+/*!
+ Replaced only when it grows so that event handlers can read it without locking.
+ */
+@property (atomic, readonly) _SRHotKeyTable *table;
+
+- (UInt32)makeHotKeyIDForMonitor:(SRGlobalShortcutMonitor *)aMonitor;
+
+/*!
+ Free the ID along with its slot.
+ */
+- (void)recycleHotKeyID:(UInt32)aHotKeyID;
+
+- (nullable EventHotKeyRef)hotKeyForHotKeyID:(UInt32)aHotKeyID;
+
+- (void)setHotKey:(nullable EventHotKeyRef)aHotKey forHotKeyID:(UInt32)aHotKeyID;
+
+- (void)setKey:(_SRShortcutKey)aKey forHotKeyID:(UInt32)aHotKeyID;
+
+@end
+
+
+@interface _SRHotKeyRegistry ()
+@property (atomic, readwrite) _SRHotKeyTable *table;
+@end
+
+
+@implementation _SRHotKeyRegistry
+{
+    pthread_mutex_t _lock;
+    UInt32 _count; // slots ever used
+    UInt32 _freeHead; // oldest freed ID
+    UInt32 _freeTail; // newest freed ID
+}
+
++ (_SRHotKeyRegistry *)shared
+{
+    static _SRHotKeyRegistry *Shared = nil;
+    static dispatch_once_t OnceToken;
+    dispatch_once(&OnceToken, ^{
+        Shared = [_SRHotKeyRegistry new];
+    });
+    return Shared;
+}
 
-            if ([oldShortcut isEqual:newShortcut])
-                return;
+- (instancetype)init
+{
+    self = [super init];
 
-            @synchronized (_actions)
-            {
-                [self _enabledActionDidChangeShortcut:action
-                                                 from:((id)oldShortcut == NSNull.null) ? nil : oldShortcut
-                                                   to:((id)newShortcut == NSNull.null) ? nil : newShortcut];
-            }
-        }
+    if (self)
+    {
+        pthread_mutex_init(&_lock, NULL);
+        _table = [[_SRHotKeyTable alloc] initWithCapacity:0 table:nil];
+        _freeHead = _SRInvalidHotKeyID;
+        _freeTail = _SRInvalidHotKeyID;
     }
-    else
-        [super observeValueForKeyPath:aKeyPath ofObject:anObject change:aChange context:aContext];
+
+    return self;
 }
 
-- (NSString *)debugDescription
+- (void)dealloc
 {
-    NSMutableString *d = [NSMutableString new];
-    __auto_type formatActions = ^(NSMutableDictionary<SRShortcut *, NSMutableOrderedSet<SRShortcutAction *> *> *aShortcutToActions) {
-        for (SRShortcut *s in aShortcutToActions)
-        {
-            [d appendFormat:@"\t%@: {\n", s];
-
-            for (SRShortcutAction *a in aShortcutToActions[s])
-                [d appendFormat:@"\t\t%@\n", a];
+    pthread_mutex_destroy(&_lock);
+}
 
-            [d appendString:@"\t}\n"];
-        }
-    };
+- (UInt32)makeHotKeyIDForMonitor:(SRGlobalShortcutMonitor *)aMonitor
+{
+    pthread_mutex_lock(&_lock);
+    __auto_type table = self.table;
+    UInt32 hotKeyID = _freeHead;
 
-    if (_shortcutToEnabledKeyDownActions.count)
+    if (hotKeyID != _SRInvalidHotKeyID &&
+        _SRMachTimeToSeconds(mach_absolute_time() - table->_slots[hotKeyID - 1].freeTime) >= _SRHotKeyIDReuseDelay)
     {
-        [d appendString:@"Key Down Shortcuts: {\n"];
-        formatActions(_shortcutToEnabledKeyDownActions);
-        [d appendString:@"}\n"];
-    }
+        _freeHead = table->_slots[hotKeyID - 1].nextFreeHotKeyID;
 
-    if (_shortcutToEnabledKeyUpActions.count)
+        if (_freeHead == _SRInvalidHotKeyID)
+            _freeTail = _SRInvalidHotKeyID;
+    }
+    else
     {
-        [d appendString:@"Key Up Shortcuts: {\n"];
-        formatActions(_shortcutToEnabledKeyUpActions);
-        [d appendString:@"}\n"];
+        if (_count == table->_capacity)
+        {
+            NSUInteger capacity = MAX(table->_capacity * 2, _SRHotKeyTableMinimumCapacity);
+            table = [[_SRHotKeyTable alloc] initWithCapacity:capacity table:table];
+            self.table = table;
+        }
+
+        hotKeyID = ++_count;
     }
 
-    if (d.length)
-        return d;
-    else
-        return @"No Shortcuts";
+    atomic_store_explicit(&table->_slots[hotKeyID - 1].monitor, (uintptr_t)aMonitor, memory_order_release);
+    pthread_mutex_unlock(&_lock);
+    return hotKeyID;
 }
 
-@end
-
+- (void)recycleHotKeyID:(UInt32)aHotKeyID
+{
+    pthread_mutex_lock(&_lock);
+    __auto_type table = self.table;
+    __auto_type slot = &table->_slots[aHotKeyID - 1];
+    atomic_store_explicit(&slot->key, SRCoreShortcutKeyInvalid, memory_order_release);
+    atomic_store_explicit(&slot->monitor, 0, memory_order_release);
+    slot->hotKey = NULL;
+    slot->nextFreeHotKeyID = _SRInvalidHotKeyID;
+    slot->freeTime = mach_absolute_time();
+
+    if (_freeTail != _SRInvalidHotKeyID)
+        table->_slots[_freeTail - 1].nextFreeHotKeyID = aHotKeyID;
+    else
+        _freeHead = aHotKeyID;
 
-@implementation SRShortcutMonitor (SRShortcutMonitorConveniences)
+    _freeTail = aHotKeyID;
+    pthread_mutex_unlock(&_lock);
+}
 
-- (SRShortcutAction *)addAction:(SEL)anAction forKeyEquivalent:(NSString *)aKeyEquivalent tag:(NSInteger)aTag
+- (EventHotKeyRef)hotKeyForHotKeyID:(UInt32)aHotKeyID
 {
-    SRShortcut *shortcut = [SRShortcut shortcutWithKeyEquivalent:aKeyEquivalent];
+    pthread_mutex_lock(&_lock);
+    EventHotKeyRef hotKey = self.table->_slots[aHotKeyID - 1].hotKey;
+    pthread_mutex_unlock(&_lock);
+    return hotKey;
+}
 
-    if (!shortcut)
-        return nil;
+- (void)setHotKey:(EventHotKeyRef)aHotKey forHotKeyID:(UInt32)aHotKeyID
+{
+    pthread_mutex_lock(&_lock);
+    self.table->_slots[aHotKeyID - 1].hotKey = aHotKey;
+    pthread_mutex_unlock(&_lock);
+}
 
-    SRShortcutAction *action = [SRShortcutAction shortcutActionWithShortcut:shortcut target:nil action:anAction tag:aTag];
-    [self addAction:action forKeyEvent:SRKeyEventTypeDown];
-    return action;
+- (void)setKey:(_SRShortcutKey)aKey forHotKeyID:(UInt32)aHotKeyID
+{
+    pthread_mutex_lock(&_lock);
+    atomic_store_explicit(&self.table->_slots[aHotKeyID - 1].key, aKey, memory_order_release);
+    pthread_mutex_unlock(&_lock);
 }
 
 @end
 
 
-const OSType SRShortcutActionSignature = 'SRSR';
-
-static const UInt32 _SRInvalidHotKeyID = 0;
-
-
 @implementation SRGlobalShortcutMonitor
 {
-    NSMutableDictionary<NSNumber *, SRShortcut *> *_hotKeyIdToShortcut;
-    NSMapTable<SRShortcut *, id> *_shortcutToHotKeyRef;
     NSMutableDictionary<SRShortcut *, NSNumber *> *_shortcutToHotKeyId;
     EventHandlerRef _carbonEventHandler;
     NSInteger _disableCounter;
+    BOOL _areHotKeysUnregistered; // paused with SRGlobalShortcutMonitorPauseBehaviorUnregister
 }
 
 static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anEvent, void *aUserData)
@@ -994,9 +3514,6 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
 
     if (self)
     {
-        _hotKeyIdToShortcut = [NSMutableDictionary new];
-        _shortcutToHotKeyRef = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality
-                                                     valueOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality];
         _shortcutToHotKeyId = [NSMutableDictionary new];
     }
 
@@ -1020,8 +3537,14 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
         os_trace_debug("Global Shortcut Monitor counter: %ld -> %ld", _disableCounter, _disableCounter - 1);
         _disableCounter -= 1;
 
-        if (_disableCounter == 0)
+        if (_disableCounter == 0 && _areHotKeysUnregistered)
         {
+            _areHotKeysUnregistered = NO;
+
+            // Hot keys kept their IDs while paused; those removed meanwhile are already gone.
+            for (SRShortcut *shortcut in _shortcutToHotKeyId.allKeys)
+                [self _reregisterHotKeyForShortcut:shortcut];
+
             for (SRShortcut *shortcut in _shortcuts)
                 [self _registerHotKeyForShortcutIfNeeded:shortcut];
         }
@@ -1037,10 +3560,12 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
         os_trace_debug("Global Shortcut Monitor counter: %ld -> %ld", _disableCounter, _disableCounter + 1);
         _disableCounter += 1;
 
-        if (_disableCounter == 1)
+        if (_disableCounter == 1 && _pauseBehavior == SRGlobalShortcutMonitorPauseBehaviorUnregister)
         {
-            for (SRShortcut *shortcut in _shortcuts)
-                [self _unregisterHotKeyForShortcutIfNeeded:shortcut];
+            _areHotKeysUnregistered = YES;
+
+            for (SRShortcut *shortcut in _shortcutToHotKeyId)
+                [self _suspendHotKeyForShortcut:shortcut];
         }
 
         [self _removeEventHandlerIfNeeded];
@@ -1052,6 +3577,7 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
     __block OSStatus error = eventNotHandledErr;
 
     os_activity_initiate("-[SRGlobalShortcutMonitor handleEvent:]", OS_ACTIVITY_FLAG_DETACHED, ^{
+        // Hot keys of a suspended monitor stay registered: ignore them.
         if (self->_disableCounter > 0)
         {
             os_trace_debug("Monitoring is currently disabled");
@@ -1070,49 +3596,38 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
             return;
         }
 
-        @synchronized (self->_actions)
-        {
-            SRShortcut *shortcut = [self->_hotKeyIdToShortcut objectForKey:@(hotKeyID.id)];
-
-            if (!shortcut)
-            {
-                os_trace("Unregistered hot key with id %u and signature %u", hotKeyID.id, hotKeyID.signature);
-                return;
-            }
-
-            SRKeyEventType eventType = 0;
-            switch (GetEventKind(anEvent))
-            {
-                case kEventHotKeyPressed:
-                    eventType = SRKeyEventTypeDown;
-                    break;
-                case kEventHotKeyReleased:
-                    eventType = SRKeyEventTypeUp;
-                    break;
-                default:
-                    os_trace("#Error Unexpected key event of type %u", GetEventKind(anEvent));
-                    return;
-            }
+        _SRShortcutKey key = [_SRHotKeyRegistry.shared.table keyForHotKeyID:hotKeyID.id monitor:self];
 
-            __auto_type actions = [self enabledActionsForShortcut:shortcut keyEvent:eventType];
+        // Either unregistered or of another monitor: let the next handler have it.
+        if (key == SRCoreShortcutKeyInvalid)
+        {
+            os_trace_debug("Foreign or unregistered hot key with id %u and signature %u", hotKeyID.id, hotKeyID.signature);
+            return;
+        }
 
-            if (!actions.count)
-            {
-                os_trace("No actions for the shortcut");
+        SRKeyEventType eventType = 0;
+        switch (GetEventKind(anEvent))
+        {
+            case kEventHotKeyPressed:
+                eventType = SRKeyEventTypeDown;
+                break;
+            case kEventHotKeyReleased:
+                eventType = SRKeyEventTypeUp;
+                break;
+            default:
+                os_trace("#Error Unexpected key event of type %u", GetEventKind(anEvent));
                 return;
-            }
+        }
 
-            __block BOOL isHandled = NO;
+        if (eventType == SRKeyEventTypeDown)
+            key |= SRCoreShortcutKeyKeyDownMask;
 
-            [actions enumerateObjectsWithOptions:NSEnumerationReverse
-                                      usingBlock:^(SRShortcutAction *obj, NSUInteger idx, BOOL *stop)
-            {
-                *stop = isHandled = [obj performActionOnTarget:nil];
-            }];
+        uint64_t start = mach_absolute_time();
+        BOOL isHandled = [self _performEnabledActionsForKey:key time:start onTarget:nil];
+        [self _traceKey:key isHandled:isHandled since:start];
 
-            if (isHandled)
-                error = noErr;
-        }
+        if (isHandled)
+            error = noErr;
     });
 
     return error;
@@ -1135,7 +3650,7 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
     if (_carbonEventHandler)
         return;
 
-    if (_disableCounter > 0 || !_shortcutToHotKeyRef.count)
+    if (_areHotKeysUnregistered || !_shortcutToHotKeyId.count)
         return;
 
     static const EventTypeSpec EventSpec[] = {
@@ -1164,7 +3679,7 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
     if (!_carbonEventHandler)
         return;
 
-    if (_disableCounter <= 0 && _shortcutToHotKeyRef.count)
+    if (!_areHotKeysUnregistered && _shortcutToHotKeyId.count)
         return;
 
     os_trace("Removing Carbon hot key event handler");
@@ -1180,9 +3695,11 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
 
 - (void)_registerHotKeyForShortcutIfNeeded:(SRShortcut *)aShortcut
 {
-    EventHotKeyRef hotKey = (__bridge EventHotKeyRef)([_shortcutToHotKeyRef objectForKey:aShortcut]);
+    // Registered on resume.
+    if (_areHotKeysUnregistered)
+        return;
 
-    if (hotKey)
+    if ([_shortcutToHotKeyId objectForKey:aShortcut])
         return;
 
     if (aShortcut.keyCode == SRKeyCodeNone)
@@ -1191,8 +3708,49 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
         return;
     }
 
-    static UInt32 CarbonID = _SRInvalidHotKeyID;
-    EventHotKeyID hotKeyID = {SRShortcutActionSignature, ++CarbonID};
+    __auto_type registry = _SRHotKeyRegistry.shared;
+    UInt32 hotKeyID = [registry makeHotKeyIDForMonitor:self];
+    EventHotKeyRef hotKey = [self _registerHotKeyWithID:hotKeyID forShortcut:aShortcut];
+
+    if (!hotKey)
+    {
+        [registry recycleHotKeyID:hotKeyID];
+        return;
+    }
+
+    [registry setHotKey:hotKey forHotKeyID:hotKeyID];
+    [registry setKey:_SRShortcutKeyMakeWithShortcut(aShortcut, SRKeyEventTypeUp) forHotKeyID:hotKeyID];
+    [_shortcutToHotKeyId setObject:@(hotKeyID) forKey:aShortcut];
+}
+
+- (void)_reregisterHotKeyForShortcut:(SRShortcut *)aShortcut
+{
+    __auto_type registry = _SRHotKeyRegistry.shared;
+    UInt32 hotKeyID = [_shortcutToHotKeyId objectForKey:aShortcut].unsignedIntValue;
+    NSAssert(![registry hotKeyForHotKeyID:hotKeyID], @"Hot key is already registered");
+    EventHotKeyRef hotKey = [self _registerHotKeyWithID:hotKeyID forShortcut:aShortcut];
+
+    if (hotKey)
+        [registry setHotKey:hotKey forHotKeyID:hotKeyID];
+    else
+    {
+        [_shortcutToHotKeyId removeObjectForKey:aShortcut];
+        [registry recycleHotKeyID:hotKeyID];
+    }
+}
+
+- (void)_suspendHotKeyForShortcut:(SRShortcut *)aShortcut
+{
+    __auto_type registry = _SRHotKeyRegistry.shared;
+    UInt32 hotKeyID = [_shortcutToHotKeyId objectForKey:aShortcut].unsignedIntValue;
+    [self _unregisterHotKey:[registry hotKeyForHotKeyID:hotKeyID] withID:hotKeyID forShortcut:aShortcut];
+    [registry setHotKey:NULL forHotKeyID:hotKeyID];
+}
+
+- (nullable EventHotKeyRef)_registerHotKeyWithID:(UInt32)aHotKeyID forShortcut:(SRShortcut *)aShortcut
+{
+    EventHotKeyRef hotKey = NULL;
+    EventHotKeyID hotKeyID = {SRShortcutActionSignature, aHotKeyID};
     os_trace("Registering Carbon hot key");
     OSStatus error = RegisterEventHotKey(aShortcut.carbonKeyCode,
                                          aShortcut.carbonModifierFlags,
@@ -1207,7 +3765,7 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
             xpc_dictionary_set_uint64(d, "keyCode", aShortcut.keyCode);
             xpc_dictionary_set_uint64(d, "modifierFlags", aShortcut.modifierFlags);
         });
-        return;
+        return NULL;
     }
 
     os_trace_with_payload("Registered Carbon hot key %u", hotKeyID.id, ^(xpc_object_t d) {
@@ -1215,64 +3773,317 @@ static OSStatus _SRCarbonEventHandler(EventHandlerCallRef aHandler, EventRef anE
         xpc_dictionary_set_uint64(d, "modifierFlags", aShortcut.modifierFlags);
     });
 
-    [_shortcutToHotKeyRef setObject:(__bridge id _Nullable)(hotKey) forKey:aShortcut];
-    [_hotKeyIdToShortcut setObject:aShortcut forKey:@(hotKeyID.id)];
-    [_shortcutToHotKeyId setObject:@(hotKeyID.id) forKey:aShortcut];
+    return hotKey;
+}
+
+- (void)_unregisterHotKeyForShortcutIfNeeded:(SRShortcut *)aShortcut
+{
+    NSNumber *hotKeyIDNumber = [_shortcutToHotKeyId objectForKey:aShortcut];
+
+    if (!hotKeyIDNumber)
+        return;
+
+    __auto_type registry = _SRHotKeyRegistry.shared;
+    UInt32 hotKeyID = hotKeyIDNumber.unsignedIntValue;
+    EventHotKeyRef hotKey = [registry hotKeyForHotKeyID:hotKeyID];
+
+    // Hot keys of a paused monitor are already unregistered.
+    if (hotKey)
+        [self _unregisterHotKey:hotKey withID:hotKeyID forShortcut:aShortcut];
+
+    // Assume that an error to unregister the handler is due to the latter being invalid.
+    [_shortcutToHotKeyId removeObjectForKey:aShortcut];
+    [registry recycleHotKeyID:hotKeyID];
+}
+
+- (void)_unregisterHotKey:(EventHotKeyRef)aHotKey withID:(UInt32)aHotKeyID forShortcut:(SRShortcut *)aShortcut
+{
+    os_trace("Removing Carbon hot key %u", aHotKeyID);
+    OSStatus error = UnregisterEventHotKey(aHotKey);
+
+    if (error != noErr)
+    {
+        os_trace_error_with_payload("#Critical Failed to unregister Carbon hot key %u: %d", aHotKeyID, error, ^(xpc_object_t d) {
+            xpc_dictionary_set_uint64(d, "keyCode", aShortcut.keyCode);
+            xpc_dictionary_set_uint64(d, "modifierFlags", aShortcut.modifierFlags);
+        });
+    }
+    else
+    {
+        os_trace_with_payload("Unregistered Carbon hot key %u", aHotKeyID, ^(xpc_object_t d) {
+            xpc_dictionary_set_uint64(d, "keyCode", aShortcut.keyCode);
+            xpc_dictionary_set_uint64(d, "modifierFlags", aShortcut.modifierFlags);
+        });
+    }
+}
+
+#pragma mark SRShortcutMonitor
+
+- (void)didAddShortcut:(SRShortcut *)aShortcut
+{
+    [self _registerHotKeyForShortcutIfNeeded:aShortcut];
+    [self _installEventHandlerIfNeeded];
+}
+
+- (void)willRemoveShortcut:(SRShortcut *)aShortcut
+{
+    [self _unregisterHotKeyForShortcutIfNeeded:aShortcut];
+    [self _removeEventHandlerIfNeeded];
+}
+
+@end
+
+
+NSNotificationName const SRAXGlobalShortcutMonitorEventTapDisabledNotification = @"SRAXGlobalShortcutMonitorEventTapDisabled";
+
+NSString *const SRAXGlobalShortcutMonitorEventTapDisabledReasonKey = @"reason";
+
+NSString *const SRAXGlobalShortcutMonitorEventTapReenableDelayKey = @"reenableDelay";
+
+NSString *const SRAXGlobalShortcutMonitorCallbackDurationMedianKey = @"callbackDurationMedian";
+
+NSString *const SRAXGlobalShortcutMonitorCallbackDurationP99Key = @"callbackDurationP99";
+
+NSString *const SRAXGlobalShortcutMonitorCallbackDurationMaximumKey = @"callbackDurationMaximum";
+
+
+#pragma mark -
+
+
+/*!
+ Modifier gestures are looked up by the offset of the key code from the smallest one of the supported keys.
+ */
+#define _SRModifierGestureKeyCodeBase kVK_RightCommand
+
+#define _SRModifierGestureKeyCodeCount (kVK_RightControl - kVK_RightCommand + 1)
+
+static const NSTimeInterval _SRModifierGestureDefaultTapInterval = 0.3;
+
+/*!
+ The timer that fires holds stays scheduled: it is re-armed when a key is pressed instead of being recreated.
+ */
+static const CFTimeInterval _SRModifierGestureTimerIdleInterval = 1.0e9;
+
+NS_INLINE uint64_t _SRSecondsToNanoseconds(NSTimeInterval aSeconds)
+{
+    return (uint64_t)(aSeconds * NSEC_PER_SEC);
+}
+
+
+@implementation SRModifierGesture
+
++ (instancetype)tapWithKeyCode:(SRKeyCode)aKeyCode
+{
+    return [[self alloc] initWithKind:SRModifierGestureKindTap keyCode:aKeyCode interval:_SRModifierGestureDefaultTapInterval];
+}
+
++ (instancetype)doubleTapWithKeyCode:(SRKeyCode)aKeyCode interval:(NSTimeInterval)anInterval
+{
+    return [[self alloc] initWithKind:SRModifierGestureKindDoubleTap keyCode:aKeyCode interval:anInterval];
+}
+
++ (instancetype)holdWithKeyCode:(SRKeyCode)aKeyCode duration:(NSTimeInterval)aDuration
+{
+    return [[self alloc] initWithKind:SRModifierGestureKindHold keyCode:aKeyCode interval:aDuration];
+}
+
+- (instancetype)initWithKind:(SRModifierGestureKind)aKind keyCode:(SRKeyCode)aKeyCode interval:(NSTimeInterval)anInterval
+{
+    if (!_SRModifierFlagForKeyCode(aKeyCode))
+        [NSException raise:NSInvalidArgumentException format:@"Key code %hu is not a supported modifier key", aKeyCode];
+
+    if (!(anInterval > 0.0))
+        [NSException raise:NSInvalidArgumentException format:@"Interval %f is not positive", anInterval];
+
+    self = [super init];
+
+    if (self)
+    {
+        _kind = aKind;
+        _keyCode = aKeyCode;
+        _interval = anInterval;
+    }
+
+    return self;
+}
+
+#pragma mark NSCopying
+
+- (instancetype)copyWithZone:(NSZone *)aZone
+{
+    // Immutable.
+    return self;
+}
+
+#pragma mark NSObject
+
+- (BOOL)isEqual:(NSObject *)anObject
+{
+    if (anObject == self)
+        return YES;
+    else if (![anObject isKindOfClass:SRModifierGesture.class])
+        return NO;
+
+    __auto_type gesture = (SRModifierGesture *)anObject;
+    return gesture.kind == _kind && gesture.keyCode == _keyCode && gesture.interval == _interval;
+}
+
+- (NSUInteger)hash
+{
+    return (_kind << 16) | _keyCode;
+}
+
+- (NSString *)description
+{
+    static NSString * const KindNames[] = {@"tap", @"double-tap", @"hold"};
+    return [NSString stringWithFormat:@"<%@ %p %@ %hu %f>", self.className, self, KindNames[_kind], _keyCode, _interval];
+}
+
+@end
+
+
+/*!
+ Immutable lookup of the modifier gestures and their actions by key code.
+
+ @discussion
+ Gestures and actions of a key are index-aligned so the event tap can look them up without hashing.
+ */
+@interface _SRModifierGestureTable : NSObject
+
+- (instancetype)initWithGestureActions:(NSDictionary<SRModifierGesture *, NSArray<SRShortcutAction *> *> *)aGestureActions NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (readonly) NSArray<SRModifierGesture *> *gestures;
+
+- (nullable NSArray<SRModifierGesture *> *)gesturesForKeyCode:(unsigned short)aKeyCode;
+
+- (nullable NSArray<NSArray<SRShortcutAction *> *> *)actionsForKeyCode:(unsigned short)aKeyCode;
+
+/*!
+ Gestures of the key in the form of the portable core, index-aligned with gesturesForKeyCode:.
+ */
+- (nullable const SRCoreModifierGesture *)coreGesturesForKeyCode:(unsigned short)aKeyCode count:(size_t *)outCount;
+
+@end
+
+
+@implementation _SRModifierGestureTable
+{
+    NSArray<SRModifierGesture *> *_gesturesByKeyCode[_SRModifierGestureKeyCodeCount];
+    NSArray<NSArray<SRShortcutAction *> *> *_actionsByKeyCode[_SRModifierGestureKeyCodeCount];
+    SRCoreModifierGesture *_coreGesturesByKeyCode[_SRModifierGestureKeyCodeCount];
+}
+
+- (instancetype)initWithGestureActions:(NSDictionary<SRModifierGesture *, NSArray<SRShortcutAction *> *> *)aGestureActions
+{
+    self = [super init];
+
+    if (self)
+    {
+        NSMutableArray<SRModifierGesture *> *gestures[_SRModifierGestureKeyCodeCount] = {nil};
+        NSMutableArray<NSArray<SRShortcutAction *> *> *actions[_SRModifierGestureKeyCodeCount] = {nil};
+
+        for (SRModifierGesture *gesture in aGestureActions)
+        {
+            NSUInteger index = gesture.keyCode - _SRModifierGestureKeyCodeBase;
+
+            if (!gestures[index])
+            {
+                gestures[index] = [NSMutableArray new];
+                actions[index] = [NSMutableArray new];
+            }
+
+            [gestures[index] addObject:gesture];
+            [actions[index] addObject:[aGestureActions[gesture] copy]];
+        }
+
+        for (NSUInteger i = 0; i < _SRModifierGestureKeyCodeCount; ++i)
+        {
+            _gesturesByKeyCode[i] = [gestures[i] copy];
+            _actionsByKeyCode[i] = [actions[i] copy];
+
+            if (!gestures[i])
+                continue;
+
+            _coreGesturesByKeyCode[i] = calloc(gestures[i].count, sizeof(SRCoreModifierGesture));
+
+            if (!_coreGesturesByKeyCode[i])
+                return nil;
+
+            for (NSUInteger j = 0, count = gestures[i].count; j < count; ++j)
+            {
+                _coreGesturesByKeyCode[i][j].kind = (SRCoreModifierGestureKind)gestures[i][j].kind;
+                _coreGesturesByKeyCode[i][j].interval = _SRSecondsToNanoseconds(gestures[i][j].interval);
+            }
+        }
+
+        _gestures = aGestureActions.allKeys;
+    }
+
+    return self;
 }
 
-- (void)_unregisterHotKeyForShortcutIfNeeded:(SRShortcut *)aShortcut
+- (NSArray<SRModifierGesture *> *)gesturesForKeyCode:(unsigned short)aKeyCode
 {
-    EventHotKeyRef hotKey = (__bridge EventHotKeyRef)([_shortcutToHotKeyRef objectForKey:aShortcut]);
+    if (aKeyCode < _SRModifierGestureKeyCodeBase || aKeyCode - _SRModifierGestureKeyCodeBase >= _SRModifierGestureKeyCodeCount)
+        return nil;
 
-    if (!hotKey)
-        return;
+    return _gesturesByKeyCode[aKeyCode - _SRModifierGestureKeyCodeBase];
+}
 
-    UInt32 hotKeyID = [_shortcutToHotKeyId objectForKey:aShortcut].unsignedIntValue;
+- (NSArray<NSArray<SRShortcutAction *> *> *)actionsForKeyCode:(unsigned short)aKeyCode
+{
+    if (aKeyCode < _SRModifierGestureKeyCodeBase || aKeyCode - _SRModifierGestureKeyCodeBase >= _SRModifierGestureKeyCodeCount)
+        return nil;
 
-    os_trace("Removing Carbon hot key %u", hotKeyID);
-    OSStatus error = UnregisterEventHotKey(hotKey);
+    return _actionsByKeyCode[aKeyCode - _SRModifierGestureKeyCodeBase];
+}
 
-    if (error != noErr)
-    {
-        os_trace_error_with_payload("#Critical Failed to unregister Carbon hot key %u: %d", hotKeyID, error, ^(xpc_object_t d) {
-            xpc_dictionary_set_uint64(d, "keyCode", aShortcut.keyCode);
-            xpc_dictionary_set_uint64(d, "modifierFlags", aShortcut.modifierFlags);
-        });
-    }
-    else
+- (const SRCoreModifierGesture *)coreGesturesForKeyCode:(unsigned short)aKeyCode count:(size_t *)outCount
+{
+    if (aKeyCode < _SRModifierGestureKeyCodeBase || aKeyCode - _SRModifierGestureKeyCodeBase >= _SRModifierGestureKeyCodeCount)
     {
-        os_trace_with_payload("Unregistered Carbon hot key %u", hotKeyID, ^(xpc_object_t d) {
-            xpc_dictionary_set_uint64(d, "keyCode", aShortcut.keyCode);
-            xpc_dictionary_set_uint64(d, "modifierFlags", aShortcut.modifierFlags);
-        });
+        *outCount = 0;
+        return NULL;
     }
 
-    // Assume that an error to unregister the handler is due to the latter being invalid.
-    [_shortcutToHotKeyRef removeObjectForKey:aShortcut];
-    [_shortcutToHotKeyId removeObjectForKey:aShortcut];
-    [_hotKeyIdToShortcut removeObjectForKey:@(hotKeyID)];
+    *outCount = _gesturesByKeyCode[aKeyCode - _SRModifierGestureKeyCodeBase].count;
+    return _coreGesturesByKeyCode[aKeyCode - _SRModifierGestureKeyCodeBase];
 }
 
-#pragma mark SRShortcutMonitor
-
-- (void)didAddShortcut:(SRShortcut *)aShortcut
+- (void)dealloc
 {
-    [self _registerHotKeyForShortcutIfNeeded:aShortcut];
-    [self _installEventHandlerIfNeeded];
+    for (NSUInteger i = 0; i < _SRModifierGestureKeyCodeCount; ++i)
+        free(_coreGesturesByKeyCode[i]);
 }
 
-- (void)willRemoveShortcut:(SRShortcut *)aShortcut
-{
-    [self _unregisterHotKeyForShortcutIfNeeded:aShortcut];
-    [self _removeEventHandlerIfNeeded];
-}
+@end
+
+
 
+
+static void _SRModifierGestureTimerHandler(CFRunLoopTimerRef aTimer, void *aUserInfo);
+
+
+@interface SRAXGlobalShortcutMonitor ()
+@property (nullable) _SRModifierGestureTable *modifierGestureTable;
+- (void)_recordCallbackDuration:(uint64_t)aDuration;
+- (void)_eventTapDidDisableWithReason:(CGEventType)aReason;
+- (void)_modifierGestureTimerDidFire;
 @end
 
 
 @implementation SRAXGlobalShortcutMonitor
 {
     BOOL _canActivelyFilterEvents;
+    _Atomic(uint64_t) _callbackDurations[SRCoreCallbackDurationsCapacity]; // in mach time units
+    _Atomic(NSUInteger) _callbackDurationsCount;
+    uint64_t _lastEventTapDisableTime;
+    NSTimeInterval _eventTapReenableDelay;
+    NSMutableDictionary<SRModifierGesture *, NSMutableArray<SRShortcutAction *> *> *_modifierGestureActions;
+    CFRunLoopTimerRef _modifierGestureTimer;
+    SRCoreModifierGestureState _modifierGestureState; // accessed only on the event tap's run loop
 }
 
 CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType aType, CGEventRef anEvent, void * _Nullable aUserInfo)
@@ -1281,8 +4092,7 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
 
     if (aType == kCGEventTapDisabledByTimeout || aType == kCGEventTapDisabledByUserInput)
     {
-        os_trace_error("#Error #Developer The system disabled event tap due to %u", aType);
-        CGEventTapEnable(self.eventTap, true);
+        [self _eventTapDidDisableWithReason:aType];
         return anEvent;
     }
     else if (aType != kCGEventKeyDown && aType != kCGEventKeyUp && aType != kCGEventFlagsChanged)
@@ -1291,7 +4101,17 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
         return anEvent;
     }
     else
-        return [self handleEvent:anEvent];
+    {
+        uint64_t start = mach_absolute_time();
+        __auto_type result = [self handleEvent:anEvent];
+        [self _recordCallbackDuration:mach_absolute_time() - start];
+        return result;
+    }
+}
+
+static void _SRModifierGestureTimerHandler(CFRunLoopTimerRef aTimer, void *aUserInfo)
+{
+    [(__bridge SRAXGlobalShortcutMonitor *)aUserInfo _modifierGestureTimerDidFire];
 }
 
 - (instancetype)init
@@ -1327,8 +4147,26 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
     {
         _eventTap = eventTap;
         _eventTapSource = CFMachPortCreateRunLoopSource(kCFAllocatorDefault, eventTap, 0);
+        _eventTapRunLoop = aRunLoop;
         _canActivelyFilterEvents = (aTapOptions & kCGEventTapOptionListenOnly) == 0;
         CFRunLoopAddSource(aRunLoop.getCFRunLoop, _eventTapSource, kCFRunLoopDefaultMode);
+
+        _modifierGestureActions = [NSMutableDictionary new];
+        _modifierGestureClock = ^uint64_t{
+            return _SRMachTimeToNanoseconds(mach_absolute_time());
+        };
+        SRCoreModifierGestureStateInit(&_modifierGestureState);
+
+        // Holds are fired by the timer on the same run loop as the event tap: the state needs no locking.
+        CFRunLoopTimerContext timerContext = {0, (__bridge void *)self, NULL, NULL, NULL};
+        _modifierGestureTimer = CFRunLoopTimerCreate(kCFAllocatorDefault,
+                                                     CFAbsoluteTimeGetCurrent() + _SRModifierGestureTimerIdleInterval,
+                                                     _SRModifierGestureTimerIdleInterval,
+                                                     0,
+                                                     0,
+                                                     _SRModifierGestureTimerHandler,
+                                                     &timerContext);
+        CFRunLoopAddTimer(aRunLoop.getCFRunLoop, _modifierGestureTimer, kCFRunLoopDefaultMode);
     }
 
     return self;
@@ -1336,6 +4174,12 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
 
 - (void)dealloc
 {
+    if (_modifierGestureTimer)
+    {
+        CFRunLoopTimerInvalidate(_modifierGestureTimer);
+        CFRelease(_modifierGestureTimer);
+    }
+
     if (_eventTap)
         CFRelease(_eventTap);
 
@@ -1343,50 +4187,102 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
         CFRelease(_eventTapSource);
 }
 
+#pragma mark Properties
+
+- (void)setModifierGestureClock:(uint64_t (^)(void))aClock
+{
+    if (aClock)
+        _modifierGestureClock = [aClock copy];
+    else
+    {
+        _modifierGestureClock = ^uint64_t{
+            return _SRMachTimeToNanoseconds(mach_absolute_time());
+        };
+    }
+}
+
+- (NSArray<SRModifierGesture *> *)modifierGestures
+{
+    __auto_type gestures = self.modifierGestureTable.gestures;
+    return gestures ? gestures : @[];
+}
+
 #pragma mark Methods
 
+- (NSTimeInterval)callbackDurationAtPercentile:(double)aPercentile
+{
+    if (aPercentile < 0.0 || aPercentile > 100.0)
+        [NSException raise:NSInvalidArgumentException format:@"Percentile %f is out of the [0, 100] range", aPercentile];
+
+    uint64_t durations[SRCoreCallbackDurationsCapacity];
+    NSUInteger count = atomic_load_explicit(&_callbackDurationsCount, memory_order_acquire);
+
+    for (NSUInteger i = 0; i < MIN(count, SRCoreCallbackDurationsCapacity); ++i)
+        durations[i] = atomic_load_explicit(&_callbackDurations[i], memory_order_relaxed);
+
+    return _SRMachTimeToSeconds(SRCoreCallbackDurationAtPercentile(durations, count, aPercentile));
+}
+
 - (CGEventRef)handleEvent:(CGEventRef)anEvent
 {
-    __block __auto_type result = anEvent;
+    // The event tap sees every keystroke: avoid allocations and key code translation by going
+    // straight from the raw event to the packed shortcut key.
+    __auto_type eventKeyCode = (unsigned short)CGEventGetIntegerValueField(anEvent, kCGKeyboardEventKeycode);
+    __auto_type cocoaModifierFlags = SRCoreGraphicsToCocoaFlags(CGEventGetFlags(anEvent));
+    SRKeyCode keyCode = SRKeyCodeNone;
+    SRKeyEventType keyEventType = SRKeyEventTypeDown;
+    BOOL isRepeat = NO;
+
+    __auto_type gestureTable = self.modifierGestureTable;
+
+    switch (CGEventGetType(anEvent))
+    {
+        case kCGEventKeyDown:
+            keyCode = eventKeyCode;
+            keyEventType = SRKeyEventTypeDown;
+            isRepeat = CGEventGetIntegerValueField(anEvent, kCGKeyboardEventAutorepeat) != 0;
 
-    os_activity_initiate("-[SRAXGlobalShortcutMonitor handleEvent:]", OS_ACTIVITY_FLAG_DETACHED, ^{
-        __auto_type eventKeyCode = CGEventGetIntegerValueField(anEvent, kCGKeyboardEventKeycode);
-        __auto_type eventType = CGEventGetType(anEvent);
-        __auto_type cocoaModifierFlags = SRCoreGraphicsToCocoaFlags(CGEventGetFlags(anEvent));
-        NSEventType cocoaEventType;
-        switch (eventType)
+            if (gestureTable)
+                [self _cancelModifierGestureInTable:gestureTable];
+
+            break;
+        case kCGEventKeyUp:
+            keyCode = eventKeyCode;
+            keyEventType = SRKeyEventTypeUp;
+            break;
+        case kCGEventFlagsChanged:
         {
-            case kCGEventKeyDown:
-                cocoaEventType = NSEventTypeKeyDown;
-                break;
-            case kCGEventKeyUp:
-                cocoaEventType = NSEventTypeKeyUp;
-                break;
-            case kCGEventFlagsChanged:
-                cocoaEventType = NSEventTypeFlagsChanged;
-                break;
-            default:
-                cocoaEventType = 0;
-                break;
+            NSEventModifierFlags keyCodeModifierFlag = _SRModifierFlagForKeyCode(eventKeyCode);
+
+            if (!keyCodeModifierFlag)
+            {
+                os_trace("#Error Unexpected key code %hu for the FlagsChanged event", eventKeyCode);
+                return anEvent;
+            }
+
+            keyEventType = cocoaModifierFlags & keyCodeModifierFlag ? SRKeyEventTypeDown : SRKeyEventTypeUp;
+
+            if (gestureTable)
+            {
+                [self _modifierKey:eventKeyCode
+                     didChangeDown:SRCoreIsModifierKeyDown(eventKeyCode, CGEventGetFlags(anEvent))
+                           inTable:gestureTable];
+            }
+
+            break;
         }
+        default:
+            os_trace_error("#Error #Developer Unexpected event of type %u", CGEventGetType(anEvent));
+            return anEvent;
+    }
 
-        __auto_type shortcut = [SRShortcut shortcutWithCode:eventType != kCGEventFlagsChanged ? (SRKeyCode)eventKeyCode : SRKeyCodeNone
-                                              modifierFlags:cocoaModifierFlags
-                                                 characters:nil
-                                charactersIgnoringModifiers:nil];
-        __auto_type keyEventType = [NSEvent SR_keyEventTypeForEventType:cocoaEventType
-                                                                keyCode:(unsigned short)eventKeyCode
-                                                          modifierFlags:cocoaModifierFlags];
-        __auto_type actions = [self enabledActionsForShortcut:shortcut keyEvent:keyEventType];
-        __block BOOL isHandled = NO;
-        [actions enumerateObjectsWithOptions:NSEnumerationReverse
-                                  usingBlock:^(SRShortcutAction *obj, NSUInteger idx, BOOL *stop)
-        {
-            *stop = isHandled = [obj performActionOnTarget:nil];
-        }];
+    __auto_type key = _SRShortcutKeyMake(keyCode, cocoaModifierFlags, keyEventType);
 
-        result = isHandled ? nil : anEvent;
-    });
+    if (isRepeat)
+        key |= SRCoreShortcutKeyRepeatMask;
+
+    BOOL isHandled = [self _performActionsForKey:key time:mach_absolute_time() onTarget:nil];
+    __auto_type result = isHandled ? NULL : anEvent;
 
     if (!result && !_canActivelyFilterEvents)
         os_trace_error("#Developer #Error The monitor is not configured to actively filter events");
@@ -1394,20 +4290,232 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
     return result;
 }
 
+- (void)addAction:(SRShortcutAction *)anAction forModifierGesture:(SRModifierGesture *)aGesture
+{
+    @synchronized (_actions)
+    {
+        __auto_type actions = _modifierGestureActions[aGesture];
+
+        if (!actions)
+        {
+            actions = [NSMutableArray new];
+            _modifierGestureActions[aGesture] = actions;
+        }
+        else
+            [actions removeObject:anAction];
+
+        [actions addObject:anAction];
+        [self _didChangeModifierGestures];
+    }
+}
+
+- (void)removeAction:(SRShortcutAction *)anAction forModifierGesture:(SRModifierGesture *)aGesture
+{
+    @synchronized (_actions)
+    {
+        __auto_type actions = _modifierGestureActions[aGesture];
+
+        if (![actions containsObject:anAction])
+            return;
+
+        [actions removeObject:anAction];
+
+        if (!actions.count)
+            [_modifierGestureActions removeObjectForKey:aGesture];
+
+        [self _didChangeModifierGestures];
+    }
+}
+
 #pragma mark SRShortcutMonitor
 
+- (void)removeAllActions
+{
+    @synchronized (_actions)
+    {
+        [super removeAllActions];
+
+        if (_modifierGestureActions.count)
+        {
+            [_modifierGestureActions removeAllObjects];
+            [self _didChangeModifierGestures];
+        }
+    }
+}
+
 - (void)didAddShortcut:(SRShortcut *)aShortcut
 {
     if (_shortcuts.count)
         CGEventTapEnable(_eventTap, true);
 }
 
-- (void)willRemoveShortcut:(SRShortcut *)aShortcut
+- (void)didRemoveShortcut:(SRShortcut *)aShortcut
 {
-    if (_shortcuts.count == 1 && [_shortcuts countForObject:aShortcut] == 1)
+    if (![self _needsEventTap])
         CGEventTapEnable(_eventTap, false);
 }
 
+- (void)_didChangeShortcutSequences
+{
+    // The initial snapshot is published before the event tap is created.
+    if (_eventTap)
+        CGEventTapEnable(_eventTap, [self _needsEventTap]);
+}
+
+#pragma mark Private
+
+- (BOOL)_needsEventTap
+{
+    return _shortcuts.count || _sequenceActions.count || _modifierGestureActions.count;
+}
+
+- (void)_didChangeModifierGestures
+{
+    self.modifierGestureTable = _modifierGestureActions.count ? [[_SRModifierGestureTable alloc] initWithGestureActions:_modifierGestureActions] : nil;
+    CGEventTapEnable(_eventTap, [self _needsEventTap]);
+}
+
+- (void)_modifierKey:(unsigned short)aKeyCode didChangeDown:(BOOL)anIsDown inTable:(_SRModifierGestureTable *)aTable
+{
+    uint64_t now = _modifierGestureClock();
+    [self _performModifierHoldsInTable:aTable now:now];
+
+    size_t gestureCount = 0;
+    __auto_type gestures = [aTable coreGesturesForKeyCode:aKeyCode count:&gestureCount];
+    size_t matches[MAX(gestureCount, 1)];
+    size_t matchCount = SRCoreModifierGestureStateUpdate(&_modifierGestureState, aKeyCode, anIsDown, now, gestures, gestureCount, matches);
+
+    if (anIsDown)
+    {
+        [self _scheduleModifierHoldsInTable:aTable now:now];
+        return;
+    }
+
+    __auto_type actions = [aTable actionsForKeyCode:aKeyCode];
+
+    for (size_t i = 0; i < matchCount; ++i)
+        [self _performModifierGestureActions:actions[matches[i]] forKeyCode:aKeyCode isDown:NO];
+}
+
+- (void)_cancelModifierGestureInTable:(_SRModifierGestureTable *)aTable
+{
+    [self _performModifierHoldsInTable:aTable now:_modifierGestureClock()];
+    SRCoreModifierGestureStateCancel(&_modifierGestureState);
+}
+
+- (void)_modifierGestureTimerDidFire
+{
+    __auto_type table = self.modifierGestureTable;
+
+    if (!table)
+        return;
+
+    uint64_t now = _modifierGestureClock();
+    [self _performModifierHoldsInTable:table now:now];
+    [self _scheduleModifierHoldsInTable:table now:now];
+}
+
+/*!
+ Perform actions of the holds of the tracked key whose duration elapsed since the last evaluation.
+
+ @discussion
+ Called before every event as well as by the timer so a late timer does not reorder holds and other gestures.
+ */
+- (void)_performModifierHoldsInTable:(_SRModifierGestureTable *)aTable now:(uint64_t)aNow
+{
+    SRKeyCode keyCode = _modifierGestureState.keyCode;
+    size_t gestureCount = 0;
+    __auto_type gestures = [aTable coreGesturesForKeyCode:keyCode count:&gestureCount];
+    size_t matches[MAX(gestureCount, 1)];
+    size_t matchCount = SRCoreModifierGestureStateAdvance(&_modifierGestureState, aNow, gestures, gestureCount, matches);
+
+    if (!matchCount)
+        return;
+
+    __auto_type actions = [aTable actionsForKeyCode:keyCode];
+
+    for (size_t i = 0; i < matchCount; ++i)
+        [self _performModifierGestureActions:actions[matches[i]] forKeyCode:keyCode isDown:YES];
+}
+
+/*!
+ Arm the timer for the nearest hold of the tracked key that is yet to elapse.
+ */
+- (void)_scheduleModifierHoldsInTable:(_SRModifierGestureTable *)aTable now:(uint64_t)aNow
+{
+    size_t gestureCount = 0;
+    __auto_type gestures = [aTable coreGesturesForKeyCode:_modifierGestureState.keyCode count:&gestureCount];
+    uint64_t delay = SRCoreModifierGestureStateNextHoldDelay(&_modifierGestureState, aNow, gestures, gestureCount);
+
+    if (delay != UINT64_MAX)
+        CFRunLoopTimerSetNextFireDate(_modifierGestureTimer, CFAbsoluteTimeGetCurrent() + (CFTimeInterval)delay / NSEC_PER_SEC);
+}
+
+/*!
+ Perform actions of the matched gesture or put them on the action queue like actions of any other shortcut.
+
+ @discussion
+ The FlagsChanged event itself is counted and passed on by -handleEvent:, so the modifier key remains usable
+ on its own.
+ */
+- (void)_performModifierGestureActions:(NSArray<SRShortcutAction *> *)anActions forKeyCode:(SRKeyCode)aKeyCode isDown:(BOOL)anIsDown
+{
+    [self _performActions:anActions
+                   forKey:_SRShortcutKeyMake(aKeyCode, 0, anIsDown ? SRKeyEventTypeDown : SRKeyEventTypeUp)
+                     time:mach_absolute_time()
+                 onTarget:nil];
+}
+
+- (void)_recordCallbackDuration:(uint64_t)aDuration
+{
+    // Only the event tap's thread records.
+    NSUInteger count = atomic_load_explicit(&_callbackDurationsCount, memory_order_relaxed);
+    atomic_store_explicit(&_callbackDurations[SRCoreCallbackDurationsIndex(count)], aDuration, memory_order_relaxed);
+    atomic_store_explicit(&_callbackDurationsCount, count + 1, memory_order_release);
+}
+
+- (void)_eventTapDidDisableWithReason:(CGEventType)aReason
+{
+    os_trace_error("#Error #Developer The system disabled event tap due to %u", aReason);
+
+    uint64_t now = mach_absolute_time();
+    NSTimeInterval timeSinceLastDisable = _lastEventTapDisableTime ? _SRMachTimeToSeconds(now - _lastEventTapDisableTime) : DBL_MAX;
+    _lastEventTapDisableTime = now;
+    _eventTapReenableDelay = SRCoreEventTapReenableDelay(_eventTapReenableDelay, timeSinceLastDisable);
+
+    if (_eventTapReenableDelay > 0.0)
+    {
+        os_trace("Re-enabling event tap in %f seconds", _eventTapReenableDelay);
+        __weak typeof(self) weakSelf = self;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_eventTapReenableDelay * NSEC_PER_SEC)),
+                       dispatch_get_global_queue(QOS_CLASS_USER_INTERACTIVE, 0),
+                       ^{
+            [weakSelf _reenableEventTapIfNeeded];
+        });
+    }
+    else
+        [self _reenableEventTapIfNeeded];
+
+    [NSNotificationCenter.defaultCenter postNotificationName:SRAXGlobalShortcutMonitorEventTapDisabledNotification
+                                                      object:self
+                                                    userInfo:@{
+                                                        SRAXGlobalShortcutMonitorEventTapDisabledReasonKey: @(aReason),
+                                                        SRAXGlobalShortcutMonitorEventTapReenableDelayKey: @(_eventTapReenableDelay),
+                                                        SRAXGlobalShortcutMonitorCallbackDurationMedianKey: @([self callbackDurationAtPercentile:50.0]),
+                                                        SRAXGlobalShortcutMonitorCallbackDurationP99Key: @([self callbackDurationAtPercentile:99.0]),
+                                                        SRAXGlobalShortcutMonitorCallbackDurationMaximumKey: @([self callbackDurationAtPercentile:100.0])
+                                                    }];
+}
+
+- (void)_reenableEventTapIfNeeded
+{
+    @synchronized (_actions)
+    {
+        if ([self _needsEventTap])
+            CGEventTapEnable(_eventTap, true);
+    }
+}
+
 @end
 
 
@@ -1422,121 +4530,125 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
 + (SRLocalShortcutMonitor *)standardShortcuts
 {
     SRLocalShortcutMonitor *m = [SRLocalShortcutMonitor new];
-    [m addAction:@selector(moveForward:) forKeyEquivalent:@"⌃F" tag:0];
-    [m addAction:@selector(moveRight:) forKeyEquivalent:@"→" tag:0];
-    [m addAction:@selector(moveBackward:) forKeyEquivalent:@"⌃B" tag:0];
-    [m addAction:@selector(moveLeft:) forKeyEquivalent:@"←" tag:0];
-    [m addAction:@selector(moveUp:) forKeyEquivalent:@"↑" tag:0];
-    [m addAction:@selector(moveUp:) forKeyEquivalent:@"⌃P" tag:0];
-    [m addAction:@selector(moveDown:) forKeyEquivalent:@"↓" tag:0];
-    [m addAction:@selector(moveDown:) forKeyEquivalent:@"⌃N" tag:0];
-    [m addAction:@selector(moveWordForward:) forKeyEquivalent:@"⌥F" tag:0];
-    [m addAction:@selector(moveWordBackward:) forKeyEquivalent:@"⌥B" tag:0];
-    [m addAction:@selector(moveToBeginningOfLine:) forKeyEquivalent:@"⌃A" tag:0];
-    [m addAction:@selector(moveToEndOfLine:) forKeyEquivalent:@"⌃E" tag:0];
-    [m addAction:@selector(moveToEndOfDocument:) forKeyEquivalent:@"⌘↓" tag:0];
-    [m addAction:@selector(moveToBeginningOfDocument:) forKeyEquivalent:@"⌘↑" tag:0];
-    [m addAction:@selector(pageDown:) forKeyEquivalent:@"⌃V" tag:0];
-    [m addAction:@selector(pageUp:) forKeyEquivalent:@"⌥V" tag:0];
-    [m addAction:@selector(centerSelectionInVisibleArea:) forKeyEquivalent:@"⌃L" tag:0];
-    [m addAction:@selector(moveBackwardAndModifySelection:) forKeyEquivalent:@"⇧⌃B" tag:0];
-    [m addAction:@selector(moveForwardAndModifySelection:) forKeyEquivalent:@"⇧⌃F" tag:0];
-    [m addAction:@selector(moveWordForwardAndModifySelection:) forKeyEquivalent:@"⇧⌥F" tag:0];
-    [m addAction:@selector(moveWordBackwardAndModifySelection:) forKeyEquivalent:@"⇧⌥B" tag:0];
-    [m addAction:@selector(moveUpAndModifySelection:) forKeyEquivalent:@"⇧↑" tag:0];
-    [m addAction:@selector(moveUpAndModifySelection:) forKeyEquivalent:@"⇧⌃P" tag:0];
-    [m addAction:@selector(moveDownAndModifySelection:) forKeyEquivalent:@"⇧↓" tag:0];
-    [m addAction:@selector(moveDownAndModifySelection:) forKeyEquivalent:@"⇧⌃N" tag:0];
-    [m addAction:@selector(moveToBeginningOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌃A" tag:0];
-    [m addAction:@selector(moveToBeginningOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘←" tag:0];
-    [m addAction:@selector(moveToEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌃E" tag:0];
-    [m addAction:@selector(moveToEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘→" tag:0];
-    [m addAction:@selector(moveToEndOfDocumentAndModifySelection:) forKeyEquivalent:@"⇧⌘↓" tag:0];
-    [m addAction:@selector(moveToBeginningOfDocumentAndModifySelection:) forKeyEquivalent:@"⇧⌘↑" tag:0];
-    [m addAction:@selector(pageDownAndModifySelection:) forKeyEquivalent:@"⇧⌃V" tag:0];
-    [m addAction:@selector(pageUpAndModifySelection:) forKeyEquivalent:@"⇧⌥V" tag:0];
-    [m addAction:@selector(moveWordRight:) forKeyEquivalent:@"⌥→" tag:0];
-    [m addAction:@selector(moveWordLeft:) forKeyEquivalent:@"⌥←" tag:0];
-    [m addAction:@selector(moveRightAndModifySelection:) forKeyEquivalent:@"⇧→" tag:0];
-    [m addAction:@selector(moveLeftAndModifySelection:) forKeyEquivalent:@"⇧←" tag:0];
-    [m addAction:@selector(moveWordRightAndModifySelection:) forKeyEquivalent:@"⇧⌥→" tag:0];
-    [m addAction:@selector(moveWordLeftAndModifySelection:) forKeyEquivalent:@"⇧⌥←" tag:0];
-    [m addAction:@selector(moveToLeftEndOfLine:) forKeyEquivalent:@"⌘←" tag:0];
-    [m addAction:@selector(moveToRightEndOfLine:) forKeyEquivalent:@"⌘→" tag:0];
-    [m addAction:@selector(moveToLeftEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘←" tag:0];
-    [m addAction:@selector(moveToRightEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘→" tag:0];
-    [m addAction:@selector(scrollPageUp:) forKeyEquivalent:@"⇞" tag:0];
-    [m addAction:@selector(scrollPageDown:) forKeyEquivalent:@"⇟" tag:0];
-    [m addAction:@selector(scrollToBeginningOfDocument:) forKeyEquivalent:@"↖" tag:0];
-    [m addAction:@selector(scrollToEndOfDocument:) forKeyEquivalent:@"↘" tag:0];
-    [m addAction:@selector(transpose:) forKeyEquivalent:@"⌃T" tag:0];
-    [m addAction:@selector(transposeWords:) forKeyEquivalent:@"⌥T" tag:0];
-    [m addAction:@selector(selectAll:) forKeyEquivalent:@"⌘A" tag:0];
-    [m addAction:@selector(insertNewline:) forKeyEquivalent:@"⌃O" tag:0];
-    [m addAction:@selector(deleteForward:) forKeyEquivalent:@"⌦" tag:0];
-    [m addAction:@selector(deleteBackward:) forKeyEquivalent:@"⌫" tag:0];
-    [m addAction:@selector(deleteWordForward:) forKeyEquivalent:@"⌥⌦" tag:0];
-    [m addAction:@selector(deleteWordBackward:) forKeyEquivalent:@"⌥⌫" tag:0];
-    [m addAction:@selector(deleteToEndOfLine:) forKeyEquivalent:@"⌃K" tag:0];
-    [m addAction:@selector(deleteToBeginningOfLine:) forKeyEquivalent:@"⌃W" tag:0];
-    [m addAction:@selector(yank:) forKeyEquivalent:@"⌃Y" tag:0];
-    [m addAction:@selector(setMark:) forKeyEquivalent:@"⌃Space" tag:0];
-    [m addAction:@selector(complete:) forKeyEquivalent:@"⌥⎋" tag:0];
-    [m addAction:@selector(cancelOperation:) forKeyEquivalent:@"⌘." tag:0];
-    [m updateWithCocoaTextKeyBindings];
+    [m performBatchUpdates:^{
+        [m addAction:@selector(moveForward:) forKeyEquivalent:@"⌃F" tag:0];
+        [m addAction:@selector(moveRight:) forKeyEquivalent:@"→" tag:0];
+        [m addAction:@selector(moveBackward:) forKeyEquivalent:@"⌃B" tag:0];
+        [m addAction:@selector(moveLeft:) forKeyEquivalent:@"←" tag:0];
+        [m addAction:@selector(moveUp:) forKeyEquivalent:@"↑" tag:0];
+        [m addAction:@selector(moveUp:) forKeyEquivalent:@"⌃P" tag:0];
+        [m addAction:@selector(moveDown:) forKeyEquivalent:@"↓" tag:0];
+        [m addAction:@selector(moveDown:) forKeyEquivalent:@"⌃N" tag:0];
+        [m addAction:@selector(moveWordForward:) forKeyEquivalent:@"⌥F" tag:0];
+        [m addAction:@selector(moveWordBackward:) forKeyEquivalent:@"⌥B" tag:0];
+        [m addAction:@selector(moveToBeginningOfLine:) forKeyEquivalent:@"⌃A" tag:0];
+        [m addAction:@selector(moveToEndOfLine:) forKeyEquivalent:@"⌃E" tag:0];
+        [m addAction:@selector(moveToEndOfDocument:) forKeyEquivalent:@"⌘↓" tag:0];
+        [m addAction:@selector(moveToBeginningOfDocument:) forKeyEquivalent:@"⌘↑" tag:0];
+        [m addAction:@selector(pageDown:) forKeyEquivalent:@"⌃V" tag:0];
+        [m addAction:@selector(pageUp:) forKeyEquivalent:@"⌥V" tag:0];
+        [m addAction:@selector(centerSelectionInVisibleArea:) forKeyEquivalent:@"⌃L" tag:0];
+        [m addAction:@selector(moveBackwardAndModifySelection:) forKeyEquivalent:@"⇧⌃B" tag:0];
+        [m addAction:@selector(moveForwardAndModifySelection:) forKeyEquivalent:@"⇧⌃F" tag:0];
+        [m addAction:@selector(moveWordForwardAndModifySelection:) forKeyEquivalent:@"⇧⌥F" tag:0];
+        [m addAction:@selector(moveWordBackwardAndModifySelection:) forKeyEquivalent:@"⇧⌥B" tag:0];
+        [m addAction:@selector(moveUpAndModifySelection:) forKeyEquivalent:@"⇧↑" tag:0];
+        [m addAction:@selector(moveUpAndModifySelection:) forKeyEquivalent:@"⇧⌃P" tag:0];
+        [m addAction:@selector(moveDownAndModifySelection:) forKeyEquivalent:@"⇧↓" tag:0];
+        [m addAction:@selector(moveDownAndModifySelection:) forKeyEquivalent:@"⇧⌃N" tag:0];
+        [m addAction:@selector(moveToBeginningOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌃A" tag:0];
+        [m addAction:@selector(moveToBeginningOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘←" tag:0];
+        [m addAction:@selector(moveToEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌃E" tag:0];
+        [m addAction:@selector(moveToEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘→" tag:0];
+        [m addAction:@selector(moveToEndOfDocumentAndModifySelection:) forKeyEquivalent:@"⇧⌘↓" tag:0];
+        [m addAction:@selector(moveToBeginningOfDocumentAndModifySelection:) forKeyEquivalent:@"⇧⌘↑" tag:0];
+        [m addAction:@selector(pageDownAndModifySelection:) forKeyEquivalent:@"⇧⌃V" tag:0];
+        [m addAction:@selector(pageUpAndModifySelection:) forKeyEquivalent:@"⇧⌥V" tag:0];
+        [m addAction:@selector(moveWordRight:) forKeyEquivalent:@"⌥→" tag:0];
+        [m addAction:@selector(moveWordLeft:) forKeyEquivalent:@"⌥←" tag:0];
+        [m addAction:@selector(moveRightAndModifySelection:) forKeyEquivalent:@"⇧→" tag:0];
+        [m addAction:@selector(moveLeftAndModifySelection:) forKeyEquivalent:@"⇧←" tag:0];
+        [m addAction:@selector(moveWordRightAndModifySelection:) forKeyEquivalent:@"⇧⌥→" tag:0];
+        [m addAction:@selector(moveWordLeftAndModifySelection:) forKeyEquivalent:@"⇧⌥←" tag:0];
+        [m addAction:@selector(moveToLeftEndOfLine:) forKeyEquivalent:@"⌘←" tag:0];
+        [m addAction:@selector(moveToRightEndOfLine:) forKeyEquivalent:@"⌘→" tag:0];
+        [m addAction:@selector(moveToLeftEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘←" tag:0];
+        [m addAction:@selector(moveToRightEndOfLineAndModifySelection:) forKeyEquivalent:@"⇧⌘→" tag:0];
+        [m addAction:@selector(scrollPageUp:) forKeyEquivalent:@"⇞" tag:0];
+        [m addAction:@selector(scrollPageDown:) forKeyEquivalent:@"⇟" tag:0];
+        [m addAction:@selector(scrollToBeginningOfDocument:) forKeyEquivalent:@"↖" tag:0];
+        [m addAction:@selector(scrollToEndOfDocument:) forKeyEquivalent:@"↘" tag:0];
+        [m addAction:@selector(transpose:) forKeyEquivalent:@"⌃T" tag:0];
+        [m addAction:@selector(transposeWords:) forKeyEquivalent:@"⌥T" tag:0];
+        [m addAction:@selector(selectAll:) forKeyEquivalent:@"⌘A" tag:0];
+        [m addAction:@selector(insertNewline:) forKeyEquivalent:@"⌃O" tag:0];
+        [m addAction:@selector(deleteForward:) forKeyEquivalent:@"⌦" tag:0];
+        [m addAction:@selector(deleteBackward:) forKeyEquivalent:@"⌫" tag:0];
+        [m addAction:@selector(deleteWordForward:) forKeyEquivalent:@"⌥⌦" tag:0];
+        [m addAction:@selector(deleteWordBackward:) forKeyEquivalent:@"⌥⌫" tag:0];
+        [m addAction:@selector(deleteToEndOfLine:) forKeyEquivalent:@"⌃K" tag:0];
+        [m addAction:@selector(deleteToBeginningOfLine:) forKeyEquivalent:@"⌃W" tag:0];
+        [m addAction:@selector(yank:) forKeyEquivalent:@"⌃Y" tag:0];
+        [m addAction:@selector(setMark:) forKeyEquivalent:@"⌃Space" tag:0];
+        [m addAction:@selector(complete:) forKeyEquivalent:@"⌥⎋" tag:0];
+        [m addAction:@selector(cancelOperation:) forKeyEquivalent:@"⌘." tag:0];
+        [m updateWithCocoaTextKeyBindings];
+    }];
     return m;
 }
 
 + (SRLocalShortcutMonitor *)mainMenuShortcuts
 {
     SRLocalShortcutMonitor *m = [SRLocalShortcutMonitor new];
-    [m addAction:@selector(hide:) forKeyEquivalent:@"⌘H" tag: 0];
-    [m addAction:@selector(hideOtherApplications:) forKeyEquivalent:@"⌥⌘H" tag: 0];
-    [m addAction:@selector(terminate:) forKeyEquivalent:@"⌘Q" tag: 0];
-    [m addAction:@selector(newDocument:) forKeyEquivalent:@"⌘N" tag:0];
-    [m addAction:@selector(openDocument:) forKeyEquivalent:@"⌘O" tag:0];
-    [m addAction:@selector(performClose:) forKeyEquivalent:@"⌘W" tag:0];
-    [m addAction:@selector(saveDocument:) forKeyEquivalent:@"⌘S" tag:0];
-    [m addAction:@selector(saveDocumentAs:) forKeyEquivalent:@"⇧⌘S" tag:0];
-    [m addAction:@selector(revertDocumentToSaved:) forKeyEquivalent:@"⌘R" tag:0];
-    [m addAction:@selector(runPageLayout:) forKeyEquivalent:@"⇧⌘P" tag:0];
-    [m addAction:@selector(print:) forKeyEquivalent:@"⌘P" tag:0];
-    [m addAction:@selector(undo:) forKeyEquivalent:@"⌘Z" tag:0];
-    [m addAction:@selector(redo:) forKeyEquivalent:@"⇧⌘Z" tag:0];
-    [m addAction:@selector(cut:) forKeyEquivalent:@"⌘X" tag:0];
-    [m addAction:@selector(copy:) forKeyEquivalent:@"⌘C" tag:0];
-    [m addAction:@selector(paste:) forKeyEquivalent:@"⌘V" tag:0];
-    [m addAction:@selector(pasteAsPlainText:) forKeyEquivalent:@"⌥⇧⌘V" tag:0];
-    [m addAction:@selector(selectAll:) forKeyEquivalent:@"⌘A" tag:0];
-    [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌘F" tag:NSTextFinderActionShowFindInterface];
-    [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌥⌘F" tag:NSTextFinderActionShowReplaceInterface];
-    [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌘G" tag:NSTextFinderActionNextMatch];
-    [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⇧⌘G" tag:NSTextFinderActionPreviousMatch];
-    [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌘E" tag:NSTextFinderActionSetSearchString];
-    [m addAction:@selector(centerSelectionInVisibleArea:) forKeyEquivalent:@"⌘J" tag:0];
-    [m addAction:@selector(showGuessPanel:) forKeyEquivalent:@"⇧⌘;" tag:0];
-    [m addAction:@selector(checkSpelling:) forKeyEquivalent:@"⌘;" tag:0];
-    [m addAction:@selector(orderFrontFontPanel:) forKeyEquivalent:@"⌘T" tag:0];
-    [m addAction:@selector(addFontTrait:) forKeyEquivalent:@"⌘B" tag:NSBoldFontMask];
-    [m addAction:@selector(addFontTrait:) forKeyEquivalent:@"⌘I" tag:NSItalicFontMask];
-    [m addAction:@selector(underline:) forKeyEquivalent:@"⌘U" tag:0];
-    [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⌘=" tag:NSSizeUpFontAction];
-    [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⇧⌘=" tag:NSSizeUpFontAction];
-    [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⌘-" tag:NSSizeDownFontAction];
-    [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⇧⌘-" tag:NSSizeDownFontAction];
-    [m addAction:@selector(orderFrontColorPanel:) forKeyEquivalent:@"⇧⌘C" tag:0];
-    [m addAction:@selector(copyFont:) forKeyEquivalent:@"⌥⌘C" tag:0];
-    [m addAction:@selector(pasteFont:) forKeyEquivalent:@"⌥⌘V" tag:0];
-    [m addAction:@selector(alignLeft:) forKeyEquivalent:@"⇧⌘[" tag:0];
-    [m addAction:@selector(alignCenter:) forKeyEquivalent:@"⇧⌘\\" tag:0];
-    [m addAction:@selector(alignRight:) forKeyEquivalent:@"⇧⌘]" tag:0];
-    [m addAction:@selector(copyRuler:) forKeyEquivalent:@"⌃⌘C" tag:0];
-    [m addAction:@selector(pasteRuler:) forKeyEquivalent:@"⌃⌘V" tag:0];
-    [m addAction:@selector(toggleToolbarShown:) forKeyEquivalent:@"⌥⌘T" tag:0];
-    [m addAction:@selector(toggleSidebar:) forKeyEquivalent:@"⌃⌘S" tag:0];
-    [m addAction:@selector(toggleFullScreen:) forKeyEquivalent:@"⌃⌘F" tag:0];
-    [m addAction:@selector(performMiniaturize:) forKeyEquivalent:@"⌘M" tag:0];
-    [m addAction:@selector(showHelp:) forKeyEquivalent:@"⇧⌘/" tag:0];
+    [m performBatchUpdates:^{
+        [m addAction:@selector(hide:) forKeyEquivalent:@"⌘H" tag: 0];
+        [m addAction:@selector(hideOtherApplications:) forKeyEquivalent:@"⌥⌘H" tag: 0];
+        [m addAction:@selector(terminate:) forKeyEquivalent:@"⌘Q" tag: 0];
+        [m addAction:@selector(newDocument:) forKeyEquivalent:@"⌘N" tag:0];
+        [m addAction:@selector(openDocument:) forKeyEquivalent:@"⌘O" tag:0];
+        [m addAction:@selector(performClose:) forKeyEquivalent:@"⌘W" tag:0];
+        [m addAction:@selector(saveDocument:) forKeyEquivalent:@"⌘S" tag:0];
+        [m addAction:@selector(saveDocumentAs:) forKeyEquivalent:@"⇧⌘S" tag:0];
+        [m addAction:@selector(revertDocumentToSaved:) forKeyEquivalent:@"⌘R" tag:0];
+        [m addAction:@selector(runPageLayout:) forKeyEquivalent:@"⇧⌘P" tag:0];
+        [m addAction:@selector(print:) forKeyEquivalent:@"⌘P" tag:0];
+        [m addAction:@selector(undo:) forKeyEquivalent:@"⌘Z" tag:0];
+        [m addAction:@selector(redo:) forKeyEquivalent:@"⇧⌘Z" tag:0];
+        [m addAction:@selector(cut:) forKeyEquivalent:@"⌘X" tag:0];
+        [m addAction:@selector(copy:) forKeyEquivalent:@"⌘C" tag:0];
+        [m addAction:@selector(paste:) forKeyEquivalent:@"⌘V" tag:0];
+        [m addAction:@selector(pasteAsPlainText:) forKeyEquivalent:@"⌥⇧⌘V" tag:0];
+        [m addAction:@selector(selectAll:) forKeyEquivalent:@"⌘A" tag:0];
+        [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌘F" tag:NSTextFinderActionShowFindInterface];
+        [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌥⌘F" tag:NSTextFinderActionShowReplaceInterface];
+        [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌘G" tag:NSTextFinderActionNextMatch];
+        [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⇧⌘G" tag:NSTextFinderActionPreviousMatch];
+        [m addAction:@selector(performTextFinderAction:) forKeyEquivalent:@"⌘E" tag:NSTextFinderActionSetSearchString];
+        [m addAction:@selector(centerSelectionInVisibleArea:) forKeyEquivalent:@"⌘J" tag:0];
+        [m addAction:@selector(showGuessPanel:) forKeyEquivalent:@"⇧⌘;" tag:0];
+        [m addAction:@selector(checkSpelling:) forKeyEquivalent:@"⌘;" tag:0];
+        [m addAction:@selector(orderFrontFontPanel:) forKeyEquivalent:@"⌘T" tag:0];
+        [m addAction:@selector(addFontTrait:) forKeyEquivalent:@"⌘B" tag:NSBoldFontMask];
+        [m addAction:@selector(addFontTrait:) forKeyEquivalent:@"⌘I" tag:NSItalicFontMask];
+        [m addAction:@selector(underline:) forKeyEquivalent:@"⌘U" tag:0];
+        [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⌘=" tag:NSSizeUpFontAction];
+        [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⇧⌘=" tag:NSSizeUpFontAction];
+        [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⌘-" tag:NSSizeDownFontAction];
+        [m addAction:@selector(modifyFont:) forKeyEquivalent:@"⇧⌘-" tag:NSSizeDownFontAction];
+        [m addAction:@selector(orderFrontColorPanel:) forKeyEquivalent:@"⇧⌘C" tag:0];
+        [m addAction:@selector(copyFont:) forKeyEquivalent:@"⌥⌘C" tag:0];
+        [m addAction:@selector(pasteFont:) forKeyEquivalent:@"⌥⌘V" tag:0];
+        [m addAction:@selector(alignLeft:) forKeyEquivalent:@"⇧⌘[" tag:0];
+        [m addAction:@selector(alignCenter:) forKeyEquivalent:@"⇧⌘\\" tag:0];
+        [m addAction:@selector(alignRight:) forKeyEquivalent:@"⇧⌘]" tag:0];
+        [m addAction:@selector(copyRuler:) forKeyEquivalent:@"⌃⌘C" tag:0];
+        [m addAction:@selector(pasteRuler:) forKeyEquivalent:@"⌃⌘V" tag:0];
+        [m addAction:@selector(toggleToolbarShown:) forKeyEquivalent:@"⌥⌘T" tag:0];
+        [m addAction:@selector(toggleSidebar:) forKeyEquivalent:@"⌃⌘S" tag:0];
+        [m addAction:@selector(toggleFullScreen:) forKeyEquivalent:@"⌃⌘F" tag:0];
+        [m addAction:@selector(performMiniaturize:) forKeyEquivalent:@"⌘M" tag:0];
+        [m addAction:@selector(showHelp:) forKeyEquivalent:@"⇧⌘/" tag:0];
+    }];
     return m;
 }
 
@@ -1587,22 +4699,36 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
 
 - (BOOL)handleEvent:(NSEvent *)anEvent withTarget:(nullable id)aTarget
 {
-    SRShortcut *shortcut = [SRShortcut shortcutWithEvent:anEvent ignoringCharacters:YES];
-    if (!shortcut)
+    __auto_type eventType = anEvent.type;
+    __auto_type keyCode = (SRKeyCode)anEvent.keyCode;
+    __auto_type modifierFlags = anEvent.modifierFlags;
+
+    switch (eventType)
     {
-        os_trace_error("#Error Not a keyboard event");
-        return NO;
+        case NSEventTypeKeyDown:
+        case NSEventTypeKeyUp:
+            break;
+        case NSEventTypeFlagsChanged:
+            // Match +[SRShortcut shortcutWithEvent:ignoringCharacters:].
+            modifierFlags |= _SRModifierFlagForKeyCode(keyCode);
+            keyCode = SRKeyCodeNone;
+            break;
+        default:
+            os_trace_error("#Error Not a keyboard event");
+            return NO;
     }
 
-    __auto_type actions = [self enabledActionsForShortcut:shortcut keyEvent:anEvent.SR_keyEventType];
-    __block BOOL isHandled = NO;
-    [actions enumerateObjectsWithOptions:NSEnumerationReverse
-                              usingBlock:^(SRShortcutAction *obj, NSUInteger idx, BOOL *stop)
-    {
-        *stop = isHandled = [obj performActionOnTarget:aTarget];
-    }];
+    __auto_type keyEventType = anEvent.SR_keyEventType;
+    if (keyEventType != SRKeyEventTypeDown && keyEventType != SRKeyEventTypeUp)
+        return NO;
 
-    return isHandled;
+    __auto_type key = _SRShortcutKeyMake(keyCode, modifierFlags, keyEventType);
+
+    // isARepeat raises for FlagsChanged.
+    if (eventType == NSEventTypeKeyDown && anEvent.isARepeat)
+        key |= SRCoreShortcutKeyRepeatMask;
+
+    return [self _performActionsForKey:key time:mach_absolute_time() onTarget:aTarget];
 }
 
 - (void)updateWithCocoaTextKeyBindings
@@ -1613,42 +4739,69 @@ CGEventRef _Nullable _SRQuartzEventHandler(CGEventTapProxy aProxy, CGEventType a
     NSMutableDictionary *keyBindings = [systemKeyBindings mutableCopy];
     [keyBindings addEntriesFromDictionary:userKeyBindings];
 
-    @synchronized (_actions)
-    {
-        [keyBindings enumerateKeysAndObjectsUsingBlock:^(NSString *aKey, id aValue, BOOL *aStop) {
-            if (![aKey isKindOfClass:NSString.class] || !aKey.length)
-                return;
+    [self performBatchUpdates:^{
+        [self _addCocoaTextKeyBindings:keyBindings withPrefix:@[]];
+    }];
+}
 
-            SRShortcut *shortcut = [SRShortcut shortcutWithKeyBinding:aKey];
-            if (!shortcut)
-                return;
+#pragma mark Private
+
+/*!
+ @param aPrefix Shortcuts of the enclosing dictionaries: nested dictionaries define multi-key bindings.
+ */
+- (void)_addCocoaTextKeyBindings:(NSDictionary *)aKeyBindings withPrefix:(NSArray<SRShortcut *> *)aPrefix
+{
+    [aKeyBindings enumerateKeysAndObjectsUsingBlock:^(NSString *aKey, id aValue, BOOL *aStop) {
+        if (![aKey isKindOfClass:NSString.class] || !aKey.length)
+            return;
+
+        SRShortcut *shortcut = [SRShortcut shortcutWithKeyBinding:aKey];
+        if (!shortcut)
+            return;
 
-            if (![aValue isKindOfClass:NSArray.class])
-                aValue = @[aValue];
+        if ([aValue isKindOfClass:NSDictionary.class])
+        {
+            [self _addCocoaTextKeyBindings:aValue withPrefix:[aPrefix arrayByAddingObject:shortcut]];
+            return;
+        }
+        else if (![aValue isKindOfClass:NSArray.class])
+            aValue = @[aValue];
 
-            for (NSString *keyBinding in (NSArray *)aValue)
+        for (NSString *keyBinding in (NSArray *)aValue)
+        {
+            if (![keyBinding isKindOfClass:NSString.class])
+                continue;
+            else if (!keyBinding.length || [keyBinding isEqualToString:@"noop:"])
             {
-                if (![keyBinding isKindOfClass:NSString.class])
+                if (aPrefix.count)
                     continue;
-                else if (!keyBinding.length || [keyBinding isEqualToString:@"noop:"])
+
+                // Only remove actions with static shortcuts.
+                // The snapshot is not published until the batch completes: read the table directly.
+                NSUInteger count = 0;
+                __auto_type tableActions = [self->_enabledActionsTable actionsForKey:_SRShortcutKeyMakeWithShortcut(shortcut, SRKeyEventTypeDown)
+                                                                               count:&count];
+                __auto_type actions = count ? [NSArray arrayWithObjects:tableActions count:count] : @[];
+                for (SRShortcutAction *action in actions)
                 {
-                    // Only remove actions with static shortcuts.
-                    __auto_type actions = [self->_shortcutToEnabledKeyDownActions objectForKey:shortcut];
-                    NSIndexSet *actionsToRemove = [actions indexesOfObjectsPassingTest:^BOOL(SRShortcutAction *obj, NSUInteger idx, BOOL *stop) {
-                        return obj.observedObject == nil;
-                    }];
-                    [actions removeObjectsAtIndexes:actionsToRemove];
+                    if (action.observedObject == nil)
+                        [self removeAction:action forKeyEvent:SRKeyEventTypeDown];
                 }
-                else
-                    [self addAction:[SRShortcutAction shortcutActionWithShortcut:shortcut target:nil action:NSSelectorFromString(aValue) tag:0]
-                        forKeyEvent:SRKeyEventTypeDown];
             }
-        }];
-    }
+            else if (aPrefix.count)
+            {
+                [self addAction:[SRShortcutAction shortcutActionWithShortcut:shortcut target:nil action:NSSelectorFromString(keyBinding) tag:0]
+                forShortcutSequence:[aPrefix arrayByAddingObject:shortcut]];
+            }
+            else
+            {
+                [self addAction:[SRShortcutAction shortcutActionWithShortcut:shortcut target:nil action:NSSelectorFromString(keyBinding) tag:0]
+                    forKeyEvent:SRKeyEventTypeDown];
+            }
+        }
+    }];
 }
 
-#pragma mark Private
-
 + (NSDictionary<NSString *, id> *)_parseSystemKeyBindings
 {
     NSBundle *appKitBundle = [NSBundle bundleWithIdentifier:@"com.apple.AppKit"];
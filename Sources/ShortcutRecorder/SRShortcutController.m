@@ -41,16 +41,6 @@ SRShortcutControllerKeyPath const SRShortcutControllerKeyPathLiteralModifierFlag
 SRShortcutControllerKeyPath const SRShortcutControllerKeyPathSymbolicModifierFlags = @"selection.symbolicModifierFlags";
 
 
-static void _onSelectedKeyboardInputSourceChange(CFNotificationCenterRef aCenter,
-                                                 void *anObserver,
-                                                 CFNotificationName aName,
-                                                 const void *anObject,
-                                                 CFDictionaryRef aUserInfo)
-{
-    [(__bridge SRShortcutController *)anObserver onSelectedKeyboardInputSourceObserverChange];
-}
-
-
 @implementation SRShortcutController
 {
     NSString *_keyEquivalent;
@@ -63,6 +53,7 @@ static void _onSelectedKeyboardInputSourceChange(CFNotificationCenterRef aCenter
     NSString *_symbolicModifierFlags;
 
     BOOL _isSelectedKeyboardInputSourceObserved;
+    NSUInteger _inputSourceGeneration;
 
     __weak SRRecorderControl *_recorderControl;
 }
@@ -171,12 +162,10 @@ static void _onSelectedKeyboardInputSourceChange(CFNotificationCenterRef aCenter
     if (_isSelectedKeyboardInputSourceObserved)
         return;
 
-    CFNotificationCenterAddObserver(CFNotificationCenterGetDistributedCenter(),
-                                    (__bridge const void *)(self),
-                                    _onSelectedKeyboardInputSourceChange,
-                                    kTISNotifySelectedKeyboardInputSourceChanged,
-                                    NULL,
-                                    CFNotificationSuspensionBehaviorCoalesce);
+    [NSNotificationCenter.defaultCenter addObserver:self
+                                           selector:@selector(_onInputSourceDidChange:)
+                                               name:SRKeyCodeTransformerInputSourceDidChangeNotification
+                                             object:nil];
     _isSelectedKeyboardInputSourceObserved = YES;
 }
 
@@ -185,10 +174,9 @@ static void _onSelectedKeyboardInputSourceChange(CFNotificationCenterRef aCenter
     if (!_isSelectedKeyboardInputSourceObserved)
         return;
 
-    CFNotificationCenterRemoveObserver(CFNotificationCenterGetDistributedCenter(),
-                                       (__bridge const void *)(self),
-                                       kTISNotifySelectedKeyboardInputSourceChanged,
-                                       NULL);
+    [NSNotificationCenter.defaultCenter removeObserver:self
+                                                  name:SRKeyCodeTransformerInputSourceDidChangeNotification
+                                                object:nil];
     _isSelectedKeyboardInputSourceObserved = NO;
 }
 
@@ -212,6 +200,7 @@ static void _onSelectedKeyboardInputSourceChange(CFNotificationCenterRef aCenter
 
 - (void)updateComputedKeyPaths
 {
+    _inputSourceGeneration = SRKeyCodeTransformer.inputSourceGeneration;
     NSNumber *keyCode = [self valueForKeyPath:@"selection.keyCode"];
 
     if (NSIsControllerMarker(keyCode))
@@ -243,6 +232,15 @@ static void _onSelectedKeyboardInputSourceChange(CFNotificationCenterRef aCenter
     }
 }
 
+- (void)_onInputSourceDidChange:(NSNotification *)aNotification
+{
+    // Computed values are already up to date.
+    if (_inputSourceGeneration == SRKeyCodeTransformer.inputSourceGeneration)
+        return;
+
+    [self onSelectedKeyboardInputSourceObserverChange];
+}
+
 - (void)_updateRecorderControlValueBinding
 {
     __auto_type strongRecorderControl = _recorderControl;
@@ -30,6 +30,32 @@ NS_SWIFT_UNAVAILABLE("use SRLiteralKeyCodeTransformer / SRSymbolicKeyCodeTransfo
  */
 @property (class, readonly) NSArray<NSNumber *> *knownKeyCodes;
 
+/*!
+ Whether the key code is on the numeric keypad, e.g. SRKeyCodeKeypad1 or SRKeyCodeKeypadEnter.
+ */
++ (BOOL)isKeypadKeyCode:(SRKeyCode)aValue;
+
+/*!
+ Key code of the numeric keypad key that produces the same character, e.g. SRKeyCodeKeypad1 for SRKeyCode1.
+
+ @return SRKeyCodeNone if the numeric keypad has no such key.
+ */
++ (SRKeyCode)keypadKeyCodeForKeyCode:(SRKeyCode)aValue;
+
+/*!
+ Incremented whenever the selected keyboard input source changes.
+
+ @discussion
+ Caches of transformed values may compare it instead of the input source itself.
+
+ Changes are observed via the main run loop. When it is not running, e.g. in a command line tool,
+ the generation does not change and shared transformers query the selected input source again
+ once their cached one is older than 100ms.
+
+ @seealso SRKeyCodeTransformerInputSourceDidChangeNotification
+ */
+@property (class, readonly) NSUInteger inputSourceGeneration;
+
 /*!
  The input source used by the transformer.
 
@@ -50,6 +76,24 @@ NS_SWIFT_UNAVAILABLE("use SRLiteralKeyCodeTransformer / SRSymbolicKeyCodeTransfo
                    explicitModifierFlags:(NSEventModifierFlags)anExplicitModifierFlags
                          layoutDirection:(NSUserInterfaceLayoutDirection)aDirection;
 
+/*!
+ Whether the key code starts a compose sequence when pressed with the modifier flags, like Option-E in the U.S. English input source.
+ */
+- (BOOL)isDeadKeyCode:(SRKeyCode)aValue withModifierFlags:(NSEventModifierFlags)aModifierFlags;
+
+/*!
+ Return literal string the key code produces when pressed after the dead key, e.g. é for E after Option-E.
+
+ @param anImplicitModifierFlags Either none or Shift.
+
+ @discussion
+ Compose sequences are tabulated once per input source.
+ */
+- (nullable NSString *)literalForKeyCode:(SRKeyCode)aValue
+               withImplicitModifierFlags:(NSEventModifierFlags)anImplicitModifierFlags
+                        afterDeadKeyCode:(SRKeyCode)aDeadKeyCode
+            deadKeyImplicitModifierFlags:(NSEventModifierFlags)aDeadKeyImplicitModifierFlags;
+
 /*!
  Return symbolic string for the given key code, modifier flags and layout direction.
  */
@@ -103,6 +147,20 @@ NS_SWIFT_NAME(SymbolicKeyCodeTransformer)
  */
 NS_SWIFT_NAME(ASCIILiteralKeyCodeTransformer)
 @interface SRASCIILiteralKeyCodeTransformer : SRKeyCodeTransformer
+
+/*!
+ Reverse transform the literal, including characters that only modified keys produce.
+
+ @param outImplicitModifierFlags Modifier flags the literal implies, like Shift in ! in the U.S. English input source.
+
+ @discussion
+ Unmodified keys are preferred: both a and A are transformed into SRKeyCodeA without implicit modifier flags.
+ Characters of modified keys are only considered if outImplicitModifierFlags is not NULL.
+ -reverseTransformedValue: passes NULL: it transforms ! into nil rather than into SRKeyCode1 without Shift.
+ */
+- (nullable NSNumber *)reverseTransformedValue:(nullable NSString *)aValue
+                         implicitModifierFlags:(nullable NSEventModifierFlags *)outImplicitModifierFlags;
+
 @end
 
 
@@ -116,6 +174,15 @@ NS_SWIFT_NAME(ASCIISymbolicKeyCodeTransformer)
 @end
 
 
+/*!
+ Posted on the main thread after the selected keyboard input source changes and inputSourceGeneration is incremented.
+
+ @discussion
+ Observing starts with the first use of a shared transformer or inputSourceGeneration.
+ */
+extern NSNotificationName const SRKeyCodeTransformerInputSourceDidChangeNotification;
+
+
 @interface SRKeyCodeTransformer (Deprecated)
 @property (class, readonly) NSDictionary<NSNumber *, NSString *> *specialKeyCodeToSymbolMapping;
 @property (class, readonly) NSDictionary<NSNumber *, NSString *> *specialKeyCodeToLiteralMapping;
@@ -90,6 +90,9 @@ NS_SWIFT_NAME(Shortcut)
 
 /*!
  Initialize the shortcut from a left-to-right ASCII key code and symbolic modifier flags e.g. @"⇧⌘A".
+
+ @discussion
+ Characters of modified keys add their modifier flags, e.g. @"⌘!" is equal to @"⇧⌘1" in the U.S. English input source.
  */
 + (nullable instancetype)shortcutWithKeyEquivalent:(NSString *)aKeyEquivalent;
 
@@ -31,6 +31,42 @@ NS_SWIFT_NAME(ShortcutActionTarget)
 @protocol SRShortcutActionTarget;
 
 
+/*!
+ How the action reacts to the key repeats of a held shortcut.
+
+ @const SRShortcutActionRepeatPolicyPerform Every repeat performs the action.
+ @const SRShortcutActionRepeatPolicyIgnore Only the physical press performs the action.
+ @const SRShortcutActionRepeatPolicyThrottle Repeats perform the action at most once per repeatInterval.
+ @const SRShortcutActionRepeatPolicyCoalesce Like throttle, but the number of repeats since the previous perform
+        is available from repeatCount.
+
+ @discussion
+ Skipped repeats are reported as handled if the most recent perform was.
+ */
+typedef NS_CLOSED_ENUM(NSUInteger, SRShortcutActionRepeatPolicy)
+{
+    SRShortcutActionRepeatPolicyPerform = 0,
+    SRShortcutActionRepeatPolicyIgnore,
+    SRShortcutActionRepeatPolicyThrottle,
+    SRShortcutActionRepeatPolicyCoalesce
+} NS_SWIFT_NAME(SRShortcutAction.RepeatPolicy);
+
+
+/*!
+ Priority class of an action among the actions of the same shortcut.
+
+ @discussion
+ Monitors try actions of a higher priority first. Within a priority the most recently added action is tried first.
+ */
+typedef NSInteger SRShortcutActionPriority NS_TYPED_EXTENSIBLE_ENUM NS_SWIFT_NAME(SRShortcutAction.Priority);
+
+extern const SRShortcutActionPriority SRShortcutActionPriorityApplication NS_SWIFT_NAME(application);
+
+extern const SRShortcutActionPriority SRShortcutActionPriorityDocument NS_SWIFT_NAME(document);
+
+extern const SRShortcutActionPriority SRShortcutActionPriorityWindow NS_SWIFT_NAME(window);
+
+
 /*!
  A connection between a shortcut and an action.
 
@@ -137,6 +173,42 @@ NS_SWIFT_NAME(ShortcutAction)
  */
 @property (getter=isEnabled) BOOL enabled;
 
+/*!
+ How the action reacts when monitors see key repeats of the shortcut.
+
+ @discussion
+ Defaults to SRShortcutActionRepeatPolicyPerform. Calling -performActionOnTarget: directly is never a repeat.
+
+ SRGlobalShortcutMonitor never sees repeats: the system does not repeat hot keys.
+ */
+@property SRShortcutActionRepeatPolicy repeatPolicy;
+
+/*!
+ Minimum interval between performs for the throttle and coalesce policies.
+
+ @discussion
+ Defaults to 0.1 seconds.
+ */
+@property NSTimeInterval repeatInterval;
+
+/*!
+ Number of key repeats delivered by the current perform.
+
+ @discussion
+ 0 for the physical press. With SRShortcutActionRepeatPolicyCoalesce it includes the skipped repeats.
+ Only meaningful while the action is performed.
+ */
+@property (readonly) NSUInteger repeatCount;
+
+/*!
+ Priority class of the action.
+
+ @discussion
+ Defaults to SRShortcutActionPriorityApplication. Changing the priority reorders the action in its monitors
+ without changing its recency within the priority.
+ */
+@property SRShortcutActionPriority priority;
+
 /*!
  Configure the autoupdating shortcut by observing the given key path of the given object.
 
@@ -212,6 +284,67 @@ typedef NS_CLOSED_ENUM(NSUInteger, SRKeyEventType)
 @end
 
 
+/*!
+ What the monitor does with a key event when its action queue is full.
+
+ @const SRShortcutMonitorOverflowPolicyDiscard The event is considered handled and its actions are not performed.
+ @const SRShortcutMonitorOverflowPolicyPassThrough The event is not handled and is passed to the next handler.
+ */
+typedef NS_CLOSED_ENUM(NSUInteger, SRShortcutMonitorOverflowPolicy)
+{
+    SRShortcutMonitorOverflowPolicyDiscard = 0,
+    SRShortcutMonitorOverflowPolicyPassThrough
+} NS_SWIFT_NAME(ShortcutMonitor.OverflowPolicy);
+
+
+/*!
+ Point-in-time copy of the metrics of a shortcut monitor.
+
+ @discussion
+ Metrics are collected unless the library is compiled with SR_SHORTCUT_MONITOR_METRICS set to 0,
+ in which case all values are zero.
+
+ Latency histograms have 32 buckets: the bucket i counts durations within [2^i, 2^(i + 1)) nanoseconds.
+ The last bucket also counts all longer durations.
+ */
+NS_SWIFT_NAME(ShortcutMonitor.Metrics)
+@interface SRShortcutMonitorMetrics : NSObject
+
+/*!
+ Number of key events passed to the monitor.
+ */
+@property (readonly) uint64_t seenEventCount;
+
+/*!
+ Number of key events with enabled actions.
+ */
+@property (readonly) uint64_t matchedEventCount;
+
+/*!
+ Number of key events reported as handled.
+ */
+@property (readonly) uint64_t consumedEventCount;
+
+/*!
+ Durations of looking up actions for key events.
+ */
+@property (readonly) NSArray<NSNumber *> *lookupLatencyHistogram;
+
+/*!
+ Durations of performing actions for key events.
+ */
+@property (readonly) NSArray<NSNumber *> *actionLatencyHistogram;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/*!
+ Number of key events with enabled actions for the shortcut.
+ */
+- (uint64_t)fireCountForShortcut:(SRShortcut *)aShortcut keyEvent:(SRKeyEventType)aKeyEvent NS_SWIFT_NAME(fireCount(forShortcut:keyEvent:));
+
+@end
+
+
 /*!
  Base class for the SRGlobalShortcutMonitor and SRLocalShortcutMonitor.
 
@@ -219,8 +352,8 @@ typedef NS_CLOSED_ENUM(NSUInteger, SRKeyEventType)
  Observes shortcuts assigned to actions and automatically rearranges internal storage.
 
  The monitor supports multiple actions associated with the same shortcut. When that happens,
- the monitor attempts to perform the most recent action that claimed the shortcut. If it fails,
- it tries the next most recent one and so on until either the action is succesfully performed or the list
+ the monitor attempts to perform the most recent action of the highest priority that claimed the shortcut.
+ If it fails, it tries the next one and so on until either the action is succesfully performed or the list
  of candidates is exhausted.
 
  There are two key events supported by the monitor: key down and key up.
@@ -244,6 +377,40 @@ NS_SWIFT_NAME(ShortcutMonitor)
  */
 @property (copy, readonly) NSArray<SRShortcut *> *shortcuts;
 
+/*!
+ Queue to perform actions on. Defaults to nil.
+
+ @discussion
+ By default actions are performed synchronously by the event handler.
+
+ When set, the handler only decides whether the event is handled: it is if the shortcut has enabled actions.
+ The actions are put on a bounded queue and performed in order of events on the given dispatch queue. This keeps
+ the time spent in the handler short and predictable regardless of how long the actions take.
+
+ Setting the property resets the counters.
+ */
+@property (nullable) dispatch_queue_t actionQueue;
+
+/*!
+ What to do with a key event when the action queue is full. Defaults to SRShortcutMonitorOverflowPolicyDiscard.
+ */
+@property SRShortcutMonitorOverflowPolicy actionQueueOverflowPolicy;
+
+/*!
+ Current values of the monitor's counters and histograms.
+ */
+@property (readonly) SRShortcutMonitorMetrics *metrics;
+
+/*!
+ Number of key events whose actions were put on the action queue.
+ */
+@property (readonly) NSUInteger actionQueueEnqueuedCount;
+
+/*!
+ Number of key events whose actions did not fit into the action queue.
+ */
+@property (readonly) NSUInteger actionQueueOverflowCount;
+
 /*!
  All actions for a given key event in no particular order.
  */
@@ -253,7 +420,8 @@ NS_SWIFT_NAME(ShortcutMonitor)
  Enabled actions for a given shortcut and key event.
 
  @return
- Order is determined by the time of association such as that the last object is the most recently associated.
+ Ordered by priority and then by the time of association such as that the last object is
+ the most recently associated action of the highest priority.
  If the shortcut has no associated actions, returns an empty array.
  */
 - (NSArray<SRShortcutAction *> *)enabledActionsForShortcut:(SRShortcut *)aShortcut
@@ -263,7 +431,8 @@ NS_SWIFT_NAME(ShortcutMonitor)
  Add an action to the monitor for a key event.
 
  @discussion
- Adding the same action for the same event type again only changes its order by making it the most recent.
+ Adding the same action for the same event type again only changes its order by making it the most recent
+ within its priority.
  */
 - (void)addAction:(SRShortcutAction *)anAction forKeyEvent:(SRKeyEventType)aKeyEvent NS_SWIFT_NAME(addAction(_:forKeyEvent:));
 
@@ -278,10 +447,98 @@ NS_SWIFT_NAME(ShortcutMonitor)
 - (void)removeAction:(SRShortcutAction *)anAction NS_SWIFT_NAME(removeAction(_:));
 
 /*!
- Remove all actions from the monitor.
+ Remove all actions, including those of shortcut sequences, from the monitor.
  */
 - (void)removeAllActions;
 
+/*!
+ Maximum time between keystrokes of a shortcut sequence. Defaults to 1 second.
+
+ @throws NSInvalidArgumentException if the timeout is not positive.
+ */
+@property NSTimeInterval shortcutSequenceTimeout;
+
+/*!
+ Shortcut sequences that have associated actions.
+ */
+@property (readonly) NSArray<NSArray<SRShortcut *> *> *shortcutSequences;
+
+/*!
+ Add an action to perform when shortcuts of the sequence are pressed one after another, e.g. ⌃X ⌃S.
+
+ @param aSequence Two or more shortcuts.
+
+ @discussion
+ Sequences are compiled into a transition table: a keystroke costs one table lookup regardless of
+ the number of sequences. Keystrokes that continue a sequence are consumed and take precedence over
+ actions of the same shortcut. A sequence that is a prefix of another one shadows the latter.
+ An incomplete sequence is abandoned when the next keystroke does not continue it or comes later than
+ shortcutSequenceTimeout.
+
+ The shortcut of the action is ignored. Actions are performed on key down by the event handler,
+ bypassing the actionQueue.
+
+ @note Only SRLocalShortcutMonitor and SRAXGlobalShortcutMonitor match sequences.
+
+ @throws NSInvalidArgumentException if the sequence has less than 2 shortcuts.
+ */
+- (void)addAction:(SRShortcutAction *)anAction forShortcutSequence:(NSArray<SRShortcut *> *)aSequence NS_SWIFT_NAME(addAction(_:forShortcutSequence:));
+
+/*!
+ Remove an action, if present, from the shortcut sequence.
+ */
+- (void)removeAction:(SRShortcutAction *)anAction forShortcutSequence:(NSArray<SRShortcut *> *)aSequence NS_SWIFT_NAME(removeAction(_:forShortcutSequence:));
+
+/*!
+ Apply multiple additions and removals of actions as a single change.
+
+ @discussion
+ Observers of the actions and shortcuts properties are notified once. The will/did Add/Remove Shortcut
+ callbacks are made only for the net difference between the shortcuts before and after the updates.
+
+ Changes become visible to readers, including the block itself, once the outermost batch completes.
+ Batches may be nested.
+ */
+- (void)performBatchUpdates:(void (NS_NOESCAPE ^)(void))anUpdates NS_SWIFT_NAME(performBatchUpdates(_:));
+
+/*!
+ Start recording key events seen by the monitor into a binary trace file, replacing the current recording, if any.
+
+ @discussion
+ Every record holds the time since the start of the recording, the key code, the modifier flags,
+ the key event type, whether the event was an auto-repeat, whether the monitor handled it and how long that took.
+ Records are double-buffered and written on a background queue: recording neither allocates nor waits for the disk.
+ Records that arrive while the writer is a whole buffer behind are dropped.
+
+ @return NO if the file cannot be created.
+ */
+- (BOOL)startTraceRecordingToURL:(NSURL *)aURL error:(NSError * _Nullable *)outError NS_SWIFT_NAME(startTraceRecording(to:));
+
+/*!
+ Stop recording and write the remaining records.
+ */
+- (void)stopTraceRecording;
+
+/*!
+ Pass the key events of a trace to the monitor as if it received them from its event source.
+
+ @param outMismatchCount Number of events the monitor handled differently than recorded.
+
+ @discussion
+ Events are dispatched back to back on the calling thread, but the timeouts of shortcut sequences and the throttling
+ of auto-repeats follow the recorded timestamps rather than the system clock, so replays are faithful and deterministic.
+ The action queue and metrics work as with live events, which makes replays suitable for comparing dispatch
+ performance on identical input. Actions are performed with a nil target.
+
+ The trace format and the replay loop are part of ShortcutRecorderCore: the ShortcutRecorderCoreReplay tool
+ replays a trace through the core dispatch table on any platform.
+
+ @return NO if the file cannot be read or is not a trace.
+ */
+- (BOOL)replayTraceAtURL:(NSURL *)aURL
+           mismatchCount:(nullable NSUInteger *)outMismatchCount
+                   error:(NSError * _Nullable *)outError NS_SWIFT_NAME(replayTrace(at:mismatchCount:));
+
 /*!
  Called before the shortcut gets its first associated enabled action.
 
@@ -326,6 +583,23 @@ NS_SWIFT_NAME(ShortcutMonitor)
 extern const OSType SRShortcutActionSignature;
 
 
+/*!
+ What SRGlobalShortcutMonitor does with its hot keys while paused.
+
+ @const SRGlobalShortcutMonitorPauseBehaviorUnregister Hot keys are unregistered and the key presses reach other applications.
+        Resuming registers the hot keys again, except those removed while paused.
+
+ @const SRGlobalShortcutMonitorPauseBehaviorSuspend Hot keys stay registered and their events are ignored.
+        Pausing and resuming are cheap, but the key presses are still intercepted, e.g. they do not reach
+        a recorder control.
+ */
+typedef NS_CLOSED_ENUM(NSUInteger, SRGlobalShortcutMonitorPauseBehavior)
+{
+    SRGlobalShortcutMonitorPauseBehaviorUnregister = 0,
+    SRGlobalShortcutMonitorPauseBehaviorSuspend
+} NS_SWIFT_NAME(GlobalShortcutMonitor.PauseBehavior);
+
+
 /*!
  Handle shortcuts regardless of the currently active application via Carbon Hot Key API.
 
@@ -338,6 +612,14 @@ NS_SWIFT_NAME(GlobalShortcutMonitor)
 
 @property (class, readonly) SRGlobalShortcutMonitor *sharedMonitor NS_SWIFT_NAME(shared);
 
+/*!
+ What pause does with the hot keys. Defaults to SRGlobalShortcutMonitorPauseBehaviorUnregister.
+
+ @discussion
+ The behavior is applied when the monitor becomes paused.
+ */
+@property SRGlobalShortcutMonitorPauseBehavior pauseBehavior;
+
 /*!
  Enable system-wide shortcut monitoring.
 
@@ -382,6 +664,63 @@ NS_SWIFT_NAME(GlobalShortcutMonitor)
 @end
 
 
+/*!
+ Kind of a gesture made with a single modifier key.
+
+ @const SRModifierGestureKindTap The key is pressed and released alone within the interval.
+ @const SRModifierGestureKindDoubleTap The key is tapped alone twice, the second release within the interval after the first.
+ @const SRModifierGestureKindHold The key is held alone for the interval.
+ */
+typedef NS_CLOSED_ENUM(NSUInteger, SRModifierGestureKind)
+{
+    SRModifierGestureKindTap = 0,
+    SRModifierGestureKindDoubleTap,
+    SRModifierGestureKindHold
+} NS_SWIFT_NAME(ModifierGesture.Kind);
+
+
+/*!
+ Gesture made with a single modifier key, e.g. double-tap ⌥ within 250 ms or hold ⌘ for 500 ms.
+
+ @discussion
+ Left and right keys are distinguished by their key codes, e.g. kVK_Shift and kVK_RightShift.
+ A gesture is cancelled when another key, including another modifier key, is pressed in the middle of it.
+
+ Every tap is reported, including those that make a double-tap. A held key is not reported as a tap.
+
+ @see SRAXGlobalShortcutMonitor
+ */
+NS_SWIFT_NAME(ModifierGesture)
+@interface SRModifierGesture : NSObject <NSCopying>
+
++ (instancetype)tapWithKeyCode:(SRKeyCode)aKeyCode NS_SWIFT_NAME(tap(keyCode:));
+
++ (instancetype)doubleTapWithKeyCode:(SRKeyCode)aKeyCode interval:(NSTimeInterval)anInterval NS_SWIFT_NAME(doubleTap(keyCode:interval:));
+
++ (instancetype)holdWithKeyCode:(SRKeyCode)aKeyCode duration:(NSTimeInterval)aDuration NS_SWIFT_NAME(hold(keyCode:duration:));
+
+/*!
+ @param aKeyCode Key code of the Command, Option, Shift or Control key on either side.
+
+ @param anInterval Meaning depends on the kind, see SRModifierGestureKind.
+
+ @throws NSInvalidArgumentException if the key is not a supported modifier key or the interval is not positive.
+ */
+- (instancetype)initWithKind:(SRModifierGestureKind)aKind
+                     keyCode:(SRKeyCode)aKeyCode
+                    interval:(NSTimeInterval)anInterval NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (readonly) SRModifierGestureKind kind;
+
+@property (readonly) SRKeyCode keyCode;
+
+@property (readonly) NSTimeInterval interval;
+
+@end
+
+
 /*!
  Handle shortcuts regardless of the currently active application via Quartz Event Service API.
 
@@ -471,9 +810,88 @@ NS_SWIFT_NAME(AXGlobalShortcutMonitor)
  */
 - (nullable CGEventRef)handleEvent:(CGEventRef)anEvent;
 
+/*!
+ Duration of the recent event tap callbacks at a given percentile.
+
+ @param aPercentile Percentile in the [0, 100] range: 50 is the median and 100 is the maximum.
+
+ @return Duration in seconds or 0 if no events were seen yet.
+
+ @discussion
+ The monitor keeps durations of the last 128 callbacks. When the system disables the tap because
+ callbacks take too long, it's re-enabled automatically with an exponential backoff
+ and SRAXGlobalShortcutMonitorEventTapDisabledNotification is posted.
+ */
+- (NSTimeInterval)callbackDurationAtPercentile:(double)aPercentile NS_SWIFT_NAME(callbackDuration(atPercentile:));
+
+/*!
+ Monotonic clock in nanoseconds used to time modifier gestures. Defaults to the system's uptime clock.
+
+ @discussion
+ Replace to drive the gesture recognition deterministically. Must be set before gestures are added.
+ */
+@property (nonatomic, copy, null_resettable) uint64_t (^modifierGestureClock)(void);
+
+/*!
+ Modifier gestures that have associated actions.
+ */
+@property (readonly) NSArray<SRModifierGesture *> *modifierGestures;
+
+/*!
+ Add an action to perform when the modifier gesture is recognized.
+
+ @discussion
+ Gestures are recognized by the event tap callback without allocations. Taps and double-taps are reported
+ when the key is released and holds as soon as the duration elapses. The flags changed events are passed through.
+
+ Actions are performed in reverse order until one of them returns YES. The shortcut of the action is ignored.
+ */
+- (void)addAction:(SRShortcutAction *)anAction forModifierGesture:(SRModifierGesture *)aGesture NS_SWIFT_NAME(addAction(_:forModifierGesture:));
+
+/*!
+ Remove an action, if present, from the modifier gesture.
+ */
+- (void)removeAction:(SRShortcutAction *)anAction forModifierGesture:(SRModifierGesture *)aGesture NS_SWIFT_NAME(removeAction(_:forModifierGesture:));
+
 @end
 
 
+/*!
+ Posted by SRAXGlobalShortcutMonitor when the system disables its event tap.
+
+ @discussion
+ The notification is posted on the thread of the event tap's run loop.
+ The userInfo dictionary contains the SRAXGlobalShortcutMonitorEventTapDisabledReasonKey,
+ SRAXGlobalShortcutMonitorEventTapReenableDelayKey and the callback duration keys.
+ */
+extern NSNotificationName const SRAXGlobalShortcutMonitorEventTapDisabledNotification NS_SWIFT_NAME(AXGlobalShortcutMonitor.eventTapDisabledNotification);
+
+/*!
+ NSNumber of CGEventType: either kCGEventTapDisabledByTimeout or kCGEventTapDisabledByUserInput.
+ */
+extern NSString *const SRAXGlobalShortcutMonitorEventTapDisabledReasonKey NS_SWIFT_NAME(AXGlobalShortcutMonitor.eventTapDisabledReasonKey);
+
+/*!
+ NSNumber of NSTimeInterval after which the tap is re-enabled.
+ */
+extern NSString *const SRAXGlobalShortcutMonitorEventTapReenableDelayKey NS_SWIFT_NAME(AXGlobalShortcutMonitor.eventTapReenableDelayKey);
+
+/*!
+ NSNumber of NSTimeInterval.
+ */
+extern NSString *const SRAXGlobalShortcutMonitorCallbackDurationMedianKey NS_SWIFT_NAME(AXGlobalShortcutMonitor.callbackDurationMedianKey);
+
+/*!
+ NSNumber of NSTimeInterval.
+ */
+extern NSString *const SRAXGlobalShortcutMonitorCallbackDurationP99Key NS_SWIFT_NAME(AXGlobalShortcutMonitor.callbackDurationP99Key);
+
+/*!
+ NSNumber of NSTimeInterval.
+ */
+extern NSString *const SRAXGlobalShortcutMonitorCallbackDurationMaximumKey NS_SWIFT_NAME(AXGlobalShortcutMonitor.callbackDurationMaximumKey);
+
+
 /*!
  Handle AppKit's keyboard events.
 
@@ -558,6 +976,9 @@ NS_SWIFT_NAME(LocalShortcutMonitor)
 /*!
  Update the monitor with system-wide and user-specific Cocoa Text System key bindings.
 
+ @discussion
+ Nested dictionaries of multi-key bindings are added as shortcut sequences.
+
  @seealso https://developer.apple.com/library/archive/documentation/Cocoa/Conceptual/EventOverview/TextDefaultsBindings/TextDefaultsBindings.html
  */
 - (void)updateWithCocoaTextKeyBindings;
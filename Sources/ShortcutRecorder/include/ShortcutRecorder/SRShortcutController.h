@@ -55,7 +55,7 @@ extern SRShortcutControllerKeyPath const SRShortcutControllerKeyPathSymbolicModi
  - selection.symbolicModifierFlags
 
  Values of the following properties depend on the currently selected input source and
- also updated whenever kTISNotifySelectedKeyboardInputSourceChanged is posted:
+ also updated whenever SRKeyCodeTransformerInputSourceDidChangeNotification is posted:
  - selection.keyEquivalent
  - selection.literalKeyCode
  - selection.symbolicKeyCode
@@ -0,0 +1,7 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+// The core is header-only; this file makes it a target of its own and checks that it compiles as C.
+#include "SRShortcutCore.h"
@@ -0,0 +1,1543 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+/*!
+ Portable core of the shortcut monitors.
+
+ @discussion
+ Packed shortcut keys, conversions of modifier flags, the dispatch tables of actions and sequences,
+ the matcher of modifier gestures, the bookkeeping of the event tap and the format and replay of traces.
+
+ The header depends only on the C standard library and compiles as C99 and C++11 so the engine can be built,
+ tested and profiled without Apple frameworks. The constants have the values of their Cocoa, Carbon,
+ Quartz and IOKit counterparts which is asserted by the Objective-C sources at compile time.
+ */
+
+#ifndef SRShortcutCore_h
+#define SRShortcutCore_h
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#ifdef __cplusplus
+#define SR_CORE_CONSTEXPR constexpr
+extern "C" {
+#else
+#define SR_CORE_CONSTEXPR const
+#endif
+
+#define SR_CORE_INLINE static inline
+
+
+// Key Codes
+
+typedef uint16_t SRCoreKeyCode;
+
+static const SRCoreKeyCode SRCoreKeyCodeNone = UINT16_MAX;
+
+/*!
+ Virtual key codes of the modifier keys, same as kVK_* of Carbon.
+ */
+enum
+{
+    SRCoreKeyCodeRightCommand = 0x36,
+    SRCoreKeyCodeCommand = 0x37,
+    SRCoreKeyCodeShift = 0x38,
+    SRCoreKeyCodeOption = 0x3A,
+    SRCoreKeyCodeControl = 0x3B,
+    SRCoreKeyCodeRightShift = 0x3C,
+    SRCoreKeyCodeRightOption = 0x3D,
+    SRCoreKeyCodeRightControl = 0x3E
+};
+
+
+// Modifier Flags
+
+/*!
+ Device-independent modifier flags, same as NSEventModifierFlags and CGEventFlags.
+ */
+enum
+{
+    SRCoreModifierFlagShift = 1 << 17,
+    SRCoreModifierFlagControl = 1 << 18,
+    SRCoreModifierFlagOption = 1 << 19,
+    SRCoreModifierFlagCommand = 1 << 20,
+    SRCoreModifierFlagsMask = SRCoreModifierFlagShift | SRCoreModifierFlagControl | SRCoreModifierFlagOption | SRCoreModifierFlagCommand
+};
+
+/*!
+ Modifier flags of Carbon, same as cmdKey, shiftKey, optionKey and controlKey.
+ */
+enum
+{
+    SRCoreCarbonModifierFlagCommand = 1 << 8,
+    SRCoreCarbonModifierFlagShift = 1 << 9,
+    SRCoreCarbonModifierFlagOption = 1 << 11,
+    SRCoreCarbonModifierFlagControl = 1 << 12,
+    SRCoreCarbonModifierFlagsMask = SRCoreCarbonModifierFlagCommand | SRCoreCarbonModifierFlagShift | SRCoreCarbonModifierFlagOption | SRCoreCarbonModifierFlagControl
+};
+
+/*!
+ Device-dependent flags that tell left and right modifier keys apart, same as NX_DEVICE*KEYMASK.
+ */
+enum
+{
+    SRCoreDeviceModifierFlagLeftControl = 0x0001,
+    SRCoreDeviceModifierFlagLeftShift = 0x0002,
+    SRCoreDeviceModifierFlagRightShift = 0x0004,
+    SRCoreDeviceModifierFlagLeftCommand = 0x0008,
+    SRCoreDeviceModifierFlagRightCommand = 0x0010,
+    SRCoreDeviceModifierFlagLeftOption = 0x0020,
+    SRCoreDeviceModifierFlagRightOption = 0x0040,
+    SRCoreDeviceModifierFlagRightControl = 0x2000,
+    SRCoreDeviceModifierFlagsMask = SRCoreDeviceModifierFlagLeftControl | SRCoreDeviceModifierFlagRightControl |
+                                    SRCoreDeviceModifierFlagLeftShift | SRCoreDeviceModifierFlagRightShift |
+                                    SRCoreDeviceModifierFlagLeftCommand | SRCoreDeviceModifierFlagRightCommand |
+                                    SRCoreDeviceModifierFlagLeftOption | SRCoreDeviceModifierFlagRightOption
+};
+
+/*!
+ Shift of the device-independent modifier flags into the 4-bit index of the conversion tables.
+ */
+enum
+{
+    SRCoreModifierFlagsShift = 17
+};
+
+#define _SRCorePackedToCarbon(i) (((i) & 1 ? SRCoreCarbonModifierFlagShift : 0) | \
+                                  ((i) & 2 ? SRCoreCarbonModifierFlagControl : 0) | \
+                                  ((i) & 4 ? SRCoreCarbonModifierFlagOption : 0) | \
+                                  ((i) & 8 ? SRCoreCarbonModifierFlagCommand : 0))
+
+/*!
+ Carbon modifier flags indexed by the device-independent flags shifted by SRCoreModifierFlagsShift.
+ */
+static SR_CORE_CONSTEXPR uint32_t SRCorePackedToCarbonModifierFlags[16] = {
+    _SRCorePackedToCarbon(0), _SRCorePackedToCarbon(1), _SRCorePackedToCarbon(2), _SRCorePackedToCarbon(3),
+    _SRCorePackedToCarbon(4), _SRCorePackedToCarbon(5), _SRCorePackedToCarbon(6), _SRCorePackedToCarbon(7),
+    _SRCorePackedToCarbon(8), _SRCorePackedToCarbon(9), _SRCorePackedToCarbon(10), _SRCorePackedToCarbon(11),
+    _SRCorePackedToCarbon(12), _SRCorePackedToCarbon(13), _SRCorePackedToCarbon(14), _SRCorePackedToCarbon(15)
+};
+
+#undef _SRCorePackedToCarbon
+
+// Index is bits 8-12 of the Carbon flags: command, shift, caps lock, option and control.
+#define _SRCoreCarbonToPacked(i) (((i) & 1 ? 8 : 0) | ((i) & 2 ? 1 : 0) | ((i) & 8 ? 4 : 0) | ((i) & 16 ? 2 : 0))
+
+/*!
+ Device-independent flags shifted by SRCoreModifierFlagsShift indexed by bits 8-12 of the Carbon flags.
+ */
+static SR_CORE_CONSTEXPR uint8_t SRCoreCarbonToPackedModifierFlags[32] = {
+    _SRCoreCarbonToPacked(0), _SRCoreCarbonToPacked(1), _SRCoreCarbonToPacked(2), _SRCoreCarbonToPacked(3),
+    _SRCoreCarbonToPacked(4), _SRCoreCarbonToPacked(5), _SRCoreCarbonToPacked(6), _SRCoreCarbonToPacked(7),
+    _SRCoreCarbonToPacked(8), _SRCoreCarbonToPacked(9), _SRCoreCarbonToPacked(10), _SRCoreCarbonToPacked(11),
+    _SRCoreCarbonToPacked(12), _SRCoreCarbonToPacked(13), _SRCoreCarbonToPacked(14), _SRCoreCarbonToPacked(15),
+    _SRCoreCarbonToPacked(16), _SRCoreCarbonToPacked(17), _SRCoreCarbonToPacked(18), _SRCoreCarbonToPacked(19),
+    _SRCoreCarbonToPacked(20), _SRCoreCarbonToPacked(21), _SRCoreCarbonToPacked(22), _SRCoreCarbonToPacked(23),
+    _SRCoreCarbonToPacked(24), _SRCoreCarbonToPacked(25), _SRCoreCarbonToPacked(26), _SRCoreCarbonToPacked(27),
+    _SRCoreCarbonToPacked(28), _SRCoreCarbonToPacked(29), _SRCoreCarbonToPacked(30), _SRCoreCarbonToPacked(31)
+};
+
+#undef _SRCoreCarbonToPacked
+
+
+/*!
+ Convert Carbon modifier flags to device-independent flags.
+ */
+SR_CORE_INLINE uint64_t SRCoreCarbonToCocoaFlags(uint32_t aCarbonFlags)
+{
+    return (uint64_t)SRCoreCarbonToPackedModifierFlags[(aCarbonFlags >> 8) & 0x1F] << SRCoreModifierFlagsShift;
+}
+
+/*!
+ Convert device-independent modifier flags to Carbon.
+ */
+SR_CORE_INLINE uint32_t SRCoreCocoaToCarbonFlags(uint64_t aCocoaFlags)
+{
+    return SRCorePackedToCarbonModifierFlags[(aCocoaFlags & SRCoreModifierFlagsMask) >> SRCoreModifierFlagsShift];
+}
+
+/*!
+ Convert Quartz event flags to device-independent modifier flags suitable for shortcuts.
+ */
+SR_CORE_INLINE uint64_t SRCoreQuartzToCocoaFlags(uint64_t aQuartzFlags)
+{
+    return aQuartzFlags & SRCoreModifierFlagsMask;
+}
+
+/*!
+ Device-independent modifier flag of the modifier key, if any.
+ */
+SR_CORE_INLINE uint64_t SRCoreModifierFlagForKeyCode(SRCoreKeyCode aKeyCode)
+{
+    switch (aKeyCode)
+    {
+        case SRCoreKeyCodeCommand:
+        case SRCoreKeyCodeRightCommand:
+            return SRCoreModifierFlagCommand;
+        case SRCoreKeyCodeOption:
+        case SRCoreKeyCodeRightOption:
+            return SRCoreModifierFlagOption;
+        case SRCoreKeyCodeShift:
+        case SRCoreKeyCodeRightShift:
+            return SRCoreModifierFlagShift;
+        case SRCoreKeyCodeControl:
+        case SRCoreKeyCodeRightControl:
+            return SRCoreModifierFlagControl;
+        default:
+            return 0;
+    }
+}
+
+/*!
+ Device-dependent modifier flag of the modifier key, if any.
+ */
+SR_CORE_INLINE uint64_t SRCoreDeviceModifierFlagForKeyCode(SRCoreKeyCode aKeyCode)
+{
+    switch (aKeyCode)
+    {
+        case SRCoreKeyCodeCommand:
+            return SRCoreDeviceModifierFlagLeftCommand;
+        case SRCoreKeyCodeRightCommand:
+            return SRCoreDeviceModifierFlagRightCommand;
+        case SRCoreKeyCodeOption:
+            return SRCoreDeviceModifierFlagLeftOption;
+        case SRCoreKeyCodeRightOption:
+            return SRCoreDeviceModifierFlagRightOption;
+        case SRCoreKeyCodeShift:
+            return SRCoreDeviceModifierFlagLeftShift;
+        case SRCoreKeyCodeRightShift:
+            return SRCoreDeviceModifierFlagRightShift;
+        case SRCoreKeyCodeControl:
+            return SRCoreDeviceModifierFlagLeftControl;
+        case SRCoreKeyCodeRightControl:
+            return SRCoreDeviceModifierFlagRightControl;
+        default:
+            return 0;
+    }
+}
+
+/*!
+ Whether the modifier key is down after the FlagsChanged event with the given Quartz flags.
+
+ @discussion
+ When both left and right keys are down, releasing one of them keeps the device-independent flag set.
+ The device-dependent flags are used instead unless the event source does not set them.
+ */
+SR_CORE_INLINE bool SRCoreIsModifierKeyDown(SRCoreKeyCode aKeyCode, uint64_t aQuartzFlags)
+{
+    if (aQuartzFlags & SRCoreDeviceModifierFlagsMask)
+        return (aQuartzFlags & SRCoreDeviceModifierFlagForKeyCode(aKeyCode)) != 0;
+    else
+        return (SRCoreQuartzToCocoaFlags(aQuartzFlags) & SRCoreModifierFlagForKeyCode(aKeyCode)) != 0;
+}
+
+
+// Shortcut Keys
+
+/*!
+ Shortcut and key event packed into 32 bits.
+
+ @discussion
+ Bits 0-15 hold the key code, bits 16-19 hold the modifier flags (SRCoreModifierFlagsMask shifted by 1)
+ and bit 20 is set for the key down.
+
+ Bit 21 marks an auto-repeat of the key down. It travels with the key to the actions,
+ but is never part of the keys stored in tables.
+ */
+typedef uint32_t SRCoreShortcutKey;
+
+static const SRCoreShortcutKey SRCoreShortcutKeyInvalid = UINT32_MAX;
+
+enum
+{
+    SRCoreShortcutKeyKeyCodeMask = 0xFFFF,
+    SRCoreShortcutKeyModifierFlagsMask = SRCoreModifierFlagsMask >> 1,
+    SRCoreShortcutKeyKeyDownMask = 1 << 20,
+    SRCoreShortcutKeyRepeatMask = 1 << 21
+};
+
+SR_CORE_INLINE SRCoreShortcutKey SRCoreShortcutKeyMake(SRCoreKeyCode aKeyCode, uint64_t aModifierFlags, bool anIsKeyDown)
+{
+    return (SRCoreShortcutKey)aKeyCode |
+        (SRCoreShortcutKey)((aModifierFlags & SRCoreModifierFlagsMask) >> 1) |
+        (anIsKeyDown ? SRCoreShortcutKeyKeyDownMask : 0);
+}
+
+SR_CORE_INLINE SRCoreKeyCode SRCoreShortcutKeyGetKeyCode(SRCoreShortcutKey aKey)
+{
+    return (SRCoreKeyCode)(aKey & SRCoreShortcutKeyKeyCodeMask);
+}
+
+SR_CORE_INLINE uint64_t SRCoreShortcutKeyGetModifierFlags(SRCoreShortcutKey aKey)
+{
+    return (uint64_t)(aKey & SRCoreShortcutKeyModifierFlagsMask) << 1;
+}
+
+SR_CORE_INLINE bool SRCoreShortcutKeyIsKeyDown(SRCoreShortcutKey aKey)
+{
+    return (aKey & SRCoreShortcutKeyKeyDownMask) != 0;
+}
+
+SR_CORE_INLINE bool SRCoreShortcutKeyIsRepeat(SRCoreShortcutKey aKey)
+{
+    return (aKey & SRCoreShortcutKeyRepeatMask) != 0;
+}
+
+/*!
+ The key without the auto-repeat mark, suitable for lookups.
+ */
+SR_CORE_INLINE SRCoreShortcutKey SRCoreShortcutKeyGetLookupKey(SRCoreShortcutKey aKey)
+{
+    return aKey & ~(SRCoreShortcutKey)SRCoreShortcutKeyRepeatMask;
+}
+
+/*!
+ Home slot of the key in an open-addressed table of 2^aCapacityLog2 slots.
+ */
+SR_CORE_INLINE size_t SRCoreShortcutKeyTableIndex(SRCoreShortcutKey aKey, unsigned aCapacityLog2)
+{
+    // Fibonacci hashing: the high bits of the product are well mixed even for sequential key codes.
+    return (size_t)((uint32_t)(aKey * 2654435769u) >> (32 - aCapacityLog2));
+}
+
+
+// Action Tables
+
+/*!
+ Position of an action among the actions of a key: by priority, then by the order of addition.
+ */
+typedef struct
+{
+    int64_t priority;
+    uint64_t sequence; // unique within the table
+} SRCoreActionRank;
+
+SR_CORE_INLINE bool SRCoreActionRankIsLess(SRCoreActionRank aLeft, SRCoreActionRank aRight)
+{
+    return aLeft.priority < aRight.priority || (aLeft.priority == aRight.priority && aLeft.sequence < aRight.sequence);
+}
+
+/*!
+ Actions of a key.
+ */
+typedef struct
+{
+    SRCoreShortcutKey key; // SRCoreShortcutKeyInvalid if the entry is empty
+    uint32_t count;
+    uint32_t capacity;
+    const void **actions; // opaque, not owned
+    SRCoreActionRank *ranks; // index-aligned with actions
+    void *context; // opaque, not owned and shared by copies
+} SRCoreActionTableEntry;
+
+/*!
+ Open-addressed table of actions keyed by SRCoreShortcutKey.
+
+ @discussion
+ Every key owns a contiguous array of actions ordered by rank from the lowest to the highest,
+ so performing them in reverse tries higher priorities and then more recent actions first.
+ Actions are located by a binary search of their rank: the caller keeps track of the ranks.
+ Collisions are resolved by linear probing with backward shift deletion, the load factor is kept at or below 1/2.
+
+ Actions are opaque pointers compared by identity, the caller manages their lifetime.
+ */
+typedef struct
+{
+    SRCoreActionTableEntry *entries;
+    size_t count; // number of keys with at least one action
+    unsigned capacityLog2;
+} SRCoreActionTable;
+
+enum
+{
+    SRCoreActionTableInitialCapacityLog2 = 4
+};
+
+static const size_t SRCoreActionNotFound = SIZE_MAX;
+
+SR_CORE_INLINE size_t SRCoreActionTableCapacity(const SRCoreActionTable *aTable)
+{
+    return (size_t)1 << aTable->capacityLog2;
+}
+
+SR_CORE_INLINE SRCoreActionTableEntry *_SRCoreActionTableEntriesCreate(size_t aCapacity)
+{
+    SRCoreActionTableEntry *entries = (SRCoreActionTableEntry *)calloc(aCapacity, sizeof(SRCoreActionTableEntry));
+
+    if (!entries)
+        return NULL;
+
+    for (size_t i = 0; i < aCapacity; ++i)
+        entries[i].key = SRCoreShortcutKeyInvalid;
+
+    return entries;
+}
+
+/*!
+ @return false if the storage cannot be allocated; the table must not be used then.
+ */
+SR_CORE_INLINE bool SRCoreActionTableInit(SRCoreActionTable *aTable)
+{
+    aTable->count = 0;
+    aTable->capacityLog2 = SRCoreActionTableInitialCapacityLog2;
+    aTable->entries = _SRCoreActionTableEntriesCreate(SRCoreActionTableCapacity(aTable));
+    return aTable->entries != NULL;
+}
+
+/*!
+ Free the storage of the table without touching the actions.
+ */
+SR_CORE_INLINE void SRCoreActionTableDestroy(SRCoreActionTable *aTable)
+{
+    size_t capacity = aTable->entries ? SRCoreActionTableCapacity(aTable) : 0;
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        free(aTable->entries[i].actions);
+        free(aTable->entries[i].ranks);
+    }
+
+    free(aTable->entries);
+    aTable->entries = NULL;
+    aTable->count = 0;
+}
+
+/*!
+ Initialize aCopy with the keys, actions and contexts of aTable.
+
+ @return false if the storage cannot be allocated; aCopy must not be used then.
+ */
+SR_CORE_INLINE bool SRCoreActionTableCopy(SRCoreActionTable *aCopy, const SRCoreActionTable *aTable)
+{
+    size_t capacity = SRCoreActionTableCapacity(aTable);
+
+    aCopy->count = aTable->count;
+    aCopy->capacityLog2 = aTable->capacityLog2;
+    aCopy->entries = _SRCoreActionTableEntriesCreate(capacity);
+
+    if (!aCopy->entries)
+        return false;
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        const SRCoreActionTableEntry *entry = &aTable->entries[i];
+
+        if (entry->key == SRCoreShortcutKeyInvalid)
+            continue;
+
+        SRCoreActionTableEntry *copyEntry = &aCopy->entries[i];
+        *copyEntry = *entry;
+        copyEntry->capacity = entry->count;
+        copyEntry->actions = (const void **)malloc(entry->count * sizeof(const void *));
+        copyEntry->ranks = (SRCoreActionRank *)malloc(entry->count * sizeof(SRCoreActionRank));
+
+        if (!copyEntry->actions || !copyEntry->ranks)
+        {
+            // Entries that are not copied yet still point to the storage of aTable.
+            for (size_t j = i + 1; j < capacity; ++j)
+            {
+                aCopy->entries[j].actions = NULL;
+                aCopy->entries[j].ranks = NULL;
+            }
+
+            SRCoreActionTableDestroy(aCopy);
+            return false;
+        }
+
+        memcpy(copyEntry->actions, entry->actions, entry->count * sizeof(const void *));
+        memcpy(copyEntry->ranks, entry->ranks, entry->count * sizeof(SRCoreActionRank));
+    }
+
+    return true;
+}
+
+/*!
+ @return NULL if the key has no actions.
+ */
+SR_CORE_INLINE SRCoreActionTableEntry *SRCoreActionTableGetEntry(const SRCoreActionTable *aTable, SRCoreShortcutKey aKey)
+{
+    size_t mask = SRCoreActionTableCapacity(aTable) - 1;
+
+    for (size_t i = SRCoreShortcutKeyTableIndex(aKey, aTable->capacityLog2);; i = (i + 1) & mask)
+    {
+        SRCoreActionTableEntry *entry = &aTable->entries[i];
+
+        if (entry->key == aKey)
+            return entry;
+        else if (entry->key == SRCoreShortcutKeyInvalid)
+            return NULL;
+    }
+}
+
+/*!
+ Index of the first action whose rank is not less than the given one.
+ */
+SR_CORE_INLINE size_t SRCoreActionTableEntryLowerBound(const SRCoreActionTableEntry *anEntry, SRCoreActionRank aRank)
+{
+    // Ranks are mostly added at the end.
+    if (!anEntry->count || SRCoreActionRankIsLess(anEntry->ranks[anEntry->count - 1], aRank))
+        return anEntry->count;
+
+    size_t low = 0;
+    size_t high = anEntry->count;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (SRCoreActionRankIsLess(anEntry->ranks[middle], aRank))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+/*!
+ @return SRCoreActionNotFound if the entry has no such action.
+ */
+SR_CORE_INLINE size_t SRCoreActionTableEntryIndexOfAction(const SRCoreActionTableEntry *anEntry, const void *anAction)
+{
+    for (size_t i = 0; i < anEntry->count; ++i)
+    {
+        if (anEntry->actions[i] == anAction)
+            return i;
+    }
+
+    return SRCoreActionNotFound;
+}
+
+SR_CORE_INLINE size_t SRCoreActionTableEntryIndexOfRankedAction(const SRCoreActionTableEntry *anEntry,
+                                                                const void *anAction,
+                                                                SRCoreActionRank aRank)
+{
+    size_t index = SRCoreActionTableEntryLowerBound(anEntry, aRank);
+
+    if (index < anEntry->count && anEntry->actions[index] == anAction)
+        return index;
+    else
+        return SRCoreActionNotFound;
+}
+
+SR_CORE_INLINE bool SRCoreActionTableContainsAction(const SRCoreActionTable *aTable, SRCoreShortcutKey aKey, const void *anAction)
+{
+    SRCoreActionTableEntry *entry = SRCoreActionTableGetEntry(aTable, aKey);
+    return entry && SRCoreActionTableEntryIndexOfAction(entry, anAction) != SRCoreActionNotFound;
+}
+
+SR_CORE_INLINE bool _SRCoreActionTableResize(SRCoreActionTable *aTable, unsigned aCapacityLog2)
+{
+    SRCoreActionTableEntry *entries = _SRCoreActionTableEntriesCreate((size_t)1 << aCapacityLog2);
+
+    if (!entries)
+        return false;
+
+    SRCoreActionTableEntry *oldEntries = aTable->entries;
+    size_t oldCapacity = SRCoreActionTableCapacity(aTable);
+
+    aTable->capacityLog2 = aCapacityLog2;
+    aTable->entries = entries;
+
+    size_t mask = SRCoreActionTableCapacity(aTable) - 1;
+
+    for (size_t i = 0; i < oldCapacity; ++i)
+    {
+        if (oldEntries[i].key == SRCoreShortcutKeyInvalid)
+            continue;
+
+        size_t j = SRCoreShortcutKeyTableIndex(oldEntries[i].key, aCapacityLog2);
+
+        while (aTable->entries[j].key != SRCoreShortcutKeyInvalid)
+            j = (j + 1) & mask;
+
+        aTable->entries[j] = oldEntries[i];
+    }
+
+    free(oldEntries);
+    return true;
+}
+
+SR_CORE_INLINE void _SRCoreActionTableRemoveEntry(SRCoreActionTable *aTable, SRCoreActionTableEntry *anEntry)
+{
+    SRCoreActionTableEntry *entries = aTable->entries;
+    size_t mask = SRCoreActionTableCapacity(aTable) - 1;
+    size_t i = (size_t)(anEntry - entries);
+    size_t j = i;
+
+    free(entries[i].actions);
+    free(entries[i].ranks);
+
+    // Backward shift deletion: move subsequent entries of the cluster into the hole unless
+    // their home index lies cyclically within (i, j].
+    while (true)
+    {
+        j = (j + 1) & mask;
+
+        if (entries[j].key == SRCoreShortcutKeyInvalid)
+            break;
+
+        size_t k = SRCoreShortcutKeyTableIndex(entries[j].key, aTable->capacityLog2);
+
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+
+        entries[i] = entries[j];
+        i = j;
+    }
+
+    memset(&entries[i], 0, sizeof(SRCoreActionTableEntry));
+    entries[i].key = SRCoreShortcutKeyInvalid;
+    aTable->count -= 1;
+}
+
+/*!
+ Insert the action into the actions of the key according to its rank.
+
+ @discussion
+ The action must not be associated with the key.
+
+ @return false if the storage cannot be allocated; the table is left unchanged.
+ */
+SR_CORE_INLINE bool SRCoreActionTableAddAction(SRCoreActionTable *aTable,
+                                               SRCoreShortcutKey aKey,
+                                               const void *anAction,
+                                               SRCoreActionRank aRank)
+{
+    SRCoreActionTableEntry *entry = SRCoreActionTableGetEntry(aTable, aKey);
+
+    if (!entry)
+    {
+        if ((aTable->count + 1) * 2 > SRCoreActionTableCapacity(aTable) &&
+            !_SRCoreActionTableResize(aTable, aTable->capacityLog2 + 1))
+        {
+            return false;
+        }
+
+        size_t mask = SRCoreActionTableCapacity(aTable) - 1;
+        size_t i = SRCoreShortcutKeyTableIndex(aKey, aTable->capacityLog2);
+
+        while (aTable->entries[i].key != SRCoreShortcutKeyInvalid)
+            i = (i + 1) & mask;
+
+        entry = &aTable->entries[i];
+    }
+
+    if (entry->count == entry->capacity)
+    {
+        uint32_t capacity = entry->capacity ? entry->capacity * 2 : 2;
+        const void **actions = (const void **)realloc(entry->actions, capacity * sizeof(const void *));
+
+        if (!actions)
+            return false;
+
+        SRCoreActionRank *ranks = (SRCoreActionRank *)realloc(entry->ranks, capacity * sizeof(SRCoreActionRank));
+
+        if (!ranks)
+        {
+            // A grown actions array is harmless for an existing entry, but an empty slot must not own storage.
+            if (entry->key == SRCoreShortcutKeyInvalid)
+            {
+                free(actions);
+                actions = NULL;
+            }
+
+            entry->actions = actions;
+            return false;
+        }
+
+        entry->actions = actions;
+        entry->ranks = ranks;
+        entry->capacity = capacity;
+    }
+
+    if (entry->key == SRCoreShortcutKeyInvalid)
+    {
+        entry->key = aKey;
+        aTable->count += 1;
+    }
+
+    // Typically appended: a new action is the most recent one.
+    size_t index = SRCoreActionTableEntryLowerBound(entry, aRank);
+    memmove(&entry->actions[index + 1], &entry->actions[index], (entry->count - index) * sizeof(const void *));
+    memmove(&entry->ranks[index + 1], &entry->ranks[index], (entry->count - index) * sizeof(SRCoreActionRank));
+
+    entry->actions[index] = anAction;
+    entry->ranks[index] = aRank;
+    entry->count += 1;
+    return true;
+}
+
+/*!
+ Change the rank of the action.
+
+ @discussion
+ Only the actions between the old and the new positions are shifted.
+
+ @return false if the key has no such action.
+ */
+SR_CORE_INLINE bool SRCoreActionTableMoveAction(SRCoreActionTable *aTable,
+                                                SRCoreShortcutKey aKey,
+                                                const void *anAction,
+                                                SRCoreActionRank anOldRank,
+                                                SRCoreActionRank aNewRank)
+{
+    SRCoreActionTableEntry *entry = SRCoreActionTableGetEntry(aTable, aKey);
+    size_t from = entry ? SRCoreActionTableEntryIndexOfRankedAction(entry, anAction, anOldRank) : SRCoreActionNotFound;
+
+    if (from == SRCoreActionNotFound)
+        return false;
+
+    // The lower bound counts the action itself if it moves up.
+    size_t to = SRCoreActionTableEntryLowerBound(entry, aNewRank);
+
+    if (to > from)
+    {
+        to -= 1;
+        memmove(&entry->actions[from], &entry->actions[from + 1], (to - from) * sizeof(const void *));
+        memmove(&entry->ranks[from], &entry->ranks[from + 1], (to - from) * sizeof(SRCoreActionRank));
+    }
+    else if (to < from)
+    {
+        memmove(&entry->actions[to + 1], &entry->actions[to], (from - to) * sizeof(const void *));
+        memmove(&entry->ranks[to + 1], &entry->ranks[to], (from - to) * sizeof(SRCoreActionRank));
+    }
+
+    entry->actions[to] = anAction;
+    entry->ranks[to] = aNewRank;
+    return true;
+}
+
+/*!
+ Remove the action from the actions of the key, the key is removed along with its last action.
+
+ @return false if the key has no such action.
+ */
+SR_CORE_INLINE bool SRCoreActionTableRemoveAction(SRCoreActionTable *aTable,
+                                                  SRCoreShortcutKey aKey,
+                                                  const void *anAction,
+                                                  SRCoreActionRank aRank)
+{
+    SRCoreActionTableEntry *entry = SRCoreActionTableGetEntry(aTable, aKey);
+    size_t index = entry ? SRCoreActionTableEntryIndexOfRankedAction(entry, anAction, aRank) : SRCoreActionNotFound;
+
+    if (index == SRCoreActionNotFound)
+        return false;
+
+    memmove(&entry->actions[index], &entry->actions[index + 1], (entry->count - index - 1) * sizeof(const void *));
+    memmove(&entry->ranks[index], &entry->ranks[index + 1], (entry->count - index - 1) * sizeof(SRCoreActionRank));
+    entry->count -= 1;
+
+    if (!entry->count)
+        _SRCoreActionTableRemoveEntry(aTable, entry);
+
+    return true;
+}
+
+
+// Shortcut Sequences
+
+/*!
+ Input of the sequence automaton: the state in the high 32 bits and the key down in the low 32 bits.
+ */
+SR_CORE_INLINE uint64_t SRCoreSequenceInput(uint32_t aState, SRCoreShortcutKey aKey)
+{
+    return ((uint64_t)aState << 32) | aKey;
+}
+
+/*!
+ Home slot of the input in an open-addressed transition table of 2^aCapacityLog2 slots.
+ */
+SR_CORE_INLINE size_t SRCoreSequenceTransitionIndex(uint64_t anInput, unsigned aCapacityLog2)
+{
+    return (size_t)((anInput * 11400714819323198485ull) >> (64 - aCapacityLog2));
+}
+
+/*!
+ Result of advancing the sequence automaton by a keystroke.
+
+ @const SRCoreSequenceStepNone The keystroke does not belong to any sequence.
+ @const SRCoreSequenceStepPrefix The keystroke continues one or more sequences.
+ @const SRCoreSequenceStepComplete The keystroke completes a sequence.
+ */
+typedef uint8_t SRCoreSequenceStep;
+
+enum
+{
+    SRCoreSequenceStepNone = 0,
+    SRCoreSequenceStepPrefix,
+    SRCoreSequenceStepComplete
+};
+
+typedef struct
+{
+    uint64_t input; // see SRCoreSequenceInput, SRCoreSequenceTransitionEmpty if the slot is empty
+    uint32_t state;
+} SRCoreSequenceTransition;
+
+static const uint64_t SRCoreSequenceTransitionEmpty = UINT64_MAX;
+
+static const uint32_t SRCoreSequenceRootState = 0;
+
+static const uint32_t SRCoreSequenceInvalidState = UINT32_MAX;
+
+/*!
+ Deterministic automaton that recognizes shortcut sequences such as ⌃X ⌃S.
+
+ @discussion
+ Sequences are compiled into a trie whose edges are stored in an open-addressed transition table keyed
+ by the state and the key down of the shortcut. Every keystroke costs one lookup regardless of the number
+ of sequences. The load factor is kept at or below 1/2.
+
+ The table is immutable once built; the current state is kept by the caller.
+ Actions are opaque pointers, the caller manages their lifetime.
+ */
+typedef struct
+{
+    SRCoreSequenceTransition *transitions;
+    size_t count; // number of transitions
+    unsigned capacityLog2;
+    const void **stateActions; // index-aligned with states, NULL for intermediate states
+    uint32_t stateCount;
+    uint32_t stateCapacity;
+} SRCoreSequenceTable;
+
+SR_CORE_INLINE SRCoreSequenceTransition *_SRCoreSequenceTransitionsCreate(unsigned aCapacityLog2)
+{
+    size_t capacity = (size_t)1 << aCapacityLog2;
+    SRCoreSequenceTransition *transitions = (SRCoreSequenceTransition *)malloc(capacity * sizeof(SRCoreSequenceTransition));
+
+    if (!transitions)
+        return NULL;
+
+    for (size_t i = 0; i < capacity; ++i)
+        transitions[i].input = SRCoreSequenceTransitionEmpty;
+
+    return transitions;
+}
+
+SR_CORE_INLINE void _SRCoreSequenceTableInsertTransition(SRCoreSequenceTransition *aTransitions,
+                                                         unsigned aCapacityLog2,
+                                                         uint64_t anInput,
+                                                         uint32_t aState)
+{
+    size_t mask = ((size_t)1 << aCapacityLog2) - 1;
+    size_t i = SRCoreSequenceTransitionIndex(anInput, aCapacityLog2);
+
+    while (aTransitions[i].input != SRCoreSequenceTransitionEmpty)
+        i = (i + 1) & mask;
+
+    aTransitions[i].input = anInput;
+    aTransitions[i].state = aState;
+}
+
+/*!
+ Initialize the table with just the root state.
+
+ @return false if the storage cannot be allocated; the table must not be used then.
+ */
+SR_CORE_INLINE bool SRCoreSequenceTableInit(SRCoreSequenceTable *aTable)
+{
+    aTable->count = 0;
+    aTable->capacityLog2 = 4;
+    aTable->transitions = _SRCoreSequenceTransitionsCreate(aTable->capacityLog2);
+    aTable->stateCount = 1;
+    aTable->stateCapacity = 4;
+    aTable->stateActions = (const void **)calloc(aTable->stateCapacity, sizeof(const void *));
+
+    if (!aTable->transitions || !aTable->stateActions)
+    {
+        free(aTable->transitions);
+        free(aTable->stateActions);
+        aTable->transitions = NULL;
+        aTable->stateActions = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ Free the storage of the table without touching the actions.
+ */
+SR_CORE_INLINE void SRCoreSequenceTableDestroy(SRCoreSequenceTable *aTable)
+{
+    free(aTable->transitions);
+    free(aTable->stateActions);
+    aTable->transitions = NULL;
+    aTable->stateActions = NULL;
+    aTable->count = 0;
+    aTable->stateCount = 0;
+}
+
+/*!
+ State the automaton moves to from aState by the key down.
+
+ @return SRCoreSequenceInvalidState if there is no such transition.
+ */
+SR_CORE_INLINE uint32_t SRCoreSequenceTableNextState(const SRCoreSequenceTable *aTable, uint32_t aState, SRCoreShortcutKey aKey)
+{
+    uint64_t input = SRCoreSequenceInput(aState, aKey);
+    size_t mask = ((size_t)1 << aTable->capacityLog2) - 1;
+
+    for (size_t i = SRCoreSequenceTransitionIndex(input, aTable->capacityLog2);; i = (i + 1) & mask)
+    {
+        if (aTable->transitions[i].input == input)
+            return aTable->transitions[i].state;
+        else if (aTable->transitions[i].input == SRCoreSequenceTransitionEmpty)
+            return SRCoreSequenceInvalidState;
+    }
+}
+
+/*!
+ Add a sequence of key downs that completes with the actions.
+
+ @param aKeys Key downs of the sequence, at least 1.
+
+ @param anActions Actions of the sequence, replace the actions of the same sequence added earlier.
+
+ @return The final state of the sequence or SRCoreSequenceInvalidState if the storage cannot be allocated.
+         The prefix added before the failure stays in the table as intermediate states without actions.
+ */
+SR_CORE_INLINE uint32_t SRCoreSequenceTableAddSequence(SRCoreSequenceTable *aTable,
+                                                       const SRCoreShortcutKey *aKeys,
+                                                       size_t aCount,
+                                                       const void *anActions)
+{
+    uint32_t state = SRCoreSequenceRootState;
+
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        uint32_t nextState = SRCoreSequenceTableNextState(aTable, state, aKeys[i]);
+
+        if (nextState == SRCoreSequenceInvalidState)
+        {
+            if ((aTable->count + 1) * 2 > ((size_t)1 << aTable->capacityLog2))
+            {
+                SRCoreSequenceTransition *transitions = _SRCoreSequenceTransitionsCreate(aTable->capacityLog2 + 1);
+
+                if (!transitions)
+                    return SRCoreSequenceInvalidState;
+
+                SRCoreSequenceTransition *oldTransitions = aTable->transitions;
+                size_t oldCapacity = (size_t)1 << aTable->capacityLog2;
+
+                aTable->capacityLog2 += 1;
+                aTable->transitions = transitions;
+
+                for (size_t j = 0; j < oldCapacity; ++j)
+                {
+                    if (oldTransitions[j].input != SRCoreSequenceTransitionEmpty)
+                        _SRCoreSequenceTableInsertTransition(aTable->transitions, aTable->capacityLog2, oldTransitions[j].input, oldTransitions[j].state);
+                }
+
+                free(oldTransitions);
+            }
+
+            if (aTable->stateCount == aTable->stateCapacity)
+            {
+                const void **stateActions = (const void **)realloc(aTable->stateActions, aTable->stateCapacity * 2 * sizeof(const void *));
+
+                if (!stateActions)
+                    return SRCoreSequenceInvalidState;
+
+                aTable->stateActions = stateActions;
+                aTable->stateCapacity *= 2;
+            }
+
+            nextState = aTable->stateCount;
+            aTable->stateActions[nextState] = NULL;
+            aTable->stateCount += 1;
+            _SRCoreSequenceTableInsertTransition(aTable->transitions, aTable->capacityLog2, SRCoreSequenceInput(state, aKeys[i]), nextState);
+            aTable->count += 1;
+        }
+
+        state = nextState;
+    }
+
+    aTable->stateActions[state] = anActions;
+    return state;
+}
+
+/*!
+ Advance the automaton by the key down.
+
+ @param aState Current state; the caller resets it to SRCoreSequenceRootState when the sequence times out.
+
+ @param aKey Key down. An auto-repeat is consumed without changing the state while a sequence is in progress
+             and does not belong to any sequence otherwise.
+
+ @param outState State to continue from.
+
+ @param outActions Actions of the completed sequence.
+ */
+SR_CORE_INLINE SRCoreSequenceStep SRCoreSequenceTableStep(const SRCoreSequenceTable *aTable,
+                                                          uint32_t aState,
+                                                          SRCoreShortcutKey aKey,
+                                                          uint32_t *outState,
+                                                          const void **outActions)
+{
+    *outState = aState;
+
+    if (SRCoreShortcutKeyIsRepeat(aKey))
+        return aState != SRCoreSequenceRootState ? SRCoreSequenceStepPrefix : SRCoreSequenceStepNone;
+
+    uint32_t nextState = SRCoreSequenceTableNextState(aTable, aState, aKey);
+
+    // An abandoned sequence may be followed by the beginning of another one.
+    if (nextState == SRCoreSequenceInvalidState && aState != SRCoreSequenceRootState)
+        nextState = SRCoreSequenceTableNextState(aTable, SRCoreSequenceRootState, aKey);
+
+    if (nextState == SRCoreSequenceInvalidState)
+    {
+        *outState = SRCoreSequenceRootState;
+        return SRCoreSequenceStepNone;
+    }
+
+    if (aTable->stateActions[nextState])
+    {
+        *outState = SRCoreSequenceRootState;
+        *outActions = aTable->stateActions[nextState];
+        return SRCoreSequenceStepComplete;
+    }
+
+    *outState = nextState;
+    return SRCoreSequenceStepPrefix;
+}
+
+
+// Modifier Gestures
+
+/*!
+ Kind of a modifier gesture, same as SRModifierGestureKind.
+ */
+typedef uint8_t SRCoreModifierGestureKind;
+
+enum
+{
+    SRCoreModifierGestureKindTap = 0,
+    SRCoreModifierGestureKindDoubleTap,
+    SRCoreModifierGestureKindHold
+};
+
+/*!
+ @field interval Interval of the gesture in nanoseconds.
+ */
+typedef struct
+{
+    SRCoreModifierGestureKind kind;
+    uint64_t interval;
+} SRCoreModifierGesture;
+
+/*!
+ Progress of the modifier gesture.
+
+ @field keyCode Key that is down alone or SRCoreKeyCodeNone.
+
+ @field heldDuration Duration, in nanoseconds, up to which the holds of the key were already evaluated.
+
+ @field lastTapKeyCode Key of the previous tap or SRCoreKeyCodeNone if the next tap cannot make a double-tap.
+
+ @discussion
+ Functions that take gestures expect the gestures of the key they evaluate and write indices of the matched gestures
+ into outMatches which must have room for aCount indices. Times are in nanoseconds of a monotonic clock.
+ */
+typedef struct
+{
+    SRCoreKeyCode keyCode;
+    bool isCancelled;
+    bool didHold;
+    uint64_t pressTime;
+    uint64_t heldDuration;
+    SRCoreKeyCode lastTapKeyCode;
+    uint64_t lastTapTime;
+} SRCoreModifierGestureState;
+
+SR_CORE_INLINE void SRCoreModifierGestureStateInit(SRCoreModifierGestureState *aState)
+{
+    aState->keyCode = SRCoreKeyCodeNone;
+    aState->isCancelled = false;
+    aState->didHold = false;
+    aState->pressTime = 0;
+    aState->heldDuration = 0;
+    aState->lastTapKeyCode = SRCoreKeyCodeNone;
+    aState->lastTapTime = 0;
+}
+
+/*!
+ Match the holds of the tracked key whose duration elapsed since the last evaluation.
+
+ @param aGestures Gestures of aState->keyCode.
+
+ @return Number of matched gestures.
+
+ @discussion
+ Must be called before every other update so a late timer does not reorder holds and other gestures.
+ */
+SR_CORE_INLINE size_t SRCoreModifierGestureStateAdvance(SRCoreModifierGestureState *aState,
+                                                        uint64_t aNow,
+                                                        const SRCoreModifierGesture *aGestures,
+                                                        size_t aCount,
+                                                        size_t *outMatches)
+{
+    if (aState->keyCode == SRCoreKeyCodeNone || aState->isCancelled)
+        return 0;
+
+    uint64_t heldDuration = aNow - aState->pressTime;
+
+    if (heldDuration <= aState->heldDuration)
+        return 0;
+
+    size_t matchCount = 0;
+
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        if (aGestures[i].kind != SRCoreModifierGestureKindHold)
+            continue;
+
+        if (aGestures[i].interval > aState->heldDuration && aGestures[i].interval <= heldDuration)
+        {
+            aState->didHold = true;
+            outMatches[matchCount++] = i;
+        }
+    }
+
+    aState->heldDuration = heldDuration;
+    return matchCount;
+}
+
+/*!
+ Match taps and double-taps when the modifier key goes up or down.
+
+ @param aGestures Gestures of aKeyCode.
+
+ @return Number of matched gestures.
+ */
+SR_CORE_INLINE size_t SRCoreModifierGestureStateUpdate(SRCoreModifierGestureState *aState,
+                                                       SRCoreKeyCode aKeyCode,
+                                                       bool anIsDown,
+                                                       uint64_t aNow,
+                                                       const SRCoreModifierGesture *aGestures,
+                                                       size_t aCount,
+                                                       size_t *outMatches)
+{
+    if (anIsDown)
+    {
+        if (aState->keyCode != SRCoreKeyCodeNone)
+        {
+            // Another modifier joins in: it's a shortcut rather than a gesture.
+            aState->isCancelled = true;
+            aState->lastTapKeyCode = SRCoreKeyCodeNone;
+            return 0;
+        }
+
+        aState->keyCode = aKeyCode;
+        aState->isCancelled = false;
+        aState->didHold = false;
+        aState->pressTime = aNow;
+        aState->heldDuration = 0;
+        return 0;
+    }
+    else if (aState->keyCode != aKeyCode)
+    {
+        // The key was pressed while another one was tracked.
+        if (aState->keyCode != SRCoreKeyCodeNone)
+            aState->isCancelled = true;
+
+        return 0;
+    }
+
+    bool isTap = !aState->isCancelled && !aState->didHold;
+    uint64_t pressDuration = aNow - aState->pressTime;
+    bool canDoubleTap = isTap && aState->lastTapKeyCode == aKeyCode;
+    uint64_t timeSinceLastTap = aNow - aState->lastTapTime;
+    bool didDoubleTap = false;
+    size_t matchCount = 0;
+    aState->keyCode = SRCoreKeyCodeNone;
+
+    if (!isTap)
+    {
+        aState->lastTapKeyCode = SRCoreKeyCodeNone;
+        return 0;
+    }
+
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        switch (aGestures[i].kind)
+        {
+            case SRCoreModifierGestureKindTap:
+                if (pressDuration <= aGestures[i].interval)
+                    outMatches[matchCount++] = i;
+                break;
+            case SRCoreModifierGestureKindDoubleTap:
+                if (canDoubleTap && timeSinceLastTap <= aGestures[i].interval)
+                {
+                    didDoubleTap = true;
+                    outMatches[matchCount++] = i;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // A triple tap makes just one double-tap.
+    aState->lastTapKeyCode = didDoubleTap ? SRCoreKeyCodeNone : aKeyCode;
+    aState->lastTapTime = aNow;
+    return matchCount;
+}
+
+/*!
+ Cancel the gesture in progress, e.g. when a non-modifier key goes down.
+ */
+SR_CORE_INLINE void SRCoreModifierGestureStateCancel(SRCoreModifierGestureState *aState)
+{
+    if (aState->keyCode != SRCoreKeyCodeNone)
+        aState->isCancelled = true;
+
+    aState->lastTapKeyCode = SRCoreKeyCodeNone;
+}
+
+/*!
+ Time until the nearest hold of the tracked key that is yet to elapse.
+
+ @param aGestures Gestures of aState->keyCode.
+
+ @return Delay in nanoseconds or UINT64_MAX if there is no such hold.
+ */
+SR_CORE_INLINE uint64_t SRCoreModifierGestureStateNextHoldDelay(const SRCoreModifierGestureState *aState,
+                                                                uint64_t aNow,
+                                                                const SRCoreModifierGesture *aGestures,
+                                                                size_t aCount)
+{
+    if (aState->keyCode == SRCoreKeyCodeNone || aState->isCancelled)
+        return UINT64_MAX;
+
+    uint64_t heldDuration = aNow - aState->pressTime;
+    uint64_t nextDuration = UINT64_MAX;
+
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        if (aGestures[i].kind == SRCoreModifierGestureKindHold &&
+            aGestures[i].interval > heldDuration &&
+            aGestures[i].interval < nextDuration)
+        {
+            nextDuration = aGestures[i].interval;
+        }
+    }
+
+    return nextDuration != UINT64_MAX ? nextDuration - heldDuration : UINT64_MAX;
+}
+
+
+// Event Tap
+
+/*!
+ Disables that are further apart than this interval (in seconds) re-enable the tap immediately.
+ */
+static SR_CORE_CONSTEXPR double SRCoreEventTapBackoffResetInterval = 30.0;
+
+static SR_CORE_CONSTEXPR double SRCoreEventTapBackoffInitialDelay = 0.1;
+
+static SR_CORE_CONSTEXPR double SRCoreEventTapBackoffMaximumDelay = 10.0;
+
+/*!
+ Delay in seconds before the disabled event tap is re-enabled.
+
+ @param aPreviousDelay Delay used after the previous disable.
+
+ @param aTimeSinceLastDisable Time since the previous disable.
+
+ @discussion
+ An occasional disable is reacted to immediately. Disables in quick succession mean that the system
+ keeps timing out the callback, so the delay doubles each time up to the maximum.
+ */
+SR_CORE_INLINE double SRCoreEventTapReenableDelay(double aPreviousDelay, double aTimeSinceLastDisable)
+{
+    if (aTimeSinceLastDisable >= SRCoreEventTapBackoffResetInterval)
+        return 0.0;
+    else if (aPreviousDelay <= 0.0)
+        return SRCoreEventTapBackoffInitialDelay;
+    else
+        return aPreviousDelay * 2.0 < SRCoreEventTapBackoffMaximumDelay ? aPreviousDelay * 2.0 : SRCoreEventTapBackoffMaximumDelay;
+}
+
+/*!
+ Number of the most recent event tap callbacks to keep durations of.
+ */
+enum
+{
+    SRCoreCallbackDurationsCapacity = 128
+};
+
+/*!
+ Slot of the ring of callback durations to record the duration into.
+
+ @param aCount Number of durations recorded so far.
+ */
+SR_CORE_INLINE size_t SRCoreCallbackDurationsIndex(size_t aCount)
+{
+    return aCount % SRCoreCallbackDurationsCapacity;
+}
+
+SR_CORE_INLINE int _SRCoreCompareDurations(const void *aLeft, const void *aRight)
+{
+    uint64_t left = *(const uint64_t *)aLeft;
+    uint64_t right = *(const uint64_t *)aRight;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+/*!
+ Nearest-rank percentile of the callback durations.
+
+ @param aDurations Ring of callback durations; sorted in place.
+
+ @param aCount Number of durations recorded so far; only the last SRCoreCallbackDurationsCapacity are in the ring.
+
+ @param aPercentile Percentile in the [0, 100] range.
+
+ @return Duration or 0 if nothing was recorded.
+ */
+SR_CORE_INLINE uint64_t SRCoreCallbackDurationAtPercentile(uint64_t *aDurations, size_t aCount, double aPercentile)
+{
+    size_t count = aCount < (size_t)SRCoreCallbackDurationsCapacity ? aCount : (size_t)SRCoreCallbackDurationsCapacity;
+
+    if (!count)
+        return 0;
+
+    qsort(aDurations, count, sizeof(uint64_t), _SRCoreCompareDurations);
+    double rank = ceil(aPercentile / 100.0 * (double)count);
+    size_t index = rank > 1.0 ? (rank < (double)count ? (size_t)rank - 1 : count - 1) : 0;
+    return aDurations[index];
+}
+
+
+
+// Traces
+
+/*!
+ Identifies trace files: "SRTR" in the file's byte order.
+ */
+static SR_CORE_CONSTEXPR uint32_t SRCoreTraceMagic = (uint32_t)'S' | (uint32_t)'R' << 8 | (uint32_t)'T' << 16 | (uint32_t)'R' << 24;
+
+static SR_CORE_CONSTEXPR uint16_t SRCoreTraceVersion = 1;
+
+enum
+{
+    SRCoreTraceRecordFlagKeyDown = 1 << 0,
+    SRCoreTraceRecordFlagRepeat = 1 << 1,
+    SRCoreTraceRecordFlagHandled = 1 << 2
+};
+
+/*!
+ Trace file header. All fields are little-endian.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t startTime; // nanoseconds since 1970
+} SRCoreTraceHeader;
+
+/*!
+ Key event as seen by the monitor. All fields are little-endian.
+
+ @discussion
+ Records follow the header back to back.
+ */
+typedef struct
+{
+    uint64_t timestamp; // nanoseconds since the start of recording
+    uint32_t duration; // nanoseconds spent handling the event, saturated
+    uint16_t keyCode;
+    uint8_t modifierFlags; // SRCoreModifierFlagsMask shifted right by SRCoreModifierFlagsShift
+    uint8_t flags;
+} SRCoreTraceRecord;
+
+/*!
+ Trace record in the byte order of the host.
+ */
+typedef struct
+{
+    uint64_t timestamp;
+    uint32_t duration;
+    SRCoreShortcutKey key; // with the auto-repeat mark
+    bool isHandled;
+} SRCoreTraceEvent;
+
+/*!
+ Convert between the byte order of the host and little-endian; the conversion is its own inverse.
+ */
+SR_CORE_INLINE uint16_t SRCoreTraceSwapLittle16(uint16_t aValue)
+{
+    uint8_t bytes[sizeof(aValue)];
+    memcpy(bytes, &aValue, sizeof(aValue));
+    return (uint16_t)(bytes[0] | bytes[1] << 8);
+}
+
+SR_CORE_INLINE uint32_t SRCoreTraceSwapLittle32(uint32_t aValue)
+{
+    uint8_t bytes[sizeof(aValue)];
+    memcpy(bytes, &aValue, sizeof(aValue));
+    return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+SR_CORE_INLINE uint64_t SRCoreTraceSwapLittle64(uint64_t aValue)
+{
+    return (uint64_t)SRCoreTraceSwapLittle32((uint32_t)aValue) | (uint64_t)SRCoreTraceSwapLittle32((uint32_t)(aValue >> 32)) << 32;
+}
+
+/*!
+ @param aStartTime Wall clock time of the start of recording in nanoseconds since 1970.
+ */
+SR_CORE_INLINE SRCoreTraceHeader SRCoreTraceHeaderMake(uint64_t aStartTime)
+{
+    SRCoreTraceHeader header;
+    header.magic = SRCoreTraceSwapLittle32(SRCoreTraceMagic);
+    header.version = SRCoreTraceSwapLittle16(SRCoreTraceVersion);
+    header.recordSize = SRCoreTraceSwapLittle16((uint16_t)sizeof(SRCoreTraceRecord));
+    header.startTime = SRCoreTraceSwapLittle64(aStartTime);
+    return header;
+}
+
+SR_CORE_INLINE SRCoreTraceRecord SRCoreTraceRecordMake(const SRCoreTraceEvent *anEvent)
+{
+    uint8_t flags = 0;
+
+    if (SRCoreShortcutKeyIsKeyDown(anEvent->key))
+        flags |= SRCoreTraceRecordFlagKeyDown;
+
+    if (SRCoreShortcutKeyIsRepeat(anEvent->key))
+        flags |= SRCoreTraceRecordFlagRepeat;
+
+    if (anEvent->isHandled)
+        flags |= SRCoreTraceRecordFlagHandled;
+
+    SRCoreTraceRecord record;
+    record.timestamp = SRCoreTraceSwapLittle64(anEvent->timestamp);
+    record.duration = SRCoreTraceSwapLittle32(anEvent->duration);
+    record.keyCode = SRCoreTraceSwapLittle16(SRCoreShortcutKeyGetKeyCode(anEvent->key));
+    record.modifierFlags = (uint8_t)(SRCoreShortcutKeyGetModifierFlags(anEvent->key) >> SRCoreModifierFlagsShift);
+    record.flags = flags;
+    return record;
+}
+
+SR_CORE_INLINE SRCoreTraceEvent SRCoreTraceRecordGetEvent(const SRCoreTraceRecord *aRecord)
+{
+    SRCoreTraceEvent event;
+    event.timestamp = SRCoreTraceSwapLittle64(aRecord->timestamp);
+    event.duration = SRCoreTraceSwapLittle32(aRecord->duration);
+    event.key = SRCoreShortcutKeyMake(SRCoreTraceSwapLittle16(aRecord->keyCode),
+                                      (uint64_t)aRecord->modifierFlags << SRCoreModifierFlagsShift,
+                                      (aRecord->flags & SRCoreTraceRecordFlagKeyDown) != 0);
+
+    if (aRecord->flags & SRCoreTraceRecordFlagRepeat)
+        event.key |= SRCoreShortcutKeyRepeatMask;
+
+    event.isHandled = (aRecord->flags & SRCoreTraceRecordFlagHandled) != 0;
+    return event;
+}
+
+/*!
+ Number of records of the trace.
+
+ @discussion
+ A trailing partial record of an interrupted recording is ignored.
+
+ @return false if the bytes are not a trace.
+ */
+SR_CORE_INLINE bool SRCoreTraceGetRecordCount(const void *aBytes, size_t aLength, size_t *outCount)
+{
+    SRCoreTraceHeader header;
+
+    if (aLength < sizeof(header))
+        return false;
+
+    memcpy(&header, aBytes, sizeof(header));
+
+    if (SRCoreTraceSwapLittle32(header.magic) != SRCoreTraceMagic ||
+        SRCoreTraceSwapLittle16(header.version) != SRCoreTraceVersion ||
+        SRCoreTraceSwapLittle16(header.recordSize) != sizeof(SRCoreTraceRecord))
+    {
+        return false;
+    }
+
+    *outCount = (aLength - sizeof(header)) / sizeof(SRCoreTraceRecord);
+    return true;
+}
+
+/*!
+ Event of the record at the index; the bytes need not be aligned.
+ */
+SR_CORE_INLINE SRCoreTraceEvent SRCoreTraceGetEvent(const void *aBytes, size_t anIndex)
+{
+    SRCoreTraceRecord record;
+    memcpy(&record, (const uint8_t *)aBytes + sizeof(SRCoreTraceHeader) + anIndex * sizeof(SRCoreTraceRecord), sizeof(record));
+    return SRCoreTraceRecordGetEvent(&record);
+}
+
+/*!
+ Handle the replayed event.
+
+ @param aTime Time of the replay clock in nanoseconds. Logic that depends on time, such as sequence timeouts
+              and repeat throttling, must use it instead of the system time.
+
+ @return Whether the event is handled.
+ */
+typedef bool (*SRCoreTraceReplayHandler)(void *aContext, const SRCoreTraceEvent *anEvent, uint64_t aTime);
+
+/*!
+ Pass the events of the trace to the handler in order.
+
+ @param anOrigin Time of the replay clock at the start of recording, in nanoseconds.
+
+ @param outMismatchCount Number of events the handler handled differently than recorded.
+
+ @discussion
+ Events are passed back to back, but the replay clock advances by the recorded timestamps. Replays are therefore
+ as fast as the handler and yet deterministic: timeouts expire exactly where they did during recording.
+
+ @return false if the bytes are not a trace.
+ */
+SR_CORE_INLINE bool SRCoreTraceReplay(const void *aBytes,
+                                      size_t aLength,
+                                      uint64_t anOrigin,
+                                      SRCoreTraceReplayHandler aHandler,
+                                      void *aContext,
+                                      size_t *outMismatchCount)
+{
+    size_t count = 0;
+
+    if (!SRCoreTraceGetRecordCount(aBytes, aLength, &count))
+        return false;
+
+    size_t mismatchCount = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        SRCoreTraceEvent event = SRCoreTraceGetEvent(aBytes, i);
+
+        if (aHandler(aContext, &event, anOrigin + event.timestamp) != event.isHandled)
+            mismatchCount += 1;
+    }
+
+    if (outMismatchCount)
+        *outMismatchCount = mismatchCount;
+
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,216 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+/*!
+ Replay a trace recorded by -[SRShortcutMonitor startTraceRecordingToURL:error:] through the core dispatch table.
+
+ @discussion
+ The table is built from the key events the monitor handled. Events whose outcome depended on more than the key,
+ e.g. prefixes of shortcut sequences or throttled auto-repeats, are reported as mismatches. Lookups are timed
+ on the host clock while the replay clock follows the recorded timestamps, so traces can be compared
+ across machines and library versions on identical input.
+
+ Usage: ShortcutRecorderCoreReplay [--dump] <trace>
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "SRShortcutCore.h"
+
+
+typedef struct
+{
+    SRCoreActionTable table;
+    bool isDumping;
+    uint64_t lookupDuration; // nanoseconds
+} SRReplayContext;
+
+
+static uint64_t SRReplayHostTime(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+
+static int SRReplayCompareDurations(const void *aLeft, const void *aRight)
+{
+    uint32_t left = *(const uint32_t *)aLeft;
+    uint32_t right = *(const uint32_t *)aRight;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+
+static bool SRReplayHandleEvent(void *aContext, const SRCoreTraceEvent *anEvent, uint64_t aTime)
+{
+    SRReplayContext *context = (SRReplayContext *)aContext;
+
+    uint64_t start = SRReplayHostTime();
+    bool isHandled = SRCoreActionTableGetEntry(&context->table, SRCoreShortcutKeyGetLookupKey(anEvent->key)) != NULL;
+    context->lookupDuration += SRReplayHostTime() - start;
+
+    if (context->isDumping)
+    {
+        printf("%12.6f %5" PRIu16 " 0x%06" PRIx64 " %-4s%-7s %-8s %8" PRIu32 " ns%s\n",
+               (double)aTime / 1e9,
+               SRCoreShortcutKeyGetKeyCode(anEvent->key),
+               SRCoreShortcutKeyGetModifierFlags(anEvent->key),
+               SRCoreShortcutKeyIsKeyDown(anEvent->key) ? "down" : "up",
+               SRCoreShortcutKeyIsRepeat(anEvent->key) ? " repeat" : "",
+               anEvent->isHandled ? "handled" : "ignored",
+               anEvent->duration,
+               isHandled != anEvent->isHandled ? " mismatch" : "");
+    }
+
+    return isHandled;
+}
+
+
+static void *SRReplayReadFile(const char *aPath, size_t *outLength)
+{
+    FILE *file = fopen(aPath, "rb");
+
+    if (!file)
+        return NULL;
+
+    size_t capacity = 1 << 16;
+    size_t length = 0;
+    uint8_t *bytes = (uint8_t *)malloc(capacity);
+
+    while (bytes)
+    {
+        length += fread(bytes + length, 1, capacity - length, file);
+
+        if (length < capacity)
+            break;
+
+        uint8_t *newBytes = (uint8_t *)realloc(bytes, capacity * 2);
+
+        if (!newBytes)
+        {
+            free(bytes);
+            bytes = NULL;
+        }
+        else
+        {
+            bytes = newBytes;
+            capacity *= 2;
+        }
+    }
+
+    if (bytes && ferror(file))
+    {
+        free(bytes);
+        bytes = NULL;
+    }
+
+    fclose(file);
+    *outLength = length;
+    return bytes;
+}
+
+
+int main(int argc, const char *argv[])
+{
+    SRReplayContext context = {0};
+    const char *path = NULL;
+    bool isUsageError = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--dump") == 0)
+            context.isDumping = true;
+        else if (!path)
+            path = argv[i];
+        else
+            isUsageError = true;
+    }
+
+    if (!path || isUsageError)
+    {
+        fprintf(stderr, "Usage: %s [--dump] <trace>\n", argv[0]);
+        return 2;
+    }
+
+    size_t length = 0;
+    void *bytes = SRReplayReadFile(path, &length);
+    size_t count = 0;
+
+    if (!bytes)
+    {
+        perror(path);
+        return 1;
+    }
+    else if (!SRCoreTraceGetRecordCount(bytes, length, &count))
+    {
+        fprintf(stderr, "%s: not a trace\n", path);
+        free(bytes);
+        return 1;
+    }
+
+    uint32_t *durations = (uint32_t *)malloc((count ? count : 1) * sizeof(uint32_t));
+
+    if (!durations || !SRCoreActionTableInit(&context.table))
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    size_t keyDownCount = 0;
+    size_t repeatCount = 0;
+    size_t handledCount = 0;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        SRCoreTraceEvent event = SRCoreTraceGetEvent(bytes, i);
+        SRCoreShortcutKey key = SRCoreShortcutKeyGetLookupKey(event.key);
+
+        keyDownCount += SRCoreShortcutKeyIsKeyDown(event.key);
+        repeatCount += SRCoreShortcutKeyIsRepeat(event.key);
+        handledCount += event.isHandled;
+        durations[i] = event.duration;
+
+        // The table only tells whether the key has actions: every key gets a single dummy action.
+        if (event.isHandled && !SRCoreActionTableGetEntry(&context.table, key))
+        {
+            SRCoreActionRank rank = {0, (uint64_t)i};
+
+            if (!SRCoreActionTableAddAction(&context.table, key, &context, rank))
+            {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+        }
+    }
+
+    size_t mismatchCount = 0;
+    SRCoreTraceReplay(bytes, length, 0, SRReplayHandleEvent, &context, &mismatchCount);
+
+    printf("Events: %zu (%zu key downs, %zu auto-repeats, %zu handled)\n", count, keyDownCount, repeatCount, handledCount);
+
+    if (count)
+    {
+        SRCoreTraceEvent last = SRCoreTraceGetEvent(bytes, count - 1);
+        qsort(durations, count, sizeof(uint32_t), SRReplayCompareDurations);
+
+        printf("Recorded: %.3f s, handling p50 %" PRIu32 " ns, p99 %" PRIu32 " ns, max %" PRIu32 " ns\n",
+               (double)last.timestamp / 1e9,
+               durations[(count - 1) / 2],
+               durations[(count * 99 + 99) / 100 - 1],
+               durations[count - 1]);
+        printf("Replayed: %zu distinct handled keys, %.1f ns per lookup, %zu mismatches\n",
+               context.table.count,
+               (double)context.lookupDuration / (double)count,
+               mismatchCount);
+    }
+
+    SRCoreActionTableDestroy(&context.table);
+    free(durations);
+    free(bytes);
+    return 0;
+}
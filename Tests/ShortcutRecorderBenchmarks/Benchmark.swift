@@ -0,0 +1,121 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+import Foundation
+import XCTest
+
+import ShortcutRecorderCoreBenchmarkSupport
+
+
+private let suite = BenchmarkSuite(
+    baselineURL: URL(fileURLWithPath: #filePath).deletingLastPathComponent().appendingPathComponent("Baseline.json"),
+    tolerance: BenchmarkBaseline.Tolerance(time: 0.25, allocations: 0.5))
+
+
+/// Counts heap allocations made by the benchmarking thread.
+///
+/// The function table of the default malloc zone is patched once; allocations of other threads are ignored.
+enum AllocationCounter {
+    static func start() {
+        install()
+        allocationCount = 0
+        countingThread = pthread_self()
+    }
+
+    static func stop() -> Int {
+        countingThread = nil
+        return allocationCount
+    }
+
+    private static var isInstalled = false
+
+    private static func install() {
+        guard !isInstalled else {
+            return
+        }
+
+        isInstalled = true
+
+        // Hooks must not trigger lazy initialization of globals they use.
+        countingThread = nil
+        allocationCount = 0
+
+        let zone = malloc_default_zone()!
+        originalZone = zone.pointee
+
+        let address = vm_address_t(UInt(bitPattern: zone))
+        let size = vm_size_t(MemoryLayout<malloc_zone_t>.size)
+        let isProtected = zone.pointee.version >= 8
+
+        if isProtected {
+            vm_protect(mach_task_self_, address, size, 0, VM_PROT_READ | VM_PROT_WRITE)
+        }
+
+        zone.pointee.malloc = { aZone, aSize in
+            countAllocation()
+            return originalZone.malloc(aZone, aSize)
+        }
+        zone.pointee.calloc = { aZone, aCount, aSize in
+            countAllocation()
+            return originalZone.calloc(aZone, aCount, aSize)
+        }
+        zone.pointee.realloc = { aZone, aPointer, aSize in
+            countAllocation()
+            return originalZone.realloc(aZone, aPointer, aSize)
+        }
+
+#if compiler(>=5.9)
+        if zone.pointee.version >= 16 {
+            zone.pointee.malloc_type_malloc = { aZone, aSize, aType in
+                countAllocation()
+                return originalZone.malloc_type_malloc(aZone, aSize, aType)
+            }
+            zone.pointee.malloc_type_calloc = { aZone, aCount, aSize, aType in
+                countAllocation()
+                return originalZone.malloc_type_calloc(aZone, aCount, aSize, aType)
+            }
+            zone.pointee.malloc_type_realloc = { aZone, aPointer, aSize, aType in
+                countAllocation()
+                return originalZone.malloc_type_realloc(aZone, aPointer, aSize, aType)
+            }
+        }
+#endif
+
+        if isProtected {
+            vm_protect(mach_task_self_, address, size, 0, VM_PROT_READ)
+        }
+    }
+}
+
+
+private var originalZone = malloc_zone_t()
+private var countingThread: pthread_t?
+private var allocationCount = 0
+
+private func countAllocation() {
+    if let thread = countingThread, pthread_equal(thread, pthread_self()) != 0 {
+        allocationCount += 1
+    }
+}
+
+
+extension XCTestCase {
+    /// Measure ns/op, allocations/op and p99 of the body and compare them against the baseline.
+    ///
+    /// Each operation runs in its own autorelease pool so that deferred releases are attributed to it.
+    func benchmark<T>(_ aName: String,
+                      iterations anIterations: Int = 10_000,
+                      file: StaticString = #filePath,
+                      line: UInt = #line,
+                      _ aBody: () -> T) throws {
+        try suite.run(aName, iterations: anIterations, file: file, line: line, timedRun: { aRun in
+            AllocationCounter.start()
+            aRun()
+            return AllocationCounter.stop()
+        }) {
+            autoreleasepool { aBody() }
+        }
+    }
+}
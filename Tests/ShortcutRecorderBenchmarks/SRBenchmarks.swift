@@ -0,0 +1,159 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+import AppKit
+import XCTest
+
+import ShortcutRecorder
+
+
+class SRShortcutMonitorBenchmarks: XCTestCase {
+    /// Monitor with the given number of actions spread over distinct shortcuts and the shortcuts to look up.
+    func makeMonitor(actionCount anActionCount: Int) -> (LocalShortcutMonitor, [Shortcut]) {
+        let modifierFlags: [NSEvent.ModifierFlags] = [
+            [.command], [.option, .command], [.control, .command], [.shift, .command],
+            [.control, .option], [.shift, .option, .command], [.control, .shift], [.control, .option, .command]
+        ]
+        let monitor = LocalShortcutMonitor()
+        var shortcuts: [Shortcut] = []
+
+        for i in 0..<anActionCount {
+            let shortcut = Shortcut(code: KeyCode(rawValue: UInt16(i % 128))!,
+                                    modifierFlags: modifierFlags[(i / 128) % modifierFlags.count],
+                                    characters: nil,
+                                    charactersIgnoringModifiers: nil)
+            monitor.addAction(ShortcutAction(shortcut: shortcut) { _ in true }, forKeyEvent: .down)
+
+            if shortcuts.count < 1024 {
+                shortcuts.append(shortcut)
+            }
+        }
+
+        return (monitor, shortcuts)
+    }
+
+    func lookup(actionCount anActionCount: Int) throws {
+        let (monitor, shortcuts) = makeMonitor(actionCount: anActionCount)
+        var i = 0
+        try benchmark("SRShortcutMonitor.lookup.\(anActionCount)") { () -> Int in
+            i = (i + 1) % shortcuts.count
+            return monitor.enabledActions(forShortcut: shortcuts[i], keyEvent: .down).count
+        }
+    }
+
+    func testLookup10() throws {
+        try lookup(actionCount: 10)
+    }
+
+    func testLookup1k() throws {
+        try lookup(actionCount: 1_000)
+    }
+
+    func testLookup10k() throws {
+        try lookup(actionCount: 10_000)
+    }
+
+    func testHandleEvent1k() throws {
+        let (monitor, _) = makeMonitor(actionCount: 1_000)
+        let event = NSEvent.keyEvent(with: .keyDown,
+                                     location: .zero,
+                                     modifierFlags: .command,
+                                     timestamp: 0.0,
+                                     windowNumber: 0,
+                                     context: nil,
+                                     characters: "a",
+                                     charactersIgnoringModifiers: "a",
+                                     isARepeat: false,
+                                     keyCode: KeyCode.ansiA.rawValue)!
+        try benchmark("SRShortcutMonitor.handleEvent.1000") {
+            monitor.handle(event, withTarget: nil)
+        }
+    }
+}
+
+
+class SRShortcutParsingBenchmarks: XCTestCase {
+    func testKeyBindingTransformer() throws {
+        try benchmark("SRKeyBindingTransformer.transformedValue") {
+            KeyBindingTransformer.shared.transformedValue("$@a")
+        }
+    }
+
+    func testShortcutWithKeyEquivalent() throws {
+        try benchmark("SRShortcut.shortcutWithKeyEquivalent") {
+            Shortcut(keyEquivalent: "⇧⌘A")
+        }
+    }
+
+    func testIsEqualToKeyEquivalent() throws {
+        let shortcut = Shortcut(keyEquivalent: "⇧⌘A")!
+        try benchmark("SRShortcut.isEqualToKeyEquivalent") {
+            shortcut.isEqual(keyEquivalent: "A", modifierFlags: .command)
+        }
+    }
+}
+
+
+class SRShortcutFormatterBenchmarks: XCTestCase {
+    func testFormatting() throws {
+        let formatter = ShortcutFormatter()
+        let shortcut = Shortcut.default
+        try benchmark("SRShortcutFormatter.string") {
+            formatter.string(for: shortcut)
+        }
+    }
+
+    func testLiteralFormatting() throws {
+        let formatter = ShortcutFormatter()
+        formatter.isKeyCodeLiteral = true
+        formatter.usesASCIICapableKeyboardInputSource = true
+        formatter.areModifierFlagsLiteral = true
+        let shortcut = Shortcut.default
+        try benchmark("SRShortcutFormatter.string.literal") {
+            formatter.string(for: shortcut)
+        }
+    }
+}
+
+
+class SRShortcutValidatorBenchmarks: XCTestCase {
+    func testMenu() throws {
+        let menu = NSMenu()
+        for i in 0..<10 {
+            let submenu = NSMenu()
+            for character in "bcdefghijklmnopqrstu" {
+                submenu.addItem(NSMenuItem(title: "\(i)\(character)", action: nil, keyEquivalent: String(character)))
+            }
+            let item = NSMenuItem(title: "\(i)", action: nil, keyEquivalent: "")
+            item.submenu = submenu
+            menu.addItem(item)
+        }
+
+        let validator = ShortcutValidator(delegate: nil)
+        let shortcut = Shortcut(keyEquivalent: "⌥⌘A")!
+        try benchmark("SRShortcutValidator.menu", iterations: 1_000) { () -> Bool in
+            (try? validator.validate(shortcut: shortcut, againstMenu: menu)) != nil
+        }
+    }
+
+    func testSystemShortcuts() throws {
+        let validator = ShortcutValidator(delegate: nil)
+        let shortcut = Shortcut(keyEquivalent: "⌥⌘A")!
+        try benchmark("SRShortcutValidator.systemShortcuts", iterations: 1_000) { () -> Bool in
+            (try? validator.validateAgainstSystemShortcuts(shortcut: shortcut)) != nil
+        }
+    }
+}
+
+
+extension Shortcut {
+    class var `default`: Shortcut
+    {
+        return self.init(code: KeyCode.ansiA,
+                         modifierFlags: [.option, .command],
+                         characters: "å",
+                         charactersIgnoringModifiers: "a")
+    }
+}
@@ -0,0 +1,177 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+import Foundation
+import XCTest
+
+
+/// Measurements of a single benchmark.
+public struct BenchmarkResult: Codable {
+    public var nanosecondsPerOperation: Double
+    public var p99Nanoseconds: Double
+
+    /// nil unless the benchmark target counts allocations.
+    public var allocationsPerOperation: Double?
+}
+
+
+/// Committed reference measurements that benchmarks must not exceed.
+///
+/// Every benchmark target keeps its own Baseline.json next to its sources.
+///
+/// Timings are only comparable on the same machine in the same configuration, therefore benchmarks are
+/// skipped unless SR_RUN_BENCHMARKS or SR_RECORD_BENCHMARK_BASELINE is set. Set SR_RECORD_BENCHMARK_BASELINE=1
+/// to overwrite the entries with fresh measurements, e.g. after a deliberate change or when moving CI to
+/// different hardware. When gating, a benchmark without an entry fails, so new benchmarks cannot slip through.
+/// Record and gate with `SR_RUN_BENCHMARKS=1 swift test -c release --filter Benchmarks`.
+public struct BenchmarkBaseline: Codable {
+    public struct Tolerance: Codable {
+        /// Allowed relative increase of ns/op and p99.
+        public var time: Double
+
+        /// Allowed absolute increase of allocations/op.
+        public var allocations: Double?
+
+        public init(time aTime: Double, allocations anAllocations: Double? = nil) {
+            time = aTime
+            allocations = anAllocations
+        }
+    }
+
+    public var tolerance: Tolerance
+    public var benchmarks: [String: BenchmarkResult]
+
+    public static let isRecording = ProcessInfo.processInfo.environment["SR_RECORD_BENCHMARK_BASELINE"] != nil
+
+    public static let isEnabled = isRecording || ProcessInfo.processInfo.environment["SR_RUN_BENCHMARKS"] != nil
+}
+
+
+/// Keeps the optimizer from discarding the benchmarked work.
+@inline(never)
+public func blackHole<T>(_ aValue: T) {
+}
+
+
+private func now() -> UInt64 {
+    return DispatchTime.now().uptimeNanoseconds
+}
+
+
+/// Benchmarks of a target and their baseline.
+public final class BenchmarkSuite {
+    public let baselineURL: URL
+    public private(set) var baseline: BenchmarkBaseline
+
+    /// - Parameter aTolerance: Tolerance used until the baseline is recorded.
+    public init(baselineURL aURL: URL, tolerance aTolerance: BenchmarkBaseline.Tolerance) {
+        baselineURL = aURL
+
+        if let data = try? Data(contentsOf: aURL) {
+            baseline = try! JSONDecoder().decode(BenchmarkBaseline.self, from: data)
+        }
+        else {
+            baseline = BenchmarkBaseline(tolerance: aTolerance, benchmarks: [:])
+        }
+    }
+
+    /// Measure ns/op and p99 of the body and compare them against the baseline.
+    ///
+    /// - Parameter aTimedRun: Wraps the timed run of all iterations, e.g. to count its allocations.
+    ///                        Returns the number of allocations or nil if they are not counted.
+    ///
+    /// - Throws: XCTSkip unless benchmarks are enabled.
+    public func run<T>(_ aName: String,
+                       iterations anIterations: Int,
+                       file: StaticString = #filePath,
+                       line: UInt = #line,
+                       timedRun aTimedRun: (() -> Void) -> Int? = { $0(); return nil },
+                       _ aBody: () -> T) throws {
+        try XCTSkipUnless(BenchmarkBaseline.isEnabled,
+                          "Set SR_RUN_BENCHMARKS=1 to run benchmarks",
+                          file: file,
+                          line: line)
+
+        for _ in 0..<max(anIterations / 10, 1) {
+            blackHole(aBody())
+        }
+
+        var start: UInt64 = 0
+        var end: UInt64 = 0
+        let allocationCount = aTimedRun {
+            start = now()
+            for _ in 0..<anIterations {
+                blackHole(aBody())
+            }
+            end = now()
+        }
+
+        var samples = [UInt64](repeating: 0, count: anIterations)
+        for i in 0..<anIterations {
+            let sampleStart = now()
+            blackHole(aBody())
+            samples[i] = now() - sampleStart
+        }
+        samples.sort()
+
+        let result = BenchmarkResult(
+            nanosecondsPerOperation: Double(end - start) / Double(anIterations),
+            p99Nanoseconds: Double(samples[min(anIterations * 99 / 100, anIterations - 1)]),
+            allocationsPerOperation: allocationCount.map { Double($0) / Double(anIterations) })
+
+        if let allocationsPerOperation = result.allocationsPerOperation {
+            print(String(format: "%@: %.1f ns/op, %.2f allocations/op, p99 %.1f ns",
+                         aName,
+                         result.nanosecondsPerOperation,
+                         allocationsPerOperation,
+                         result.p99Nanoseconds))
+        }
+        else {
+            print(String(format: "%@: %.1f ns/op, p99 %.1f ns", aName, result.nanosecondsPerOperation, result.p99Nanoseconds))
+        }
+
+        if BenchmarkBaseline.isRecording {
+            baseline.benchmarks[aName] = result
+            XCTAssertNoThrow(try write(), file: file, line: line)
+            return
+        }
+
+        guard let reference = baseline.benchmarks[aName] else {
+            XCTFail("\(aName): no baseline, record it with SR_RECORD_BENCHMARK_BASELINE=1", file: file, line: line)
+            return
+        }
+
+        let tolerance = baseline.tolerance
+
+        XCTAssertLessThanOrEqual(result.nanosecondsPerOperation,
+                                 reference.nanosecondsPerOperation * (1.0 + tolerance.time),
+                                 "\(aName): ns/op regressed",
+                                 file: file,
+                                 line: line)
+        XCTAssertLessThanOrEqual(result.p99Nanoseconds,
+                                 reference.p99Nanoseconds * (1.0 + tolerance.time),
+                                 "\(aName): p99 regressed",
+                                 file: file,
+                                 line: line)
+
+        if let allocationsPerOperation = result.allocationsPerOperation,
+           let referenceAllocationsPerOperation = reference.allocationsPerOperation {
+            XCTAssertLessThanOrEqual(allocationsPerOperation,
+                                     referenceAllocationsPerOperation + (tolerance.allocations ?? 0.0),
+                                     "\(aName): allocations/op regressed",
+                                     file: file,
+                                     line: line)
+        }
+    }
+
+    private func write() throws {
+        let encoder = JSONEncoder()
+        encoder.outputFormatting = .prettyPrinted
+        if #available(macOS 10.13, *) {
+            encoder.outputFormatting.insert(.sortedKeys)
+        }
+        try encoder.encode(baseline).write(to: baselineURL, options: .atomic)
+    }
+}
@@ -0,0 +1,28 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+import Foundation
+import XCTest
+
+import ShortcutRecorderCoreBenchmarkSupport
+
+
+private let suite = BenchmarkSuite(
+    baselineURL: URL(fileURLWithPath: #filePath).deletingLastPathComponent().appendingPathComponent("Baseline.json"),
+    tolerance: BenchmarkBaseline.Tolerance(time: 0.25))
+
+
+extension XCTestCase {
+    /// Measure ns/op and p99 of the body and compare them against the baseline.
+    ///
+    /// The core does not allocate on its hot paths, so unlike ShortcutRecorderBenchmarks allocations are not counted.
+    func benchmark<T>(_ aName: String,
+                      iterations anIterations: Int = 100_000,
+                      file: StaticString = #filePath,
+                      line: UInt = #line,
+                      _ aBody: () -> T) throws {
+        try suite.run(aName, iterations: anIterations, file: file, line: line, aBody)
+    }
+}
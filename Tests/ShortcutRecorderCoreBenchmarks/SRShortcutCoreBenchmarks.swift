@@ -0,0 +1,115 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+import XCTest
+
+import ShortcutRecorderCore
+
+
+class SRShortcutCoreBenchmarks: XCTestCase {
+    let modifierFlags: [UInt64] = [
+        UInt64(SRCoreModifierFlagCommand),
+        UInt64(SRCoreModifierFlagOption | SRCoreModifierFlagCommand),
+        UInt64(SRCoreModifierFlagControl | SRCoreModifierFlagCommand),
+        UInt64(SRCoreModifierFlagShift | SRCoreModifierFlagCommand),
+        UInt64(SRCoreModifierFlagControl | SRCoreModifierFlagOption),
+        UInt64(SRCoreModifierFlagShift | SRCoreModifierFlagOption | SRCoreModifierFlagCommand),
+        UInt64(SRCoreModifierFlagControl | SRCoreModifierFlagShift),
+        UInt64(SRCoreModifierFlagControl | SRCoreModifierFlagOption | SRCoreModifierFlagCommand)
+    ]
+
+    /// Distinct key downs, same distribution as in SRShortcutMonitorBenchmarks.
+    func makeKeys(count aCount: Int) -> [SRCoreShortcutKey] {
+        return (0..<aCount).map {
+            SRCoreShortcutKeyMake(SRCoreKeyCode($0 % 128), modifierFlags[($0 / 128) % modifierFlags.count], true)
+        }
+    }
+
+    func lookup(actionCount anActionCount: Int) throws {
+        let keys = makeKeys(count: anActionCount)
+        var table = SRCoreActionTable()
+        SRCoreActionTableInit(&table)
+        defer { SRCoreActionTableDestroy(&table) }
+
+        for (i, key) in keys.enumerated() {
+            SRCoreActionTableAddAction(&table, key, UnsafeRawPointer(bitPattern: i + 1)!, SRCoreActionRank(priority: 0, sequence: UInt64(i)))
+        }
+
+        var i = 0
+        try benchmark("SRCoreActionTable.lookup.\(anActionCount)") { () -> UInt32 in
+            i = (i + 1) % keys.count
+            return SRCoreActionTableGetEntry(&table, keys[i]).pointee.count
+        }
+    }
+
+    func testLookup10() throws {
+        try lookup(actionCount: 10)
+    }
+
+    func testLookup1k() throws {
+        try lookup(actionCount: 1_000)
+    }
+
+    func testSequenceStep() throws {
+        let keys = makeKeys(count: 300)
+        var table = SRCoreSequenceTable()
+        SRCoreSequenceTableInit(&table)
+        defer { SRCoreSequenceTableDestroy(&table) }
+
+        for i in 0..<100 {
+            SRCoreSequenceTableAddSequence(&table, Array(keys[i * 3..<i * 3 + 3]), 3, UnsafeRawPointer(bitPattern: i + 1)!)
+        }
+
+        var i = 0
+        var state = SRCoreSequenceRootState
+        var actions: UnsafeRawPointer? = nil
+        try benchmark("SRCoreSequenceTable.step") { () -> SRCoreSequenceStep in
+            i = (i + 1) % keys.count
+            let currentState = state
+            return SRCoreSequenceTableStep(&table, currentState, keys[i], &state, &actions)
+        }
+    }
+
+    func testModifierGestureUpdate() throws {
+        let option = SRCoreKeyCode(SRCoreKeyCodeOption)
+        let gestures = [
+            SRCoreModifierGesture(kind: SRCoreModifierGestureKind(SRCoreModifierGestureKindTap), interval: 300),
+            SRCoreModifierGesture(kind: SRCoreModifierGestureKind(SRCoreModifierGestureKindDoubleTap), interval: 250),
+            SRCoreModifierGesture(kind: SRCoreModifierGestureKind(SRCoreModifierGestureKindHold), interval: 500)
+        ]
+        var state = SRCoreModifierGestureState()
+        SRCoreModifierGestureStateInit(&state)
+        var matches = [Int](repeating: 0, count: gestures.count)
+        var time: UInt64 = 0
+
+        try benchmark("SRCoreModifierGestureState.update") { () -> Int in
+            time += 100
+            return SRCoreModifierGestureStateUpdate(&state, option, time % 200 == 100, time, gestures, gestures.count, &matches)
+        }
+    }
+
+    func testQuartzEventKey() throws {
+        let quartzFlags = modifierFlags.map { $0 | UInt64(SRCoreDeviceModifierFlagLeftShift) }
+        var i = 0
+
+        try benchmark("SRCoreShortcutKey.makeWithQuartzFlags") { () -> SRCoreShortcutKey in
+            i = (i + 1) % 1024
+            return SRCoreShortcutKeyMake(SRCoreKeyCode(i % 128), SRCoreQuartzToCocoaFlags(quartzFlags[i % quartzFlags.count]), true)
+        }
+    }
+
+    func testCallbackDurationPercentile() throws {
+        let ring = (0..<Int(SRCoreCallbackDurationsCapacity)).map { UInt64(($0 * 7919) % 1000) }
+        var durations = ring
+
+        // The ring is sorted in place: restore the order of recording before every run.
+        try benchmark("SRCoreCallbackDurationAtPercentile", iterations: 10_000) { () -> UInt64 in
+            for j in 0..<ring.count {
+                durations[j] = ring[j]
+            }
+            return SRCoreCallbackDurationAtPercentile(&durations, ring.count, 99)
+        }
+    }
+}
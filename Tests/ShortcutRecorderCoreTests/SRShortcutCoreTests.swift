@@ -0,0 +1,368 @@
+//
+//  Copyright 2019 ShortcutRecorder Contributors
+//  CC BY 4.0
+//
+
+import XCTest
+
+import ShortcutRecorderCore
+
+
+class SRShortcutCoreTests: XCTestCase {
+    let shift = UInt64(SRCoreModifierFlagShift)
+    let control = UInt64(SRCoreModifierFlagControl)
+    let option = UInt64(SRCoreModifierFlagOption)
+    let command = UInt64(SRCoreModifierFlagCommand)
+
+    func testCarbonFlagsConversion() {
+        let carbonFlags: [(UInt32, UInt64)] = [
+            (UInt32(SRCoreCarbonModifierFlagCommand), command),
+            (UInt32(SRCoreCarbonModifierFlagOption), option),
+            (UInt32(SRCoreCarbonModifierFlagControl), control),
+            (UInt32(SRCoreCarbonModifierFlagShift), shift)
+        ]
+
+        for mask in 0..<16 {
+            var carbon: UInt32 = 0
+            var cocoa: UInt64 = 0
+
+            for (i, (carbonFlag, cocoaFlag)) in carbonFlags.enumerated() where mask & (1 << i) != 0 {
+                carbon |= carbonFlag
+                cocoa |= cocoaFlag
+            }
+
+            XCTAssertEqual(SRCoreCarbonToCocoaFlags(carbon), cocoa)
+            XCTAssertEqual(SRCoreCarbonToCocoaFlags(carbon | 1 << 10), cocoa, "caps lock is ignored")
+            XCTAssertEqual(SRCoreCocoaToCarbonFlags(cocoa), carbon)
+            XCTAssertEqual(SRCoreCocoaToCarbonFlags(cocoa | 1 << 16), carbon, "caps lock is ignored")
+        }
+    }
+
+    func testModifierKeyDown() {
+        let leftShift = UInt64(SRCoreDeviceModifierFlagLeftShift)
+        let rightShift = UInt64(SRCoreDeviceModifierFlagRightShift)
+        let leftShiftKey = SRCoreKeyCode(SRCoreKeyCodeShift)
+        let rightShiftKey = SRCoreKeyCode(SRCoreKeyCodeRightShift)
+
+        XCTAssertEqual(SRCoreModifierFlagForKeyCode(rightShiftKey), shift)
+        XCTAssertEqual(SRCoreModifierFlagForKeyCode(0), 0)
+
+        XCTAssertTrue(SRCoreIsModifierKeyDown(leftShiftKey, shift | leftShift | rightShift))
+        XCTAssertFalse(SRCoreIsModifierKeyDown(rightShiftKey, shift | leftShift))
+        XCTAssertTrue(SRCoreIsModifierKeyDown(rightShiftKey, shift), "device-independent flags are used without device flags")
+        XCTAssertFalse(SRCoreIsModifierKeyDown(rightShiftKey, command))
+    }
+
+    func testShortcutKey() {
+        let key = SRCoreShortcutKeyMake(0x7F, command | shift | 1 << 16, true)
+
+        XCTAssertEqual(SRCoreShortcutKeyGetKeyCode(key), 0x7F)
+        XCTAssertEqual(SRCoreShortcutKeyGetModifierFlags(key), command | shift)
+        XCTAssertTrue(SRCoreShortcutKeyIsKeyDown(key))
+        XCTAssertFalse(SRCoreShortcutKeyIsRepeat(key))
+        XCTAssertFalse(SRCoreShortcutKeyIsKeyDown(SRCoreShortcutKeyMake(0x7F, command, false)))
+
+        let repeatKey = key | SRCoreShortcutKey(SRCoreShortcutKeyRepeatMask)
+        XCTAssertTrue(SRCoreShortcutKeyIsRepeat(repeatKey))
+        XCTAssertEqual(SRCoreShortcutKeyGetLookupKey(repeatKey), key)
+    }
+
+    func testTableIndex() {
+        for keyCode in SRCoreKeyCode(0)..<128 {
+            let key = SRCoreShortcutKeyMake(keyCode, command, true)
+            XCTAssertLessThan(SRCoreShortcutKeyTableIndex(key, 4), 16)
+            XCTAssertLessThan(SRCoreSequenceTransitionIndex(SRCoreSequenceInput(1, key), 4), 16)
+        }
+    }
+
+    func testActionTable() {
+        func action(_ i: Int) -> UnsafeRawPointer { UnsafeRawPointer(bitPattern: i)! }
+
+        func actions(_ table: inout SRCoreActionTable, _ key: SRCoreShortcutKey) -> [UnsafeRawPointer] {
+            guard let entry = SRCoreActionTableGetEntry(&table, key) else { return [] }
+            return (0..<Int(entry.pointee.count)).map { entry.pointee.actions[$0]! }
+        }
+
+        var table = SRCoreActionTable()
+        XCTAssertTrue(SRCoreActionTableInit(&table))
+        defer { SRCoreActionTableDestroy(&table) }
+
+        // Enough keys to resize the table a few times.
+        let keys = (0..<512).map { SRCoreShortcutKeyMake(SRCoreKeyCode($0 % 128), UInt64($0 / 128) << 17, true) }
+        for (i, key) in keys.enumerated() {
+            SRCoreActionTableAddAction(&table, key, action(i + 1), SRCoreActionRank(priority: 0, sequence: UInt64(i)))
+        }
+
+        XCTAssertEqual(table.count, keys.count)
+        XCTAssertLessThanOrEqual(table.count * 2, SRCoreActionTableCapacity(&table))
+
+        for (i, key) in keys.enumerated() where i % 2 == 0 {
+            XCTAssertTrue(SRCoreActionTableRemoveAction(&table, key, action(i + 1), SRCoreActionRank(priority: 0, sequence: UInt64(i))))
+        }
+
+        XCTAssertEqual(table.count, keys.count / 2)
+
+        for (i, key) in keys.enumerated() {
+            XCTAssertEqual(SRCoreActionTableContainsAction(&table, key, action(i + 1)), i % 2 != 0, "backward shift deletion keeps the clusters intact")
+        }
+
+        // Actions of a key are ordered by priority, then by the order of addition.
+        let key = SRCoreShortcutKeyMake(0, 0, false)
+        let low = SRCoreActionRank(priority: 0, sequence: 1)
+        let high = SRCoreActionRank(priority: 10, sequence: 2)
+        let recent = SRCoreActionRank(priority: 0, sequence: 3)
+        SRCoreActionTableAddAction(&table, key, action(1001), low)
+        SRCoreActionTableAddAction(&table, key, action(1002), high)
+        SRCoreActionTableAddAction(&table, key, action(1003), recent)
+        XCTAssertEqual(actions(&table, key), [action(1001), action(1003), action(1002)])
+
+        let highest = SRCoreActionRank(priority: 20, sequence: 1)
+        XCTAssertTrue(SRCoreActionTableMoveAction(&table, key, action(1001), low, highest))
+        XCTAssertEqual(actions(&table, key), [action(1003), action(1002), action(1001)])
+        XCTAssertFalse(SRCoreActionTableMoveAction(&table, key, action(1001), low, highest), "the old rank is stale")
+        XCTAssertFalse(SRCoreActionTableRemoveAction(&table, key, action(1004), low))
+
+        // Copies share the contexts but not the actions.
+        var counter = 0
+        withUnsafeMutablePointer(to: &counter) { counterPointer in
+            SRCoreActionTableGetEntry(&table, key).pointee.context = UnsafeMutableRawPointer(counterPointer)
+
+            var copy = SRCoreActionTable()
+            XCTAssertTrue(SRCoreActionTableCopy(&copy, &table))
+            defer { SRCoreActionTableDestroy(&copy) }
+
+            XCTAssertTrue(SRCoreActionTableRemoveAction(&table, key, action(1003), recent))
+            XCTAssertEqual(actions(&table, key), [action(1002), action(1001)])
+            XCTAssertEqual(actions(&copy, key), [action(1003), action(1002), action(1001)])
+            XCTAssertEqual(SRCoreActionTableGetEntry(&copy, key).pointee.context, UnsafeMutableRawPointer(counterPointer))
+        }
+
+        XCTAssertTrue(SRCoreActionTableRemoveAction(&table, key, action(1002), high))
+        XCTAssertTrue(SRCoreActionTableRemoveAction(&table, key, action(1001), highest))
+        XCTAssertNil(SRCoreActionTableGetEntry(&table, key), "the key is removed along with its last action")
+    }
+
+    func testSequenceTable() {
+        let controlX = SRCoreShortcutKeyMake(7, control, true)
+        let controlS = SRCoreShortcutKeyMake(1, control, true)
+        let controlF = SRCoreShortcutKeyMake(3, control, true)
+        let save = UnsafeRawPointer(bitPattern: 1)!
+        let find = UnsafeRawPointer(bitPattern: 2)!
+
+        var table = SRCoreSequenceTable()
+        XCTAssertTrue(SRCoreSequenceTableInit(&table))
+        defer { SRCoreSequenceTableDestroy(&table) }
+
+        SRCoreSequenceTableAddSequence(&table, [controlX, controlS], 2, save)
+        SRCoreSequenceTableAddSequence(&table, [controlX, controlF], 2, find)
+
+        // Enough sequences to resize the table a few times.
+        let sequences = (0..<100).map { i in (0..<3).map { SRCoreShortcutKeyMake(SRCoreKeyCode(i + $0), command, true) } }
+        for (i, sequence) in sequences.enumerated() {
+            SRCoreSequenceTableAddSequence(&table, sequence, sequence.count, UnsafeRawPointer(bitPattern: 100 + i)!)
+        }
+
+        XCTAssertLessThanOrEqual(table.count * 2, 1 << table.capacityLog2)
+
+        var state = SRCoreSequenceRootState
+        var actions: UnsafeRawPointer? = nil
+
+        func step(_ key: SRCoreShortcutKey) -> Int {
+            let currentState = state
+            return Int(SRCoreSequenceTableStep(&table, currentState, key, &state, &actions))
+        }
+
+        XCTAssertEqual(step(controlX), Int(SRCoreSequenceStepPrefix))
+        XCTAssertEqual(step(controlF), Int(SRCoreSequenceStepComplete))
+        XCTAssertEqual(actions, find)
+        XCTAssertEqual(state, SRCoreSequenceRootState)
+
+        XCTAssertEqual(step(controlS), Int(SRCoreSequenceStepNone))
+        XCTAssertEqual(state, SRCoreSequenceRootState)
+
+        // An abandoned sequence may be followed by the beginning of another one.
+        XCTAssertEqual(step(controlX), Int(SRCoreSequenceStepPrefix))
+        XCTAssertEqual(step(controlX), Int(SRCoreSequenceStepPrefix))
+        XCTAssertEqual(step(controlS), Int(SRCoreSequenceStepComplete))
+        XCTAssertEqual(actions, save)
+
+        // Auto-repeats are consumed in the middle of a sequence and ignored otherwise.
+        let repeatControlX = controlX | SRCoreShortcutKey(SRCoreShortcutKeyRepeatMask)
+        XCTAssertEqual(step(repeatControlX), Int(SRCoreSequenceStepNone))
+        XCTAssertEqual(step(controlX), Int(SRCoreSequenceStepPrefix))
+        let prefixState = state
+        XCTAssertEqual(step(repeatControlX), Int(SRCoreSequenceStepPrefix))
+        XCTAssertEqual(state, prefixState)
+        XCTAssertEqual(step(controlS), Int(SRCoreSequenceStepComplete))
+
+        for (i, sequence) in sequences.enumerated() {
+            XCTAssertEqual(step(sequence[0]), Int(SRCoreSequenceStepPrefix))
+            XCTAssertEqual(step(sequence[1]), Int(SRCoreSequenceStepPrefix))
+            XCTAssertEqual(step(sequence[2]), Int(SRCoreSequenceStepComplete))
+            XCTAssertEqual(actions, UnsafeRawPointer(bitPattern: 100 + i))
+        }
+    }
+
+    func testModifierGestures() {
+        let option = SRCoreKeyCode(SRCoreKeyCodeOption)
+        let command = SRCoreKeyCode(SRCoreKeyCodeCommand)
+        let gestures = [
+            SRCoreModifierGesture(kind: SRCoreModifierGestureKind(SRCoreModifierGestureKindTap), interval: 300),
+            SRCoreModifierGesture(kind: SRCoreModifierGestureKind(SRCoreModifierGestureKindDoubleTap), interval: 250),
+            SRCoreModifierGesture(kind: SRCoreModifierGestureKind(SRCoreModifierGestureKindHold), interval: 500)
+        ]
+        var state = SRCoreModifierGestureState()
+        SRCoreModifierGestureStateInit(&state)
+
+        func update(_ keyCode: SRCoreKeyCode, _ isDown: Bool, _ now: UInt64) -> [Int] {
+            var matches = [Int](repeating: 0, count: gestures.count)
+            let count = SRCoreModifierGestureStateUpdate(&state, keyCode, isDown, now, gestures, gestures.count, &matches)
+            return Array(matches[0..<count])
+        }
+
+        func advance(_ now: UInt64) -> [Int] {
+            var matches = [Int](repeating: 0, count: gestures.count)
+            let count = SRCoreModifierGestureStateAdvance(&state, now, gestures, gestures.count, &matches)
+            return Array(matches[0..<count])
+        }
+
+        // Tap, then a double-tap that also reports a tap.
+        XCTAssertEqual(update(option, true, 0), [])
+        XCTAssertEqual(update(option, false, 100), [0])
+        XCTAssertEqual(update(option, true, 200), [])
+        XCTAssertEqual(SRCoreModifierGestureStateNextHoldDelay(&state, 250, gestures, gestures.count), 450)
+        XCTAssertEqual(update(option, false, 300), [0, 1])
+
+        // A triple tap makes just one double-tap.
+        XCTAssertEqual(update(option, true, 400), [])
+        XCTAssertEqual(update(option, false, 450), [0])
+
+        // A held key is not a tap.
+        XCTAssertEqual(update(option, true, 1000), [])
+        XCTAssertEqual(advance(1400), [])
+        XCTAssertEqual(advance(1600), [2])
+        XCTAssertEqual(advance(1700), [])
+        XCTAssertEqual(update(option, false, 1800), [])
+
+        // Another modifier cancels the gesture.
+        XCTAssertEqual(update(option, true, 2000), [])
+        XCTAssertEqual(update(command, true, 2050), [])
+        XCTAssertEqual(update(command, false, 2100), [])
+        XCTAssertEqual(update(option, false, 2150), [])
+        XCTAssertEqual(advance(3000), [])
+
+        // So does a non-modifier key.
+        XCTAssertEqual(update(option, true, 4000), [])
+        SRCoreModifierGestureStateCancel(&state)
+        XCTAssertEqual(update(option, false, 4050), [])
+        XCTAssertEqual(SRCoreModifierGestureStateNextHoldDelay(&state, 4100, gestures, gestures.count), UInt64.max)
+    }
+
+    func testEventTapReenableDelay() {
+        // An occasional disable re-enables the tap immediately.
+        XCTAssertEqual(SRCoreEventTapReenableDelay(0, .greatestFiniteMagnitude), 0)
+        XCTAssertEqual(SRCoreEventTapReenableDelay(0, 30), 0)
+
+        // Disables in quick succession double the delay.
+        var delay = SRCoreEventTapReenableDelay(0, 1)
+        XCTAssertEqual(delay, 0.1)
+
+        for expected in [0.2, 0.4, 0.8, 1.6, 3.2, 6.4, 10, 10] {
+            delay = SRCoreEventTapReenableDelay(delay, 1)
+            XCTAssertEqual(delay, expected, accuracy: 1e-9)
+        }
+
+        XCTAssertEqual(SRCoreEventTapReenableDelay(9, 29.9), 10, "the delay is capped")
+
+        // A quiet period resets the backoff.
+        XCTAssertEqual(SRCoreEventTapReenableDelay(delay, 30), 0)
+        XCTAssertEqual(SRCoreEventTapReenableDelay(0, 1), 0.1)
+    }
+
+    func testCallbackDurationPercentiles() {
+        let capacity = Int(SRCoreCallbackDurationsCapacity)
+        var ring = [UInt64](repeating: 0, count: capacity)
+        var count = 0
+
+        func record(_ duration: UInt64) {
+            ring[SRCoreCallbackDurationsIndex(count)] = duration
+            count += 1
+        }
+
+        func percentile(_ percentile: Double) -> UInt64 {
+            var durations = ring
+            return SRCoreCallbackDurationAtPercentile(&durations, count, percentile)
+        }
+
+        XCTAssertEqual(percentile(50), 0, "nothing is recorded")
+
+        // Partially filled ring: recorded in reverse so that sorting matters.
+        for duration in stride(from: UInt64(10), through: 1, by: -1) {
+            record(duration)
+        }
+
+        XCTAssertEqual(percentile(0), 1)
+        XCTAssertEqual(percentile(50), 5)
+        XCTAssertEqual(percentile(99), 10)
+        XCTAssertEqual(percentile(100), 10)
+
+        // Full ring keeps only the last 128 of 1...300, i.e. 173...300.
+        count = 0
+        for duration in UInt64(1)...300 {
+            record(duration)
+        }
+
+        XCTAssertEqual(count, 300)
+        XCTAssertEqual(percentile(0), 173)
+        XCTAssertEqual(percentile(50), 236)
+        XCTAssertEqual(percentile(99), 299)
+        XCTAssertEqual(percentile(100), 300)
+    }
+
+    func testTrace() {
+        let keyDown = SRCoreShortcutKeyMake(SRCoreKeyCode(0x7F), command | shift, true)
+        let events = [
+            SRCoreTraceEvent(timestamp: 0, duration: 10, key: keyDown, isHandled: true),
+            SRCoreTraceEvent(timestamp: 500, duration: 20, key: keyDown | SRCoreShortcutKey(SRCoreShortcutKeyRepeatMask), isHandled: false),
+            SRCoreTraceEvent(timestamp: 1_000, duration: UInt32.max, key: SRCoreShortcutKeyMake(0x7F, command | shift, false), isHandled: true)
+        ]
+        var bytes = withUnsafeBytes(of: SRCoreTraceHeaderMake(42)) { Array($0) }
+        for var event in events {
+            bytes += withUnsafeBytes(of: SRCoreTraceRecordMake(&event)) { Array($0) }
+        }
+
+        // The format is little-endian regardless of the host.
+        XCTAssertEqual(Array(bytes[0..<4]), Array("SRTR".utf8))
+        XCTAssertEqual(Array(bytes[16..<24]), [0, 0, 0, 0, 0, 0, 0, 0])
+        XCTAssertEqual(Array(bytes[32..<40]), [0xF4, 0x01, 0, 0, 0, 0, 0, 0])
+
+        // A trailing partial record of an interrupted recording is ignored.
+        bytes.append(0)
+
+        var count = 0
+        XCTAssertTrue(SRCoreTraceGetRecordCount(bytes, bytes.count, &count))
+        XCTAssertEqual(count, events.count)
+        XCTAssertFalse(SRCoreTraceGetRecordCount(bytes, MemoryLayout<SRCoreTraceHeader>.size - 1, &count))
+        XCTAssertFalse(SRCoreTraceGetRecordCount(Array(bytes.reversed()), bytes.count, &count))
+
+        for (i, event) in events.enumerated() {
+            let decodedEvent = SRCoreTraceGetEvent(bytes, i)
+            XCTAssertEqual(decodedEvent.timestamp, event.timestamp)
+            XCTAssertEqual(decodedEvent.duration, event.duration)
+            XCTAssertEqual(decodedEvent.key, event.key)
+            XCTAssertEqual(decodedEvent.isHandled, event.isHandled)
+        }
+
+        // The replay clock advances by the recorded timestamps from the origin.
+        var times: [UInt64] = []
+        var mismatchCount = 0
+        withUnsafeMutablePointer(to: &times) { timesPointer in
+            XCTAssertTrue(SRCoreTraceReplay(bytes, bytes.count, 1_000, { aContext, anEvent, aTime in
+                aContext!.assumingMemoryBound(to: [UInt64].self).pointee.append(aTime)
+                return !SRCoreShortcutKeyIsRepeat(anEvent!.pointee.key)
+            }, timesPointer, &mismatchCount))
+        }
+        XCTAssertEqual(times, [1_000, 1_500, 2_000])
+        XCTAssertEqual(mismatchCount, 0)
+    }
+}
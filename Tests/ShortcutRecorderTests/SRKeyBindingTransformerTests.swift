@@ -16,6 +16,15 @@ class SRKeyBindingTransformerTests: XCTestCase {
         XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("@A"), shift_cmd_a)
         XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("$@a"), shift_cmd_a)
         XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("$@A"), shift_cmd_a)
+        XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("@#1")?.keyCode, KeyCode.ansiKeypad1)
+        XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("@1")?.keyCode, KeyCode.ansi1)
+    }
+
+    func testTransformOfKeypadKeys() {
+        XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("@#.")?.keyCode, KeyCode.ansiKeypadDecimal)
+        XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("@#/")?.keyCode, KeyCode.ansiKeypadDivide)
+        XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("@.")?.keyCode, KeyCode.ansiPeriod)
+        XCTAssertEqual(KeyBindingTransformer.shared.transformedValue("@/")?.keyCode, KeyCode.ansiSlash)
     }
 
     func testReverseTransform() {
@@ -23,5 +32,6 @@ class SRKeyBindingTransformerTests: XCTestCase {
         let shift_cmd_a = Shortcut(keyEquivalent: "⇧⌘A")
         XCTAssertEqual(KeyBindingTransformer.shared.reverseTransformedValue(cmd_a), "@a")
         XCTAssertEqual(KeyBindingTransformer.shared.reverseTransformedValue(shift_cmd_a), "$@a")
+        XCTAssertEqual(KeyBindingTransformer.shared.reverseTransformedValue(Shortcut(code: KeyCode.ansiKeypad1, modifierFlags: .command, characters: nil, charactersIgnoringModifiers: nil)), "@#1")
     }
 }
@@ -22,6 +22,169 @@ class SRKeyCodeTransformerTests: XCTestCase {
         c.objectValue = Shortcut(code: KeyCode.tab, modifierFlags: [], characters: nil, charactersIgnoringModifiers: nil)
         XCTAssertEqual(c.stringValue, "\u{21E4}")
     }
+
+    func testImplicitModifierFlagsAlterTranslation() {
+        let us_input = TISInputSource.withIdentifier("com.apple.keylayout.US")!
+        let transformer = LiteralKeyCodeTransformer(inputSource: us_input)
+
+        func literal(_ implicitFlags: NSEvent.ModifierFlags, _ explicitFlags: NSEvent.ModifierFlags = []) -> String? {
+            return transformer.literal(forKeyCode: KeyCode.ansi1,
+                                       withImplicitModifierFlags: implicitFlags,
+                                       explicitModifierFlags: explicitFlags,
+                                       layoutDirection: .leftToRight)
+        }
+
+        XCTAssertEqual(literal([]), "1")
+        XCTAssertEqual(literal([.shift]), "!")
+        XCTAssertEqual(literal([.option]), "¡")
+        XCTAssertEqual(literal([], [.shift]), "1")
+    }
+
+    func testDeadKeyCompose() {
+        let us_input = TISInputSource.withIdentifier("com.apple.keylayout.US")!
+        let transformer = LiteralKeyCodeTransformer(inputSource: us_input)
+
+        XCTAssertTrue(transformer.isDeadKeyCode(KeyCode.ansiE, withModifierFlags: [.option]))
+        XCTAssertFalse(transformer.isDeadKeyCode(KeyCode.ansiE, withModifierFlags: []))
+
+        func literal(_ flags: NSEvent.ModifierFlags) -> String? {
+            return transformer.literal(forKeyCode: KeyCode.ansiE,
+                                       withImplicitModifierFlags: flags,
+                                       afterDeadKeyCode: KeyCode.ansiE,
+                                       deadKeyImplicitModifierFlags: [.option])
+        }
+
+        XCTAssertEqual(literal([]), "é")
+        XCTAssertEqual(literal([.shift]), "É")
+        XCTAssertNil(literal([.option]))
+    }
+
+    func testInputSourceGenerationIncreasesWhenInputSourceChanges() {
+        let generation = LiteralKeyCodeTransformer.inputSourceGeneration
+        let isChanged = expectation(forNotification: .SRKeyCodeTransformerInputSourceDidChange, object: nil)
+
+        DistributedNotificationCenter.default().postNotificationName(NSNotification.Name(kTISNotifySelectedKeyboardInputSourceChanged as String),
+                                                                     object: nil,
+                                                                     userInfo: nil,
+                                                                     deliverImmediately: true)
+        wait(for: [isChanged], timeout: 10.0)
+
+        XCTAssertGreaterThan(LiteralKeyCodeTransformer.inputSourceGeneration, generation)
+    }
+}
+
+
+/// Internal interface of _SRKeyCodeTranslationTable.
+@objc private protocol KeyCodeTranslationTable {
+    static var cacheDirectoryURL: URL? { get set }
+    static func data(withLayoutData: CFData, keyboardType: UInt32, layoutHash: UInt64) -> Data
+    static func table(withLayoutData: CFData, keyboardType: UInt32) -> KeyCodeTranslationTable
+    init?(data: Data, layoutHash: UInt64, keyboardType: UInt32)
+    var isCached: Bool { get }
+    func translation(forKeyCode: UInt16, modifierFlags: NSEvent.ModifierFlags) -> String?
+}
+
+
+class SRKeyCodeTranslationTableTests: XCTestCase {
+    private var tableType: KeyCodeTranslationTable.Type!
+    private var layoutData: CFData!
+    private var cacheDirectoryURL: URL!
+    private let keyboardType = UInt32(LMGetKbdType())
+    private let layoutHash: UInt64 = 0x5352_4B54
+
+    override func setUpWithError() throws {
+        let tableClass: AnyClass = try XCTUnwrap(NSClassFromString("_SRKeyCodeTranslationTable"))
+        class_addProtocol(tableClass, KeyCodeTranslationTable.self)
+        tableType = try XCTUnwrap(tableClass as? KeyCodeTranslationTable.Type)
+
+        let us_input = try XCTUnwrap(TISInputSource.withIdentifier("com.apple.keylayout.US"))
+        let layoutDataPtr = try XCTUnwrap(TISGetInputSourceProperty(us_input, kTISPropertyUnicodeKeyLayoutData))
+        layoutData = Unmanaged<CFData>.fromOpaque(layoutDataPtr).takeUnretainedValue()
+
+        cacheDirectoryURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString, isDirectory: true)
+        tableType.cacheDirectoryURL = cacheDirectoryURL
+    }
+
+    override func tearDownWithError() throws {
+        tableType.cacheDirectoryURL = nil
+        try? FileManager.default.removeItem(at: cacheDirectoryURL)
+    }
+
+    private func makeData() -> Data {
+        return tableType.data(withLayoutData: layoutData, keyboardType: keyboardType, layoutHash: layoutHash)
+    }
+
+    private func waitForCacheFile(where predicate: @escaping (Data) -> Bool) {
+        let isWritten = expectation(description: "table is written")
+        DispatchQueue.global().async {
+            for _ in 0..<100 {
+                let fileURLs = (try? FileManager.default.contentsOfDirectory(at: self.cacheDirectoryURL, includingPropertiesForKeys: nil)) ?? []
+
+                if fileURLs.contains(where: { (try? Data(contentsOf: $0)).map(predicate) ?? false }) {
+                    isWritten.fulfill()
+                    return
+                }
+
+                Thread.sleep(forTimeInterval: 0.05)
+            }
+        }
+        wait(for: [isWritten], timeout: 10.0)
+    }
+
+    func testDataRoundTrip() {
+        let table = tableType.init(data: makeData(), layoutHash: layoutHash, keyboardType: keyboardType)
+        XCTAssertNotNil(table)
+        XCTAssertEqual(table?.translation(forKeyCode: KeyCode.ansiA.rawValue, modifierFlags: []), "a")
+        XCTAssertEqual(table?.translation(forKeyCode: KeyCode.ansiA.rawValue, modifierFlags: [.shift]), "A")
+        XCTAssertEqual(table?.isCached, false)
+    }
+
+    func testTruncatedDataIsRejected() {
+        let data = makeData()
+        XCTAssertNil(tableType.init(data: data.prefix(data.count - 1), layoutHash: layoutHash, keyboardType: keyboardType))
+        XCTAssertNil(tableType.init(data: data.prefix(data.count / 2), layoutHash: layoutHash, keyboardType: keyboardType))
+        XCTAssertNil(tableType.init(data: data.prefix(8), layoutHash: layoutHash, keyboardType: keyboardType))
+        XCTAssertNil(tableType.init(data: Data(), layoutHash: layoutHash, keyboardType: keyboardType))
+    }
+
+    func testWrongVersionIsRejected() {
+        var data = makeData()
+        // Version follows the 4-byte magic.
+        data[4] &+= 1
+        XCTAssertNil(tableType.init(data: data, layoutHash: layoutHash, keyboardType: keyboardType))
+    }
+
+    func testWrongHashIsRejected() {
+        let data = makeData()
+        XCTAssertNil(tableType.init(data: data, layoutHash: layoutHash + 1, keyboardType: keyboardType))
+        XCTAssertNil(tableType.init(data: data, layoutHash: layoutHash, keyboardType: keyboardType + 1))
+    }
+
+    func testTableIsCachedAndReused() {
+        let built = tableType.table(withLayoutData: layoutData, keyboardType: keyboardType)
+        XCTAssertFalse(built.isCached)
+        waitForCacheFile { $0.prefix(4) == Data("SRKT".utf8) }
+
+        let reused = tableType.table(withLayoutData: layoutData, keyboardType: keyboardType)
+        XCTAssertTrue(reused.isCached)
+        XCTAssertEqual(reused.translation(forKeyCode: KeyCode.ansiA.rawValue, modifierFlags: []), "a")
+    }
+
+    func testDamagedCacheIsRebuilt() throws {
+        _ = tableType.table(withLayoutData: layoutData, keyboardType: keyboardType)
+        waitForCacheFile { $0.prefix(4) == Data("SRKT".utf8) }
+
+        let fileURL = try XCTUnwrap(FileManager.default.contentsOfDirectory(at: cacheDirectoryURL, includingPropertiesForKeys: nil).first)
+        let validData = try Data(contentsOf: fileURL)
+        try validData.prefix(validData.count / 2).write(to: fileURL)
+
+        let rebuilt = tableType.table(withLayoutData: layoutData, keyboardType: keyboardType)
+        XCTAssertFalse(rebuilt.isCached)
+        XCTAssertEqual(rebuilt.translation(forKeyCode: KeyCode.ansiA.rawValue, modifierFlags: []), "a")
+        waitForCacheFile { $0 == validData }
+
+        XCTAssertTrue(tableType.table(withLayoutData: layoutData, keyboardType: keyboardType).isCached)
+    }
 }
 
 
@@ -244,6 +407,27 @@ class SRASCIILiteralKeyCodeTransformerTests: XCTestCase {
         AssertEqual(literal: "*", code: KeyCode.ansiKeypadMultiply);
         AssertEqual(literal: "+", code: KeyCode.ansiKeypadPlus);
     }
+
+    func testReverseTransformOfModifiedKeys() {
+        func AssertEqual(literal: String, code: KeyCode, flags: NSEvent.ModifierFlags) {
+            XCTContext.runActivity(named: literal) { (_) in
+                var implicitFlags: NSEvent.ModifierFlags = []
+                let keyCode = ASCIILiteralKeyCodeTransformer.shared.reverseTransformedValue(literal, implicitModifierFlags: &implicitFlags)
+                XCTAssertEqual(keyCode?.uint16Value, code.rawValue)
+                XCTAssertEqual(implicitFlags, flags)
+            }
+        }
+
+        AssertEqual(literal: "a", code: KeyCode.ansiA, flags: [])
+        AssertEqual(literal: "A", code: KeyCode.ansiA, flags: [])
+        AssertEqual(literal: "!", code: KeyCode.ansi1, flags: [.shift])
+        AssertEqual(literal: "?", code: KeyCode.ansiSlash, flags: [.shift])
+        AssertEqual(literal: "å", code: KeyCode.ansiA, flags: [.option])
+        AssertEqual(literal: "Å", code: KeyCode.ansiA, flags: [.shift, .option])
+
+        XCTAssertNil(ASCIILiteralKeyCodeTransformer.shared.reverseTransformedValue("!"), "implied Shift must not be dropped")
+        XCTAssertNil(ASCIILiteralKeyCodeTransformer.shared.reverseTransformedValue("å"), "implied Option must not be dropped")
+    }
 }
 
 
@@ -459,4 +643,16 @@ class SRASCIISymbolicKeyCodeTransformerTests: XCTestCase {
         AssertEqual(symbol: "*", code: KeyCode.ansiKeypadMultiply);
         AssertEqual(symbol: "+", code: KeyCode.ansiKeypadPlus);
     }
+
+    func testReverseTransformOfSpecialKeySymbols() {
+        let transformer = ASCIISymbolicKeyCodeTransformer.shared
+
+        for keyCode in [KeyCode.space, .delete, .forwardDelete, .escape, .return, .ansiKeypadEnter, .tab, .ansiKeypadClear] {
+            let symbol = transformer.symbol(forKeyCode: keyCode,
+                                            withImplicitModifierFlags: [],
+                                            explicitModifierFlags: [],
+                                            layoutDirection: .leftToRight)!
+            XCTAssertEqual(transformer.reverseTransformedValue(symbol) as! UInt16, keyCode.rawValue, "\(keyCode)")
+        }
+    }
 }
@@ -4,6 +4,7 @@
 //
 
 import XCTest
+import Carbon.HIToolbox
 
 import ShortcutRecorder
 
@@ -329,6 +330,28 @@ class SRShortcutActionTests: XCTestCase {
         action.perform(onTarget: nil)
         wait(for: [target.expectation], timeout: 0)
     }
+
+    func testChangesAfterPerformAreRespected() {
+        let target = Target()
+        target.expectation.expectedFulfillmentCount = 3
+        let action = ShortcutAction(shortcut: .default, target: target, action: #selector(Target.action(_:)), tag: 0)
+        XCTAssertTrue(action.perform(onTarget: nil))
+
+        action.action = #selector(Target.anotherAction)
+        XCTAssertTrue(action.perform(onTarget: nil))
+
+        action.action = nil
+        XCTAssertTrue(action.perform(onTarget: nil))
+
+        let anotherTarget = Target()
+        action.target = anotherTarget
+        action.action = #selector(Target.action(_:))
+        XCTAssertTrue(action.perform(onTarget: nil))
+        wait(for: [target.expectation, anotherTarget.expectation], timeout: 0)
+
+        action.actionHandler = { _ in false }
+        XCTAssertFalse(action.perform(onTarget: target))
+    }
 }
 
 
@@ -741,35 +764,497 @@ class SRShortcutMonitorTests: XCTestCase {
         XCTContext.runActivity(named: "up key event") { _ in test(.up) }
     }
 
-    func testActionAddedTwiceIsObservedJustOnce() {
-        class ObservedAction: ShortcutAction {
-            let addObserverExpectation = XCTestExpectation(description: "add observer", assertForOverFulfill: true)
-            let removeObserverExpectation = XCTestExpectation(description: "remove observer", assertForOverFulfill: true)
+    func testPriorityOrdersActionsBeforeRecency() {
+        let windowAction = ShortcutAction(shortcut: .default) {_ in true}
+        windowAction.priority = .window
+        let documentAction = ShortcutAction(shortcut: .default) {_ in true}
+        documentAction.priority = .document
+        let appAction = ShortcutAction(shortcut: .default) {_ in true}
 
-            override func addObserver(_ observer: NSObject, forKeyPath keyPath: String, options: NSKeyValueObservingOptions = [], context: UnsafeMutableRawPointer?) {
-                if keyPath == "enabled" {
-                    addObserverExpectation.fulfill()
-                }
-                super.addObserver(observer, forKeyPath: keyPath, options: options, context: context)
+        func test(_ keyEvent: KeyEventType) {
+            let monitor = TrackingMonitor()
+            monitor.addAction(windowAction, forKeyEvent: keyEvent)
+            monitor.addAction(documentAction, forKeyEvent: keyEvent)
+            monitor.addAction(appAction, forKeyEvent: keyEvent)
+            XCTAssertEqual(monitor.enabledActions(forShortcut: .default, keyEvent: keyEvent), [appAction, documentAction, windowAction])
+
+            windowAction.priority = .application
+            XCTAssertEqual(monitor.enabledActions(forShortcut: .default, keyEvent: keyEvent), [windowAction, appAction, documentAction])
+
+            monitor.addAction(windowAction, forKeyEvent: keyEvent)
+            XCTAssertEqual(monitor.enabledActions(forShortcut: .default, keyEvent: keyEvent), [appAction, windowAction, documentAction])
+
+            windowAction.priority = .window
+            monitor.removeAction(documentAction, forKeyEvent: keyEvent)
+            XCTAssertEqual(monitor.enabledActions(forShortcut: .default, keyEvent: keyEvent), [appAction, windowAction])
+        }
+
+        XCTContext.runActivity(named: "down key event") { _ in test(.down) }
+        XCTContext.runActivity(named: "up key event") { _ in test(.up) }
+    }
+
+    func testRemovalOfReboundActions() {
+        let monitor = TrackingMonitor()
+        let shortcuts = (0..<16).map {
+            Shortcut(code: KeyCode(rawValue: UInt16($0))!, modifierFlags: .command, characters: nil, charactersIgnoringModifiers: nil)
+        }
+        let actions = shortcuts.map { ShortcutAction(shortcut: $0) {_ in true} }
+        actions.forEach { monitor.addAction($0, forKeyEvent: .down); monitor.addAction($0, forKeyEvent: .up) }
+
+        for (action, shortcut) in zip(actions, shortcuts.reversed()) {
+            action.shortcut = shortcut
+        }
+        XCTAssertEqual(Set(monitor.shortcuts), Set(shortcuts))
+
+        actions[0].isEnabled = false
+        actions[0].shortcut = shortcuts[0]
+        XCTAssertEqual(monitor.enabledActions(forShortcut: shortcuts[15], keyEvent: .down), [])
+
+        actions.forEach { monitor.removeAction($0, forKeyEvent: .down) }
+        XCTAssertEqual(Set(monitor.shortcuts), Set(shortcuts[0..<15]))
+        XCTAssertEqual(monitor.enabledActions(forShortcut: shortcuts[1], keyEvent: .up), [actions[14]])
+
+        actions.forEach { monitor.removeAction($0, forKeyEvent: .up) }
+        XCTAssertTrue(monitor.shortcuts.isEmpty)
+        XCTAssertTrue(monitor.actions.isEmpty)
+    }
+
+    func testActionInManyMonitors() {
+        let action = ShortcutAction(shortcut: .default) { _ in true }
+        let monitors = (0..<5).map { _ in TrackingMonitor() }
+        monitors.forEach { $0.addAction(action, forKeyEvent: .down) }
+
+        let newShortcut = Shortcut(keyEquivalent: "⌘B")!
+        action.shortcut = newShortcut
+        monitors.forEach { XCTAssertEqual($0.shortcuts, [newShortcut]) }
+
+        monitors[2].removeAction(action)
+        action.isEnabled = false
+        monitors.forEach { XCTAssertTrue($0.shortcuts.isEmpty) }
+
+        action.isEnabled = true
+        monitors.enumerated().forEach { XCTAssertEqual($1.shortcuts, $0 == 2 ? [] : [newShortcut]) }
+    }
+
+    func testEnabledActionsLookupWithManyShortcuts() {
+        let monitor = ShortcutMonitor()
+        let modifierFlags: [NSEvent.ModifierFlags] = [[], .command, [.option, .command], [.shift, .control]]
+        var actions: [ShortcutAction] = []
+
+        for keyCode in SymbolicKeyCodeTransformer.knownKeyCodes {
+            for flags in modifierFlags {
+                let shortcut = Shortcut(code: KeyCode(rawValue: keyCode.uint16Value)!, modifierFlags: flags, characters: nil, charactersIgnoringModifiers: nil)
+                let action = ShortcutAction(shortcut: shortcut) {_ in true}
+                monitor.addAction(action, forKeyEvent: .down)
+                actions.append(action)
             }
+        }
+
+        for action in actions {
+            XCTAssertEqual(monitor.enabledActions(forShortcut: action.shortcut!, keyEvent: .down), [action])
+            XCTAssertEqual(monitor.enabledActions(forShortcut: action.shortcut!, keyEvent: .up), [])
+        }
+
+        for (index, action) in actions.enumerated() where index % 2 == 0 {
+            monitor.removeAction(action)
+        }
+
+        for (index, action) in actions.enumerated() {
+            XCTAssertEqual(monitor.enabledActions(forShortcut: action.shortcut!, keyEvent: .down), index % 2 == 0 ? [] : [action])
+        }
+    }
+
+    func testBatchUpdatesAreObservedOnce() {
+        let monitor = TrackingMonitor()
+        let cmd_a = Shortcut(keyEquivalent: "⌘A")!
+        let cmd_b = Shortcut(keyEquivalent: "⌘B")!
+        let action_a = ShortcutAction(shortcut: cmd_a) {_ in true}
+        let action_b = ShortcutAction(shortcut: cmd_b) {_ in true}
+
+        monitor.performBatchUpdates {
+            monitor.addAction(action_a, forKeyEvent: .down)
+            monitor.addAction(action_b, forKeyEvent: .down)
+            monitor.performBatchUpdates {
+                monitor.removeAction(action_b)
+            }
+            XCTAssertTrue(monitor.actions.isEmpty)
+        }
+
+        XCTAssertEqual(monitor.changes, [
+            .willChangeActions(Set()),
+            .willChangeShortcuts(Set()),
+            .willAddShortcut(cmd_a),
+            .didAddShortcut(cmd_a),
+            .didChangeShortcuts(Set(), Set([cmd_a])),
+            .didChangeActions(Set(), Set([action_a]))
+        ])
+        XCTAssertEqual(monitor.enabledActions(forShortcut: cmd_a, keyEvent: .down), [action_a])
+        XCTAssertEqual(monitor.enabledActions(forShortcut: cmd_b, keyEvent: .down), [])
+    }
+
+    func testActionQueuePerformsActionsInOrder() {
+        let monitor = LocalShortcutMonitor()
+        let shortcut = Shortcut(code: .ansiA, modifierFlags: .command, characters: nil, charactersIgnoringModifiers: nil)
+        let event = NSEvent.keyEvent(with: .keyDown,
+                                     location: .zero,
+                                     modifierFlags: .command,
+                                     timestamp: 0.0,
+                                     windowNumber: 0,
+                                     context: nil,
+                                     characters: "a",
+                                     charactersIgnoringModifiers: "a",
+                                     isARepeat: false,
+                                     keyCode: 0)!
+        let expectation = XCTestExpectation(description: "actions performed")
+        expectation.expectedFulfillmentCount = 3
+        expectation.assertForOverFulfill = true
+        var performedTags: [Int] = []
+        let action = ShortcutAction(shortcut: shortcut) { action in
+            XCTAssertFalse(Thread.isMainThread)
+            performedTags.append(performedTags.count)
+            expectation.fulfill()
+            return false
+        }
+        monitor.addAction(action, forKeyEvent: .down)
+        monitor.actionQueue = DispatchQueue(label: "actions")
+
+        for _ in 0..<3 {
+            XCTAssertTrue(monitor.handle(event, withTarget: nil))
+        }
+
+        wait(for: [expectation], timeout: 1.0)
+        XCTAssertEqual(performedTags, [0, 1, 2])
+        XCTAssertEqual(monitor.actionQueueEnqueuedCount, 3)
+        XCTAssertEqual(monitor.actionQueueOverflowCount, 0)
+
+        monitor.removeAllActions()
+        XCTAssertFalse(monitor.handle(event, withTarget: nil))
+    }
+
+    func testMetrics() {
+        let monitor = LocalShortcutMonitor()
+        let cmd_a = Shortcut(code: .ansiA, modifierFlags: .command, characters: nil, charactersIgnoringModifiers: nil)
+        let cmd_b = Shortcut(code: .ansiB, modifierFlags: .command, characters: nil, charactersIgnoringModifiers: nil)
+        func makeEvent(_ keyCode: UInt16) -> NSEvent {
+            return NSEvent.keyEvent(with: .keyDown,
+                                    location: .zero,
+                                    modifierFlags: .command,
+                                    timestamp: 0.0,
+                                    windowNumber: 0,
+                                    context: nil,
+                                    characters: "",
+                                    charactersIgnoringModifiers: "",
+                                    isARepeat: false,
+                                    keyCode: keyCode)!
+        }
+        monitor.addAction(ShortcutAction(shortcut: cmd_a) {_ in true}, forKeyEvent: .down)
+        monitor.addAction(ShortcutAction(shortcut: cmd_b) {_ in false}, forKeyEvent: .down)
+
+        XCTAssertTrue(monitor.handle(makeEvent(KeyCode.ansiA.rawValue), withTarget: nil))
+        XCTAssertTrue(monitor.handle(makeEvent(KeyCode.ansiA.rawValue), withTarget: nil))
+        XCTAssertFalse(monitor.handle(makeEvent(KeyCode.ansiB.rawValue), withTarget: nil))
+        XCTAssertFalse(monitor.handle(makeEvent(KeyCode.ansiC.rawValue), withTarget: nil))
+
+        let metrics = monitor.metrics
+        XCTAssertEqual(metrics.seenEventCount, 4)
+        XCTAssertEqual(metrics.matchedEventCount, 3)
+        XCTAssertEqual(metrics.consumedEventCount, 2)
+        XCTAssertEqual(metrics.fireCount(forShortcut: cmd_a, keyEvent: .down), 2)
+        XCTAssertEqual(metrics.fireCount(forShortcut: cmd_b, keyEvent: .down), 1)
+        XCTAssertEqual(metrics.fireCount(forShortcut: cmd_a, keyEvent: .up), 0)
+        XCTAssertEqual(metrics.lookupLatencyHistogram.count, 32)
+        XCTAssertEqual(metrics.lookupLatencyHistogram.reduce(0) { $0 + $1.uint64Value }, 4)
+        XCTAssertEqual(metrics.actionLatencyHistogram.reduce(0) { $0 + $1.uint64Value }, 3)
+    }
+
+    func testShortcutSequences() {
+        let monitor = LocalShortcutMonitor()
+        let ctrl_x = Shortcut(code: .ansiX, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        let ctrl_s = Shortcut(code: .ansiS, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        let ctrl_c = Shortcut(code: .ansiC, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        func makeEvent(_ keyCode: KeyCode) -> NSEvent {
+            return NSEvent.keyEvent(with: .keyDown,
+                                    location: .zero,
+                                    modifierFlags: .control,
+                                    timestamp: 0.0,
+                                    windowNumber: 0,
+                                    context: nil,
+                                    characters: "",
+                                    charactersIgnoringModifiers: "",
+                                    isARepeat: false,
+                                    keyCode: keyCode.rawValue)!
+        }
+        var performed: [String] = []
+        monitor.addAction(ShortcutAction(shortcut: ctrl_s) { _ in performed.append("save"); return true },
+                          forShortcutSequence: [ctrl_x, ctrl_s])
+        monitor.addAction(ShortcutAction(shortcut: ctrl_c) { _ in performed.append("quit"); return true },
+                          forShortcutSequence: [ctrl_x, ctrl_c])
+        monitor.addAction(ShortcutAction(shortcut: ctrl_s) { _ in performed.append("search"); return true },
+                          forKeyEvent: .down)
+        XCTAssertEqual(Set(monitor.shortcutSequences), Set([[ctrl_x, ctrl_s], [ctrl_x, ctrl_c]]))
+
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiX), withTarget: nil))
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiS), withTarget: nil))
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiS), withTarget: nil))
+        XCTAssertEqual(performed, ["save", "search"])
+
+        performed = []
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiX), withTarget: nil))
+        XCTAssertFalse(monitor.handle(makeEvent(.ansiA), withTarget: nil))
+        XCTAssertFalse(monitor.handle(makeEvent(.ansiC), withTarget: nil))
+        XCTAssertEqual(performed, [])
+
+        monitor.shortcutSequenceTimeout = 0.01
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiX), withTarget: nil))
+        Thread.sleep(forTimeInterval: 0.05)
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiS), withTarget: nil))
+        XCTAssertEqual(performed, ["search"])
+
+        monitor.removeAllActions()
+        XCTAssertTrue(monitor.shortcutSequences.isEmpty)
+        XCTAssertFalse(monitor.handle(makeEvent(.ansiX), withTarget: nil))
+    }
+
+    func testShortcutSequenceAutoRepeat() {
+        let monitor = LocalShortcutMonitor()
+        let ctrl_x = Shortcut(code: .ansiX, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        func makeEvent(isARepeat: Bool) -> NSEvent {
+            return NSEvent.keyEvent(with: .keyDown,
+                                    location: .zero,
+                                    modifierFlags: .control,
+                                    timestamp: 0.0,
+                                    windowNumber: 0,
+                                    context: nil,
+                                    characters: "",
+                                    charactersIgnoringModifiers: "",
+                                    isARepeat: isARepeat,
+                                    keyCode: KeyCode.ansiX.rawValue)!
+        }
+        var performedCount = 0
+        monitor.addAction(ShortcutAction(shortcut: ctrl_x) { _ in performedCount += 1; return true },
+                          forShortcutSequence: [ctrl_x, ctrl_x])
+
+        XCTAssertTrue(monitor.handle(makeEvent(isARepeat: false), withTarget: nil))
+        XCTAssertTrue(monitor.handle(makeEvent(isARepeat: true), withTarget: nil), "auto-repeat is consumed by the sequence")
+        XCTAssertTrue(monitor.handle(makeEvent(isARepeat: true), withTarget: nil))
+        XCTAssertEqual(performedCount, 0)
+
+        XCTAssertTrue(monitor.handle(makeEvent(isARepeat: false), withTarget: nil))
+        XCTAssertEqual(performedCount, 1)
+
+        XCTAssertFalse(monitor.handle(makeEvent(isARepeat: true), withTarget: nil), "auto-repeat does not begin a sequence")
+        XCTAssertEqual(performedCount, 1)
+    }
 
-            override func removeObserver(_ observer: NSObject, forKeyPath keyPath: String, context: UnsafeMutableRawPointer?) {
-                if keyPath == "enabled" {
-                    removeObserverExpectation.fulfill()
+    func testShortcutSequenceActionQueue() {
+        let monitor = LocalShortcutMonitor()
+        let ctrl_x = Shortcut(code: .ansiX, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        let ctrl_s = Shortcut(code: .ansiS, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        func makeEvent(_ keyCode: KeyCode) -> NSEvent {
+            return NSEvent.keyEvent(with: .keyDown,
+                                    location: .zero,
+                                    modifierFlags: .control,
+                                    timestamp: 0.0,
+                                    windowNumber: 0,
+                                    context: nil,
+                                    characters: "",
+                                    charactersIgnoringModifiers: "",
+                                    isARepeat: false,
+                                    keyCode: keyCode.rawValue)!
+        }
+        let expectation = XCTestExpectation(description: "sequence performed")
+        monitor.addAction(ShortcutAction(shortcut: ctrl_s) { _ in
+            XCTAssertFalse(Thread.isMainThread)
+            expectation.fulfill()
+            return true
+        }, forShortcutSequence: [ctrl_x, ctrl_s])
+        monitor.actionQueue = DispatchQueue(label: "actions")
+
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiX), withTarget: nil))
+        XCTAssertTrue(monitor.handle(makeEvent(.ansiS), withTarget: nil))
+
+        wait(for: [expectation], timeout: 1.0)
+        XCTAssertEqual(monitor.actionQueueEnqueuedCount, 1)
+
+        let metrics = monitor.metrics
+        XCTAssertEqual(metrics.seenEventCount, 2)
+        XCTAssertEqual(metrics.matchedEventCount, 1)
+        XCTAssertEqual(metrics.consumedEventCount, 2)
+    }
+
+    func testRepeatPolicies() {
+        let monitor = LocalShortcutMonitor()
+        let shortcut = Shortcut(code: .ansiA, modifierFlags: .command, characters: nil, charactersIgnoringModifiers: nil)
+        func makeEvent(isARepeat: Bool) -> NSEvent {
+            return NSEvent.keyEvent(with: .keyDown,
+                                    location: .zero,
+                                    modifierFlags: .command,
+                                    timestamp: 0.0,
+                                    windowNumber: 0,
+                                    context: nil,
+                                    characters: "",
+                                    charactersIgnoringModifiers: "",
+                                    isARepeat: isARepeat,
+                                    keyCode: KeyCode.ansiA.rawValue)!
+        }
+        var repeatCounts: [UInt] = []
+        let action = ShortcutAction(shortcut: shortcut) { repeatCounts.append($0.repeatCount); return true }
+        monitor.addAction(action, forKeyEvent: .down)
+
+        for isARepeat in [false, true, true] {
+            XCTAssertTrue(monitor.handle(makeEvent(isARepeat: isARepeat), withTarget: nil))
+        }
+        XCTAssertEqual(repeatCounts, [0, 1, 1])
+
+        repeatCounts = []
+        action.repeatPolicy = .ignore
+        for isARepeat in [false, true, true] {
+            XCTAssertTrue(monitor.handle(makeEvent(isARepeat: isARepeat), withTarget: nil))
+        }
+        XCTAssertEqual(repeatCounts, [0])
+
+        repeatCounts = []
+        action.repeatPolicy = .coalesce
+        action.repeatInterval = 0.05
+        for isARepeat in [false, true, true] {
+            XCTAssertTrue(monitor.handle(makeEvent(isARepeat: isARepeat), withTarget: nil))
+        }
+        Thread.sleep(forTimeInterval: 0.1)
+        XCTAssertTrue(monitor.handle(makeEvent(isARepeat: true), withTarget: nil))
+        XCTAssertEqual(repeatCounts, [0, 3])
+    }
+
+    func testTraceRecordingAndReplay() throws {
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        defer { try? FileManager.default.removeItem(at: url) }
+        func makeEvent(_ type: NSEvent.EventType, _ keyCode: KeyCode) -> NSEvent {
+            return NSEvent.keyEvent(with: type,
+                                    location: .zero,
+                                    modifierFlags: .command,
+                                    timestamp: 0.0,
+                                    windowNumber: 0,
+                                    context: nil,
+                                    characters: "",
+                                    charactersIgnoringModifiers: "",
+                                    isARepeat: false,
+                                    keyCode: keyCode.rawValue)!
+        }
+        let shortcut = Shortcut(code: .ansiA, modifierFlags: .command, characters: nil, charactersIgnoringModifiers: nil)
+        var performedCount = 0
+        let action = ShortcutAction(shortcut: shortcut) { _ in performedCount += 1; return true }
+
+        let recordingMonitor = LocalShortcutMonitor()
+        recordingMonitor.addAction(action, forKeyEvent: .down)
+        try recordingMonitor.startTraceRecording(to: url)
+        for _ in 0..<2000 {
+            XCTAssertTrue(recordingMonitor.handle(makeEvent(.keyDown, .ansiA), withTarget: nil))
+            XCTAssertFalse(recordingMonitor.handle(makeEvent(.keyUp, .ansiA), withTarget: nil))
+            XCTAssertFalse(recordingMonitor.handle(makeEvent(.keyDown, .ansiB), withTarget: nil))
+        }
+        recordingMonitor.stopTraceRecording()
+        XCTAssertEqual(performedCount, 2000)
+
+        let replayingMonitor = LocalShortcutMonitor()
+        replayingMonitor.addAction(action, forKeyEvent: .down)
+        var mismatchCount = 0
+        try replayingMonitor.replayTrace(at: url, mismatchCount: &mismatchCount)
+        XCTAssertEqual(mismatchCount, 0)
+        XCTAssertEqual(performedCount, 4000)
+        XCTAssertEqual(replayingMonitor.metrics.seenEventCount, 6000)
+
+        replayingMonitor.removeAllActions()
+        try replayingMonitor.replayTrace(at: url, mismatchCount: &mismatchCount)
+        XCTAssertEqual(mismatchCount, 2000)
+    }
+
+    func testTraceReplayFollowsRecordedTiming() throws {
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        defer { try? FileManager.default.removeItem(at: url) }
+        let ctrl_x = Shortcut(code: .ansiX, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        let ctrl_s = Shortcut(code: .ansiS, modifierFlags: .control, characters: nil, charactersIgnoringModifiers: nil)
+        func makeEvent(_ keyCode: KeyCode) -> NSEvent {
+            return NSEvent.keyEvent(with: .keyDown,
+                                    location: .zero,
+                                    modifierFlags: .control,
+                                    timestamp: 0.0,
+                                    windowNumber: 0,
+                                    context: nil,
+                                    characters: "",
+                                    charactersIgnoringModifiers: "",
+                                    isARepeat: false,
+                                    keyCode: keyCode.rawValue)!
+        }
+        var performedCount = 0
+        let action = ShortcutAction(shortcut: ctrl_s) { _ in performedCount += 1; return true }
+        func makeMonitor() -> LocalShortcutMonitor {
+            let monitor = LocalShortcutMonitor()
+            monitor.shortcutSequenceTimeout = 0.05
+            monitor.addAction(action, forShortcutSequence: [ctrl_x, ctrl_s])
+            return monitor
+        }
+
+        let recordingMonitor = makeMonitor()
+        try recordingMonitor.startTraceRecording(to: url)
+        XCTAssertTrue(recordingMonitor.handle(makeEvent(.ansiX), withTarget: nil))
+        Thread.sleep(forTimeInterval: 0.1)
+        XCTAssertFalse(recordingMonitor.handle(makeEvent(.ansiS), withTarget: nil), "sequence timed out")
+        XCTAssertTrue(recordingMonitor.handle(makeEvent(.ansiX), withTarget: nil))
+        XCTAssertTrue(recordingMonitor.handle(makeEvent(.ansiS), withTarget: nil))
+        recordingMonitor.stopTraceRecording()
+        XCTAssertEqual(performedCount, 1)
+
+        // Replayed back to back the first sequence would complete as well.
+        var mismatchCount = 0
+        try makeMonitor().replayTrace(at: url, mismatchCount: &mismatchCount)
+        XCTAssertEqual(mismatchCount, 0)
+        XCTAssertEqual(performedCount, 2)
+    }
+
+    func testLookupDuringConcurrentMutation() {
+        let monitor = ShortcutMonitor()
+        let actions = (0..<8).map { _ in ShortcutAction(shortcut: .default) {_ in true} }
+        let allActions = Set(actions)
+
+        DispatchQueue.concurrentPerform(iterations: 4) { index in
+            for _ in 0..<500 {
+                if index == 0 {
+                    actions.forEach { monitor.addAction($0, forKeyEvent: .down) }
+                    actions.forEach { monitor.removeAction($0) }
+                }
+                else {
+                    let enabledActions = monitor.enabledActions(forShortcut: .default, keyEvent: .down)
+                    XCTAssertTrue(Set(enabledActions).isSubset(of: allActions))
+                    XCTAssertTrue(Set(monitor.actions).isSubset(of: allActions))
                 }
-                super.removeObserver(observer, forKeyPath: keyPath, context: context)
             }
         }
 
+        XCTAssertTrue(monitor.actions.isEmpty)
+        XCTAssertTrue(monitor.shortcuts.isEmpty)
+    }
+
+    func testActionAddedTwiceIsObservedJustOnce() {
         func test(_ keyEvent1: KeyEventType, _ keyEvent2: KeyEventType) {
-            let action = ObservedAction(shortcut: .default) { _ in true }
+            let action = ShortcutAction(shortcut: .default) { _ in true }
             let monitor = TrackingMonitor()
 
             monitor.addAction(action, forKeyEvent: keyEvent1)
             monitor.addAction(action, forKeyEvent: keyEvent2)
             monitor.removeAction(action, forKeyEvent: keyEvent1)
+
+            action.isEnabled = false
+            XCTAssertTrue(monitor.shortcuts.isEmpty)
+            action.isEnabled = true
+            XCTAssertEqual(monitor.shortcuts, [.default])
+
             monitor.removeAction(action, forKeyEvent: keyEvent2)
-            wait(for: [action.addObserverExpectation, action.removeObserverExpectation], timeout: 0)
+            XCTAssertTrue(monitor.shortcuts.isEmpty)
+
+            action.isEnabled = false
+            action.isEnabled = true
+            action.shortcut = Shortcut(keyEquivalent: "⌘B")
+            XCTAssertTrue(monitor.shortcuts.isEmpty)
+            XCTAssertTrue(monitor.actions.isEmpty)
         }
 
         XCTContext.runActivity(named: "down key event") { _ in test(.down, .down) }
@@ -1037,6 +1522,22 @@ class SRGlobalShortcutMonitorTests: XCTestCase {
         XCTAssertEqual(monitor.changes, [.add, .remove])
     }
 
+    func testBatchUpdatesInstallHandlerForNetDifference() {
+        let monitor = TrackingMonitor()
+        let action = ShortcutAction(shortcut: Shortcut.default) { _ in true }
+        monitor.performBatchUpdates {
+            monitor.addAction(action, forKeyEvent: .down)
+            monitor.removeAction(action)
+        }
+        XCTAssertEqual(monitor.changes, [])
+        monitor.performBatchUpdates {
+            monitor.addAction(action, forKeyEvent: .down)
+            monitor.addAction(action, forKeyEvent: .up)
+        }
+        XCTAssertEqual(monitor.changes, [.add])
+        monitor.removeAllActions()
+    }
+
     func testDeallocationRemovesHandler() {
         let didAddExpectation = XCTestExpectation(description: "did add", assertForOverFulfill: true)
         let didRemoveExpectation = XCTestExpectation(description: "did remove", assertForOverFulfill: true)
@@ -1120,6 +1621,32 @@ class SRGlobalShortcutMonitorTests: XCTestCase {
         XCTAssertEqual(monitor.changes, [.add, .remove, .add])
     }
 
+    func testSuspendingPauseKeepsHandler() {
+        let monitor = TrackingMonitor()
+        monitor.pauseBehavior = .suspend
+        let action1 = ShortcutAction(shortcut: .default) { _ in true }
+        let action2 = ShortcutAction(shortcut: Shortcut(keyEquivalent: "⌘B")!) { _ in true }
+
+        monitor.addAction(action1, forKeyEvent: .down)
+        monitor.pause()
+        monitor.addAction(action2, forKeyEvent: .down)
+        monitor.removeAction(action1)
+        monitor.resume()
+        XCTAssertEqual(monitor.changes, [.add])
+
+        monitor.pause()
+        monitor.pauseBehavior = .unregister
+        monitor.resume()
+        XCTAssertEqual(monitor.changes, [.add])
+
+        monitor.pause()
+        XCTAssertEqual(monitor.changes, [.add, .remove])
+        monitor.pauseBehavior = .suspend
+        monitor.resume()
+        XCTAssertEqual(monitor.changes, [.add, .remove, .add])
+        monitor.removeAllActions()
+    }
+
     func testAddingKeylessShortcutDoesNotInstallHandler() {
         let monitor = TrackingMonitor()
         monitor.didAddExpectation = XCTestExpectation(description: "did add", isInverted: true)
@@ -1133,3 +1660,69 @@ class SRGlobalShortcutMonitorTests: XCTestCase {
         wait(for: [monitor.didAddExpectation, monitor.didRemoveExpectation], timeout: 0, enforceOrder: true)
     }
 }
+
+
+class SRAXGlobalShortcutMonitorTests: XCTestCase {
+    func testModifierGestures() throws {
+        // The event tap requires the Accessibility permission.
+        guard let monitor = AXGlobalShortcutMonitor() else { return }
+        let option = KeyCode(rawValue: UInt16(kVK_Option))!
+        let leftOptionFlags = CGEventFlags(rawValue: CGEventFlags.maskAlternate.rawValue | 0x20)
+        // The shortcut of the action is ignored by gestures.
+        let shortcut = Shortcut(code: .ansiA, modifierFlags: .option, characters: nil, charactersIgnoringModifiers: nil)
+        var now: UInt64 = 1_000_000_000
+        monitor.modifierGestureClock = { now }
+
+        func send(_ type: CGEventType, _ keyCode: Int, _ flags: CGEventFlags, after aDelay: UInt64 = 0) {
+            now += aDelay * 1_000_000
+            let event = CGEvent(keyboardEventSource: nil, virtualKey: CGKeyCode(keyCode), keyDown: type != .keyUp)!
+            event.type = type
+            event.flags = flags
+            _ = monitor.handle(event)
+        }
+
+        var performed: [String] = []
+        monitor.addAction(ShortcutAction(shortcut: shortcut) { _ in performed.append("tap"); return true },
+                          forModifierGesture: .tap(keyCode: option))
+        monitor.addAction(ShortcutAction(shortcut: shortcut) { _ in performed.append("double-tap"); return true },
+                          forModifierGesture: .doubleTap(keyCode: option, interval: 0.25))
+        monitor.addAction(ShortcutAction(shortcut: shortcut) { _ in performed.append("hold"); return true },
+                          forModifierGesture: .hold(keyCode: option, duration: 0.5))
+        XCTAssertEqual(monitor.modifierGestures.count, 3)
+
+        send(.flagsChanged, kVK_Option, leftOptionFlags)
+        send(.flagsChanged, kVK_Option, [], after: 50)
+        send(.flagsChanged, kVK_Option, leftOptionFlags, after: 100)
+        send(.flagsChanged, kVK_Option, [], after: 50)
+        XCTAssertEqual(performed, ["tap", "tap", "double-tap"])
+
+        performed = []
+        send(.flagsChanged, kVK_Option, leftOptionFlags, after: 1000)
+        send(.flagsChanged, kVK_Option, [], after: 600)
+        XCTAssertEqual(performed, ["hold"])
+
+        performed = []
+        send(.flagsChanged, kVK_Option, leftOptionFlags, after: 1000)
+        send(.keyDown, kVK_ANSI_A, leftOptionFlags, after: 10)
+        send(.keyUp, kVK_ANSI_A, leftOptionFlags, after: 10)
+        send(.flagsChanged, kVK_Option, [], after: 10)
+        XCTAssertEqual(performed, [])
+
+        // Gesture actions go through the action queue like actions of any other shortcut.
+        let queue = DispatchQueue(label: "actions")
+        monitor.actionQueue = queue
+        let matchedEventCount = monitor.metrics.matchedEventCount
+        performed = []
+        send(.flagsChanged, kVK_Option, leftOptionFlags, after: 1000)
+        send(.flagsChanged, kVK_Option, [], after: 50)
+        let didPerform = NSPredicate { _, _ in queue.sync { !performed.isEmpty } }
+        wait(for: [XCTNSPredicateExpectation(predicate: didPerform, object: nil)], timeout: 1.0)
+        XCTAssertEqual(queue.sync { performed }, ["tap"])
+        XCTAssertEqual(monitor.actionQueueEnqueuedCount, 1)
+        XCTAssertEqual(monitor.metrics.matchedEventCount, matchedEventCount + 1)
+        monitor.actionQueue = nil
+
+        monitor.removeAllActions()
+        XCTAssertTrue(monitor.modifierGestures.isEmpty)
+    }
+}
@@ -465,6 +465,10 @@ class SRShortcutTests: XCTestCase {
 
         let ctrl_esc = Shortcut(code: KeyCode.escape, modifierFlags: [.control], characters: nil, charactersIgnoringModifiers: nil)
         XCTAssertEqual(Shortcut(keyEquivalent: "⌃Escape"), ctrl_esc)
+
+        let shift_cmd_1 = Shortcut(code: KeyCode.ansi1, modifierFlags: [.shift, .command], characters: nil, charactersIgnoringModifiers: nil)
+        XCTAssertEqual(Shortcut(keyEquivalent: "⌘!"), shift_cmd_1)
+        XCTAssertEqual(Shortcut(keyEquivalent: "⇧⌘!"), shift_cmd_1)
     }
 
     func testInitializationWithFlagsChangedEvent() {